@@ -1,131 +1,253 @@
-//*****************************************************************************
-//! @file       device_config.h
-//! @brief      Hardware definitions for the compiler
-//!
-//!
-//!
-//	Copyright (C) 2015 Texas Instruments Incorporated - http://www.ti.com/
-//
-//
-//  Redistribution and use in source and binary forms, with or without
-//  modification, are permitted provided that the following conditions
-//  are met:
-//
-//    Redistributions of source code must retain the above copyright
-//    notice, this list of conditions and the following disclaimer.
-//
-//    Redistributions in binary form must reproduce the above copyright
-//    notice, this list of conditions and the following disclaimer in the
-//    documentation and/or other materials provided with the distribution.
-//
-//    Neither the name of Texas Instruments Incorporated nor the names of
-//    its contributors may be used to endorse or promote products derived
-//    from this software without specific prior written permission.
-//
-//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-//  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-//  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-//  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-//  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-//****************************************************************************/
-
-
-/**************************************************************************//**
- * @addtogroup Config
- * @{
- ******************************************************************************/
-#ifndef HWCONFIG
-#define HWCONFIG
-
-
-/*!
- * \brief Frequency Standard. Available options:
- * \li \b	MODE_FCC
- * \li \b	MODE_ETSI
- */
-#define MODE_FCC
-
-/*!
- * \brief CC112X EVM Selection. Available options:
- *  \li \b CC1125EM_CAT1_868
- *  \li \b CC1120_BOOSTERPACK
- *  \li \b OTHER for custom boards
- */
-#define CC1120_BOOSTERPACK
-
-
-/*!
- * \brief Demo Control Interface. Available options:
- * 	\li \b AT_CMD for AT-commands over UART to control from a host
- * 	\li \b PB_KEY for Push Button triggered interface controlled by MSP430
- * \note Both interfaces can be defined simultaneously.
- */
-#define PB_KEY
-#define AT_CMD
-
-/*!
- * \brief This is the value of the external oscillator connected to CC112X
- *	between XOSC_Q1(Pin 30) and XOSC_Q2(Pin31). Choose from the following
- *	values depending on hardware configuration.
- *	\li \b	RF_XTAL_FREQ_40MHZ
- *	\li \b	RF_XTAL_FREQ_32MHZ
- */
-#if defined(CC1125EM_CAT1_868)
-#define RF_XTAL_FREQ_40MHZ	/*<! This board has a 40MHz XTAL*/
-#elif defined(CC1120_BOOSTERPACK)
-#define RF_XTAL_FREQ_32MHZ	/*<! This board has a 32MHz XTAL */
-#define CC1190_PA_LNA		/*<! Boosterpack has CC1190 PA/LNA */
-#elif defined(OTHER)		/* Other hardware -> manually define XTAL value */
-// define the XTAL frequency used in the custom board
-#define RF_XTAL_FREQ_40MHZ
-// define if using CC1190 PA/LNA
-#define CC1190_PA_LNA
-#else
-#error RF_XTAL_FREQ must be defined in apps/device_config.h
-#endif
-
-/*
- * 	example:
- * 	For		tranmit frequency 902.8MHz, receive frequency 904MHz
- *		#define		ftx		902800000
- *		#define 	frx		904000000
- */
-/*!
- *  \def ftx
- * 	\brief TX carrier frequency in Hz
- */
-/*!
- *  \def frx
- *  \brief RX carrier frequency in Hz
- */
-#if defined(MODE_FCC)
-#define ftx		902200000
-#define frx		905200000
-#elif defined(MODE_ETSI)
-#define ftx		868130000
-#define frx		869525000
-#else
-#error incorrect Frequency Standard defined in apps/device_config.h
-#endif
-
-
-/*!
- * \brief The RF_DEBUG flag will display the TX and RX frequency values on UART.
- * 		  The RF_DEGUG_ADV will display the frequency register values on UART.
- */
-//#define RF_DEBUG
-//#define RF_DEBUG_ADV
-
-
-#endif //HWCONFIG
-
-/**************************************************************************//**
- * Close the Doxygen group.
- * @}
- ******************************************************************************/
+//*****************************************************************************
+//! @file       device_config.h
+//! @brief      Hardware definitions for the compiler
+//!
+//!
+//!
+//	Copyright (C) 2015 Texas Instruments Incorporated - http://www.ti.com/
+//
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//    Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    Neither the name of Texas Instruments Incorporated nor the names of
+//    its contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//****************************************************************************/
+
+
+/**************************************************************************//**
+ * @addtogroup Config
+ * @{
+ ******************************************************************************/
+#ifndef HWCONFIG
+#define HWCONFIG
+
+
+/*!
+ * \brief Frequency Standard. Available options:
+ * \li \b	MODE_FCC
+ * \li \b	MODE_ETSI
+ * \li \b	MODE_ETSI_OPT
+ * 		It gives the frequencies below and the modulation profile selected at
+ * 		start-up, see RADIO_select_profile().
+ */
+#define MODE_FCC
+
+/*!
+ * \brief CC112X EVM Selection. Available options:
+ *  \li \b CC1125EM_CAT1_868
+ *  \li \b CC1120_BOOSTERPACK
+ *  \li \b OTHER for custom boards
+ */
+#define CC1120_BOOSTERPACK
+
+
+/*!
+ * \brief Demo Control Interface. Available options:
+ * 	\li \b AT_CMD for AT-commands over UART to control from a host
+ * 	\li \b PB_KEY for Push Button triggered interface controlled by MSP430
+ * \note Both interfaces can be defined simultaneously.
+ */
+#define PB_KEY
+#define AT_CMD
+
+/*!
+ * \brief This is the value of the external oscillator connected to CC112X
+ *	between XOSC_Q1(Pin 30) and XOSC_Q2(Pin31). Choose from the following
+ *	values depending on hardware configuration.
+ *	\li \b	RF_XTAL_FREQ_40MHZ
+ *	\li \b	RF_XTAL_FREQ_32MHZ
+ */
+#if defined(CC1125EM_CAT1_868)
+#define RF_XTAL_FREQ_40MHZ	/*<! This board has a 40MHz XTAL*/
+#elif defined(CC1120_BOOSTERPACK)
+#define RF_XTAL_FREQ_32MHZ	/*<! This board has a 32MHz XTAL */
+#define CC1190_PA_LNA		/*<! Boosterpack has CC1190 PA/LNA */
+#elif defined(OTHER)		/* Other hardware -> manually define XTAL value */
+// define the XTAL frequency used in the custom board
+#define RF_XTAL_FREQ_40MHZ
+// define if using CC1190 PA/LNA
+#define CC1190_PA_LNA
+#else
+#error RF_XTAL_FREQ must be defined in apps/device_config.h
+#endif
+
+/*
+ * 	example:
+ * 	For		tranmit frequency 902.8MHz, receive frequency 904MHz
+ *		#define		ftx		902800000
+ *		#define 	frx		904000000
+ */
+/*!
+ *  \def ftx
+ * 	\brief TX carrier frequency in Hz
+ */
+/*!
+ *  \def frx
+ *  \brief RX carrier frequency in Hz
+ */
+/*!
+ *  \def RADIO_PROFILE_DEFAULT
+ *  \brief Modulation profile selected at start-up, see ::te_ModProfileId
+ */
+#if defined(MODE_FCC)
+#define ftx		902200000
+#define frx		905200000
+#define RADIO_PROFILE_DEFAULT	E_PROFILE_FCC
+#elif defined(MODE_ETSI)
+#define ftx		868130000
+#define frx		869525000
+#define RADIO_PROFILE_DEFAULT	E_PROFILE_ETSI
+#elif defined(MODE_ETSI_OPT)
+#define ftx		868130000
+#define frx		869525000
+#define RADIO_PROFILE_DEFAULT	E_PROFILE_ETSI_OPT
+#else
+#error incorrect Frequency Standard defined in apps/device_config.h
+#endif
+
+
+/*!
+ * \brief The RADIO_DMA_MODULATION flag streams the PA ramps of the modulation
+ * 		  to the CC112X with a Timer_B0 paced DMA channel instead of busy-wait
+ * 		  loops. The PA and FREQOFF profile (MODE_ETSI_OPT) keeps
+ * 		  the busy-wait loops.
+ */
+//#define RADIO_DMA_MODULATION
+
+
+/*!
+ * \brief The RADIO_HW_PA_RAMP flag lets the CC112X ramp the PA itself
+ * 		  (PA_CFG1 ramp shaping) when the carrier starts and stops. With
+ * 		  the PA ramp profiles (MODE_FCC, MODE_ETSI), the phase flip dips
+ * 		  leave TX (FSTXON) and enter it again instead of writing the ramp.
+ * 		  It takes precedence over RADIO_DMA_MODULATION.
+ */
+//#define RADIO_HW_PA_RAMP
+
+
+/*!
+ * \brief The TX_POLLING_ENGINE flag makes sfx_send() poll the state set by
+ * 		  the bit rate timer interrupt instead of sleeping in LPM0 till the
+ * 		  interrupt wakes it up for a '0' bit. Both engines modulate out of
+ * 		  the interrupt.
+ * 		  The TX_JITTER_STATS flag records in TxJitter the latency between
+ * 		  the bit rate interrupt and the start of the modulation, to compare
+ * 		  both engines.
+ */
+//#define TX_POLLING_ENGINE
+//#define TX_JITTER_STATS
+
+
+/*!
+ * \brief The RADIO_FS_CAL_CACHE flag switches the CC112X synthesizer to manual
+ * 		  calibration. The calibration results are kept per channel and
+ * 		  written back on the next hops instead of calibrating again.
+ */
+//#define RADIO_FS_CAL_CACHE
+
+
+/*!
+ * \brief The RADIO_TX_SESSION flag keeps the CC112X configured between the
+ * 		  repeats of a frame: the repeats only change the frequency. The
+ * 		  synthesizer keeps running (FSTXON) unless sfx_delay() is called
+ * 		  between the repeats.
+ */
+//#define RADIO_TX_SESSION
+
+
+/*!
+ * \brief The RADIO_XTAL_COMP flag corrects the TX and RX frequencies for the
+ * 		  CC112X XTAL error. The error is learned from the frequency offset
+ * 		  (FREQOFF_EST) of the received downlink frames and kept by
+ * 		  temperature in the MSP430 information memory (segment D). The RX
+ * 		  windows following a miss search around the correction. The
+ * 		  temperature comes from ADC_MEASUREMENT: without it the table
+ * 		  would only ever use the 25.0 degC bin.
+ */
+//#define RADIO_XTAL_COMP
+
+
+/*!
+ * \brief The NVM_LOW_VOLTAGE_FLUSH flag writes the PN9 and sequence number
+ * 		  cache to flash when the supply drops below the SVM high side
+ * 		  level (system NMI). The cache otherwise goes to flash when a
+ * 		  frame with a new sequence number starts.
+ */
+//#define NVM_LOW_VOLTAGE_FLUSH
+
+
+/*!
+ * \brief The ADC_MEASUREMENT flag measures the supply and the temperature given
+ * 		  to the library by sfx_get_voltage_temperature(): AVCC/2 and the
+ * 		  internal sensor with the ADC12_A, averaged over DMA channels 1 and
+ * 		  2. The idle values are measured after each frame, the TX supply in
+ * 		  the middle of the longest PA plateau of the frame.
+ * 		  It takes the ADC12_A, the REF module and DMA channels 1 and 2, and
+ * 		  the DMA vector without RADIO_DMA_MODULATION. Without it the
+ * 		  library gets the fixed values of sfx_get_voltage_temperature().
+ */
+//#define ADC_MEASUREMENT
+
+#if defined(RADIO_XTAL_COMP) && !defined(ADC_MEASUREMENT)
+#error RADIO_XTAL_COMP needs the temperature of ADC_MEASUREMENT in apps/device_config.h
+#endif
+
+
+/*!
+ * \brief The RADIO_LBT flag listens to the TX frequency before each frame
+ * 		  (listen before talk). A busy channel, RSSI over RADIO_LBT_THRESHOLD,
+ * 		  is listened to again after a random backoff, see RADIO_lbt().
+ */
+//#define RADIO_LBT
+
+
+/*!
+ * \brief The TX_REPEAT_ADAPTIVE flag lets sfx_link_adapt() set the repeats
+ * 		  of the uplink frames (TxRep, 0 to 2) from the link margin: the RSSI
+ * 		  of the downlink frames and the downlink acks received or missed.
+ * 		  The TX_POWER_ADAPTIVE flag lowers the PA level of the uplink frames
+ * 		  as long as the margin allows, up to 24 dB, see
+ * 		  RADIO_set_power_ceiling().
+ * 		  TX_LINK_RELIABILITY is the target, in frames delivered per 1000.
+ */
+//#define TX_REPEAT_ADAPTIVE
+//#define TX_POWER_ADAPTIVE
+#define TX_LINK_RELIABILITY		990
+
+
+/*!
+ * \brief The RF_DEBUG flag will display the TX and RX frequency values on UART.
+ * 		  The RF_DEGUG_ADV will display the frequency register values on UART.
+ */
+//#define RF_DEBUG
+//#define RF_DEBUG_ADV
+
+
+#endif //HWCONFIG
+
+/**************************************************************************//**
+ * Close the Doxygen group.
+ * @}
+ ******************************************************************************/
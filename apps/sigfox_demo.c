@@ -34,6 +34,9 @@
 #include "bsp_led.h"
 #include "bsp_key.h"
 #include "uart_drv.h"
+#ifdef ADC_MEASUREMENT
+#include "adc.h"
+#endif
 #include "../sigfox_library_api/sigfox.h"
 #include "../sigfox_library_api/sigfox_types.h"
 
@@ -78,11 +81,7 @@ u32 TxFrequency; /*!< Init of the Transmit central frequency */
 u32 RxFrequency; /*!< Init of the Receive central frequency */
 
 u8  TxRep = 2;               /*!< Init of the number of repetition of the Transmit frame which initiate the Downlink */
-#if defined(MODE_ETSI)||defined(MODE_ETSI_OPT)
-SFX_std_t standard = SFX_STD_ETSI;
-#else
-SFX_std_t standard = SFX_STD_FCC;
-#endif
+SFX_std_t standard;		/*!< Given by the modulation profile, see RADIO_select_profile() */
 
 /* Pointers used by the SigFox library : Do not modify */
 u8* key_ptr  = (u8*)&key; /*!< Library key pointer init */
@@ -129,37 +128,6 @@ static const char pLcdTiLogo[1024] =
 /******************************************************************************
 * FUNCTIONS
 */
-/***************************************************************************//**
- *   @brief		Initializes dynamic memory blocks
- *   @param 	nb_blocks is the number of blocks
- *   @param		size_block is the size of each block
- *   @param		start_memory_ptr is the pointer to the begining of the block
- *   @param		table_ptr is a pointer to the initialized memory
- ******************************************************************************/
-static void
-memory_block_init ( int nb_blocks, int size_block, u8 *start_memory_ptr, MemoryBlock *table_ptr )
-{
-	u8 i = 0;
-	for ( i = 0; i < nb_blocks ; i++ )
-	{
-		table_ptr->memory_ptr = start_memory_ptr + i*size_block;
-		table_ptr->allocated = FALSE;
-		table_ptr++;
-	}
-}
-
-/***************************************************************************//**
- *   @brief		Initializes the dynamic memory required for the demo
- ******************************************************************************/
-static void
-dynamic_memory_init ( void )
-{
-	memory_block_init(NUMBER_BLOCKS_64BYTES, BYTES_SIZE_64,(u8*)(DynamicMemoryTable + START_MEMORY_BLOCK_64BYTES), Table_64bytes );
-	memory_block_init(NUMBER_BLOCKS_32BYTES, BYTES_SIZE_32,(u8*)(DynamicMemoryTable + START_MEMORY_BLOCK_32BYTES), Table_32bytes );
-	memory_block_init(NUMBER_BLOCKS_30BYTES, BYTES_SIZE_30,(u8*)(DynamicMemoryTable + START_MEMORY_BLOCK_30BYTES), Table_30bytes );
-	memory_block_init(NUMBER_BLOCKS_8BYTES, BYTES_SIZE_8,  (u8*)(DynamicMemoryTable + START_MEMORY_BLOCK_8BYTES) , Table_8bytes );
-}
-
 ///******************************************************************************
 // * Global Var for I2C
 // */
@@ -272,7 +240,11 @@ main(void)
 #endif
 
 	//Initialize the memory
-	dynamic_memory_init();
+	sfx_memory_init();
+
+	// Select the modulation profile before the bit rate timer and the library use it
+	RADIO_select_profile(RADIO_PROFILE_DEFAULT);
+	standard = RADIO_get_profile()->e_Standard;
 
 	// Initialize MCU and Peripherals
 	initMCU();
@@ -286,6 +258,9 @@ main(void)
 	// Write the uplink and downlink frequencies if device is programmed for first time
 	resetCF();
 
+	// Load the PN9 and sequence number cache from flash
+	sfx_nv_mem_init();
+
 	// SIGFOX library init
 	err = SfxInit();
 	assert(SFX_ERR_NONE == err);
@@ -333,6 +308,8 @@ main(void)
 			bspLedClear(BSP_LED_2);
 			bspLedSet(BSP_LED_1);
 
+			// Repeats and power of the frame for the link margin
+			sfx_link_adapt();
 
 			if(buttonPressed == BSP_KEY_UP)
 			{
@@ -407,6 +384,7 @@ main(void)
  *	 @note 		\li \b UART interface
  *	 @note 		\li \b PA_LNA controls
  *	 @note 		\li \b TIMER Bit Rate for the symbols
+ *	 @note 		\li \b ADC supply and temperature measurement
  *	 @note 		\li \b INTERRUPT enable service
  *******************************************************************************/
 static void
@@ -467,6 +445,14 @@ initMCU(void)
 	 */
 	TIMER_bitrate_init();
 
+	// Start the ACLK time base of the statistics
+	TIMER_timebase_init();
+
+#ifdef ADC_MEASUREMENT
+	// Supply and temperature measurement, the first one starts now
+	ADC_init();
+#endif
+
 	// Enable global interrupt
 	_BIS_SR(GIE);
 }
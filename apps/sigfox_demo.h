@@ -22,48 +22,71 @@ typedef enum{
 }e_SystemState;
 
 
-#define BYTES_SIZE_64 64
-#define BYTES_SIZE_32 32
-#define BYTES_SIZE_30 30
-#define BYTES_SIZE_8   8
+/*!
+ * \brief Memory pool of the SigFox library, one SFX_POOL_CLASS(block size,
+ * 		  number of blocks) per class, by increasing block size. A request
+ * 		  takes the smallest class that fits, or the next one when it is full.
+ * \note  The library asks 2 x 30 bytes from SfxInit() to SfxClose(), 32 bytes
+ * 		  while a frame is built and 8 bytes for an out of band frame. The
+ * 		  64 byte block of the original tables is kept.
+ * \note  Up to 16 blocks per class.
+ */
+#define SFX_MEMORY_POOL(SFX_POOL_CLASS) \
+	SFX_POOL_CLASS( 8, 1) \
+	SFX_POOL_CLASS(30, 2) \
+	SFX_POOL_CLASS(32, 1) \
+	SFX_POOL_CLASS(64, 1)
+
+#define SFX_POOL_BYTES(size, nb)	+ (size) * (nb)
+#define SFX_POOL_BLOCKS(size, nb)	+ (nb)
+#define SFX_POOL_CLASSES(size, nb)	+ 1
+
+#define SFX_DYNAMIC_MEMORY	(0 SFX_MEMORY_POOL(SFX_POOL_BYTES))
+#define SFX_POOL_NB_BLOCKS	(0 SFX_MEMORY_POOL(SFX_POOL_BLOCKS))
+#define SFX_POOL_NB_CLASSES	(0 SFX_MEMORY_POOL(SFX_POOL_CLASSES))
 
-#define NUMBER_BLOCKS_64BYTES 1
-#define NUMBER_BLOCKS_32BYTES 1
-#define NUMBER_BLOCKS_30BYTES 2
-#define NUMBER_BLOCKS_8BYTES  1
-
-#define START_DYNAMIC_MEMORY 0
-
-#define START_MEMORY_BLOCK_64BYTES START_DYNAMIC_MEMORY
-#define END_MEMORY_BLOCK_64BYTES START_DYNAMIC_MEMORY +  NUMBER_BLOCKS_64BYTES * BYTES_SIZE_64
-
-#define START_MEMORY_BLOCK_32BYTES END_MEMORY_BLOCK_64BYTES
-#define END_MEMORY_BLOCK_32BYTES START_MEMORY_BLOCK_32BYTES + NUMBER_BLOCKS_32BYTES * BYTES_SIZE_32
-
-#define START_MEMORY_BLOCK_30BYTES END_MEMORY_BLOCK_32BYTES
-#define END_MEMORY_BLOCK_30BYTES START_MEMORY_BLOCK_30BYTES + NUMBER_BLOCKS_30BYTES * BYTES_SIZE_30
-
-#define START_MEMORY_BLOCK_8BYTES END_MEMORY_BLOCK_30BYTES
-#define END_MEMORY_BLOCK_8BYTES START_MEMORY_BLOCK_8BYTES + NUMBER_BLOCKS_8BYTES * BYTES_SIZE_8
-
-#define SFX_DYNAMIC_MEMORY END_MEMORY_BLOCK_8BYTES
+/********************************
+ * \struct MemoryPool
+ * \brief blocks of one size of the memory pool
+ *******************************/
+typedef struct
+{
+	u8 * memory_ptr;	/*!< pointer to the first block */
+	u16 size;			/*!< size of the blocks */
+	u16 free;			/*!< bitmap of the free blocks */
+	u8  nb_blocks;		/*!< number of blocks */
+	u8  first;			/*!< index of the first block in the pool */
+}MemoryPool;
 
 /********************************
- * \struct MemoryBlock
- * \brief memory block
+ * \struct MemoryPoolStats
+ * \brief memory pool counters, in bytes or allocations
  *******************************/
 typedef struct
 {
-	u8 * memory_ptr;	/*!< pointer to the memory location */
-	u8  allocated;		/*!< allocation status */
-}MemoryBlock;
+	u16 in_use;			/*!< bytes of the blocks in use */
+	u16 high_watermark;	/*!< highest in_use */
+	u16 wasted;			/*!< bytes of the blocks in use beyond the requested sizes */
+	u16 wasted_max;		/*!< highest wasted */
+	u16 spilled;		/*!< allocations served by a larger class, the best fit being full */
+	u16 failed;			/*!< allocations without a free block */
+	u16 fragmented;		/*!< failed allocations of a size the pool serves, the free bytes would have fit */
+}MemoryPoolStats;
+
+/********************************
+ * \brief application work run during the downlink waits,
+ * called with the seconds left in the wait
+ *******************************/
+typedef void (*SfxWaitHook)(u16 seconds_left);
 
 extern u8 DynamicMemoryTable[SFX_DYNAMIC_MEMORY];
 
-extern MemoryBlock Table_64bytes[NUMBER_BLOCKS_64BYTES];
-extern MemoryBlock Table_32bytes[NUMBER_BLOCKS_32BYTES];
-extern MemoryBlock Table_30bytes[NUMBER_BLOCKS_30BYTES];
-extern MemoryBlock Table_8bytes[NUMBER_BLOCKS_8BYTES];
+void sfx_memory_init(void);
+const MemoryPoolStats * sfx_memory_stats(void);
+void sfx_set_wait_hook(SfxWaitHook hook);
+void sfx_nv_mem_init(void);
+void sfx_nv_mem_flush(void);
+void sfx_link_adapt(void);
 
 
 #endif
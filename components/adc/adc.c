@@ -0,0 +1,419 @@
+//*****************************************************************************
+//! @file       adc.c
+//! @brief      Supply voltage and temperature measurement.
+//!				The ADC12_A converts the internal temperature sensor and
+//!				AVCC/2 against the 2.0 V reference, the samples are moved by
+//!				DMA and averaged when the sequence completes.
+//!       \li \e idle after each frame, see ADC_start_idle()
+//!       \li \e TX in the middle of a PA plateau, see ADC_start_tx()
+//!
+//****************************************************************************/
+
+
+/**************************************************************************//**
+* @addtogroup Adc
+* @{
+******************************************************************************/
+
+
+/******************************************************************************
+ * INCLUDES
+ */
+#include "msp430.h"
+#include "driverlib.h"
+#include "hal_types.h"
+#include "device_config.h"
+#include "adc.h"
+
+#ifdef ADC_MEASUREMENT
+
+/******************************************************************************
+ * DEFINES
+ */
+/* The ADC12_A hardware triggers (TA0.1, TB0.0, TB0.1) are used by the delays
+ * and the radio: the sequences start with ADC12SC, the sampling timer paces
+ * the conversions (MSC) */
+#define ADC_MEM_TEMP			ADC12_A_MEMORY_7	// Last memory sampled with SHT0
+#define ADC_MEM_VDD				ADC12_A_MEMORY_8	// First memory sampled with SHT1
+#define ADC_SAMPLES				(ADC_SETTLE + ADC_OVERSAMPLING)
+
+/* Sample times on ADC12OSC (4.2 to 5.4 MHz): the temperature sensor needs
+ * 30 us, AVCC/2 1 us */
+#define ADC_SHT_TEMP			ADC12_A_CYCLEHOLD_256_CYCLES
+#define ADC_SHT_VDD				ADC12_A_CYCLEHOLD_16_CYCLES
+
+/* DMA trigger select of ADC12IFGx, the end of the sequence */
+#define ADC_DMA_TSEL_ADC12IFG	DMA_TRIGGERSOURCE_24
+#define ADC_DMA_TEMP			DMA_CHANNEL_1
+#define ADC_DMA_VDD				DMA_CHANNEL_2		// Interrupt at the end of the measurement
+
+/* TLV words of the ADC12 and REF calibration tags */
+#define TLV_ADC12_GAIN			0
+#define TLV_ADC12_OFFSET		1
+#define TLV_ADC12_20T30			4
+#define TLV_ADC12_20T85			5
+#define TLV_ADC12_WORDS			8
+#define TLV_REF_20VREF			1
+#define TLV_REF_WORDS			3
+
+/* Typical calibration, without TLV: 680 mV + 2.55 mV/degC on the 2.0 V reference */
+#define ADC_TYP_T30				1549
+#define ADC_TYP_T85				1836
+
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+/**
+ * \enum te_AdcState
+ * \brief State of the measurement
+ */
+typedef enum
+{
+	E_ADC_IDLE = 0,			/*!< No measurement in progress */
+	E_ADC_RUN_IDLE,			/*!< Temperature and supply converted */
+	E_ADC_ARMED_TX,			/*!< Reference on, waiting for ADC_start_tx() */
+	E_ADC_RUN_TX			/*!< Supply converted in the PA plateau */
+}te_AdcState;
+
+
+/******************************************************************************
+ * LOCAL VARIABLES
+ */
+static volatile te_AdcState e_AdcState = E_ADC_IDLE;
+static AdcCal_t AdcCal = { 32768, 0, 32768, ADC_TYP_T30, ADC_TYP_T85 };
+
+/* Placeholder values of the library till the first measurements */
+static AdcValues_t AdcValues = { 3300, 3100, 250, 0, 0, 0 };
+
+/* Samples written by DMA, the first ADC_SETTLE are dropped */
+static uint16 TempSamples[ADC_SAMPLES];
+static uint16 VddSamples[ADC_SAMPLES];
+
+
+/******************************************************************************
+ * FUNCTION PROTOTYPE
+ */
+static void ADC_dma_arm(uint8 u8_Channel, uint16 *pu16_Samples);
+static uint16 ADC_sum(const uint16 *pu16_Samples);
+
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+/**************************************************************************//**
+ *  @brief 		Sets up the ADC12_A, the reference and the DMA channels, and
+ *  			starts the first idle measurement.
+ *
+ *  @note		The calibration comes from the device TLV, the typical
+ *  			values are kept without it.
+ ******************************************************************************/
+void
+ADC_init(void)
+{
+	ADC12_A_configureMemoryParam mem = {0};
+	DMA_initParam dma = {0};
+	uint16 *pu16_Tlv;
+	uint8 len;
+
+	// Calibration of the device
+	TLV_getInfo(TLV_TAG_ADC12CAL, 0, &len, &pu16_Tlv);
+	if ((pu16_Tlv != 0) && (len >= 2*TLV_ADC12_WORDS)
+		&& (pu16_Tlv[TLV_ADC12_20T85] > pu16_Tlv[TLV_ADC12_20T30]))
+	{
+		AdcCal.u16_Gain   = pu16_Tlv[TLV_ADC12_GAIN];
+		AdcCal.s16_Offset = (int16)pu16_Tlv[TLV_ADC12_OFFSET];
+		AdcCal.u16_T30    = pu16_Tlv[TLV_ADC12_20T30];
+		AdcCal.u16_T85    = pu16_Tlv[TLV_ADC12_20T85];
+	}
+	TLV_getInfo(TLV_TAG_REFCAL, 0, &len, &pu16_Tlv);
+	if ((pu16_Tlv != 0) && (len >= 2*TLV_REF_WORDS))
+	{
+		AdcCal.u16_VrefFactor = pu16_Tlv[TLV_REF_20VREF];
+	}
+
+	// 2.0 V reference of the REF module, turned on by the measurements only
+	REFCTL0 |= REFMSTR;
+	Ref_setReferenceVoltage(REF_BASE, REF_VREF2_0V);
+	Ref_enableTempSensor(REF_BASE);
+
+	// Temperature then AVCC/2, the end of the sequence triggers the DMA
+	ADC12_A_init(ADC12_A_BASE, ADC12_A_SAMPLEHOLDSOURCE_SC, ADC12_A_CLOCKSOURCE_ADC12OSC, ADC12_A_CLOCKDIVIDER_1);
+	ADC12_A_setupSamplingTimer(ADC12_A_BASE, ADC_SHT_TEMP, ADC_SHT_VDD, ADC12_A_MULTIPLESAMPLESENABLE);
+
+	mem.memoryBufferControlIndex = ADC_MEM_TEMP;
+	mem.inputSourceSelect = ADC12_A_INPUT_TEMPSENSOR;
+	mem.positiveRefVoltageSourceSelect = ADC12_A_VREFPOS_INT;
+	mem.negativeRefVoltageSourceSelect = ADC12_A_VREFNEG_AVSS;
+	mem.endOfSequence = ADC12_A_NOTENDOFSEQUENCE;
+	ADC12_A_configureMemory(ADC12_A_BASE, &mem);
+
+	mem.memoryBufferControlIndex = ADC_MEM_VDD;
+	mem.inputSourceSelect = ADC12_A_INPUT_BATTERYMONITOR;
+	mem.endOfSequence = ADC12_A_ENDOFSEQUENCE;
+	ADC12_A_configureMemory(ADC12_A_BASE, &mem);
+
+	ADC12_A_enable(ADC12_A_BASE);
+
+	// One word per sequence and per channel, the radio keeps DMA channel 0
+	dma.transferModeSelect = DMA_TRANSFER_SINGLE;
+	dma.transferSize = ADC_SAMPLES;
+	dma.triggerSourceSelect = ADC_DMA_TSEL_ADC12IFG;
+	dma.transferUnitSelect = DMA_SIZE_SRCWORD_DSTWORD;
+	dma.triggerTypeSelect = DMA_TRIGGER_RISINGEDGE;
+
+	dma.channelSelect = ADC_DMA_TEMP;
+	DMA_init(&dma);
+	DMA_setSrcAddress(ADC_DMA_TEMP, ADC12_A_getMemoryAddressForDMA(ADC12_A_BASE, ADC_MEM_TEMP), DMA_DIRECTION_UNCHANGED);
+
+	dma.channelSelect = ADC_DMA_VDD;
+	DMA_init(&dma);
+	DMA_setSrcAddress(ADC_DMA_VDD, ADC12_A_getMemoryAddressForDMA(ADC12_A_BASE, ADC_MEM_VDD), DMA_DIRECTION_UNCHANGED);
+	DMA_enableInterrupt(ADC_DMA_VDD);
+
+	ADC_start_idle();
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Starts the measurement of the temperature and of the supply
+ *  			with the radio idle. Called after each frame (sfx_close()).
+ *
+ *  @note		Returns at once, ADC_dma_isr() stores the results about
+ *  			1 ms later. A TX measurement armed but not started is
+ *  			replaced, a measurement in progress is not disturbed.
+ ******************************************************************************/
+void
+ADC_start_idle(void)
+{
+	uint16 istate = __get_interrupt_state();
+
+	__disable_interrupt();
+
+	if ((e_AdcState == E_ADC_RUN_IDLE) || (e_AdcState == E_ADC_RUN_TX))
+	{
+		AdcValues.u16_Skipped++;
+		__set_interrupt_state(istate);
+		return;
+	}
+
+	Ref_enableReferenceVoltage(REF_BASE);
+	ADC_dma_arm(ADC_DMA_TEMP, TempSamples);
+	ADC_dma_arm(ADC_DMA_VDD, VddSamples);
+
+	e_AdcState = E_ADC_RUN_IDLE;
+	ADC12_A_startConversion(ADC12_A_BASE, ADC_MEM_TEMP, ADC12_A_REPEATED_SEQOFCHANNELS);
+
+	__set_interrupt_state(istate);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Prepares the measurement of the supply in the frame about to
+ *  			be sent, ADC_start_tx() starts it. Called by TxInit().
+ *
+ *  @note		The reference is turned on now: it has settled when the PA
+ *  			plateau is reached.
+ ******************************************************************************/
+void
+ADC_arm_tx(void)
+{
+	uint16 istate = __get_interrupt_state();
+
+	__disable_interrupt();
+
+	if (e_AdcState != E_ADC_IDLE)
+	{
+		AdcValues.u16_Skipped++;
+		__set_interrupt_state(istate);
+		return;
+	}
+
+	Ref_enableReferenceVoltage(REF_BASE);
+	ADC_dma_arm(ADC_DMA_VDD, VddSamples);
+	e_AdcState = E_ADC_ARMED_TX;
+
+	__set_interrupt_state(istate);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Starts the measurement of the supply prepared by
+ *  			ADC_arm_tx(). Called from the bit rate timer interrupt, in
+ *  			the middle of a PA plateau.
+ *
+ *  @note		The samples take about 100 us, within one bit.
+ ******************************************************************************/
+void
+ADC_start_tx(void)
+{
+	if (e_AdcState == E_ADC_ARMED_TX)
+	{
+		e_AdcState = E_ADC_RUN_TX;
+		ADC12_A_startConversion(ADC12_A_BASE, ADC_MEM_VDD, ADC12_A_REPEATED_SINGLECHANNEL);
+	}
+}
+
+
+/**************************************************************************//**
+ *  @brief 		End of a measurement, called from the DMA interrupt: stops
+ *  			the ADC12_A and the reference and stores the averages.
+ ******************************************************************************/
+void
+ADC_dma_isr(void)
+{
+	ADC12_A_disableConversions(ADC12_A_BASE, ADC12_A_PREEMPTCONVERSION);
+	Ref_disableReferenceVoltage(REF_BASE);
+	DMA_disableTransfers(ADC_DMA_TEMP);
+	ADC12_A_clearInterrupt(ADC12_A_BASE, ADC12IFG7 + ADC12IFG8);
+
+	if (e_AdcState == E_ADC_RUN_IDLE)
+	{
+		AdcValues.u16_VddIdle = ADC_vdd_mv(ADC_sum(VddSamples), &AdcCal);
+		AdcValues.s16_Temp = ADC_temp(ADC_sum(TempSamples), &AdcCal);
+		if (AdcValues.u16_Tx == 0)
+		{
+			AdcValues.u16_VddTx = AdcValues.u16_VddIdle;
+		}
+		AdcValues.u16_Idle++;
+	}
+	else if (e_AdcState == E_ADC_RUN_TX)
+	{
+		AdcValues.u16_VddTx = ADC_vdd_mv(ADC_sum(VddSamples), &AdcCal);
+		AdcValues.u16_Tx++;
+	}
+	e_AdcState = E_ADC_IDLE;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Gives the last measurements, updated from the DMA interrupt.
+ *
+ *  @return 	the measurements, to be read with the interrupts disabled
+ ******************************************************************************/
+const AdcValues_t *
+ADC_values(void)
+{
+	return &AdcValues;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Converts AVCC/2 samples to the supply voltage.
+ *
+ *  @note		The reference and gain factors then the offset correct the
+ *  			sum, as in the ADC12_A calibration of the user's guide.
+ *
+ *  @param 		u16_Sum 	is the sum of ADC_OVERSAMPLING samples
+ *  @param 		pCal 		is the calibration
+ *
+ *  @return 	the supply in mV
+ ******************************************************************************/
+uint16
+ADC_vdd_mv(uint16 u16_Sum, const AdcCal_t *pCal)
+{
+	int32 corrected;
+
+	corrected = (int32)(((uint32)u16_Sum * pCal->u16_VrefFactor) >> 15);
+	corrected = (int32)(((uint32)corrected * pCal->u16_Gain) >> 15);
+	corrected += (int32)pCal->s16_Offset * ADC_OVERSAMPLING;
+	if (corrected < 0)
+	{
+		corrected = 0;
+	}
+
+	// AVCC/2 on the reference
+	return (uint16)(((uint32)corrected * (2UL * ADC_VREF_MV) + (ADC_FULL_SCALE * ADC_OVERSAMPLING / 2))
+					/ (ADC_FULL_SCALE * ADC_OVERSAMPLING));
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Converts temperature sensor samples to degrees.
+ *
+ *  @note		Linear between the two points measured in factory, the
+ *  			samples are not corrected: the points include the reference
+ *  			and gain errors.
+ *
+ *  @param 		u16_Sum 	is the sum of ADC_OVERSAMPLING samples
+ *  @param 		pCal 		is the calibration
+ *
+ *  @return 	the temperature in 1/10 degC
+ ******************************************************************************/
+int16
+ADC_temp(uint16 u16_Sum, const AdcCal_t *pCal)
+{
+	int32 num;
+	int32 den;
+
+	num = ((int32)u16_Sum - (int32)pCal->u16_T30 * ADC_OVERSAMPLING) * ((ADC_CAL_T85 - ADC_CAL_T30) * 10);
+	den = ((int32)pCal->u16_T85 - (int32)pCal->u16_T30) * ADC_OVERSAMPLING;
+
+	// Rounded to the nearest
+	num += (num >= 0) ? den/2 : -den/2;
+	return (int16)(ADC_CAL_T30 * 10 + num / den);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Points a DMA channel to a sample buffer, for ADC_SAMPLES
+ *  			sequences.
+ *
+ *  @param 		u8_Channel 		is ADC_DMA_TEMP or ADC_DMA_VDD
+ *  @param 		pu16_Samples 	is the buffer
+ ******************************************************************************/
+static void
+ADC_dma_arm(uint8 u8_Channel, uint16 *pu16_Samples)
+{
+	DMA_setDstAddress(u8_Channel, (uint32)pu16_Samples, DMA_DIRECTION_INCREMENT);
+	DMA_setTransferSize(u8_Channel, ADC_SAMPLES);
+	DMA_clearInterrupt(u8_Channel);
+	DMA_enableTransfers(u8_Channel);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Sums the samples of a measurement after the settling ones.
+ *
+ *  @param 		pu16_Samples 	is the buffer
+ *
+ *  @return 	the sum of ADC_OVERSAMPLING samples
+ ******************************************************************************/
+static uint16
+ADC_sum(const uint16 *pu16_Samples)
+{
+	uint16 sum = 0;
+	uint8 i;
+
+	for (i = ADC_SETTLE; i < ADC_SAMPLES; i++)
+	{
+		sum += pu16_Samples[i] & 0x0FFF;
+	}
+	return sum;
+}
+
+
+#ifndef RADIO_DMA_MODULATION
+/**************************************************************************//**
+ *  @brief 		DMA interrupt: end of a measurement.
+ *  @note		With RADIO_DMA_MODULATION the radio takes the DMA interrupt
+ *  			and calls ADC_dma_isr().
+ ******************************************************************************/
+#pragma vector=DMA_VECTOR
+__interrupt void
+ADC_DMA_ISR(void)
+{
+	if (__even_in_range(DMAIV, 16) == DMAIV_DMA2IFG)
+	{
+		ADC_dma_isr();
+	}
+}
+#endif
+
+#endif // ADC_MEASUREMENT
+
+
+/**************************************************************************//**
+* Close the Doxygen group.
+* @}
+******************************************************************************/
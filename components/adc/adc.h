@@ -0,0 +1,74 @@
+//*****************************************************************************
+//! @file       adc.h
+//! @brief      Supply voltage and temperature measurement.
+//!				The ADC12_A converts the internal temperature sensor and
+//!				AVCC/2 against the 2.0 V reference, the samples are moved by
+//!				DMA and averaged when the sequence completes.
+//!       \li \e idle after each frame, see ADC_start_idle()
+//!       \li \e TX in the middle of a PA plateau, see ADC_start_tx()
+//!
+//****************************************************************************/
+
+
+#ifndef ADC_H
+#define ADC_H
+
+#include "hal_types.h"
+
+
+/******************************************************************************
+ * DEFINES
+ */
+#define ADC_OVERSAMPLING	16		// Samples averaged by measurement, 16 at most (sums on 16 bits)
+#define ADC_SETTLE			2		// First samples dropped, the reference settles
+
+#define ADC_VREF_MV			2000	// Internal reference, mV
+#define ADC_FULL_SCALE		4096	// 12-bit conversions
+#define ADC_CAL_T30			30		// degC of CAL_ADC_20T30
+#define ADC_CAL_T85			85		// degC of CAL_ADC_20T85
+
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+/**
+ * \struct AdcCal_t
+ * \brief Calibration of the conversions, from the TLV of the device
+ */
+typedef struct
+{
+	uint16 u16_Gain;		/*!< CAL_ADC_GAIN_FACTOR, 1/32768 */
+	int16 s16_Offset;		/*!< CAL_ADC_OFFSET, LSB */
+	uint16 u16_VrefFactor;	/*!< CAL_ADC_20VREF_FACTOR, 1/32768 */
+	uint16 u16_T30;			/*!< CAL_ADC_20T30, temperature sensor at 30 degC */
+	uint16 u16_T85;			/*!< CAL_ADC_20T85, temperature sensor at 85 degC */
+}AdcCal_t;
+
+/**
+ * \struct AdcValues_t
+ * \brief Last measurements, see ADC_values()
+ */
+typedef struct
+{
+	uint16 u16_VddIdle;		/*!< Supply with the radio idle, mV */
+	uint16 u16_VddTx;		/*!< Supply in the PA plateau of the last frame, mV */
+	int16 s16_Temp;			/*!< Temperature, 1/10 degC */
+	uint16 u16_Idle;		/*!< Idle measurements */
+	uint16 u16_Tx;			/*!< TX measurements */
+	uint16 u16_Skipped;		/*!< Measurements not started, the ADC was busy */
+}AdcValues_t;
+
+
+/******************************************************************************
+ * FUNCTION PROTOTYPES
+ */
+void ADC_init(void);
+void ADC_start_idle(void);
+void ADC_arm_tx(void);
+void ADC_start_tx(void);
+void ADC_dma_isr(void);
+const AdcValues_t * ADC_values(void);
+uint16 ADC_vdd_mv(uint16 u16_Sum, const AdcCal_t *pCal);
+int16 ADC_temp(uint16 u16_Sum, const AdcCal_t *pCal);
+
+#endif // ADC_H
@@ -49,6 +49,64 @@
 #include "cc112x_spi.h"
 
 
+/******************************************************************************
+ * DEFINES
+ */
+#define CC112X_EXT_ADDR					0x2F	/*!< Extended register space prefix */
+#define CC112X_BURST_ADDR_INCR_EN_BM	0x01	/*!< EXT_CTRL.BURST_ADDR_INCR_EN */
+#define CC112X_EXT_CTRL_RESET			0x01	/*!< EXT_CTRL value after reset */
+
+/* Configuration space held in the shadow: 8-bit 0x00-0x2E then extended 0x00-0x39 */
+#define CC112X_SHADOW_NB_8BIT			(CC112X_PKT_LEN + 1)
+#define CC112X_SHADOW_NB_EXT			((CC112X_PA_CFG3 & 0x00FF) + 1)
+#define CC112X_SHADOW_SIZE				(CC112X_SHADOW_NB_8BIT + CC112X_SHADOW_NB_EXT)
+
+/* Registers outside the configuration space that cc112xSpiConfigure() can hold */
+#define CC112X_SHADOW_NB_OTHER			4
+
+
+/******************************************************************************
+ * LOCAL VARIABLES
+ */
+/*! Last value written to EXT_CTRL, tells if burst accesses increment the address */
+static uint8 u8_ExtCtrl = CC112X_EXT_CTRL_RESET;
+
+/*! cc112xSpiWriteRegs() work buffers, kept out of the 160 bytes stack */
+static uint8 WriteOrder[CC112X_WRITE_REGS_MAX];
+static uint8 WriteBurst[CC112X_WRITE_REGS_MAX];
+
+/*! Register values of the configuration space, as last written */
+static uint8 RegShadow[CC112X_SHADOW_SIZE];
+
+/*! Bitmap of the RegShadow entries that hold the chip value */
+static uint8 RegShadowValid[(CC112X_SHADOW_SIZE + 7) / 8];
+
+/*! Register values read once after the first reset */
+static uint8 RegReset[CC112X_SHADOW_SIZE];
+static uint8 b_RegResetRead = 0;
+
+/*! Registers written by cc112xSpiConfigure() outside the configuration space */
+static struct {
+  uint16 addr;		/*!< register address, 0 if the entry is free */
+  uint8  reset;		/*!< value read before the first write */
+  uint8  value;		/*!< value last written */
+}RegOther[CC112X_SHADOW_NB_OTHER];
+
+/*! cc112xSpiConfigure() list of the registers to write */
+static registerSetting_t ConfigDiff[CC112X_WRITE_REGS_MAX];
+
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ */
+static uint8 cc112xSpiWriteRuns(const registerSetting_t *pRegs, const uint8 *pOrder,
+								uint8 count, uint8 b_Merge);
+static int16 cc112xShadowIndex(uint16 addr);
+static void cc112xShadowWrite(uint16 addr, const uint8 *pData, uint8 len);
+static uint8 cc112xConfigDiffAdd(uint8 nb, uint16 addr, uint8 data);
+static uint8 cc112xConfigOther(uint8 nb, uint16 addr, uint8 data, uint8 *pListed);
+
+
 /******************************************************************************
  * FUNCTIONS
  */
@@ -111,15 +169,426 @@ cc112xSpiWriteReg(uint16 addr, uint8 *pData, uint8 len)
   if(!tempExt)
   {
     rc = trx8BitRegAccess((RADIO_BURST_ACCESS|RADIO_WRITE_ACCESS),tempAddr,pData,len);
+    cc112xShadowWrite(addr, pData, len);
   }
   else if (tempExt == 0x2F)
   {
     rc = trx16BitRegAccess((RADIO_BURST_ACCESS|RADIO_WRITE_ACCESS),tempExt,tempAddr,pData,len);
+    cc112xShadowWrite(addr, pData, len);
+  }
+  return (rc);
+}
+
+
+/**************************************************************************//**
+ * @brief       Write a scatter list of config/extended radio registers.
+ *              The writes are sorted by address and registers with
+ *              consecutive addresses are merged into one burst access.
+ *
+ * @param       pRegs 	is the list of { address, value } to write
+ * @param       count 	is the number of entries, ::CC112X_WRITE_REGS_MAX at most
+ *
+ * @return      status byte ::rfStatus_t of the last access
+ *
+ * @note		\li Burst accesses only increment the address when
+ * 				EXT_CTRL.BURST_ADDR_INCR_EN is set. When it is cleared (TX
+ * 				settings) the increment is enabled around the bursts if it
+ * 				saves more accesses than the two EXT_CTRL writes it costs,
+ * 				otherwise the registers are written one by one.
+ * @note		\li An EXT_CTRL entry of the list is written last.
+ * @note		\li The registers of a list must not depend on the order
+ * 				they are written in.
+ *****************************************************************************/
+rfStatus_t
+cc112xSpiWriteRegs(const registerSetting_t *pRegs, uint8 count)
+{
+  uint8 *order = WriteOrder;
+  uint8 nb_sorted = 0;
+  uint8 saved = 0;
+  uint8 ext_ctrl = u8_ExtCtrl;
+  uint8 b_ExtCtrlListed = 0;
+  uint8 b_Merge;
+  uint8 writeByte;
+  uint8 rc = 0;
+  uint8 i, j;
+
+  if (count > CC112X_WRITE_REGS_MAX) return STATUS_CHIP_RDYn_BM;
+
+  // Sort the list by address (insertion sort on indexes, the list is short)
+  for (i = 0; i < count; i++)
+  {
+    if (pRegs[i].addr == CC112X_EXT_CTRL)
+    {
+      ext_ctrl = pRegs[i].data;
+      b_ExtCtrlListed = 1;
+      continue;
+    }
+    for (j = nb_sorted; (j > 0) && (pRegs[order[j-1]].addr > pRegs[i].addr); j--)
+    {
+      order[j] = order[j-1];
+    }
+    order[j] = i;
+    nb_sorted++;
+  }
+
+  // Count the accesses saved by merging consecutive registers
+  for (i = 1; i < nb_sorted; i++)
+  {
+    if (pRegs[order[i]].addr == (pRegs[order[i-1]].addr + 1))
+    {
+      saved++;
+    }
+  }
+
+  b_Merge = ((u8_ExtCtrl & CC112X_BURST_ADDR_INCR_EN_BM) || (saved > 2));
+
+  // Enable the burst address increment for the time of the writes
+  if (b_Merge && !(u8_ExtCtrl & CC112X_BURST_ADDR_INCR_EN_BM))
+  {
+    writeByte = u8_ExtCtrl | CC112X_BURST_ADDR_INCR_EN_BM;
+    cc112xSpiWriteReg(CC112X_EXT_CTRL, &writeByte, 1);
+    b_ExtCtrlListed = 1;
+  }
+
+  rc = cc112xSpiWriteRuns(pRegs, order, nb_sorted, b_Merge);
+
+  // Program the final EXT_CTRL value
+  if (b_ExtCtrlListed)
+  {
+    rc = cc112xSpiWriteReg(CC112X_EXT_CTRL, &ext_ctrl, 1);
+  }
+  return (rc);
+}
+
+
+/**************************************************************************//**
+ * @brief       Write sorted registers, merging consecutive addresses of the
+ *              same register space into one burst access when allowed.
+ *
+ * @param       pRegs 	is the list of { address, value } to write
+ * @param       pOrder 	is the list of indexes of pRegs sorted by address
+ * @param       count 	is the number of indexes
+ * @param       b_Merge is not 0 if the burst address increment is enabled
+ *
+ * @return      status byte ::rfStatus_t of the last access
+ *****************************************************************************/
+static uint8
+cc112xSpiWriteRuns(const registerSetting_t *pRegs, const uint8 *pOrder, uint8 count, uint8 b_Merge)
+{
+  uint8 *burst = WriteBurst;
+  uint16 addr;
+  uint8 len;
+  uint8 rc = 0;
+  uint8 i = 0;
+
+  while (i < count)
+  {
+    addr = pRegs[pOrder[i]].addr;
+    burst[0] = pRegs[pOrder[i]].data;
+    len = 1;
+    i++;
+
+    // Extend the burst while the next register follows in the same space
+    while (b_Merge && (i < count)
+           && (pRegs[pOrder[i]].addr == (addr + len))
+           && ((uint8)(addr & 0x00FF) + len <= 0xFF))
+    {
+      burst[len++] = pRegs[pOrder[i]].data;
+      i++;
+    }
+    rc = cc112xSpiWriteReg(addr, burst, len);
   }
   return (rc);
 }
 
 
+/**************************************************************************//**
+ * @brief       Reset the radio chip with the SRES strobe.
+ *
+ * @return      status byte ::rfStatus_t
+ *
+ * @note		The register values tracked by this driver are set back to
+ * 				their reset value.
+ *****************************************************************************/
+rfStatus_t
+cc112xSpiReset(void)
+{
+  uint8 rc;
+  uint8 i;
+
+  u8_ExtCtrl = CC112X_EXT_CTRL_RESET;
+  rc = trxSpiCmdStrobe(CC112X_SRES);
+
+  // Read the reset values of the configuration space the first time
+  if (!b_RegResetRead)
+  {
+    cc112xSpiReadReg(0x0000, &RegReset[0], CC112X_SHADOW_NB_8BIT);
+    cc112xSpiReadReg(0x2F00, &RegReset[CC112X_SHADOW_NB_8BIT], CC112X_SHADOW_NB_EXT);
+    b_RegResetRead = 1;
+  }
+
+  for (i = 0; i < CC112X_SHADOW_SIZE; i++)
+  {
+    RegShadow[i] = RegReset[i];
+  }
+  for (i = 0; i < sizeof(RegShadowValid); i++)
+  {
+    RegShadowValid[i] = 0xFF;
+  }
+  return(rc);
+}
+
+
+/**************************************************************************//**
+ * @brief       Bring the configuration space to its reset values overridden
+ *              by a list of registers, writing only the registers whose
+ *              shadow value differs. The chip is reset the first time, when
+ *              its register values are not known.
+ *
+ * @param       pRegs 	is the list of { address, value } to apply over the
+ * 						reset values
+ * @param       count 	is the number of entries
+ *
+ * @return      status byte ::rfStatus_t of the last access
+ *
+ * @note		\li The differences are written with cc112xSpiWriteRegs(),
+ * 				consecutive registers share one burst access.
+ * @note		\li Registers written behind the driver (trx8BitRegAccess(),
+ * 				DMA) must be declared with cc112xSpiShadowInvalidate().
+ * @note		\li Up to ::CC112X_SHADOW_NB_OTHER registers outside the
+ * 				configuration space (e.g. SERIAL_STATUS) are held as well,
+ * 				they must only be written through this function.
+ *****************************************************************************/
+rfStatus_t
+cc112xSpiConfigure(const registerSetting_t *pRegs, uint8 count)
+{
+  uint8 listed[(CC112X_SHADOW_SIZE + 7) / 8];
+  uint8 other_listed = 0;
+  uint8 nb = 0;
+  uint8 rc = 0;
+  int16 idx;
+  uint8 i;
+
+  if (!b_RegResetRead)
+  {
+    rc = cc112xSpiReset();
+  }
+
+  for (i = 0; i < sizeof(listed); i++)
+  {
+    listed[i] = 0;
+  }
+
+  // Registers of the list
+  for (i = 0; i < count; i++)
+  {
+    idx = cc112xShadowIndex(pRegs[i].addr);
+    if (idx < 0)
+    {
+      nb = cc112xConfigOther(nb, pRegs[i].addr, pRegs[i].data, &other_listed);
+      continue;
+    }
+    listed[idx >> 3] |= (1 << (idx & 0x07));
+    if ((RegShadowValid[idx >> 3] & (1 << (idx & 0x07))) && (RegShadow[idx] == pRegs[i].data))
+    {
+      continue;
+    }
+    nb = cc112xConfigDiffAdd(nb, pRegs[i].addr, pRegs[i].data);
+  }
+
+  // Registers outside the configuration space not in the list go back to their reset value
+  for (i = 0; i < CC112X_SHADOW_NB_OTHER; i++)
+  {
+    if (RegOther[i].addr && !(other_listed & (1 << i)) && (RegOther[i].value != RegOther[i].reset))
+    {
+      RegOther[i].value = RegOther[i].reset;
+      nb = cc112xConfigDiffAdd(nb, RegOther[i].addr, RegOther[i].reset);
+    }
+  }
+
+  // Registers not in the list go back to their reset value
+  for (idx = 0; idx < CC112X_SHADOW_SIZE; idx++)
+  {
+    if (listed[idx >> 3] & (1 << (idx & 0x07)))
+    {
+      continue;
+    }
+    if ((RegShadowValid[idx >> 3] & (1 << (idx & 0x07))) && (RegShadow[idx] == RegReset[idx]))
+    {
+      continue;
+    }
+    if (idx < CC112X_SHADOW_NB_8BIT)
+    {
+      nb = cc112xConfigDiffAdd(nb, (uint16)idx, RegReset[idx]);
+    }
+    else
+    {
+      nb = cc112xConfigDiffAdd(nb, (uint16)(0x2F00 + idx - CC112X_SHADOW_NB_8BIT), RegReset[idx]);
+    }
+  }
+
+  if (nb)
+  {
+    rc = cc112xSpiWriteRegs(ConfigDiff, nb);
+  }
+  return (rc);
+}
+
+
+/**************************************************************************//**
+ * @brief       Mark a register as unknown in the shadow, for a register
+ *              written without cc112xSpiWriteReg() or changed by the chip.
+ *
+ * @param       addr 	is the register address
+ *****************************************************************************/
+void
+cc112xSpiShadowInvalidate(uint16 addr)
+{
+  int16 idx = cc112xShadowIndex(addr);
+
+  if (idx >= 0)
+  {
+    RegShadowValid[idx >> 3] &= ~(1 << (idx & 0x07));
+  }
+}
+
+
+/**************************************************************************//**
+ * @brief       Index of a register in the shadow.
+ *
+ * @param       addr 	is the register address
+ *
+ * @return      index in RegShadow, -1 if the register is not held. The
+ * 				synthesizer calibration results (FS_CHP, FS_VCO4-1) are
+ * 				changed by the chip and are never held.
+ *****************************************************************************/
+static int16
+cc112xShadowIndex(uint16 addr)
+{
+  uint8 tempAddr = (uint8)(addr & 0x00FF);
+
+  if ((addr >> 8) == 0)
+  {
+    return ((tempAddr < CC112X_SHADOW_NB_8BIT) ? tempAddr : -1);
+  }
+  if (((addr >> 8) != CC112X_EXT_ADDR) || (tempAddr >= CC112X_SHADOW_NB_EXT))
+  {
+    return -1;
+  }
+  if ((addr == CC112X_FS_CHP) || ((addr >= CC112X_FS_VCO4) && (addr <= CC112X_FS_VCO1)))
+  {
+    return -1;
+  }
+  return (CC112X_SHADOW_NB_8BIT + tempAddr);
+}
+
+
+/**************************************************************************//**
+ * @brief       Record a register write in the shadow.
+ *
+ * @param       addr 	is address of the first register written
+ * @param       pData 	is pointer to the bytes written
+ * @param       len 	is the number of bytes written
+ *
+ * @note		Without EXT_CTRL.BURST_ADDR_INCR_EN, all the bytes of a
+ * 				burst go to the first register.
+ *****************************************************************************/
+static void
+cc112xShadowWrite(uint16 addr, const uint8 *pData, uint8 len)
+{
+  uint8 incr = (u8_ExtCtrl & CC112X_BURST_ADDR_INCR_EN_BM);
+  int16 idx;
+  uint8 i;
+
+  for (i = 0; i < len; i++)
+  {
+    idx = cc112xShadowIndex(addr);
+    if (idx >= 0)
+    {
+      RegShadow[idx] = pData[i];
+      RegShadowValid[idx >> 3] |= (1 << (idx & 0x07));
+    }
+
+    // Keep track of the burst address increment setting
+    if (addr == CC112X_EXT_CTRL)
+    {
+      u8_ExtCtrl = pData[i];
+    }
+    if (incr)
+    {
+      addr++;
+    }
+  }
+}
+
+
+/**************************************************************************//**
+ * @brief       Append a register to the cc112xSpiConfigure() list, the list
+ *              is written when it is full.
+ *
+ * @param       nb 		is the number of registers in the list
+ * @param       addr 	is the register address
+ * @param       data 	is the register value
+ *
+ * @return      new number of registers in the list
+ *****************************************************************************/
+static uint8
+cc112xConfigDiffAdd(uint8 nb, uint16 addr, uint8 data)
+{
+  if (nb == CC112X_WRITE_REGS_MAX)
+  {
+    cc112xSpiWriteRegs(ConfigDiff, nb);
+    nb = 0;
+  }
+  ConfigDiff[nb].addr = addr;
+  ConfigDiff[nb].data = data;
+  return (nb + 1);
+}
+
+
+/**************************************************************************//**
+ * @brief       Append a register outside the configuration space to the
+ *              cc112xSpiConfigure() list if its value changes. Its reset
+ *              value is read before it is written the first time.
+ *
+ * @param       nb 		is the number of registers in the list
+ * @param       addr 	is the register address
+ * @param       data 	is the register value
+ * @param       pListed is the bitmap of the ::RegOther entries of the list
+ *
+ * @return      new number of registers in the list
+ *****************************************************************************/
+static uint8
+cc112xConfigOther(uint8 nb, uint16 addr, uint8 data, uint8 *pListed)
+{
+  uint8 i;
+
+  for (i = 0; (i < CC112X_SHADOW_NB_OTHER) && (RegOther[i].addr != addr); i++);
+
+  if (i == CC112X_SHADOW_NB_OTHER)
+  {
+    for (i = 0; (i < CC112X_SHADOW_NB_OTHER) && RegOther[i].addr; i++);
+
+    // No entry left: the register is always written
+    if (i == CC112X_SHADOW_NB_OTHER)
+    {
+      return cc112xConfigDiffAdd(nb, addr, data);
+    }
+    RegOther[i].addr = addr;
+    cc112xSpiReadReg(addr, &RegOther[i].reset, 1);
+    RegOther[i].value = RegOther[i].reset;
+  }
+
+  *pListed |= (1 << i);
+  if (RegOther[i].value != data)
+  {
+    RegOther[i].value = data;
+    nb = cc112xConfigDiffAdd(nb, addr, data);
+  }
+  return (nb);
+}
+
+
 /***************************************************************************//**
  * @brief       Write pData to radio transmit FIFO.
  *
@@ -273,6 +273,9 @@ extern "C" {
 #define CC112X_STATE_RXFIFO_ERROR       0x60
 #define CC112X_STATE_TXFIFO_ERROR       0x70
 
+/* Maximum number of registers written by cc112xSpiWriteRegs() */
+#define CC112X_WRITE_REGS_MAX           64
+
 
 
 /******************************************************************************
@@ -282,6 +285,10 @@ rfStatus_t cc112xSpiReadReg(uint16 addr, uint8 *data, uint8 len);
 rfStatus_t cc112xGetTxStatus(void);
 rfStatus_t cc112xGetRxStatus(void);  
 rfStatus_t cc112xSpiWriteReg(uint16 addr, uint8 *data, uint8 len);
+rfStatus_t cc112xSpiWriteRegs(const registerSetting_t *pRegs, uint8 count);
+rfStatus_t cc112xSpiReset(void);
+rfStatus_t cc112xSpiConfigure(const registerSetting_t *pRegs, uint8 count);
+void cc112xSpiShadowInvalidate(uint16 addr);
 rfStatus_t cc112xSpiWriteTxFifo(uint8 *pWriteData, uint8 len);
 rfStatus_t cc112xSpiReadRxFifo(uint8 *pReadData, uint8 len);
 
@@ -47,8 +47,13 @@
 #include "stdlib.h"
 #include "stdio.h"
 #include "math.h"
+#include "string.h"
 #include "radio.h"
 #include "timer.h"
+#include "sigfox_demo.h"
+#ifdef ADC_MEASUREMENT
+#include "adc.h"
+#endif
 #include "../sigfox_library_api/sigfox.h"
 #include "../sigfox_library_api/sigfox_types.h"
 
@@ -77,6 +82,10 @@ unsigned short sequence_number = 0; // Sequence number for rx test
 unsigned char stringToData(char *str, unsigned char *data, unsigned char length);
 unsigned char hexToByte(char *hex);
 void byteToHex(unsigned char byte, char *hex);
+static void putNumber(unsigned long value, char separator);
+#if defined(RADIO_LBT) || defined(ADC_MEASUREMENT)
+static void putSigned(long value, char separator);
+#endif
 
 /* data configuration */
 #define CMD_AT_OFFSET             0x00
@@ -86,6 +95,9 @@ void byteToHex(unsigned char byte, char *hex);
 #define	CR	0x0D
 #define LF  0x0A
 
+/* Names of the radio power states, in ::te_RadioPowerState order */
+static const char * const PowerStateName[E_RADIO_PWR_NB] = {"ACTIVE", "IDLE", "XOFF", "SLEEP"};
+
 /******************************************************************************
  * FUNCTIONS
  */
@@ -158,6 +170,9 @@ parseHostCmd(unsigned char *host_cmd, unsigned char length)
 				// Send status bit command
 				if ((host_cmd[cmd_index+CMD_CMD_OFFSET+2]) == '=')
 				{
+					// Repeats and power of the frame for the link margin
+					sfx_link_adapt();
+
 					if(host_cmd[cmd_index+CMD_DATA_OFFSET] == '1')
 					{
 						if(host_cmd[cmd_index+CMD_DATA_OFFSET+1] == 0x0D)
@@ -263,6 +278,9 @@ parseHostCmd(unsigned char *host_cmd, unsigned char length)
 				// Send frame command
 				if ((host_cmd[cmd_index+CMD_CMD_OFFSET+2]) == '=')
 				{
+					// Repeats and power of the frame for the link margin
+					sfx_link_adapt();
+
 					// Parse command for uplink message
 					msg_mask = 0;
 					while (((host_cmd[cmd_index+CMD_CMD_OFFSET+2+msg_mask]) != ',') && ((host_cmd[cmd_index+CMD_CMD_OFFSET+2+msg_mask]) != 0x0D))
@@ -765,6 +783,181 @@ parseHostCmd(unsigned char *host_cmd, unsigned char length)
 				break;
 			}
 			break;
+		case 'P':
+			switch(host_cmd[cmd_index+CMD_CMD_OFFSET+1])
+			{
+			case 'S':
+				// Radio power state statistics inquiry
+				if(((host_cmd[cmd_index+CMD_CMD_OFFSET+2]) == '?') && ((host_cmd[cmd_index+CMD_CMD_OFFSET+3]) == 0x0D))
+				{
+					const RadioPowerStats_t *pStats = RADIO_power_stats();
+					unsigned char jj;
+
+					// One line per state {<name>,<residency ms>,<entries><CR><LF>}
+					for(jj = 0; jj<E_RADIO_PWR_NB; jj++)
+					{
+						uartPutStr((char *)PowerStateName[jj], strlen(PowerStateName[jj]));
+						uartPutChar(',');
+						putNumber((pStats->ul_Residency[jj] / TIMER_TIMEBASE_HZ) * 1000UL
+								+ ((pStats->ul_Residency[jj] % TIMER_TIMEBASE_HZ) * 1000UL) / TIMER_TIMEBASE_HZ, ',');
+						putNumber(pStats->u16_Entries[jj], CR);
+						uartPutChar(LF);
+					}
+					// Wake-ups and longest wake-up settle time {WAKE,<count>,<ticks><CR><LF>}
+					uartPutStr("WAKE,", 5);
+					putNumber(pStats->u16_Wakeups, ',');
+					putNumber(pStats->u16_WakeSettleMax, CR);
+					uartPutChar(LF);
+
+					// Terminate command with {OK<CR><LF>}
+					uartPutStr("OK", 2);
+					uartPutChar(CR);
+					uartPutChar(LF);
+				}
+				else
+				{
+					ret_cmd = HOST_CMD_ERROR;
+				}
+				break;
+			case 'L':
+				// Link statistics inquiry
+				if(((host_cmd[cmd_index+CMD_CMD_OFFSET+2]) == '?') && ((host_cmd[cmd_index+CMD_CMD_OFFSET+3]) == 0x0D))
+				{
+					unsigned char snapshot[RADIO_LINK_SNAPSHOT_SIZE];
+					unsigned char len, jj;
+					char hex[2];
+
+					// Binary snapshot in hex {<snapshot><CR><LF>}, see RADIO_link_snapshot()
+					len = RADIO_link_snapshot(snapshot);
+					for(jj = 0; jj<len; jj++)
+					{
+						byteToHex(snapshot[jj], hex);
+						uartPutStr(hex, 2);
+					}
+					uartPutChar(CR);
+					uartPutChar(LF);
+
+					// Terminate command with {OK<CR><LF>}
+					uartPutStr("OK", 2);
+					uartPutChar(CR);
+					uartPutChar(LF);
+				}
+				else
+				{
+					ret_cmd = HOST_CMD_ERROR;
+				}
+				break;
+#ifdef RADIO_LBT
+			case 'C':
+				// Listen before talk statistics inquiry
+				if(((host_cmd[cmd_index+CMD_CMD_OFFSET+2]) == '?') && ((host_cmd[cmd_index+CMD_CMD_OFFSET+3]) == 0x0D))
+				{
+					const RadioLbtStats_t *pLbt = RADIO_lbt_stats();
+					unsigned char jj;
+
+					// Listens and busy listens {LISTEN,<count>,<busy><CR><LF>}
+					uartPutStr("LISTEN,", 7);
+					putNumber(pLbt->u16_Listens, ',');
+					putNumber(pLbt->u16_Busy, CR);
+					uartPutChar(LF);
+					// Frames sent clear by listen, then sent busy {CLEAR,<1st>,<2nd>,...,<busy><CR><LF>}
+					uartPutStr("CLEAR,", 6);
+					for(jj = 0; jj<RADIO_LBT_ATTEMPTS; jj++)
+					{
+						putNumber(pLbt->u16_Clear[jj], ',');
+					}
+					putNumber(pLbt->u16_Forced, CR);
+					uartPutChar(LF);
+					// Backoff time and RSSI in dBm {BACKOFF,<ms><CR><LF>RSSI,<last>,<max><CR><LF>}
+					uartPutStr("BACKOFF,", 8);
+					putNumber(pLbt->ul_BackoffMs, CR);
+					uartPutChar(LF);
+					uartPutStr("RSSI,", 5);
+					putSigned(pLbt->s8_RssiLast, ',');
+					putSigned(pLbt->s8_RssiMax, CR);
+					uartPutChar(LF);
+
+					// Terminate command with {OK<CR><LF>}
+					uartPutStr("OK", 2);
+					uartPutChar(CR);
+					uartPutChar(LF);
+				}
+				else
+				{
+					ret_cmd = HOST_CMD_ERROR;
+				}
+				break;
+#endif
+#ifdef ADC_MEASUREMENT
+			case 'V':
+				// Supply voltage and temperature inquiry
+				if(((host_cmd[cmd_index+CMD_CMD_OFFSET+2]) == '?') && ((host_cmd[cmd_index+CMD_CMD_OFFSET+3]) == 0x0D))
+				{
+					const AdcValues_t *pAdc = ADC_values();
+
+					// Supply in mV, idle then under TX {VDD,<idle>,<tx><CR><LF>}
+					uartPutStr("VDD,", 4);
+					putNumber(pAdc->u16_VddIdle, ',');
+					putNumber(pAdc->u16_VddTx, CR);
+					uartPutChar(LF);
+					// Temperature in 1/10 degC {TEMP,<temp><CR><LF>}
+					uartPutStr("TEMP,", 5);
+					putSigned(pAdc->s16_Temp, CR);
+					uartPutChar(LF);
+					// Measurements done and skipped {MEAS,<idle>,<tx>,<skipped><CR><LF>}
+					uartPutStr("MEAS,", 5);
+					putNumber(pAdc->u16_Idle, ',');
+					putNumber(pAdc->u16_Tx, ',');
+					putNumber(pAdc->u16_Skipped, CR);
+					uartPutChar(LF);
+
+					// Terminate command with {OK<CR><LF>}
+					uartPutStr("OK", 2);
+					uartPutChar(CR);
+					uartPutChar(LF);
+				}
+				else
+				{
+					ret_cmd = HOST_CMD_ERROR;
+				}
+				break;
+#endif
+			case 'W':
+				// CPU waits of the last frame inquiry
+				if(((host_cmd[cmd_index+CMD_CMD_OFFSET+2]) == '?') && ((host_cmd[cmd_index+CMD_CMD_OFFSET+3]) == 0x0D))
+				{
+					const TimerWaitStats_t *pWait = TIMER_wait_stats();
+
+					// Time slept and awake in ms {SLEEP,<ms><CR><LF>AWAKE,<ms><CR><LF>}
+					uartPutStr("SLEEP,", 6);
+					putNumber((pWait->ul_Sleep / TIMER_TIMEBASE_HZ) * 1000UL
+							+ ((pWait->ul_Sleep % TIMER_TIMEBASE_HZ) * 1000UL) / TIMER_TIMEBASE_HZ, CR);
+					uartPutChar(LF);
+					uartPutStr("AWAKE,", 6);
+					putNumber((pWait->ul_Awake / TIMER_TIMEBASE_HZ) * 1000UL
+							+ ((pWait->ul_Awake % TIMER_TIMEBASE_HZ) * 1000UL) / TIMER_TIMEBASE_HZ, CR);
+					uartPutChar(LF);
+					// Delays and longest overrun {DELAY,<count>,<ticks><CR><LF>}
+					uartPutStr("DELAY,", 6);
+					putNumber(pWait->u16_Delays, ',');
+					putNumber(pWait->u16_LateMax, CR);
+					uartPutChar(LF);
+
+					// Terminate command with {OK<CR><LF>}
+					uartPutStr("OK", 2);
+					uartPutChar(CR);
+					uartPutChar(LF);
+				}
+				else
+				{
+					ret_cmd = HOST_CMD_ERROR;
+				}
+				break;
+			default:
+				ret_cmd = HOST_CMD_ERROR;
+				break;
+			}
+			break;
 		default:
 			ret_cmd = HOST_CMD_ERROR;
 			break;
@@ -773,6 +966,41 @@ parseHostCmd(unsigned char *host_cmd, unsigned char length)
 	return ret_cmd;
 }
 
+/**********************************************************************//**
+ * @brief  Prints a decimal number followed by a separator
+ *
+ * @param  value		is the number to print
+ * @param  separator	is the character printed after the number
+ **************************************************************************/
+static void
+putNumber(unsigned long value, char separator)
+{
+	char tmp_str[12];
+
+	ltoa(value, tmp_str);
+	uartPutStr(tmp_str, strlen(tmp_str));
+	uartPutChar(separator);
+}
+
+#if defined(RADIO_LBT) || defined(ADC_MEASUREMENT)
+/**********************************************************************//**
+ * @brief  Prints a signed decimal number followed by a separator
+ *
+ * @param  value		is the number to print
+ * @param  separator	is the character printed after the number
+ **************************************************************************/
+static void
+putSigned(long value, char separator)
+{
+	if (value < 0)
+	{
+		uartPutChar('-');
+		value = -value;
+	}
+	putNumber((unsigned long)value, separator);
+}
+#endif
+
 /**********************************************************************//**
  * @brief  Converts bytes stored as ASCII string to int array
  *
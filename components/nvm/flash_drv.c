@@ -42,12 +42,37 @@
 #include "flash_drv.h"
 
 
+/* Record log of flash_log_write(): each segment of the storage array starts
+ * with FLASH_LOG_MAGIC and holds records {count, data..., check} */
+#define FLASH_LOG_MAGIC		0xD0D0		// Above the 50000 counts of the wear level records
+#define FLASH_LOG_SEGMENTS	(SIZE_OF_STORAGE_ARRAY / SEGMENT_SIZE)
+#define FLASH_LOG_FREE		0xFFFF
+#define FLASH_WEAR_LEVEL_MAX	0xC350		// Last count of flash_write_wear_level()
+
+static unsigned int log_segment;			// Segment of the last record
+static unsigned int log_index;				// Next record in the segment
+static unsigned int log_count;				// Count of the next record
+static unsigned char log_loaded = 0;		// The log was scanned
+static unsigned char log_erase = 0;			// The segment after log_segment has to be erased
+
+static unsigned char flash_log_scan(unsigned int length);
+static unsigned int flash_log_check(unsigned int *record, unsigned int length);
+static unsigned char flash_log_erased(unsigned int index, unsigned int length);
+static unsigned char flash_log_wear_record(unsigned int index);
+static unsigned char flash_log_wear_segment(unsigned int segment, unsigned int length);
+
+
 #if defined (__MSP430F5438A__) || defined (__MSP430F5529__)
 
 #define FLASH_ARRAY_ORIGIN 0x8000
 #pragma location=FLASH_ARRAY_ORIGIN
 unsigned int flash_array[SIZE_OF_STORAGE_ARRAY];
 
+// Information memory segment D, kept out of the wear level array
+#define FLASH_INFO_ORIGIN 0x1800
+#pragma location=FLASH_INFO_ORIGIN
+unsigned int info_array[INFO_SEGMENT_SIZE];
+
 /**************************************************************************//**
 * @brief    Erase then write data on the flash memeory
 *
@@ -117,6 +142,39 @@ flash_erase_segment(unsigned int index, unsigned int length)
 	return;
 }
 
+/**************************************************************************//**
+* @brief    Erases the information segment then writes data at its start
+*
+* @param	data	is pointer to the data to write
+* @param	length	is the length of the data, up to INFO_SEGMENT_SIZE
+******************************************************************************/
+void
+flash_write_info(unsigned int *data, unsigned int length)
+{
+	unsigned int ii;
+
+	// 5xx Workaround: Disable global interrupt while erasing
+	__disable_interrupt();
+
+	FCTL3 = FWKEY;                            // Clear Lock bit
+	FCTL1 = FWKEY+ERASE;                      // Set Erase bit
+	info_array[0] = 0;                        // Dummy write to erase Flash segment
+	while (FCTL3 & BUSY );
+
+	FCTL1 = FWKEY+WRT;                        // Enable 16 bit write operation
+	for(ii=0; ii<length; ii++)
+	{
+		info_array[ii] = data[ii];            // Write to Flash
+		while (FCTL3 & BUSY );
+	}
+	FCTL1 = FWKEY;                            // Clear WRT bit
+	FCTL3 = FWKEY+LOCK;                       // Set LOCK bit
+	// 5xx Workaround: Re-enable global interrupt after erasing
+	__enable_interrupt();
+
+	return;
+}
+
 
 #endif
 
@@ -126,6 +184,11 @@ flash_erase_segment(unsigned int index, unsigned int length)
 #pragma location=FLASH_ARRAY_ORIGIN
 unsigned int flash_array[SIZE_OF_STORAGE_ARRAY];
 
+// Information memory segment D, segment A holds the calibration data
+#define FLASH_INFO_ORIGIN 0x1000
+#pragma location=FLASH_INFO_ORIGIN
+unsigned int info_array[INFO_SEGMENT_SIZE];
+
 /**************************************************************************//**
 * @brief    Erases a segment on the flash memeory
 *
@@ -156,7 +219,7 @@ flash_erase_segment(unsigned int index, unsigned int length)
 	{
 		FCTL3 = FWKEY;
 		FCTL1 = FWKEY + ERASE;
-		*(Flash_ptr+ii) = 0;              // Write to Flash
+		*(Flash_ptr+ii+index) = 0;        // Dummy write to erase Flash segment
 		while (FCTL3 & BUSY );
 		FCTL1 = FWKEY;
 		FCTL3 = FWKEY +  LOCK;
@@ -194,6 +257,35 @@ flash_write_data(unsigned int *data, unsigned int index ,unsigned int length)
 	return;
 }
 
+/**************************************************************************//**
+* @brief    Erases the information segment then writes data at its start
+*
+* @param	data	is pointer to the data to write
+* @param	length	is the length of the data, up to INFO_SEGMENT_SIZE
+******************************************************************************/
+void
+flash_write_info(unsigned int *data, unsigned int length)
+{
+	unsigned int ii;
+
+	// flash memory controller
+	FCTL2 = FWKEY + FSSEL_2 + FN5 + FN3;      // SMCLK/40 for flash timing generator
+	FCTL3 = FWKEY;
+	FCTL1 = FWKEY + ERASE;
+	info_array[0] = 0;                        // Dummy write to erase Flash segment
+	while (FCTL3 & BUSY );
+
+	FCTL1 = FWKEY + WRT;
+	for(ii=0; ii<length; ii++)
+	{
+		info_array[ii] = data[ii];            // Write to Flash
+		while (FCTL3 & BUSY );
+	}
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY + LOCK;
+	return;
+}
+
 #endif
 
 /**************************************************************************//**
@@ -320,6 +412,307 @@ flash_read_wear_level(unsigned int *data, unsigned int length)
 	return flash_write_count;
 }
 
+
+/**************************************************************************//**
+* @brief    Reads data from the start of the information segment
+*
+* @param	data	is the pointer to store the read data
+* @param	length	is the length of the data to read
+******************************************************************************/
+void
+flash_read_info(unsigned int *data, unsigned int length)
+{
+	unsigned int ii;
+
+	for(ii=0; ii<length; ii++) {
+		data[ii] = info_array[ii];
+	}
+	return;
+}
+
+/**************************************************************************//**
+* @brief    Reads the last record of the log
+*
+* @note     The storage array is scanned once, the position of the next
+*           record is kept for flash_log_write(). Till the first record, the
+*           last record of flash_write_wear_level() is read: the log starts
+*           in the segment after the records of an older firmware, and only
+*           erases the newest of them once it holds a record.
+*
+* @param	data	is the pointer to store the read data
+* @param	length	is the length of the data, as written
+*
+* @return   \b 1 if a record was found, 0 if the log is empty
+******************************************************************************/
+unsigned int
+flash_log_read(unsigned int *data, unsigned int length)
+{
+	unsigned int ii;
+	unsigned int found = 0;
+
+	if (flash_log_scan(length))
+	{
+		flash_read_data(data, log_segment * SEGMENT_SIZE + log_index - (length + 1), length);
+		return 1;
+	}
+
+	// Wear level records {count, data...} from word 0, the last one is the newest
+	for (ii = 0; ii + length + 1 <= SIZE_OF_STORAGE_ARRAY; ii += length + 1)
+	{
+		if (flash_log_wear_record(ii))
+		{
+			found = ii + 1;
+		}
+	}
+	if (found)
+	{
+		flash_read_data(data, found, length);
+		return 1;
+	}
+	return 0;
+}
+
+
+/**************************************************************************//**
+* @brief    Appends a record to the log
+*
+* @note     The count goes first and the check last: a power cut leaves the
+*           previous record as the last valid one. When a segment is full,
+*           the log moves on to the next one, which flash_log_prepare() keeps
+*           erased: the write only programs words.
+*
+* @param	data	is the pointer to the data to write
+* @param	length	is the length of the data
+*
+* @return   \b count 	of the record written
+******************************************************************************/
+unsigned int
+flash_log_write(unsigned int *data, unsigned int length)
+{
+	unsigned int record = length + 2;
+	unsigned int base;
+	unsigned int word;
+
+	if (!log_loaded)
+	{
+		flash_log_scan(length);
+	}
+
+	for (;;)
+	{
+		if (log_index + record > SEGMENT_SIZE)
+		{
+			// Next segment, erased unless a power cut interrupted the erase
+			log_segment = (log_segment + 1) % FLASH_LOG_SEGMENTS;
+			base = log_segment * SEGMENT_SIZE;
+			if (!flash_log_erased(base, SEGMENT_SIZE))
+			{
+				flash_erase_segment(base, SEGMENT_SIZE);
+			}
+			word = FLASH_LOG_MAGIC;
+			flash_write_data(&word, base, 1);
+			log_index = 1;
+			log_erase = 1;
+		}
+		base = log_segment * SEGMENT_SIZE + log_index;
+
+		// Skip the records a power cut left incomplete
+		if (flash_log_erased(base, record))
+		{
+			break;
+		}
+		log_index += record;
+	}
+
+	word = log_count;
+	flash_write_data(&word, base, 1);
+	flash_write_data(data, base + 1, length);
+	word = flash_log_check(&flash_array[base], length);
+	flash_write_data(&word, base + record - 1, 1);
+
+	log_index += record;
+	word = log_count;
+	log_count = (log_count + 1 == FLASH_LOG_FREE) ? 0 : log_count + 1;
+
+	return word;
+}
+
+
+/**************************************************************************//**
+* @brief    Erases the segment the log moves on to when the current one is full
+*
+* @note     The erase disables the interrupts for tens of ms: it is left out
+*           of flash_log_write() and run where the timing allows it.
+******************************************************************************/
+void
+flash_log_prepare(void)
+{
+	unsigned int base;
+
+	if (log_loaded && log_erase)
+	{
+		base = ((log_segment + 1) % FLASH_LOG_SEGMENTS) * SEGMENT_SIZE;
+		if (!flash_log_erased(base, SEGMENT_SIZE))
+		{
+			flash_erase_segment(base, SEGMENT_SIZE);
+		}
+		log_erase = 0;
+	}
+}
+
+
+/**************************************************************************//**
+* @brief    Finds the last record of the log
+*
+* @note     The record with the highest count wins, the records a power cut
+*           left incomplete fail their check and are skipped.
+*
+* @param	length	is the length of the data, as written
+*
+* @return   \b 1 if a record was found
+******************************************************************************/
+static unsigned char
+flash_log_scan(unsigned int length)
+{
+	unsigned int seg, ii;
+	unsigned int record = length + 2;
+	unsigned char found = 0;
+	unsigned int best_index = 0;
+	unsigned int best_count = 0;
+	unsigned int count;
+
+	for (seg = 0; seg < SIZE_OF_STORAGE_ARRAY; seg += SEGMENT_SIZE)
+	{
+		if (flash_array[seg] != FLASH_LOG_MAGIC)
+		{
+			continue;
+		}
+		for (ii = seg + 1; ii + record <= seg + SEGMENT_SIZE; ii += record)
+		{
+			count = flash_array[ii];
+			if ((count != FLASH_LOG_FREE) && (flash_log_check(&flash_array[ii], length) == flash_array[ii + record - 1])
+					&& (!found || ((signed short)(count - best_count) > 0)))
+			{
+				found = 1;
+				best_count = count;
+				best_index = ii;
+			}
+		}
+	}
+
+	if (found)
+	{
+		log_segment = best_index / SEGMENT_SIZE;
+		log_index = best_index - log_segment * SEGMENT_SIZE + record;
+		log_count = (best_count + 1 == FLASH_LOG_FREE) ? 0 : best_count + 1;
+		log_erase = 1;
+	}
+	else
+	{
+		// Start after the last segment of wear level records, the first one
+		// when they fill the array: it holds the oldest of them
+		for (seg = FLASH_LOG_SEGMENTS; (seg > 0) && !flash_log_wear_segment(seg - 1, length); seg--);
+		log_segment = (seg + FLASH_LOG_SEGMENTS - 1) % FLASH_LOG_SEGMENTS;
+		log_index = SEGMENT_SIZE;
+		log_count = 0;
+		log_erase = 0;
+	}
+	log_loaded = 1;
+
+	return found;
+}
+
+
+/**************************************************************************//**
+* @brief    Computes the check word of a record
+*
+* @param	record	is the pointer to the record, starting with its count
+* @param	length	is the length of the data
+*
+* @return   \b check word, a rotate-xor of the count and the data
+******************************************************************************/
+static unsigned int
+flash_log_check(unsigned int *record, unsigned int length)
+{
+	unsigned int check = FLASH_LOG_MAGIC;
+	unsigned int ii;
+
+	for (ii = 0; ii <= length; ii++)
+	{
+		check = (((check << 1) | (check >> 15)) & 0xFFFF) ^ record[ii];
+	}
+	return check;
+}
+
+
+/**************************************************************************//**
+* @brief    Tells if words of the storage array are erased
+*
+* @param	index	is the start location
+* @param	length	is the number of words
+*
+* @return   \b 1 if all the words are erased
+******************************************************************************/
+static unsigned char
+flash_log_erased(unsigned int index, unsigned int length)
+{
+	unsigned int ii;
+
+	for (ii = 0; ii < length; ii++)
+	{
+		if (flash_array[index + ii] != FLASH_LOG_FREE)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+/**************************************************************************//**
+* @brief    Tells if a word is the count of a flash_write_wear_level() record
+*
+* @note     The counts go from 1 to 50000: a magic word a power cut left half
+*           programmed is above. The log segments are skipped.
+*
+* @param	index	is the location of the count
+*
+* @return   \b 1 if a record starts there
+******************************************************************************/
+static unsigned char
+flash_log_wear_record(unsigned int index)
+{
+	return (flash_array[index] != 0) && (flash_array[index] <= FLASH_WEAR_LEVEL_MAX)
+			&& (flash_array[index - index % SEGMENT_SIZE] != FLASH_LOG_MAGIC);
+}
+
+
+/**************************************************************************//**
+* @brief    Tells if a segment holds flash_write_wear_level() records
+*
+* @param	segment	is the segment of the storage array
+* @param	length	is the length of the data, as written
+*
+* @return   \b 1 if a record starts in the segment
+******************************************************************************/
+static unsigned char
+flash_log_wear_segment(unsigned int segment, unsigned int length)
+{
+	unsigned int ii = segment * SEGMENT_SIZE;
+
+	// First record of the segment, records are written from word 0
+	ii += (length + 1 - ii % (length + 1)) % (length + 1);
+	for (; (ii < (segment + 1) * SEGMENT_SIZE) && (ii + length + 1 <= SIZE_OF_STORAGE_ARRAY); ii += length + 1)
+	{
+		if (flash_log_wear_record(ii))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
 /**************************************************************************//**
 * Close the Doxygen group.
 * @}
@@ -37,9 +37,19 @@
 #define SIZE_OF_STORAGE_ARRAY 1024    /* this value is in 16bit words */
 #define SEGMENT_SIZE 256              /* this value is in 16bit words */
 #define SIZE_OF_INFO_ARRAY	128
+#if defined (__MSP430G2553__)
+#define INFO_SEGMENT_SIZE 32          /* this value is in 16bit words */
+#else
+#define INFO_SEGMENT_SIZE 64          /* this value is in 16bit words */
+#endif
 
 unsigned int flash_write_wear_level(unsigned int *data, unsigned int length);
 unsigned int flash_read_wear_level(unsigned int *data, unsigned int length);
+void flash_write_info(unsigned int *data, unsigned int length);
+void flash_read_info(unsigned int *data, unsigned int length);
+unsigned int flash_log_read(unsigned int *data, unsigned int length);
+unsigned int flash_log_write(unsigned int *data, unsigned int length);
+void flash_log_prepare(void);
 
 
 #endif /* FLASH_DRV_H_ */
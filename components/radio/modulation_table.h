@@ -12,12 +12,13 @@
 /******************************************************************************
 * DEFINES AND CONSTANTS
 */
-#if (defined(MODE_FCC) || defined(MODE_ETSI))
+/* Both tables are built in, the modulation profile selected at run time
+ * tells which one is used. See RADIO_select_profile() */
 
 #define NB_PTS_PA  	106
 
-/* PA Table for 600 bps modulation (FCC) */
-static const unsigned int Table_Pa_600bps[NB_PTS_PA] = {
+/* PA Table for the PA ramp profiles (FCC and ETSI). PA_CFG2 levels, one byte each */
+static const unsigned char Table_Pa_600bps[NB_PTS_PA] = {
 	    63   ,
 	    63   ,
 		63   ,
@@ -126,13 +127,12 @@ static const unsigned int Table_Pa_600bps[NB_PTS_PA] = {
 		0    ,
 };
 
-#elif defined(MODE_ETSI_OPT)
-
 #define NB_POINTS	640
 #define MID_NB_PTS 	320
 
-/* PA and FREQOFF Table for 100 bps modulation (ETSI) */
-static const unsigned int CC1120_etsi_profile[NB_POINTS][2]=
+/* PA and FREQOFF Table for the optimized 100 bps profile (ETSI).
+ * { PA_CFG2 level, FREQOFF0 deviation from FOFF0_ETSI }, one byte each */
+static const unsigned char CC1120_etsi_profile[NB_POINTS][2]=
 {
 		{62 ,0  },
 		{62 ,0  },
@@ -775,7 +775,6 @@ static const unsigned int CC1120_etsi_profile[NB_POINTS][2]=
 		{62 ,0 },
 		{63 ,0 }
 };
-#endif  // FCC vs ETSI mode
 
 
 #endif	// MODULATION_TABLE_H
@@ -45,6 +45,7 @@
 * INCLUDES
 */
 #include "stdbool.h"
+#include "string.h"
 #include "device_config.h"
 #include "modulation_table.h"
 #include "trx_rf_int.h"
@@ -55,6 +56,12 @@
 #include "host_cmd.h"
 #endif
 #include "hal_spi_rf_trxeb.h"
+#include "bsp.h"
+#include "timer.h"
+#include "flash_drv.h"
+#if defined(RADIO_DMA_MODULATION) && defined(ADC_MEASUREMENT)
+#include "adc.h"
+#endif
 #include "../../sigfox_library_api/sigfox.h"
 
 /******************************************************************************
@@ -126,20 +133,217 @@
 #define FOFF0_ETSI			 0x7F  // the middle of the register value
 #endif
 
-/* Delay constants. (Depend on MCU SMCLK value and SPI speed) */
+/* Delay constants, tuned with SMCLK = MODULATION_REF_CLK and a SMCLK/3 SPI clock.
+ * RADIO_calibrate_timing() keeps the same durations for the running clock and SPI divider */
+#define MODULATION_REF_CLK					BSP_SYS_CLK_24MHZ
 #define MODULATION_DELAY_CYCLES_600bps		57		// Calibrate the shape of 600 bps spectrum
 #define MODULATION_DELAY_CYCLES_100bps		1000		// Calibrate the shape of 100 bps spectrum
 #define PHASE_ACCUMULATION_DELAY_CYCLES		320		// Calibrate time to accumulate the 180 degree phase change. Depends on FOFFx values declared above.
+#define ETSI_OPT_DELAY_CYCLES				58		// Calibrate the shape of the E_PROFILE_ETSI_OPT profile
+#define CARRIER_RAMP_DELAY_CYCLES			320		// Step of the carrier start / stop ramps
+
+/* Cost of the SPI accesses inside the tuned durations, at the reference setting */
+#define TRX_8BIT_WRITE_CYCLES				70		// Cost of one trx8BitWrite() with a SMCLK/3 SPI clock
+#define FREQOFF_WRITE_CYCLES				130		// Cost of one cc112xSpiWriteReg() to FREQOFFx
+#define TRX_16BIT_WRITE_CYCLES				95		// Cost of one trx16BitWrite()
+
+#define SPIN_CAL_LOOPS						64		// RADIO_spin() loops timed by the calibration
+
+#ifdef RADIO_DMA_MODULATION
+/* DMA trigger select of Timer_B0 CCR0, used to pace the PA ramp */
+#if defined(__MSP430F5529__)
+#define RADIO_DMA_TSEL_TB0CCR0				7
+#elif defined(__MSP430F5438A__)
+#define RADIO_DMA_TSEL_TB0CCR0				5
+#endif
+
+#endif
+
+/* Hardware PA ramps (E_RAMP_HARDWARE). With RAMP_SHAPE = 0 a ramp lasts 3/8 of the
+ * symbol time set by SYMBOL_RATE, which the CFM TX settings do not use otherwise.
+ * The intermediate levels are the ones closest to Table_Pa_600bps */
+#define PA_CFG2_RAMP_SHAPE_EN	0x40		// PA_CFG2.PA_RAMP_SHAPE_EN
+#define PA_POWER_RAMP_MAX		0x3F		// PA_CFG2.PA_POWER_RAMP of the full level
+#define HW_RAMP_CFG				0xFC		// PA_CFG1: FIRST_IPL = 7/16, SECOND_IPL = 15/16, RAMP_SHAPE = 3/8 symbol
+#define HW_RAMP_MARGIN_US		20			// Added to a ramp before FREQOFF is written
+#define HW_RAMP_600BPS_US		563			// Length of the 600 bps ramps
+#define HW_RAMP_100BPS_US		4500		// Length of the 100 bps ramps, two ramps fit in a bit
+#if defined(RF_XTAL_FREQ_40MHZ)
+#define HW_RAMP_600BPS_RATE2	0x31		// 666.7 sps
+#define HW_RAMP_600BPS_RATE1	0x79
+#define HW_RAMP_600BPS_RATE0	0xED
+#define HW_RAMP_100BPS_RATE2	0x08		// 83.33 sps
+#define HW_RAMP_100BPS_RATE1	0xBC
+#define HW_RAMP_100BPS_RATE0	0xF6
+#elif defined(RF_XTAL_FREQ_32MHZ)
+#define HW_RAMP_600BPS_RATE2	0x35		// 666.7 sps
+#define HW_RAMP_600BPS_RATE1	0xD8
+#define HW_RAMP_600BPS_RATE0	0x68
+#define HW_RAMP_100BPS_RATE2	0x0A		// 83.33 sps
+#define HW_RAMP_100BPS_RATE1	0xEC
+#define HW_RAMP_100BPS_RATE0	0x34
+#endif
+
+#ifdef RADIO_HW_PA_RAMP
+#define PA_RAMP_BACKEND			E_RAMP_HARDWARE
+#else
+#define PA_RAMP_BACKEND			E_RAMP_SOFTWARE
+#endif
+
+/* Period between two points of each modulation profile, SPI writes included */
+#define FCC_STEP_CYCLES			(MODULATION_DELAY_CYCLES_600bps + TRX_8BIT_WRITE_CYCLES)
+#define ETSI_STEP_CYCLES		(MODULATION_DELAY_CYCLES_100bps + TRX_8BIT_WRITE_CYCLES)
+#define ETSI_OPT_STEP_CYCLES	(ETSI_OPT_DELAY_CYCLES + TRX_8BIT_WRITE_CYCLES + TRX_16BIT_WRITE_CYCLES)
+
+/* Bit periods tuned with SMCLK = 24 MHz, scaled to the running clock by TIMER_bitrate_init() */
+#define BIT_PERIOD_600BPS		39990		// 1.66 ms at 24 MHz
+#define BIT_PERIOD_100BPS		29982		// 10 ms at 24 MHz / 8
+
+/* Time of the phase accumulation, FREQOFF writes included */
+#define PHASE_STEP_CYCLES		(PHASE_ACCUMULATION_DELAY_CYCLES + 2*FREQOFF_WRITE_CYCLES)
+
+/* Hardware specific constants to calculate frequency register settings.
+ * STEP_MULTIPLICATOR = ((2^16)*4)/Fxosc is kept as the exact fraction STEP_NUM/STEP_DEN */
+#if defined(RF_XTAL_FREQ_40MHZ)
+#define STEP_NUM			512			// 0.0065536 = 512/78125
+#define STEP_DEN			78125
+#elif defined(RF_XTAL_FREQ_32MHZ)
+#define STEP_NUM			128			// 0.008192 = 128/15625
+#define STEP_DEN			15625
+#endif
+#define STPMoverFSR_SHIFT	2			// STEP_MULTIPLICATOR/FINE_STEP_REGISTER = 0.25
+
+/* Number of frequency register settings kept in cache */
+#define FREQ_CACHE_SIZE		8
+
+/* RX engine, see RADIO_rx_packet_interrupt_handler() */
+#define RX_FIFO_ERROR			0x11		// MARCSTATE value on RX FIFO overflow
+#define RX_LAST_READS			4			// RXLAST reads till two agree (SPI read synchronization)
+#define RX_RSSI_OFFSET			102			// RSSI offset of the CC112x, dB
+#define RSSI0_RSSI_VALID		0x01		// RSSI0.RSSI_VALID
+
+/* Radio power policy, see RADIO_power_sleep() */
+#define PWR_IDLE_MAX_MS			2			// Shorter waits stay in IDLE: the XOSC restart takes ~0.3 ms
+#define PWR_XOSC_OFF_MAX_MS		20			// Shorter waits keep the digital core powered (XOFF)
+
+#ifdef RADIO_FS_CAL_CACHE
+/* Synthesizer calibration cache */
+#define FS_CAL_CACHE_SIZE		8
+#define FS_CAL_CHANNEL_WIDTH	25000		// Frequencies (Hz) sharing one calibration
+#define FS_CAL_MAX_USES			32			// Hops before a channel is calibrated again
+#define FS_CAL_TIMEOUT_MS		5			// SCAL back to IDLE, ~0.5 ms expected
+#define MARC_STATE_IDLE			0x01		// MARCSTATE.MARC_STATE value in IDLE
+#endif
 
-/* Hardware specific constants to calculate frequency register settings */
+#ifdef RADIO_XTAL_COMP
+/* XTAL correction table, see RADIO_xtal_learn(). Temperatures are in 1/10 degC,
+ * corrections in 1/100 ppm of the RF frequency */
+#define XTAL_TEMP_MIN			(-400)		// Lower edge of the first bin
+#define XTAL_TEMP_STEP			100			// Width of a bin
+#define XTAL_NB_BINS			13			// -40 to +85 degC
+#define XTAL_TEMP_DEFAULT		250			// Temperature till RADIO_xtal_temperature() is called
+#define XTAL_CORR_MAX			4000		// Larger estimates are rejected (40 ppm)
+#define XTAL_OUTLIER			150			// Estimate away from a learned bin (1.5 ppm)
+#define XTAL_OUTLIER_MAX		3			// Outliers in a row restarting a bin
+#define XTAL_AVG_MAX			8			// Estimates averaged in a bin, older ones then fade out
+#define XTAL_NVM_DELTA			10			// Drift of a bin before it is saved again (0.1 ppm)
+#define XTAL_SEARCH_STEP		350			// RX search step after a miss, within twice the FOC range (3.5 ppm)
+#define XTAL_SEARCH_STEPS		3			// Search steps on each side of the correction
+#define XTAL_NVM_MAGIC			0x5843		// Marks a saved table in information memory
 #if defined(RF_XTAL_FREQ_40MHZ)
-#define STEP_MULTIPLICATOR  0.0065536  	// Pre-calculated frequency coefficient : float(((2^16)*4)/40000000)
-#define FINE_STEP_REGISTER	0.026214	// Pre-calculated frequency coefficient : float(((2^18)*4)/40000000)
-#define STPMoverFSR			0.25		// Pre-calculated frequency coefficient : 0.0065536/0.026214
+#define XTAL_EST_STEP_MHZ		38147		// FREQOFF_EST step in mHz: Fxosc / (4 * 2^18)
 #elif defined(RF_XTAL_FREQ_32MHZ)
-#define STEP_MULTIPLICATOR	0.008192	// Pre-calculated frequency coefficient : float(((2^16)*4)/32000000)
-#define FINE_STEP_REGISTER	0.032768	// Pre-calculated frequency coefficient : float(((2^18)*4)/32000000)
-#define STPMoverFSR			0.25		// Pre-calculated frequency coefficient : 0.008192/0.032768
+#define XTAL_EST_STEP_MHZ		30518
+#endif
+#endif
+
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+#ifdef RADIO_DMA_MODULATION
+/********************************
+ * \enum te_DmaRampState
+ * \brief State of the DMA driven modulation
+ *******************************/
+typedef enum {
+	E_DMA_IDLE = 0,			/*!< No modulation in progress */
+	E_DMA_RAMP_DOWN,		/*!< PA ramp down is streamed */
+	E_DMA_RAMP_UP			/*!< PA ramp up is streamed */
+}te_DmaRampState;
+#endif
+
+
+#ifdef RADIO_HW_PA_RAMP
+/********************************
+ * \enum te_HwRampState
+ * \brief Hardware PA ramp timed by Timer_B0
+ *******************************/
+typedef enum {
+	E_HW_RAMP_IDLE = 0,		/*!< No ramp in progress */
+	E_HW_RAMP_DIP,			/*!< Ramp down of a phase flip, FREQOFF is written at its end */
+	E_HW_RAMP_WAIT			/*!< Carrier ramp, the CPU waits in LPM0 */
+}te_HwRampState;
+#endif
+
+
+/********************************
+ * \struct ModTiming_t
+ * \brief Modulation delays for the running clock, see RADIO_calibrate_timing()
+ *******************************/
+typedef struct {
+	uint16 ramp_loops;		/*!< RADIO_spin() loops between two PA levels of the modulation */
+	uint16 phase_loops;		/*!< RADIO_spin() loops of the phase accumulation */
+	uint16 carrier_loops;	/*!< RADIO_spin() loops between two PA levels of the carrier ramps */
+	uint16 dma_step;		/*!< SMCLK cycles between two PA levels of a DMA ramp */
+	uint16 hw_ramp;			/*!< SMCLK/8 cycles of a hardware PA ramp */
+}ModTiming_t;
+
+
+/********************************
+ * \struct RadioPowerPolicy_t
+ * \brief Power state used for the waits up to a duration
+ *******************************/
+typedef struct {
+	uint32 ul_MaxMs;			/*!< Longest wait (ms) using the state */
+	te_RadioPowerState e_State;	/*!< Power state */
+}RadioPowerPolicy_t;
+
+
+/********************************
+ * \struct FreqCacheEntry_t
+ * \brief FREQ2/1/0 register values computed for a RF frequency
+ *******************************/
+typedef struct {
+	unsigned long freq_rf;	/*!< RF frequency in Hz, 0 if the entry is free */
+	uint8 reg[3];			/*!< FREQ0, FREQ1, FREQ2 */
+}FreqCacheEntry_t;
+
+
+#ifdef RADIO_FS_CAL_CACHE
+/********************************
+ * \struct FsCalEntry_t
+ * \brief Synthesizer calibration results of a channel
+ *******************************/
+typedef struct {
+	uint16 channel;			/*!< RF frequency / FS_CAL_CHANNEL_WIDTH, 0 if the entry is free */
+	uint8 mode;				/*!< ::te_RxChipMode the channel was calibrated in */
+	uint8 uses;				/*!< Hops left before a new calibration */
+	uint8 reg[3];			/*!< FS_CHP, FS_VCO4, FS_VCO2 */
+}FsCalEntry_t;
+#endif
+
+
+#ifdef RADIO_XTAL_COMP
+/********************************
+ * \struct XtalTable_t
+ * \brief XTAL corrections by temperature, saved in information memory
+ *******************************/
+typedef struct {
+	uint16 u16_Magic;				/*!< ::XTAL_NVM_MAGIC once the table was saved */
+	int16 s16_Corr[XTAL_NB_BINS];	/*!< Correction of each bin, 1/100 ppm */
+	uint8 u8_Count[XTAL_NB_BINS];	/*!< Estimates averaged in each bin, 0 if the bin is not learned */
+}XtalTable_t;
 #endif
 
 
@@ -148,34 +352,561 @@
  */
 static bool b_Diff;
 
+/* Modulation profiles, indexed by ::te_ModProfileId */
+static const RadioProfile_t RadioProfiles[E_PROFILE_NB] = {
+	/* E_PROFILE_FCC */
+	{ E_MOD_PA_RAMP, SFX_STD_FCC, Table_Pa_600bps, NB_PTS_PA, FCC_STEP_CYCLES,
+	  FREQ_STEP_LOW_FOFF1, FREQ_STEP_LOW_FOFF0, FREQ_STEP_HIGH_FOFF1, FREQ_STEP_HIGH_FOFF0, 0,
+	  BIT_PERIOD_600BPS, ID_0,
+	  PA_RAMP_BACKEND, HW_RAMP_CFG, HW_RAMP_600BPS_RATE2, HW_RAMP_600BPS_RATE1, HW_RAMP_600BPS_RATE0, HW_RAMP_600BPS_US },
+
+	/* E_PROFILE_ETSI */
+	{ E_MOD_PA_RAMP, SFX_STD_ETSI, Table_Pa_600bps, NB_PTS_PA, ETSI_STEP_CYCLES,
+	  FREQ_STEP_LOW_FOFF1, FREQ_STEP_LOW_FOFF0, FREQ_STEP_HIGH_FOFF1, FREQ_STEP_HIGH_FOFF0, 0,
+	  BIT_PERIOD_100BPS, ID_3,
+	  PA_RAMP_BACKEND, HW_RAMP_CFG, HW_RAMP_100BPS_RATE2, HW_RAMP_100BPS_RATE1, HW_RAMP_100BPS_RATE0, HW_RAMP_100BPS_US },
+
+	/* E_PROFILE_ETSI_OPT */
+	{ E_MOD_PA_FREQOFF, SFX_STD_ETSI, &CC1120_etsi_profile[0][0], NB_POINTS, ETSI_OPT_STEP_CYCLES,
+	  0, 0, 0, 0, FOFF0_ETSI,
+	  BIT_PERIOD_100BPS, ID_3,
+	  PA_RAMP_BACKEND, HW_RAMP_CFG, HW_RAMP_100BPS_RATE2, HW_RAMP_100BPS_RATE1, HW_RAMP_100BPS_RATE0, HW_RAMP_100BPS_US }
+};
+static const RadioProfile_t *pProfile = &RadioProfiles[RADIO_PROFILE_DEFAULT];
+
+static ModTiming_t ModTiming;
+static bool b_TimingCalibrated = false;
+
+static bool b_TxSession = false;	// Back-to-back frames, see RADIO_tx_session()
+static bool b_TxReady = false;		// TX registers set by a previous frame of the session
+static bool b_TxWarm = false;		// Synthesizer left in FSTXON between two carriers
+
+/* Power states by expected wait, the last entry catches every duration */
+static const RadioPowerPolicy_t PowerPolicy[] = {
+	{ PWR_IDLE_MAX_MS,		E_RADIO_PWR_IDLE },
+	{ PWR_XOSC_OFF_MAX_MS,	E_RADIO_PWR_XOSC_OFF },
+	{ RADIO_NEXT_UNKNOWN,	E_RADIO_PWR_DOWN }
+};
+static te_RadioPowerState e_PwrState = E_RADIO_PWR_IDLE;
+static uint32 ul_PwrSince = 0;						// TIMER_timebase_get() at the last state change
+static uint32 ul_NextTxMs = RADIO_NEXT_UNKNOWN;		// See RADIO_power_next_tx()
+static RadioPowerStats_t PwrStats;
+
+static FreqCacheEntry_t FreqCache[FREQ_CACHE_SIZE];
+static uint8 freq_cache_next = 0;
+
+#ifdef RADIO_FS_CAL_CACHE
+static FsCalEntry_t FsCal[FS_CAL_CACHE_SIZE];
+static uint8 fs_cal_next = 0;
+#endif
+static te_RxChipMode e_ChipModeCur = E_TX_MODE;	// Settings written by RADIO_init_chip()
+
+/* Frames queued by the RX interrupt, see RADIO_rx_pop() */
+static RadioRxFrame_t RxRing[RADIO_RX_RING_SIZE];
+static volatile uint8 u8_RxHead = 0;				// Next frame written by the interrupt
+static volatile uint8 u8_RxTail = 0;				// Next frame read by RADIO_rx_pop()
+static RadioRxStats_t RxStats;
+static bool b_RxOn = false;						// Receiver started by RADIO_start_rx()
+static RadioRxFrame_t RxOverflow;				// Frame read while the ring is full
+
+/* Link statistics, see RADIO_link_snapshot() */
+static RadioLinkStats_t LinkStats;
+static RadioLinkChannel_t *pLinkChannel = NULL;	// Channel of the RX window
+static bool b_LinkHit = false;					// A frame was received in the window
+static uint8 link_channel_next = 0;
+
+#ifdef RADIO_LBT
+static RadioLbtStats_t LbtStats;
+static uint16 u16_LbtRandom = 0xACE1;			// Backoff generator, see RADIO_lbt_backoff()
+
+/* Registers of the RX settings a listen needs: front end control, IF,
+ * channel filter and modem gain. Those of HighPerfModeRx are written. */
+static const uint16 LbtRegs[] = { CC112X_IOCFG3, CC112X_IOCFG2, CC112X_IOCFG0, CC112X_DCFILT_CFG,
+								  CC112X_FREQ_IF_CFG, CC112X_CHAN_BW, CC112X_MDMCFG1, CC112X_MDMCFG0 };
+static registerSetting_t LbtRx[sizeof(LbtRegs) / sizeof(LbtRegs[0])];
+static registerSetting_t LbtTx[sizeof(LbtRegs) / sizeof(LbtRegs[0])];	// Values restored after a listen
+static uint8 u8_LbtNbRegs = 0;
+#endif
+
+#ifdef RADIO_XTAL_COMP
+static XtalTable_t XtalTable;
+static int16 s16_XtalSaved[XTAL_NB_BINS];		// Corrections in information memory
+static int16 s16_XtalTemp = XTAL_TEMP_DEFAULT;	// See RADIO_xtal_temperature()
+static int16 s16_XtalCorr = 0;					// Correction at s16_XtalTemp
+static int16 s16_XtalRxCorr = 0;				// Correction of the RX frequency, search included
+static uint8 u8_XtalOutliers = 0;				// Outliers in a row
+static uint8 u8_XtalMisses = 0;					// RX windows without frame in a row
+static bool b_XtalLoaded = false;
+#endif
+
+/* PA levels written by the modulation and the carrier start/stop, at the
+ * ceiling: the E_MOD_PA_RAMP table resampled, or the PA column of the
+ * E_MOD_PA_FREQOFF profile */
+#define RAMP_PA_SIZE	((NB_POINTS > NB_PTS_PA) ? NB_POINTS : NB_PTS_PA)
+static uint8 Ramp_Pa[RAMP_PA_SIZE];
+static int16 nb_ramp_pts = 0;
+
+/* PA_CFG2 level written for each level of the ramps, see RADIO_set_power_ceiling() */
+static uint8 PaLevel[PA_POWER_RAMP_MAX + 1] = {
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+	32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+	48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63
+};
+
+#ifdef RADIO_DMA_MODULATION
+static volatile te_DmaRampState e_DmaState = E_DMA_IDLE;
+static uint8 dma_FOFF1;
+static uint8 dma_FOFF0;
+#endif
+
+#ifdef RADIO_HW_PA_RAMP
+static volatile te_HwRampState e_HwRampState = E_HW_RAMP_IDLE;
+static uint8 hw_FOFF1;
+static uint8 hw_FOFF0;
+#endif
+
 
 /******************************************************************************
  * FUNCTION PROTOTYPE
  */
 static void RADIO_rx_packet_interrupt_handler(void);
+static void RADIO_rx_stop(void);
+static void RADIO_link_frame(const RadioRxFrame_t *pFrame);
+static void RADIO_link_window(unsigned long ul_Freq);
+static uint8 * RADIO_frequency_registers(unsigned long freq_rf);
+static void RADIO_calibrate_timing(void);
+static void RADIO_spin(uint16 u16_Loops);
+static void RADIO_modulate_pa_ramp(void);
+static void RADIO_modulate_pa_freqoff(void);
+static void RADIO_power_enter(te_RadioPowerState e_State);
+static void RADIO_power_wake(void);
+#ifdef RADIO_LBT
+static int8 RADIO_lbt_listen(void);
+static uint16 RADIO_lbt_backoff(uint8 u8_Seed);
+#endif
+#ifdef RADIO_FS_CAL_CACHE
+static void RADIO_fs_calibration(unsigned long freq_rf);
+#endif
+#ifdef RADIO_XTAL_COMP
+static void RADIO_xtal_load(void);
+static uint8 RADIO_xtal_bin(int16 s16_Temp);
+static int16 RADIO_xtal_lookup(void);
+static int16 RADIO_xtal_search(void);
+#endif
+#ifdef RADIO_DMA_MODULATION
+static void RADIO_dma_ramp_start(const unsigned char *pu8_Table, uint16 u16_SrcIncr);
+static void RADIO_dma_ramp_end(void);
+#endif
+#ifdef RADIO_HW_PA_RAMP
+static void RADIO_modulate_hw_ramp(void);
+static void RADIO_hw_ramp_setup(void);
+static void RADIO_hw_ramp_timer(te_HwRampState e_State);
+static void RADIO_hw_ramp_wait(void);
+#endif
 
 
 /******************************************************************************
 * FUNCTIONS
 */
 /**************************************************************************//**
- * @brief       ISR for packet handling in RX. Sets packet semaphore
- *              and clears isr flag.
+ * @brief       ISR for packet handling in RX, on the end of a packet
+ *              (PKT_SYNC_RXTX falling edge). The frame and its status bytes
+ *              are queued with a timestamp, then the receiver is restarted.
+ *
+ * @note        The radio is in IDLE after a packet (RXOFF_MODE): the FIFO
+ *              does not move while it is read, and the frames arriving
+ *              while the library processes the previous ones are queued.
+ *              Frames are dropped only when ::RADIO_RX_RING_SIZE wait.
+ * @note        Sets packetSemaphore while frames are queued.
  *******************************************************************************/
 static void
 RADIO_rx_packet_interrupt_handler(void)
 {
-	// Set packet semaphore
-	packetSemaphore = ISR_ACTION_REQUIRED;
+	RadioRxFrame_t *pFrame;
+	uint8 marc_state;
+	uint8 rx_last;
+	uint8 rx_prev;
+	uint8 i;
+#ifdef RADIO_XTAL_COMP
+	uint8 est[2];
+#endif
 
 	// Clear isr flag
 	trxClearIntFlag();
+
+	cc112xSpiReadReg(CC112X_MARCSTATE, &marc_state, 1);
+
+	// RXLAST is the index of the last byte of the FIFO
+	cc112xSpiReadReg(CC112X_RXLAST, &rx_last, 1);
+	for (i = 0; i < RX_LAST_READS; i++)
+	{
+		rx_prev = rx_last;
+		cc112xSpiReadReg(CC112X_RXLAST, &rx_last, 1);
+		if (rx_last == rx_prev)
+		{
+			break;
+		}
+	}
+
+	if (((marc_state & 0x1F) == RX_FIFO_ERROR) || (rx_last < RADIO_RX_FRAME_SIZE - 1))
+	{
+		RxStats.u16_FifoErrors++;
+	}
+	else
+	{
+		// A full ring still reads the frame, for the link statistics
+		pFrame = ((uint8)(u8_RxHead - u8_RxTail) >= RADIO_RX_RING_SIZE) ? &RxOverflow
+				: &RxRing[u8_RxHead & (RADIO_RX_RING_SIZE - 1)];
+
+		// Frame, then the RSSI and the CRC_OK / LQI status bytes
+		cc112xSpiReadRxFifo(pFrame->au8_Data, RADIO_RX_FRAME_SIZE);
+		pFrame->ul_Time = TIMER_timebase_get();
+		pFrame->s8_Rssi = (int8)pFrame->au8_Data[RADIO_RX_FRAME_SIZE - 2];
+		pFrame->b_CrcOk = (pFrame->au8_Data[RADIO_RX_FRAME_SIZE - 1] & 0x80) ? true : false;
+		RADIO_link_frame(pFrame);
+
+		if (pFrame == &RxOverflow)
+		{
+			RxStats.u16_Dropped++;
+		}
+		else
+		{
+#ifdef RADIO_XTAL_COMP
+			cc112xSpiReadReg(CC112X_FREQOFF_EST1, est, 2);
+			pFrame->s16_FreqOff = (int16)(((uint16)est[0] << 8) | est[1]);
+#endif
+			u8_RxHead++;
+
+			RxStats.u16_Frames++;
+			if ((uint8)(u8_RxHead - u8_RxTail) > RxStats.u8_Queued)
+			{
+				RxStats.u8_Queued = (uint8)(u8_RxHead - u8_RxTail);
+			}
+			packetSemaphore = ISR_ACTION_REQUIRED;
+		}
+	}
+
+	// Flush what is left and receive the next frame
+	trxSpiCmdStrobe(CC112X_SFRX);
+	trxSpiCmdStrobe(CC112X_SRX);
+}
+
+
+/**************************************************************************//**
+ * @brief       Takes the oldest frame queued by the RX interrupt
+ *
+ * @param       pFrame 	is the frame read
+ *
+ * @return      \li \b true if a frame was queued
+ * @return      \li \b false if none
+ *******************************************************************************/
+bool
+RADIO_rx_pop(RadioRxFrame_t *pFrame)
+{
+	uint16 istate;
+
+	if (u8_RxTail == u8_RxHead)
+	{
+		return false;
+	}
+	memcpy(pFrame, &RxRing[u8_RxTail & (RADIO_RX_RING_SIZE - 1)], sizeof(RadioRxFrame_t));
+
+	// The interrupt queues the next frames meanwhile
+	istate = __get_interrupt_state();
+	__disable_interrupt();
+	u8_RxTail++;
+	if (u8_RxTail == u8_RxHead)
+	{
+		packetSemaphore = ISR_IDLE;
+	}
+	__set_interrupt_state(istate);
+
+	return true;
+}
+
+
+/**************************************************************************//**
+ * @brief       Returns the counters of the RX engine
+ *
+ * @return      pointer to the counters, kept across the RX windows
+ *******************************************************************************/
+const RadioRxStats_t *
+RADIO_rx_stats(void)
+{
+	return &RxStats;
+}
+
+
+/**************************************************************************//**
+ * @brief       Gives the link statistics
+ *
+ * @return      the statistics, updated by the RX interrupt
+ *******************************************************************************/
+const RadioLinkStats_t *
+RADIO_link_stats(void)
+{
+	return &LinkStats;
+}
+
+
+/**************************************************************************//**
+ * @brief       Counts an RX window ended without a frame for the device
+ *******************************************************************************/
+void
+RADIO_rx_timeout(void)
+{
+	if (++LinkStats.u16_Timeouts == 0xFFFF)
+	{
+		LinkStats.u16_Timeouts >>= 1;
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief       Writes the link statistics in a compact binary snapshot
+ *
+ * @note        Little endian, ::RADIO_LINK_SNAPSHOT_SIZE bytes:
+ *              version (::RADIO_LINK_VERSION), RSSI histogram (u16 each),
+ *              RSSI average (s16, 1/16 dBm), RSSI min and max (s8, dBm),
+ *              CRC OK, CRC errors and timeouts (u16), then per channel the
+ *              RX frequency (u32, Hz), windows and windows with a frame
+ *              (u16). See RadioLinkStats_t.
+ *
+ * @param       pu8_Buf 	is the buffer, ::RADIO_LINK_SNAPSHOT_SIZE bytes
+ *
+ * @return      the number of bytes written
+ *******************************************************************************/
+uint8
+RADIO_link_snapshot(uint8 *pu8_Buf)
+{
+	RadioLinkStats_t stats;
+	uint16 istate;
+	uint8 *p = pu8_Buf;
+	uint8 i;
+
+	// The RX interrupt updates the statistics
+	istate = __get_interrupt_state();
+	__disable_interrupt();
+	memcpy(&stats, &LinkStats, sizeof(stats));
+	__set_interrupt_state(istate);
+
+	*p++ = RADIO_LINK_VERSION;
+	for (i = 0; i < RADIO_LINK_RSSI_BINS; i++)
+	{
+		*p++ = (uint8)stats.u16_RssiHist[i];
+		*p++ = (uint8)(stats.u16_RssiHist[i] >> 8);
+	}
+	*p++ = (uint8)stats.s16_RssiAvg;
+	*p++ = (uint8)((uint16)stats.s16_RssiAvg >> 8);
+	*p++ = (uint8)stats.s8_RssiMin;
+	*p++ = (uint8)stats.s8_RssiMax;
+	*p++ = (uint8)stats.u16_CrcOk;
+	*p++ = (uint8)(stats.u16_CrcOk >> 8);
+	*p++ = (uint8)stats.u16_CrcFails;
+	*p++ = (uint8)(stats.u16_CrcFails >> 8);
+	*p++ = (uint8)stats.u16_Timeouts;
+	*p++ = (uint8)(stats.u16_Timeouts >> 8);
+	for (i = 0; i < RADIO_LINK_CHANNELS; i++)
+	{
+		*p++ = (uint8)stats.Channels[i].ul_Freq;
+		*p++ = (uint8)(stats.Channels[i].ul_Freq >> 8);
+		*p++ = (uint8)(stats.Channels[i].ul_Freq >> 16);
+		*p++ = (uint8)(stats.Channels[i].ul_Freq >> 24);
+		*p++ = (uint8)stats.Channels[i].u16_Windows;
+		*p++ = (uint8)(stats.Channels[i].u16_Windows >> 8);
+		*p++ = (uint8)stats.Channels[i].u16_Hits;
+		*p++ = (uint8)(stats.Channels[i].u16_Hits >> 8);
+	}
+
+	return (uint8)(p - pu8_Buf);
+}
+
+
+/**************************************************************************//**
+ * @brief       Adds a received frame to the link statistics, from the RX
+ *              interrupt
+ *
+ * @note        Constant time, but for the halving of the histogram when a
+ *              bin would overflow.
+ *
+ * @param       pFrame 	is the frame received
+ *******************************************************************************/
+static void
+RADIO_link_frame(const RadioRxFrame_t *pFrame)
+{
+	int16 rssi;
+	int16 rssi8;
+	int16 bin;
+	uint8 i;
+
+	if (pFrame->b_CrcOk == false)
+	{
+		if (++LinkStats.u16_CrcFails == 0xFFFF)
+		{
+			LinkStats.u16_CrcFails >>= 1;
+		}
+		return;
+	}
+
+	rssi = (int16)pFrame->s8_Rssi - RX_RSSI_OFFSET;
+
+	// The min and max are 8-bit: below -128 dBm, the first bin tells more
+	rssi8 = (rssi < RADIO_LINK_RSSI_LOW) ? RADIO_LINK_RSSI_LOW : rssi;
+	if (LinkStats.u16_CrcOk == 0)
+	{
+		LinkStats.s16_RssiAvg = rssi * 16;
+		LinkStats.s8_RssiMin = (int8)rssi8;
+		LinkStats.s8_RssiMax = (int8)rssi8;
+	}
+	else
+	{
+		LinkStats.s16_RssiAvg += (rssi * 16 - LinkStats.s16_RssiAvg) / 8;
+		if (rssi8 < LinkStats.s8_RssiMin)
+		{
+			LinkStats.s8_RssiMin = (int8)rssi8;
+		}
+		if (rssi8 > LinkStats.s8_RssiMax)
+		{
+			LinkStats.s8_RssiMax = (int8)rssi8;
+		}
+	}
+	if (++LinkStats.u16_CrcOk == 0xFFFF)
+	{
+		LinkStats.u16_CrcOk >>= 1;
+	}
+
+	// First bin below RADIO_LINK_RSSI_LOW, the last one above
+	bin = rssi - RADIO_LINK_RSSI_LOW;
+	bin = (bin < 0) ? 0 : (bin >> RADIO_LINK_RSSI_SHIFT) + 1;
+	if (bin >= RADIO_LINK_RSSI_BINS)
+	{
+		bin = RADIO_LINK_RSSI_BINS - 1;
+	}
+	if (++LinkStats.u16_RssiHist[bin] == 0xFFFF)
+	{
+		for (i = 0; i < RADIO_LINK_RSSI_BINS; i++)
+		{
+			LinkStats.u16_RssiHist[i] >>= 1;
+		}
+	}
+
+	if ((pLinkChannel != NULL) && (b_LinkHit == false))
+	{
+		b_LinkHit = true;
+		pLinkChannel->u16_Hits++;
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief       Opens an RX window in the link statistics
+ *
+ * @param       ul_Freq 	is the RX frequency, without correction
+ *******************************************************************************/
+static void
+RADIO_link_window(unsigned long ul_Freq)
+{
+	RadioLinkChannel_t *pChannel = NULL;
+	uint8 i;
+
+	for (i = 0; i < RADIO_LINK_CHANNELS; i++)
+	{
+		if (LinkStats.Channels[i].ul_Freq == ul_Freq)
+		{
+			pChannel = &LinkStats.Channels[i];
+			break;
+		}
+	}
+	if (pChannel == NULL)
+	{
+		// Replace the channels in turn
+		pChannel = &LinkStats.Channels[link_channel_next];
+		link_channel_next = (link_channel_next + 1) % RADIO_LINK_CHANNELS;
+		pChannel->ul_Freq = ul_Freq;
+		pChannel->u16_Windows = 0;
+		pChannel->u16_Hits = 0;
+	}
+
+	if (++pChannel->u16_Windows == 0xFFFF)
+	{
+		// Keep the success rate
+		pChannel->u16_Windows >>= 1;
+		pChannel->u16_Hits >>= 1;
+	}
+	pLinkChannel = pChannel;
+	b_LinkHit = false;
+}
+
+
+/**************************************************************************//**
+ * @brief       Stops the RX interrupt, before the radio leaves RX. The
+ *              frames queued stay readable.
+ *******************************************************************************/
+static void
+RADIO_rx_stop(void)
+{
+	trxDisableInt();
+	trxClearIntFlag();
+	b_RxOn = false;
+}
+
+
+/**************************************************************************//**
+ *  @brief		Selects the modulation profile: PA table, delays, FREQOFF
+ *  			steps and bit period. See ::RadioProfiles.
+ *
+ *  @note		To be called before SfxInit(): the SigFox standard of the
+ *  			profile is given to the library and TIMER_bitrate_init()
+ *  			reads its bit period. The PA ramp goes back to the full
+ *  			resolution and the modulation delays are computed again at
+ *  			the next RADIO_init_chip().
+ *
+ *  @param 		e_Profile 	is the profile, see ::te_ModProfileId
+ *
+ *  @return 	\li \b true if the profile is selected
+ *  @return		\li \b false if it is unknown or a modulation is in progress
+ ******************************************************************************/
+bool
+RADIO_select_profile(te_ModProfileId e_Profile)
+{
+	if ((e_Profile >= E_PROFILE_NB) || RADIO_modulation_busy())
+	{
+		return false;
+	}
+
+	pProfile = &RadioProfiles[e_Profile];
+	nb_ramp_pts = 0;
+	b_TimingCalibrated = false;
+
+	// The ramp settings of the profile are written by the next RADIO_init_chip()
+	b_TxReady = false;
+
+	return true;
+}
+
+
+/**************************************************************************//**
+ *  @brief		Returns the modulation profile in use
+ *
+ *  @return		pointer to the profile, see RADIO_select_profile()
+ ******************************************************************************/
+const RadioProfile_t *
+RADIO_get_profile(void)
+{
+	return pProfile;
 }
 
 
 /**************************************************************************//**
  *  @brief		This function initializes the RF Chip
  *
+ *  @note		The chip is reset on the first call only. Afterwards, only
+ *  			the registers that differ between the current and the
+ *  			requested configuration are written, see cc112xSpiConfigure().
+ *  @note		Between two frames of a TX session, nothing but the
+ *  			frequency is written, see RADIO_tx_session().
+ *
  *  @param 		ul_CentralFrequency	is the new frequency (in Hz) to program the chip
  *
  *	@param 		e_ChipMode 			is the mode ( RX or TX ) see ::te_RxChipMode
@@ -183,43 +914,70 @@ RADIO_rx_packet_interrupt_handler(void)
 void
 RADIO_init_chip(u32 ul_CentralFrequency, te_RxChipMode e_ChipMode)
 {
-	uint8 writeByte;
-	uint16 i;
+	RADIO_power_wake();
+	RADIO_rx_stop();
 
-	// Reset radio
-	trxSpiCmdStrobe(CC112X_SRES);
+	if ((b_TxReady == true) && (e_ChipMode == E_TX_MODE))
+	{
+		// Next frame of a TX session: the registers are set, only the
+		// frequency changes
+		RADIO_change_frequency(ul_CentralFrequency);
+		return;
+	}
 
 	// Set the radio in IDLE mode
 	trxSpiCmdStrobe(CC112X_SIDLE);
+	RADIO_power_enter(E_RADIO_PWR_IDLE);
+	b_TxReady = false;
+	b_TxWarm = false;
 
-	// Program the proper registers depending on the RF mode ( RX / TX )
+	// The calibration results and the RX search depend on the RX / TX settings
+	e_ChipModeCur = e_ChipMode;
+
+	// Program the proper registers depending on the RF mode ( RX / TX ).
+	// Only the registers that differ from the current configuration are
+	// written, the radio is reset the first time only.
 	if ( e_ChipMode == E_TX_MODE )
 	{
 		// Write registers of the radio chip for TX mode
-		for( i = 0; i < (sizeof(HighPerfModeTx)/sizeof(registerSetting_t)); i++)
-		{
-			writeByte = HighPerfModeTx[i].data;
-			cc112xSpiWriteReg(HighPerfModeTx[i].addr, &writeByte, 1);
-		}
+		cc112xSpiConfigure(HighPerfModeTx, sizeof(HighPerfModeTx)/sizeof(registerSetting_t));
+#ifdef RADIO_HW_PA_RAMP
+		RADIO_hw_ramp_setup();
+#endif
 	}
 	else if ( e_ChipMode == E_RX_MODE )
 	{
 		// Write registers of the radio chip for RX mode
-		for( i = 0; i < (sizeof(HighPerfModeRx)/sizeof(registerSetting_t)); i++)
-		{
-			writeByte = HighPerfModeRx[i].data;
-			cc112xSpiWriteReg(HighPerfModeRx[i].addr, &writeByte, 1);
-		}
-		// Configure ISR to signal PKT_SYNC_RXTX - asserted when sync word has been received
+		cc112xSpiConfigure(HighPerfModeRx, sizeof(HighPerfModeRx)/sizeof(registerSetting_t));
+		// Configure ISR to signal PKT_SYNC_RXTX - deasserted at the end of the packet
 		trxIsrConnect(&RADIO_rx_packet_interrupt_handler);
 
+		// A new RX window: drop the frames of the previous one
+		u8_RxTail = u8_RxHead;
+		packetSemaphore = ISR_IDLE;
+		RADIO_link_window(ul_CentralFrequency);
+
 		// Enable interrupt from GPIO_3
+		trxClearIntFlag();
 		trxEnableInt();
 	}
 
 	// Send the frequency value to the chip
 	RADIO_change_frequency(ul_CentralFrequency);
 
+	// Build the full resolution PA ramp if none was selected
+	if (nb_ramp_pts == 0)
+	{
+		RADIO_set_ramp_resolution((uint8)pProfile->u16_NbPoints);
+	}
+
+	// Fit the modulation delays to the MCU clock and SPI divider
+	if (b_TimingCalibrated == false)
+	{
+		RADIO_calibrate_timing();
+		b_TimingCalibrated = true;
+	}
+
 
 #ifdef CC1190_PA_LNA
 	// Enable PA/LNA according to the e_ChipMode
@@ -240,68 +998,405 @@ RADIO_init_chip(u32 ul_CentralFrequency, te_RxChipMode e_ChipMode)
 
 
 /**************************************************************************//**
- *  @brief 		This function puts the radio in Idle mode
+ *  @brief 		This function puts the radio in Idle mode, or in a lower
+ *  			power state when the next frame is not expected soon.
+ *  			See RADIO_power_next_tx().
  ******************************************************************************/
 void
 RADIO_close_chip(void)
 {
-	trxSpiCmdStrobe(CC112X_SIDLE);
+	RADIO_power_sleep(ul_NextTxMs);
+	b_TxReady = false;
 }
 
 
 /**************************************************************************//**
- *  @brief 		This function allows to change the central frequency used by the chip
- *
- *  @param 		ul_Freq is the new frequency to use
- *
- *  @note		RF frequency Programming : From the CC1125 documentation,
- * 				frequencies have to be programmed following the relations
+ *  @brief 		Opens or closes a TX session. The frames sent in a session
+ *  			keep the chip configuration, the XOSC and the synthesizer.
  *
- *	@note 	 	Freq_rf = Freq_vco / LO_Divider [Hz]
- *  @note		Freq_vco = FREQ * Fxosc/2^16 + FREOFF * Fxosc/2^18  [Hz]
- *
- *  @note		With LO_Divider = 4 and Fxosc = 40 MHz or 32 MHz, we can simplify the equation to:
+ *  @note		In a session, RADIO_stop_rf_carrier() leaves the radio in
+ *  			FSTXON instead of IDLE. The next frame only writes its
+ *  			frequency: the channels of a frame lie within the 192 kHz
+ *  			SigFox band, the synthesizer follows the hop without a new
+ *  			calibration, and STX from FSTXON turns the PA on at once.
+ *  @note		The synthesizer draws current while it waits, see
+ *  			RADIO_tx_session_park(). Closing the session puts the
+ *  			radio back in IDLE.
  *
- *  @note		\li FREQ = 0.0065536 * Freq_rf - 0.25 FREQOFF for 40 MHz XTAL
- *  @note		\li FREQ = 0.008192 * Freq_rf - 0.25 FREQOFF for 32 MHz XTAL
+ *  @param 		b_Enable 	opens (true) or closes (false) the session
  ******************************************************************************/
 void
-RADIO_change_frequency(unsigned long ul_Freq)
+RADIO_tx_session(bool b_Enable)
 {
-	uint8 tuc_Frequence[3];
-	unsigned long CalibFrequency = 0;
-	unsigned long freq_rf;
-	unsigned long freq_reg_value;
-	uint16 offset_reg_value;
-	uint8 writeByte[2];
-
-	// Sending the FREQOFF value
-	writeByte[0] = FOFF0;
-	writeByte[1] = FOFF1;
-	cc112xSpiWriteReg(CC112X_FREQOFF0, &writeByte[0],1);
-	cc112xSpiWriteReg(CC112X_FREQOFF1, &writeByte[1],1);
+	b_TxSession = b_Enable;
 
-	// adding a calibration offset if it's necessary
-	freq_rf = ul_Freq + CalibFrequency;
+	if (b_Enable == false)
+	{
+		RADIO_tx_session_park();
+		b_TxReady = false;
+	}
+}
 
-	// adding Frequency register offset value to compute new frequency value
-	offset_reg_value = (u16)(FOFF1<<8) + (u16)(FOFF0);
-	freq_reg_value   = (u32)(STEP_MULTIPLICATOR * freq_rf ) - (u32)( STPMoverFSR * offset_reg_value );
 
-	// save the value into table
-	tuc_Frequence[0]= (u8) (freq_reg_value & 0x000000FF);
-	tuc_Frequence[1]= (u8) ((freq_reg_value & 0x0000FF00)>> 8u);
-	tuc_Frequence[2]= (u8) ((freq_reg_value & 0x00FF0000)>> 16u);
+/**************************************************************************//**
+ *  @brief 		Stops the synthesizer kept running by a TX session.
+ *
+ *  @note		To be called before a long wait between two frames: the
+ *  			synthesizer current would exceed the cost of the ~0.5 ms
+ *  			calibration done by the next STX. The session keeps the
+ *  			chip configuration, the next frame still only writes its
+ *  			frequency.
+ ******************************************************************************/
+void
+RADIO_tx_session_park(void)
+{
+	if (b_TxWarm == true)
+	{
+		trxSpiCmdStrobe(CC112X_SIDLE);
+		RADIO_power_enter(E_RADIO_PWR_IDLE);
+		b_TxWarm = false;
+	}
+}
 
-	// send frequency registers value to the chip
-	cc112xSpiWriteReg(CC112X_FREQ2, &tuc_Frequence[2],1);
-	cc112xSpiWriteReg(CC112X_FREQ1, &tuc_Frequence[1],1);
-	cc112xSpiWriteReg(CC112X_FREQ0, &tuc_Frequence[0],1);
 
-#ifdef RF_DEBUG_ADV
-	uint8 frOff[2];
-	uint8 fr[3];
-	char freqoff[4];
+/**************************************************************************//**
+ *  @brief 		Tells when the next frame is expected. RADIO_close_chip()
+ *  			selects the power state of the radio from it.
+ *
+ *  @param 		ul_NextMs 	is the time to the next frame in ms, or
+ *  						::RADIO_NEXT_UNKNOWN (default)
+ ******************************************************************************/
+void
+RADIO_power_next_tx(uint32 ul_NextMs)
+{
+	ul_NextTxMs = ul_NextMs;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Puts the radio in the lowest power state worth a wait,
+ *  			see ::PowerPolicy.
+ *
+ *  @note		\li \b IDLE for the waits shorter than the XOSC restart
+ *  @note		\li \b XOFF (SXOFF) for the short waits: only the XOSC is
+ *  			stopped
+ *  @note		\li \b SLEEP (SPWD) for the longer waits
+ *  @note		The registers are kept in XOFF and SLEEP: the register
+ *  			shadow and the TX session stay valid. The chip wakes up
+ *  			when CS_N goes low, the next radio function waits for the
+ *  			XOSC to settle, see RADIO_power_wake().
+ *
+ *  @param 		ul_IdleMs 	is the expected wait in ms, or ::RADIO_NEXT_UNKNOWN
+ ******************************************************************************/
+void
+RADIO_power_sleep(uint32 ul_IdleMs)
+{
+	uint8 i;
+	te_RadioPowerState e_State;
+
+	for (i = 0; ul_IdleMs > PowerPolicy[i].ul_MaxMs; i++);
+	e_State = PowerPolicy[i].e_State;
+
+	if ((e_State == e_PwrState) && (e_State != E_RADIO_PWR_IDLE))
+	{
+		return;
+	}
+
+	// XOFF and SLEEP are entered from IDLE. No RX interrupt out of RX,
+	// nor while the GPIOs are not driven
+	RADIO_power_wake();
+	RADIO_rx_stop();
+	trxSpiCmdStrobe(CC112X_SIDLE);
+	b_TxWarm = false;
+
+	if (e_State != E_RADIO_PWR_IDLE)
+	{
+		trxSpiCmdStrobe((e_State == E_RADIO_PWR_XOSC_OFF) ? CC112X_SXOFF : CC112X_SPWD);
+	}
+	RADIO_power_enter(e_State);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Returns the residency counters of the radio power states,
+ *  			updated to the current time
+ *
+ *  @return		pointer to the counters
+ ******************************************************************************/
+const RadioPowerStats_t *
+RADIO_power_stats(void)
+{
+	RADIO_power_enter(e_PwrState);
+	return &PwrStats;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Records a power state change in the residency counters
+ *
+ *  @param 		e_State 	is the new power state
+ ******************************************************************************/
+static void
+RADIO_power_enter(te_RadioPowerState e_State)
+{
+	uint32 ul_Now = TIMER_timebase_get();
+
+	PwrStats.ul_Residency[e_PwrState] += ul_Now - ul_PwrSince;
+	ul_PwrSince = ul_Now;
+
+	if (e_State != e_PwrState)
+	{
+		PwrStats.u16_Entries[e_State]++;
+		e_PwrState = e_State;
+	}
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Wakes the radio up from XOFF or SLEEP.
+ *
+ *  @note		CS_N low starts the XOSC, SO goes low once it is stable
+ *  			and the chip is back in IDLE. The settle time is recorded.
+ ******************************************************************************/
+static void
+RADIO_power_wake(void)
+{
+	uint32 ul_Start;
+	uint32 ul_Settle;
+
+	if (e_PwrState < E_RADIO_PWR_XOSC_OFF)
+	{
+		return;
+	}
+
+	ul_Start = TIMER_timebase_get();
+	TRXEM_SPI_BEGIN();
+	while(TRXEM_PORT_IN & TRXEM_SPI_MISO_PIN);
+	TRXEM_SPI_END();
+	ul_Settle = TIMER_timebase_get() - ul_Start;
+
+	PwrStats.u16_Wakeups++;
+	if (ul_Settle > PwrStats.u16_WakeSettleMax)
+	{
+		PwrStats.u16_WakeSettleMax = (uint16)ul_Settle;
+	}
+	RADIO_power_enter(E_RADIO_PWR_IDLE);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Turns the receiver on
+ *
+ *  @note		Once on, the receiver is restarted after each frame by the
+ *  			RX interrupt: the next calls do nothing till RADIO_init_chip()
+ *  			or RADIO_close_chip().
+ ******************************************************************************/
+void
+RADIO_start_rx(void)
+{
+	if (b_RxOn == true)
+	{
+		return;
+	}
+	RADIO_power_wake();
+	trxSpiCmdStrobe(CC112X_SRX);
+	RADIO_power_enter(E_RADIO_PWR_ACTIVE);
+	b_RxOn = true;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Selects the number of PA levels written for each ramp of the
+ *  			modulation and of the carrier start/stop.
+ *
+ *  @note		The ramp is resampled from the table of the profile with a
+ *  			linear interpolation (8-bit fraction). With as many steps as
+ *  			the table, it is the reference table. Each step keeps the same
+ *  			delay, so a lower resolution shortens the ramps and cuts the
+ *  			SPI traffic, at the cost of a less clean spectrum.
+ *  @note		The E_MOD_PA_FREQOFF profiles modulate with FREQOFF as well,
+ *  			their phase accumulation depends on every point: the full
+ *  			profile is always used, only its PA levels are copied to
+ *  			the ramp, u8_NbSteps has no effect.
+ *  @note		Selecting a profile goes back to the full resolution.
+ *
+ *  @param 		u8_NbSteps 	is the number of PA levels, 2 to the table size
+ *
+ *  @return 	\li \b true if the resolution is applied
+ *  @return		\li \b false if it is out of range
+ ******************************************************************************/
+bool
+RADIO_set_ramp_resolution(uint8 u8_NbSteps)
+{
+	const unsigned char *pu8_Table = pProfile->pu8_Table;
+	uint16 nb_pts = pProfile->u16_NbPoints;
+	uint16 i;
+	uint16 index;
+	uint16 frac;
+	uint32 pos;
+	int16 level;
+
+	if (pProfile->e_Type == E_MOD_PA_FREQOFF)
+	{
+		if (RADIO_modulation_busy())
+		{
+			return false;
+		}
+		for (i = 0; i < nb_pts; i++)
+		{
+			Ramp_Pa[i] = PaLevel[pu8_Table[2*i]];
+		}
+		nb_ramp_pts = nb_pts;
+		return true;
+	}
+
+	if ((u8_NbSteps < 2) || (u8_NbSteps > nb_pts) || (u8_NbSteps > NB_PTS_PA) || RADIO_modulation_busy())
+	{
+		return false;
+	}
+
+	for (i = 0; i < u8_NbSteps; i++)
+	{
+		// Position in the reference table, 8-bit fixed point
+		pos   = ((uint32)i * (nb_pts-1) * 256) / (u8_NbSteps-1);
+		index = (uint16)(pos >> 8);
+		frac  = (uint16)(pos & 0xFF);
+
+		level = pu8_Table[index];
+		if (frac != 0)
+		{
+			level += (int16)(((int16)pu8_Table[index+1] - level) * (int16)frac + 128) >> 8;
+		}
+		Ramp_Pa[i] = PaLevel[level];
+	}
+	nb_ramp_pts = u8_NbSteps;
+
+	return true;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Sets the PA level reached by the carrier and the ramps
+ *
+ *  @note		The levels of the ramp tables are moved down by the same
+ *  			number of steps (0.5 dB each), the lowest ones stay at 0:
+ *  			the shape of the ramps in dB is kept without new tables.
+ *  			The hardware ramps start from the ceiling.
+ *  @note		The CC1190 has no bypass: with CC1190_PA_LNA the ceiling
+ *  			lowers the drive of its PA.
+ *
+ *  @param 		u8_Level 	is the PA_CFG2 level, up to 63 (full power)
+ *
+ *  @return 	\li \b true if the ceiling is applied
+ *  @return		\li \b false if a modulation is in progress
+ ******************************************************************************/
+bool
+RADIO_set_power_ceiling(uint8 u8_Level)
+{
+	uint8 offset;
+	uint8 i;
+
+	if (u8_Level > PA_POWER_RAMP_MAX)
+	{
+		u8_Level = PA_POWER_RAMP_MAX;
+	}
+	if (PaLevel[PA_POWER_RAMP_MAX] == u8_Level)
+	{
+		return true;
+	}
+	if (RADIO_modulation_busy())
+	{
+		return false;
+	}
+
+	offset = PA_POWER_RAMP_MAX - u8_Level;
+	for (i = 0; i <= PA_POWER_RAMP_MAX; i++)
+	{
+		PaLevel[i] = (i > offset) ? i - offset : 0;
+	}
+
+	// Rebuild the ramp with the new levels, the modulation writes it as is
+	if (nb_ramp_pts != 0)
+	{
+		RADIO_set_ramp_resolution((uint8)nb_ramp_pts);
+	}
+	return true;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		This function allows to change the central frequency used by the chip
+ *
+ *  @param 		ul_Freq is the new frequency to use
+ *
+ *  @note		RF frequency Programming : From the CC1125 documentation,
+ * 				frequencies have to be programmed following the relations
+ *
+ *	@note 	 	Freq_rf = Freq_vco / LO_Divider [Hz]
+ *  @note		Freq_vco = FREQ * Fxosc/2^16 + FREOFF * Fxosc/2^18  [Hz]
+ *
+ *  @note		With LO_Divider = 4 and Fxosc = 40 MHz or 32 MHz, we can simplify the equation to:
+ *
+ *  @note		\li FREQ = 0.0065536 * Freq_rf - 0.25 FREQOFF for 40 MHz XTAL
+ *  @note		\li FREQ = 0.008192 * Freq_rf - 0.25 FREQOFF for 32 MHz XTAL
+ *
+ *  @note		The register values come from a cache of the last
+ *  			::FREQ_CACHE_SIZE frequencies, see RADIO_frequency_registers().
+ *  @note		With RADIO_FS_CAL_CACHE, the synthesizer is calibrated here,
+ *  			the radio has to be in IDLE. See RADIO_fs_calibration().
+ *  			The hops of a TX session keep the running calibration.
+ *  @note		With RADIO_XTAL_COMP, the frequency is pulled by the XTAL
+ *  			correction learned for the current temperature, see
+ *  			RADIO_xtal_learn().
+ ******************************************************************************/
+void
+RADIO_change_frequency(unsigned long ul_Freq)
+{
+	uint8 * tuc_Frequence;
+	long CalibFrequency = 0;
+	unsigned long freq_rf;
+	registerSetting_t freqRegs[5];
+
+	RADIO_power_wake();
+
+#ifdef RADIO_XTAL_COMP
+	// XTAL correction in Hz: the frequency is taken in 10 kHz units to stay in 32 bits
+	RADIO_xtal_load();
+	CalibFrequency = s16_XtalCorr;
+	if (e_ChipModeCur == E_RX_MODE)
+	{
+		CalibFrequency += RADIO_xtal_search();
+		s16_XtalRxCorr = (int16)CalibFrequency;
+	}
+	CalibFrequency = ((long)(ul_Freq / 10000UL) * CalibFrequency) / 10000L;
+#endif
+
+	// adding a calibration offset if it's necessary
+	freq_rf = ul_Freq + CalibFrequency;
+
+	// get the frequency registers value
+	tuc_Frequence = RADIO_frequency_registers(freq_rf);
+
+	// send FREQOFF and frequency registers value to the chip in one burst
+	freqRegs[0].addr = CC112X_FREQOFF1;	freqRegs[0].data = FOFF1;
+	freqRegs[1].addr = CC112X_FREQOFF0;	freqRegs[1].data = FOFF0;
+	freqRegs[2].addr = CC112X_FREQ2;	freqRegs[2].data = tuc_Frequence[2];
+	freqRegs[3].addr = CC112X_FREQ1;	freqRegs[3].data = tuc_Frequence[1];
+	freqRegs[4].addr = CC112X_FREQ0;	freqRegs[4].data = tuc_Frequence[0];
+	cc112xSpiWriteRegs(freqRegs, 5);
+
+#ifdef RADIO_FS_CAL_CACHE
+	// Calibrate the synthesizer or restore the channel calibration
+	if (b_TxWarm == false)
+	{
+		RADIO_fs_calibration(freq_rf);
+	}
+#endif
+
+#ifdef RF_DEBUG_ADV
+	uint8 frOff[2];
+	uint8 fr[3];
+	char freqoff[4];
 	char freq[6];
 	cc112xSpiReadReg(CC112X_FREQOFF1, &frOff[0], 1);
 	cc112xSpiReadReg(CC112X_FREQOFF0, &frOff[1], 1);
@@ -318,6 +1413,500 @@ RADIO_change_frequency(unsigned long ul_Freq)
 }
 
 
+/**************************************************************************//**
+ *  @brief 		Returns the FREQ0/1/2 register values of a RF frequency
+ *
+ *  @note		Integer computation of FREQ = STEP_MULTIPLICATOR * Freq_rf
+ *  			- FREQOFF/4. The product is split on STEP_DEN to stay in
+ *  			32 bits: it gives the same result as the double precision
+ *  			computation without the floating point library.
+ *  @note		The last ::FREQ_CACHE_SIZE results are kept, hopping back to
+ *  			a known channel is a table lookup.
+ *
+ *  @param 		freq_rf 	is the RF frequency in Hz
+ *
+ *  @return		pointer to FREQ0, FREQ1, FREQ2
+ ******************************************************************************/
+static uint8 *
+RADIO_frequency_registers(unsigned long freq_rf)
+{
+	FreqCacheEntry_t *entry;
+	unsigned long freq_reg_value;
+	uint8 i;
+
+	for (i = 0; i < FREQ_CACHE_SIZE; i++)
+	{
+		if (FreqCache[i].freq_rf == freq_rf)
+		{
+			return FreqCache[i].reg;
+		}
+	}
+
+	// adding Frequency register offset value to compute new frequency value
+	freq_reg_value  = (freq_rf / STEP_DEN) * STEP_NUM;
+	freq_reg_value += ((freq_rf % STEP_DEN) * STEP_NUM) / STEP_DEN;
+	freq_reg_value -= (((u16)(FOFF1<<8) + (u16)(FOFF0)) >> STPMoverFSR_SHIFT);
+
+	// save the value into the cache, replacing the oldest entry
+	entry = &FreqCache[freq_cache_next];
+	freq_cache_next = (freq_cache_next + 1) % FREQ_CACHE_SIZE;
+
+	entry->freq_rf = freq_rf;
+	entry->reg[0]  = (u8) (freq_reg_value & 0x000000FF);
+	entry->reg[1]  = (u8) ((freq_reg_value & 0x0000FF00)>> 8u);
+	entry->reg[2]  = (u8) ((freq_reg_value & 0x00FF0000)>> 16u);
+
+	return entry->reg;
+}
+
+
+#ifdef RADIO_FS_CAL_CACHE
+/**************************************************************************//**
+ *  @brief 		Calibrates the synthesizer for a RF frequency, or writes back
+ *  			the calibration results of its channel.
+ *
+ *  @note		The automatic calibration is disabled in the register
+ *  			settings (SETTLING_CFG.FS_AUTOCAL = 0). The first hop on a
+ *  			channel issues a SCAL strobe and saves FS_CHP, FS_VCO4 and
+ *  			FS_VCO2. The next hops write these 3 registers instead of
+ *  			calibrating for ~0.5 ms when entering TX or RX. A channel is
+ *  			calibrated again after ::FS_CAL_MAX_USES hops to follow the
+ *  			temperature and supply drifts.
+ *  @note		The return to IDLE is awaited ::FS_CAL_TIMEOUT_MS at most:
+ *  			without it the results are not saved, the next hop on the
+ *  			channel calibrates again.
+ *
+ *  @param 		freq_rf 	is the RF frequency in Hz
+ ******************************************************************************/
+static void
+RADIO_fs_calibration(unsigned long freq_rf)
+{
+	FsCalEntry_t *entry;
+	registerSetting_t calRegs[3];
+	uint16 channel = (uint16)(freq_rf / FS_CAL_CHANNEL_WIDTH);
+	uint32 ul_Start;
+	uint32 ul_Timeout = ((uint32)FS_CAL_TIMEOUT_MS * TIMER_TIMEBASE_HZ + 999UL) / 1000UL;
+	uint8 marcState;
+	uint8 i;
+
+	for (i = 0; i < FS_CAL_CACHE_SIZE; i++)
+	{
+		if ((FsCal[i].channel == channel) && (FsCal[i].mode == (uint8)e_ChipModeCur))
+		{
+			break;
+		}
+	}
+	entry = &FsCal[(i < FS_CAL_CACHE_SIZE) ? i : fs_cal_next];
+
+	if ((i < FS_CAL_CACHE_SIZE) && (entry->uses != 0))
+	{
+		// Write back the calibration of the channel
+		entry->uses--;
+		calRegs[0].addr = CC112X_FS_CHP;	calRegs[0].data = entry->reg[0];
+		calRegs[1].addr = CC112X_FS_VCO4;	calRegs[1].data = entry->reg[1];
+		calRegs[2].addr = CC112X_FS_VCO2;	calRegs[2].data = entry->reg[2];
+		cc112xSpiWriteRegs(calRegs, 3);
+		return;
+	}
+
+	if (i == FS_CAL_CACHE_SIZE)
+	{
+		// New channel, replacing the oldest entry
+		fs_cal_next = (fs_cal_next + 1) % FS_CAL_CACHE_SIZE;
+		entry->channel = channel;
+		entry->mode = (uint8)e_ChipModeCur;
+	}
+
+	// Calibrate and wait for the radio to return in IDLE
+	trxSpiCmdStrobe(CC112X_SCAL);
+	ul_Start = TIMER_timebase_get();
+	do
+	{
+		cc112xSpiReadReg(CC112X_MARCSTATE, &marcState, 1);
+	}while (((marcState & 0x1F) != MARC_STATE_IDLE) && ((TIMER_timebase_get() - ul_Start) < ul_Timeout));
+
+	if ((marcState & 0x1F) != MARC_STATE_IDLE)
+	{
+		// Not cached, calibrated again at the next hop
+		entry->uses = 0;
+		return;
+	}
+
+	cc112xSpiReadReg(CC112X_FS_CHP, &entry->reg[0], 1);
+	cc112xSpiReadReg(CC112X_FS_VCO4, &entry->reg[1], 1);
+	cc112xSpiReadReg(CC112X_FS_VCO2, &entry->reg[2], 1);
+	entry->uses = FS_CAL_MAX_USES;
+}
+#endif
+
+
+#ifdef RADIO_XTAL_COMP
+/**************************************************************************//**
+ *  @brief 		Sets the temperature the XTAL correction is looked up for.
+ *
+ *  @note		To be called before the frequencies of a frame are set, with
+ *  			the temperature sfx_get_voltage_temperature() reports.
+ *
+ *  @param 		s16_Temp 	is the temperature in 1/10 degC
+ ******************************************************************************/
+void
+RADIO_xtal_temperature(int16 s16_Temp)
+{
+	RADIO_xtal_load();
+	s16_XtalTemp = s16_Temp;
+	s16_XtalCorr = RADIO_xtal_lookup();
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Learns the XTAL error from the frequency offset of a received
+ *  			downlink frame.
+ *
+ *  @note		The base stations transmit on an accurate frequency:
+ *  			FREQOFF_EST, the offset the FOC measured on the frame, is
+ *  			what remains of the XTAL error after the correction of the
+ *  			RX frequency. Both add up to the correction of the
+ *  			temperature bin.
+ *  @note		A bin averages its first ::XTAL_AVG_MAX estimates, the older
+ *  			ones then fade out to follow the ageing. The first estimate
+ *  			of a bin is replaced by the next one when they differ by
+ *  			more than ::XTAL_OUTLIER. Once confirmed, such estimates are
+ *  			dropped unless ::XTAL_OUTLIER_MAX come in a row.
+ *  @note		The table is saved in information memory when a bin is
+ *  			learned or has moved by ::XTAL_NVM_DELTA: one segment erase
+ *  			per downlink at most.
+ *
+ *  @param 		ul_Freq 	is the RX frequency of the frame, without correction
+ *  @param 		s16_FreqOff	is the FREQOFF_EST of the frame, see RadioRxFrame_t
+ ******************************************************************************/
+void
+RADIO_xtal_learn(unsigned long ul_Freq, int16 s16_FreqOff)
+{
+	long s32_Corr;
+	int16 s16_Diff;
+	uint8 bin;
+
+	RADIO_xtal_load();
+	u8_XtalMisses = 0;
+
+	// Residual offset in 1/100 ppm: Hz * 10^8 / Freq_rf
+	s32_Corr = (long)s16_FreqOff * XTAL_EST_STEP_MHZ;
+	s32_Corr = s32_Corr / (long)(ul_Freq / 100000UL) + s16_XtalRxCorr;
+
+	if ((s32_Corr > XTAL_CORR_MAX) || (s32_Corr < -XTAL_CORR_MAX))
+	{
+		return;
+	}
+
+	bin = RADIO_xtal_bin(s16_XtalTemp);
+	s16_Diff = (int16)s32_Corr - XtalTable.s16_Corr[bin];
+
+	if ((XtalTable.u8_Count[bin] != 0) && ((s16_Diff > XTAL_OUTLIER) || (s16_Diff < -XTAL_OUTLIER)))
+	{
+		if ((XtalTable.u8_Count[bin] > 1) && (++u8_XtalOutliers < XTAL_OUTLIER_MAX))
+		{
+			return;
+		}
+		// The bin does not match the XTAL, learn it again
+		XtalTable.u8_Count[bin] = 0;
+	}
+	u8_XtalOutliers = 0;
+
+	if (XtalTable.u8_Count[bin] < XTAL_AVG_MAX)
+	{
+		XtalTable.u8_Count[bin]++;
+	}
+	if (XtalTable.u8_Count[bin] == 1)
+	{
+		XtalTable.s16_Corr[bin] = (int16)s32_Corr;
+	}
+	else
+	{
+		XtalTable.s16_Corr[bin] += s16_Diff / XtalTable.u8_Count[bin];
+	}
+	s16_XtalCorr = RADIO_xtal_lookup();
+
+	s16_Diff = XtalTable.s16_Corr[bin] - s16_XtalSaved[bin];
+	if ((XtalTable.u8_Count[bin] == 1) || (s16_Diff >= XTAL_NVM_DELTA) || (s16_Diff <= -XTAL_NVM_DELTA))
+	{
+		XtalTable.u16_Magic = XTAL_NVM_MAGIC;
+		flash_write_info((unsigned int *)&XtalTable, sizeof(XtalTable_t) / sizeof(unsigned int));
+		for (bin = 0; bin < XTAL_NB_BINS; bin++)
+		{
+			s16_XtalSaved[bin] = XtalTable.s16_Corr[bin];
+		}
+	}
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Counts a RX window closed without frame. The next RX
+ *  			frequencies search around the correction, see
+ *  			RADIO_xtal_search().
+ ******************************************************************************/
+void
+RADIO_xtal_miss(void)
+{
+	u8_XtalMisses++;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Gives the XTAL correction in use.
+ *
+ *  @return		correction at the current temperature in 1/100 ppm
+ ******************************************************************************/
+int16
+RADIO_xtal_correction(void)
+{
+	RADIO_xtal_load();
+	return s16_XtalCorr;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Reads the XTAL correction table from information memory,
+ *  			once. A blank or foreign segment gives an empty table.
+ ******************************************************************************/
+static void
+RADIO_xtal_load(void)
+{
+	uint8 bin;
+
+	if (b_XtalLoaded == true)
+	{
+		return;
+	}
+	b_XtalLoaded = true;
+
+	flash_read_info((unsigned int *)&XtalTable, sizeof(XtalTable_t) / sizeof(unsigned int));
+	for (bin = 0; bin < XTAL_NB_BINS; bin++)
+	{
+		if ((XtalTable.u16_Magic != XTAL_NVM_MAGIC) || (XtalTable.u8_Count[bin] > XTAL_AVG_MAX))
+		{
+			XtalTable.s16_Corr[bin] = 0;
+			XtalTable.u8_Count[bin] = 0;
+		}
+		s16_XtalSaved[bin] = XtalTable.s16_Corr[bin];
+	}
+	s16_XtalCorr = RADIO_xtal_lookup();
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Gives the bin of a temperature, the outer bins extend to
+ *  			the temperatures out of the table.
+ *
+ *  @param 		s16_Temp 	is the temperature in 1/10 degC
+ *
+ *  @return		index in XtalTable
+ ******************************************************************************/
+static uint8
+RADIO_xtal_bin(int16 s16_Temp)
+{
+	if (s16_Temp < XTAL_TEMP_MIN)
+	{
+		return 0;
+	}
+	if (s16_Temp >= XTAL_TEMP_MIN + XTAL_NB_BINS * XTAL_TEMP_STEP)
+	{
+		return XTAL_NB_BINS - 1;
+	}
+	return (uint8)((s16_Temp - XTAL_TEMP_MIN) / XTAL_TEMP_STEP);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Looks up the XTAL correction of the current temperature.
+ *
+ *  @note		The correction of a bin stands for the middle of the bin.
+ *  			The temperature takes the linear interpolation of the
+ *  			closest learned bins around it, or the closest learned bin
+ *  			when it is outside of them. No bin learned gives 0.
+ *
+ *  @return		correction in 1/100 ppm
+ ******************************************************************************/
+static int16
+RADIO_xtal_lookup(void)
+{
+	int16 s16_Pos = s16_XtalTemp - (XTAL_TEMP_MIN + XTAL_TEMP_STEP / 2);
+	int8 lo, hi;
+
+	// Position from the middle of the first bin
+	if (s16_Pos < 0)
+	{
+		s16_Pos = 0;
+	}
+	if (s16_Pos > (XTAL_NB_BINS - 1) * XTAL_TEMP_STEP)
+	{
+		s16_Pos = (XTAL_NB_BINS - 1) * XTAL_TEMP_STEP;
+	}
+
+	lo = (int8)(s16_Pos / XTAL_TEMP_STEP);
+	hi = (s16_Pos % XTAL_TEMP_STEP) ? lo + 1 : lo;
+	for (; (lo >= 0) && (XtalTable.u8_Count[lo] == 0); lo--);
+	for (; (hi < XTAL_NB_BINS) && (XtalTable.u8_Count[hi] == 0); hi++);
+
+	if ((lo >= 0) && (hi < XTAL_NB_BINS) && (lo != hi))
+	{
+		return XtalTable.s16_Corr[lo] + (int16)(((long)(XtalTable.s16_Corr[hi] - XtalTable.s16_Corr[lo])
+				* (s16_Pos - lo * XTAL_TEMP_STEP)) / ((hi - lo) * XTAL_TEMP_STEP));
+	}
+	if (lo >= 0)
+	{
+		return XtalTable.s16_Corr[lo];
+	}
+	if (hi < XTAL_NB_BINS)
+	{
+		return XtalTable.s16_Corr[hi];
+	}
+	return 0;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Gives the offset of the RX frequency from the correction.
+ *
+ *  @note		The window after a miss stays on the correction: a frame
+ *  			lost on the link is no reason to move. After two misses in
+ *  			a row, the next windows alternate between a search step
+ *  			and the correction: +1, -1, +2 ...
+ *  			::XTAL_SEARCH_STEP on each side, up to ::XTAL_SEARCH_STEPS,
+ *  			then again. It finds the base stations while no bin is
+ *  			learned, or when the table no longer matches the XTAL,
+ *  			without moving away from a good correction for more than
+ *  			one window.
+ *
+ *  @return		offset in 1/100 ppm
+ ******************************************************************************/
+static int16
+RADIO_xtal_search(void)
+{
+	uint8 step;
+
+	if ((u8_XtalMisses < 2) || (u8_XtalMisses & 1))
+	{
+		return 0;
+	}
+
+	step = (u8_XtalMisses / 2 - 1) % (2 * XTAL_SEARCH_STEPS);
+	if (step & 1)
+	{
+		return -(int16)((step + 1) / 2) * XTAL_SEARCH_STEP;
+	}
+	return (int16)(step / 2 + 1) * XTAL_SEARCH_STEP;
+}
+#endif
+
+
+/**************************************************************************//**
+ *  @brief 		Computes the modulation delays for the running MCU clock.
+ *
+ *  @note		The delays were tuned with SMCLK = ::MODULATION_REF_CLK and a
+ *  			SMCLK/3 SPI clock. The durations they give for the selected
+ *  			profile, SPI writes included, are kept: the SPI writes and RADIO_spin() are timed
+ *  			with Timer_B0 on SMCLK (= MCLK) and the number of RADIO_spin()
+ *  			loops is what remains of each duration. When the writes alone
+ *  			are longer than a duration, the delay is 0 and the modulation
+ *  			is slower than tuned.
+ *  @note		PA_CFG2 and FREQOFF are written: the radio has to be in IDLE.
+ ******************************************************************************/
+static void
+RADIO_calibrate_timing(void)
+{
+	uint16 istate;
+	uint16 t_start;
+	uint16 t_ref;
+	uint16 spin_0;
+	uint16 spin_n;
+	uint16 write_ramp;
+	uint16 write_phase;
+	uint32 clk_khz = bspSysClockSpeedGet() / 1000;
+	uint32 target;
+	uint8 writeByte_FOFF1 = FOFF1;
+	uint8 writeByte_FOFF0 = FOFF0;
+
+	istate = __get_interrupt_state();
+	__disable_interrupt();
+
+	// Timer_B0 free running on SMCLK
+	TB0CCTL0 = 0;
+	TB0CTL   = TBSSEL_2 + MC_2 + TBCLR;
+
+	// Cost of reading the timer
+	t_start = TB0R;
+	t_ref = TB0R - t_start;
+
+	// RADIO_spin() call and loop
+	t_start = TB0R;
+	RADIO_spin(0);
+	spin_0 = TB0R - t_start - t_ref;
+	t_start = TB0R;
+	RADIO_spin(SPIN_CAL_LOOPS);
+	spin_n = (TB0R - t_start - t_ref - spin_0 + SPIN_CAL_LOOPS/2) / SPIN_CAL_LOOPS;
+
+	// SPI writes of a ramp step
+	t_start = TB0R;
+	trx8BitWrite(CC112X_PA_CFG2, 0x00);
+	if (pProfile->e_Type == E_MOD_PA_FREQOFF)
+	{
+		trx16BitWrite((uint8)(CC112X_FREQOFF0 >> 8), (uint8)(CC112X_FREQOFF0 & 0x00FF), pProfile->u8_DevFoff0);
+	}
+	write_ramp = TB0R - t_start - t_ref;
+
+	// SPI writes of the phase accumulation
+	t_start = TB0R;
+	cc112xSpiWriteReg(CC112X_FREQOFF1, &writeByte_FOFF1, 1);
+	cc112xSpiWriteReg(CC112X_FREQOFF0, &writeByte_FOFF0, 1);
+	write_phase = TB0R - t_start - t_ref;
+
+	TB0CTL = TBCLR;
+	__set_interrupt_state(istate);
+
+	// PA_CFG2 was written behind the register shadow
+	cc112xSpiShadowInvalidate(CC112X_PA_CFG2);
+
+	// Ramp step
+	target = (pProfile->u16_StepCycles * clk_khz) / (MODULATION_REF_CLK / 1000);
+	ModTiming.dma_step = (uint16)target;
+	if (ModTiming.dma_step < write_ramp)
+	{
+		ModTiming.dma_step = write_ramp;
+	}
+	target = (target > (write_ramp + spin_0)) ? (target - write_ramp - spin_0) : 0;
+	ModTiming.ramp_loops = (uint16)(target / spin_n);
+
+	// Phase accumulation
+	target = (PHASE_STEP_CYCLES * clk_khz) / (MODULATION_REF_CLK / 1000);
+	target = (target > (write_phase + spin_0)) ? (target - write_phase - spin_0) : 0;
+	ModTiming.phase_loops = (uint16)(target / spin_n);
+
+	// Carrier ramps
+	target = (CARRIER_RAMP_DELAY_CYCLES * clk_khz) / (MODULATION_REF_CLK / 1000);
+	target = (target > spin_0) ? (target - spin_0) : 0;
+	ModTiming.carrier_loops = (uint16)(target / spin_n);
+
+	// Hardware ramps, Timer_B0 on SMCLK/8
+	target = ((uint32)(pProfile->u16_HwRampUs + HW_RAMP_MARGIN_US) * clk_khz) / (1000UL * 8);
+	ModTiming.hw_ramp = (uint16)target;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Busy-waits for a number of loops, see RADIO_calibrate_timing()
+ *
+ *  @param 		u16_Loops 	is the number of loops
+ ******************************************************************************/
+static void
+RADIO_spin(uint16 u16_Loops)
+{
+	while (u16_Loops--)
+	{
+		__no_operation();
+	}
+}
+
+
 /**************************************************************************//**
  *  @brief 		This function produces the modulation (PA + Freq).
  *         		It is called only when a '0' bit is encountered in the frame.
@@ -337,10 +1926,58 @@ RADIO_change_frequency(unsigned long ul_Freq)
  *  			the other we decrease it.
  *  @note       During the modulation time, the PA is OFF
  ******************************************************************************/
-void
-RADIO_modulate(void)
+void
+RADIO_modulate(void)
+{
+	// The profile type is tested once per bit, the loops of each
+	// engine are the ones of a single built-in profile
+	if (pProfile->e_Type == E_MOD_PA_RAMP)
+	{
+		RADIO_modulate_pa_ramp();
+	}
+	else
+	{
+		RADIO_modulate_pa_freqoff();
+	}
+}
+
+
+/**************************************************************************//**
+ *  @brief 		E_MOD_PA_RAMP modulation: PA ramp down, FREQOFF step during
+ *  			the phase accumulation, PA ramp up. See RADIO_modulate().
+ ******************************************************************************/
+static void
+RADIO_modulate_pa_ramp(void)
 {
-#if (defined(MODE_FCC) || defined(MODE_ETSI))
+#ifdef RADIO_HW_PA_RAMP
+	if (pProfile->e_Ramp == E_RAMP_HARDWARE)
+	{
+		RADIO_modulate_hw_ramp();
+		return;
+	}
+#endif
+
+#if defined(RADIO_DMA_MODULATION)
+	if (b_Diff == false)
+	{
+		b_Diff = true;
+		// Frequency step down
+		dma_FOFF1 = pProfile->u8_StepLowFoff1;
+		dma_FOFF0 = pProfile->u8_StepLowFoff0;
+	}
+	else
+	{
+		b_Diff = false;
+		// Frequency step high
+		dma_FOFF1 = pProfile->u8_StepHighFoff1;
+		dma_FOFF0 = pProfile->u8_StepHighFoff0;
+	}
+
+	// Queue the PA ramp down. Phase flip and ramp up are chained from the DMA ISR
+	e_DmaState = E_DMA_RAMP_DOWN;
+	RADIO_dma_ramp_start(&Ramp_Pa[0], DMASRCINCR_3);
+
+#else
 	s16 count;
 	uint8 writeByte_FOFF0;
 	uint8 writeByte_FOFF1;
@@ -349,28 +1986,24 @@ RADIO_modulate(void)
 	{
 		b_Diff = true;
 		// Frequency step down
-		writeByte_FOFF1 = FREQ_STEP_LOW_FOFF1;
-		writeByte_FOFF0 = FREQ_STEP_LOW_FOFF0;
+		writeByte_FOFF1 = pProfile->u8_StepLowFoff1;
+		writeByte_FOFF0 = pProfile->u8_StepLowFoff0;
 	}
 	else
 	{
 		b_Diff = false;
 		// Frequency step high
-		writeByte_FOFF1 = FREQ_STEP_HIGH_FOFF1;
-		writeByte_FOFF0 = FREQ_STEP_HIGH_FOFF0;
+		writeByte_FOFF1 = pProfile->u8_StepHighFoff1;
+		writeByte_FOFF0 = pProfile->u8_StepHighFoff0;
 	}
 	// deacrease PA
-	for (count = (NB_PTS_PA-1); count >= 0; count--)
+	for (count = (nb_ramp_pts-1); count >= 0; count--)
 	{
 		// Write the PA ramp levels to PA_CFG2 register
-		trx8BitWrite(CC112X_PA_CFG2, Table_Pa_600bps[NB_PTS_PA-count-1]);
+		trx8BitWrite(CC112X_PA_CFG2, Ramp_Pa[nb_ramp_pts-count-1]);
 
 		// Wait after changing PA level to reduce spurrs
-#if defined(MODE_FCC)
-		__delay_cycles(MODULATION_DELAY_CYCLES_600bps);
-#elif defined(MODE_ETSI)
-		__delay_cycles(MODULATION_DELAY_CYCLES_100bps);
-#endif
+		RADIO_spin(ModTiming.ramp_loops);
 	}
 
 	// Program the frequency offset
@@ -389,9 +2022,10 @@ RADIO_modulate(void)
 	 * the modulation for best possible quality ( SNR ) of the BPSK
 	 * signal. The quality of BPSK modulation might change for different
 	 * compiler optimization settings and different MCU clock frequencies.
-	 * Thus, requiring new calibration for this delay value.
+	 * RADIO_calibrate_timing() keeps the tuned duration for the running
+	 * clock and SPI divider.
 	 */
-	__delay_cycles(PHASE_ACCUMULATION_DELAY_CYCLES);
+	RADIO_spin(ModTiming.phase_loops);
 
 	writeByte_FOFF1 = FOFF1;
 	cc112xSpiWriteReg(CC112X_FREQOFF1, &writeByte_FOFF1, 1);
@@ -400,20 +2034,34 @@ RADIO_modulate(void)
 
 
 	// increase PA
-	for (count = NB_PTS_PA-1; count >= (0); count--)
+	for (count = nb_ramp_pts-1; count >= (0); count--)
 	{
 		// Write the PA ramp levels to PA_CFG2 register
-		trx8BitWrite(CC112X_PA_CFG2, Table_Pa_600bps[count]);
+		trx8BitWrite(CC112X_PA_CFG2, Ramp_Pa[count]);
 
 		// Wait after changing PA level to reduce spurrs
-#if defined(MODE_FCC)
-		__delay_cycles(MODULATION_DELAY_CYCLES_600bps);
-#elif defined(MODE_ETSI)
-		__delay_cycles(MODULATION_DELAY_CYCLES_100bps);
-#endif
+		RADIO_spin(ModTiming.ramp_loops);
 	}
+#endif
+}
+
 
-#elif defined(MODE_ETSI_OPT)
+/**************************************************************************//**
+ *  @brief 		E_MOD_PA_FREQOFF modulation: a PA level and a FREQOFF0
+ *  			deviation are written at each point of the profile. The
+ *  			deviation sign alternates from one '0' bit to the next.
+ *
+ *  @note		The DMA modulation does not apply, the two registers are
+ *  			written at each point.
+ *  @note		The PA levels are the ones of Ramp_Pa, set to the ceiling
+ *  			once by RADIO_set_power_ceiling().
+ ******************************************************************************/
+static void
+RADIO_modulate_pa_freqoff(void)
+{
+	const unsigned char *pu8_Point = pProfile->pu8_Table;
+	const uint8 *pu8_Pa = Ramp_Pa;
+	uint8 u8_DevFoff0 = pProfile->u8_DevFoff0;
 	s16 count;
 	uint8 u8_FreqValue;
 
@@ -421,74 +2069,579 @@ RADIO_modulate(void)
 	{
 		b_Diff = false;
 
-		for (count = 0; count < (NB_POINTS); count++)
+		for (count = pProfile->u16_NbPoints; count > 0; count--)
 		{
 			// Modulate using PA and FREQOFF
-			u8_FreqValue = FOFF0_ETSI + CC1120_etsi_profile[count][1];
+			u8_FreqValue = u8_DevFoff0 + pu8_Point[1];
 
-            trx8BitWrite(CC112X_PA_CFG2, CC1120_etsi_profile[count][0]);
-            trx16BitWrite((uint8)(CC112X_FREQOFF0 >> 8), (uint8)(CC112X_FREQOFF0 & 0x00FF), u8_FreqValue);
-            __delay_cycles(58);
+			trx8BitWrite(CC112X_PA_CFG2, *pu8_Pa++);
+			trx16BitWrite((uint8)(CC112X_FREQOFF0 >> 8), (uint8)(CC112X_FREQOFF0 & 0x00FF), u8_FreqValue);
+			RADIO_spin(ModTiming.ramp_loops);
+			pu8_Point += 2;
 		}
 	}
 	else
 	{
 		b_Diff = true;
 
-		for (count = 0; count < (NB_POINTS); count++)
+		for (count = pProfile->u16_NbPoints; count > 0; count--)
 		{
 			// Modulate using PA and FREQOFF
-			u8_FreqValue = FOFF0_ETSI - CC1120_etsi_profile[count][1];
+			u8_FreqValue = u8_DevFoff0 - pu8_Point[1];
+
+			trx8BitWrite(CC112X_PA_CFG2, *pu8_Pa++);
+			trx16BitWrite((uint8)(CC112X_FREQOFF0 >> 8), (uint8)(CC112X_FREQOFF0 & 0x00FF), u8_FreqValue);
+			RADIO_spin(ModTiming.ramp_loops);
+			pu8_Point += 2;
+		}
+	}
+
+	// FREQOFF0 was written behind the register shadow
+	cc112xSpiShadowInvalidate(CC112X_FREQOFF0);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Tells whether a modulation queued by RADIO_modulate() is still
+ *  			being streamed to the chip
+ *
+ *  @return 	\li \b true if the PA ramps are in progress
+ *  @return		\li \b false if the radio can be accessed
+ ******************************************************************************/
+bool
+RADIO_modulation_busy(void)
+{
+#ifdef RADIO_HW_PA_RAMP
+	if (e_HwRampState != E_HW_RAMP_IDLE)
+	{
+		return true;
+	}
+#endif
+#ifdef RADIO_DMA_MODULATION
+	return (e_DmaState != E_DMA_IDLE);
+#else
+	return false;
+#endif
+}
+
+
+#ifdef RADIO_DMA_MODULATION
+/**************************************************************************//**
+ *  @brief 		Streams a PA ramp to PA_CFG2 with DMA channel 0.
+ *
+ *  @note		CS is held low during the whole ramp. The PA levels are sent as
+ *  			one burst access, EXT_CTRL.BURST_ADDR_INCR_EN being cleared in
+ *  			the TX register settings every byte lands in PA_CFG2.
+ *  @note		Each transfer is triggered by Timer_B0 CCR0 so the PA levels
+ *  			are spaced by ModTiming.dma_step like the busy-wait loop.
+ *
+ *  @param 		pu8_Table 		is the first PA level of the ramp
+ *  @param 		u16_SrcIncr 	is DMASRCINCR_3 (increment) or DMASRCINCR_2 (decrement)
+ ******************************************************************************/
+static void
+RADIO_dma_ramp_start(const unsigned char *pu8_Table, uint16 u16_SrcIncr)
+{
+	// Pull CS_N low and send the burst header for PA_CFG2
+	TRXEM_SPI_BEGIN();
+	TRXEM_SPI_TX(RADIO_BURST_ACCESS|RADIO_WRITE_ACCESS|CC112X_PA_CFG2);
+	TRXEM_SPI_WAIT_DONE();
+
+	// Byte to byte transfer from the PA table to the SPI TX buffer, the register
+	// addresses through unsigned long for the wider pointers of the host tests
+	DMACTL0 = (DMACTL0 & 0xFF00) | RADIO_DMA_TSEL_TB0CCR0;
+	__data16_write_addr((unsigned short)(unsigned long)&DMA0SA, (unsigned long)pu8_Table);
+	__data16_write_addr((unsigned short)(unsigned long)&DMA0DA, (unsigned long)&UCB0TXBUF);
+	DMA0SZ  = nb_ramp_pts;
+	DMA0CTL = DMADT_0 + u16_SrcIncr + DMADSTINCR_0 + DMASRCBYTE + DMADSTBYTE + DMAIE + DMAEN;
+
+	// Start the pacing timer (CCIE must stay cleared to trigger the DMA)
+	TB0CCTL0 = 0;
+	TB0CCR0  = ModTiming.dma_step - 1;
+	TB0CTL   = TBSSEL_2 + MC_1 + TBCLR;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Closes the SPI burst once the last PA level has been shifted
+ *  			out and stops the pacing timer.
+ ******************************************************************************/
+static void
+RADIO_dma_ramp_end(void)
+{
+	TB0CTL = TBCLR;
+
+	// The DMA completes on the TXBUF write, wait for the byte to be sent
+	while(UCB0STAT & UCBUSY);
+	TRXEM_SPI_END();
+}
+
+
+/**************************************************************************//**
+ *  @brief 		DMA interrupt: end of a PA ramp.
+ *  			After the ramp down, produces the phase flip and queues the
+ *  			ramp up. After the ramp up, the modulation is complete.
+ *  @note		With ADC_MEASUREMENT, the end of a measurement on DMA
+ *  			channel 2 goes to ADC_dma_isr().
+ ******************************************************************************/
+#pragma vector=DMA_VECTOR
+__interrupt void
+RADIO_DMA_ISR(void)
+{
+	uint8 writeByte;
+
+	switch (__even_in_range(DMAIV, 16))
+	{
+	case DMAIV_DMA0IFG:
+		break;
+#ifdef ADC_MEASUREMENT
+	case DMAIV_DMA2IFG:
+		ADC_dma_isr();
+		return;
+#endif
+	default:
+		return;
+	}
+
+	RADIO_dma_ramp_end();
+
+	if (e_DmaState == E_DMA_RAMP_DOWN)
+	{
+		// Program the frequency offset
+		cc112xSpiWriteReg(CC112X_FREQOFF1, &dma_FOFF1, 1);
+		cc112xSpiWriteReg(CC112X_FREQOFF0, &dma_FOFF0, 1);
+
+		// Accumulate the 180 degree phase change, see RADIO_modulate()
+		RADIO_spin(ModTiming.phase_loops);
+
+		writeByte = FOFF1;
+		cc112xSpiWriteReg(CC112X_FREQOFF1, &writeByte, 1);
+		writeByte = FOFF0;
+		cc112xSpiWriteReg(CC112X_FREQOFF0, &writeByte, 1);
+
+		// Queue the PA ramp up, the table is read backward
+		e_DmaState = E_DMA_RAMP_UP;
+		RADIO_dma_ramp_start(&Ramp_Pa[nb_ramp_pts-1], DMASRCINCR_2);
+	}
+	else
+	{
+		e_DmaState = E_DMA_IDLE;
+	}
+}
+#endif
+
+
+#ifdef RADIO_HW_PA_RAMP
+/**************************************************************************//**
+ *  @brief 		E_MOD_PA_RAMP modulation with the hardware ramps: the radio
+ *  			leaves TX for FSTXON, the chip ramps the PA down while the
+ *  			synthesizer keeps the phase. The FREQOFF step and the return
+ *  			to TX are done from the Timer_B0 interrupt at the end of the
+ *  			ramp, the chip then ramps the PA up. See RADIO_modulate().
+ *
+ *  @note		Two SPI strobes and four FREQOFF writes per '0' bit, the CPU
+ *  			is free during the ramps.
+ ******************************************************************************/
+static void
+RADIO_modulate_hw_ramp(void)
+{
+	if (b_Diff == false)
+	{
+		b_Diff = true;
+		// Frequency step down
+		hw_FOFF1 = pProfile->u8_StepLowFoff1;
+		hw_FOFF0 = pProfile->u8_StepLowFoff0;
+	}
+	else
+	{
+		b_Diff = false;
+		// Frequency step high
+		hw_FOFF1 = pProfile->u8_StepHighFoff1;
+		hw_FOFF0 = pProfile->u8_StepHighFoff0;
+	}
+
+	trxSpiCmdStrobe(CC112X_SFSTXON);
+	RADIO_hw_ramp_timer(E_HW_RAMP_DIP);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Writes the hardware ramp settings of the profile after the
+ *  			TX register settings: ramp shape (PA_CFG1) and the symbol
+ *  			rate it is relative to.
+ ******************************************************************************/
+static void
+RADIO_hw_ramp_setup(void)
+{
+	uint8 writeByte;
+
+	if (pProfile->e_Ramp != E_RAMP_HARDWARE)
+	{
+		return;
+	}
+
+	writeByte = pProfile->u8_HwRampCfg;
+	cc112xSpiWriteReg(CC112X_PA_CFG1, &writeByte, 1);
+
+	// Single accesses: EXT_CTRL.BURST_ADDR_INCR_EN is cleared in TX
+	writeByte = pProfile->u8_HwRampRate2;
+	cc112xSpiWriteReg(CC112X_SYMBOL_RATE2, &writeByte, 1);
+	writeByte = pProfile->u8_HwRampRate1;
+	cc112xSpiWriteReg(CC112X_SYMBOL_RATE1, &writeByte, 1);
+	writeByte = pProfile->u8_HwRampRate0;
+	cc112xSpiWriteReg(CC112X_SYMBOL_RATE0, &writeByte, 1);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Starts Timer_B0 for the length of a hardware ramp
+ *
+ *  @param 		e_State 	is what the Timer_B0 interrupt does at the end
+ *  						of the ramp, see ::te_HwRampState
+ ******************************************************************************/
+static void
+RADIO_hw_ramp_timer(te_HwRampState e_State)
+{
+	e_HwRampState = e_State;
+
+	TB0CCR0  = ModTiming.hw_ramp - 1;
+	TB0CCTL0 = CCIE;
+	TB0CTL   = TBSSEL_2 + ID_3 + MC_1 + TBCLR;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Waits in LPM0 for the end of a carrier hardware ramp
+ ******************************************************************************/
+static void
+RADIO_hw_ramp_wait(void)
+{
+	uint16 istate;
+
+	istate = __get_interrupt_state();
+	__disable_interrupt();
+
+	RADIO_hw_ramp_timer(E_HW_RAMP_WAIT);
+	while (e_HwRampState != E_HW_RAMP_IDLE)
+	{
+		// GIE and LPM0 are set together, the interrupt cannot be missed
+		__bis_SR_register(LPM0_bits + GIE);
+		__disable_interrupt();
+	}
+
+	__set_interrupt_state(istate);
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Timer_B0 interrupt: end of a hardware ramp.
+ *  			After the ramp down of a phase flip, produces the phase flip
+ *  			and goes back to TX. After a carrier ramp, wakes the CPU up.
+ ******************************************************************************/
+#pragma vector=TIMER0_B0_VECTOR
+__interrupt void
+RADIO_HW_RAMP_ISR(void)
+{
+	uint8 writeByte;
+
+	TB0CTL   = TBCLR;
+	TB0CCTL0 = 0;
+
+	if (e_HwRampState == E_HW_RAMP_DIP)
+	{
+		// Program the frequency offset
+		cc112xSpiWriteReg(CC112X_FREQOFF1, &hw_FOFF1, 1);
+		cc112xSpiWriteReg(CC112X_FREQOFF0, &hw_FOFF0, 1);
+
+		// Accumulate the 180 degree phase change, see RADIO_modulate()
+		RADIO_spin(ModTiming.phase_loops);
+
+		writeByte = FOFF1;
+		cc112xSpiWriteReg(CC112X_FREQOFF1, &writeByte, 1);
+		writeByte = FOFF0;
+		cc112xSpiWriteReg(CC112X_FREQOFF0, &writeByte, 1);
+
+		// The chip ramps the PA up
+		trxSpiCmdStrobe(CC112X_STX);
+	}
+	else
+	{
+		__bic_SR_register_on_exit(LPM0_bits);
+	}
+	e_HwRampState = E_HW_RAMP_IDLE;
+}
+#endif
+
+
+#ifdef RADIO_LBT
+/**************************************************************************//**
+ *  @brief 		Listens to the TX frequency before a frame. A busy channel
+ *  			is listened to again after a random backoff, in LPM3.
+ *
+ *  @note		To be called once the TX frequency is set, before
+ *  			RADIO_start_rf_carrier(). The channel is busy when the RSSI
+ *  			reaches ::RADIO_LBT_THRESHOLD within ::RADIO_LBT_LISTEN_MS,
+ *  			or when no RSSI was valid.
+ *  @note		After ::RADIO_LBT_ATTEMPTS busy listens the frame is sent
+ *  			anyway: the library expects it.
+ *
+ *  @return 	\li \b true if the channel was clear
+ *  @return		\li \b false if it stayed busy
+ ******************************************************************************/
+bool
+RADIO_lbt(void)
+{
+	uint8 attempt;
+	uint16 backoff;
+	int8 rssi;
+
+	for (attempt = 0; attempt < RADIO_LBT_ATTEMPTS; attempt++)
+	{
+		rssi = RADIO_lbt_listen();
+
+		LbtStats.u16_Listens++;
+		LbtStats.s8_RssiLast = rssi;
+		if ((LbtStats.u16_Listens == 1) || (rssi > LbtStats.s8_RssiMax))
+		{
+			LbtStats.s8_RssiMax = rssi;
+		}
+
+		if ((rssi != RADIO_LBT_NO_RSSI) && (rssi < RADIO_LBT_THRESHOLD))
+		{
+			LbtStats.u16_Clear[attempt]++;
+			return true;
+		}
+		LbtStats.u16_Busy++;
+
+		if (attempt < RADIO_LBT_ATTEMPTS - 1)
+		{
+			backoff = RADIO_lbt_backoff((uint8)rssi);
+			LbtStats.ul_BackoffMs += backoff;
+			TIMER_sleep_ms(backoff);
+		}
+	}
+	LbtStats.u16_Forced++;
+	return false;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Returns the counters of the listen before talk
+ *
+ *  @return		pointer to the counters
+ ******************************************************************************/
+const RadioLbtStats_t *
+RADIO_lbt_stats(void)
+{
+	return &LbtStats;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Samples the RSSI on the current frequency
+ *
+ *  @note		The receive chain registers of the RX settings (::LbtRegs)
+ *  			are written before SRX and the TX values back after: the
+ *  			RSSI is measured with the channel filter of the downlink.
+ *  			The other registers, the frequency among them, are kept
+ *  			and the synthesizer keeps its TX calibration. The radio is
+ *  			back in IDLE after, the carrier start calibrates again in
+ *  			a TX session.
+ *  @note		The RSSI is sampled for ::RADIO_LBT_LISTEN_MS once
+ *  			RSSI_VALID is set, which is awaited ::RADIO_LBT_SETTLE_MS
+ *  			at most.
+ *
+ *  @return		the highest RSSI in dBm, ::RADIO_LBT_NO_RSSI if none was valid
+ ******************************************************************************/
+static int8
+RADIO_lbt_listen(void)
+{
+	uint32 ul_Start;
+	uint32 ul_Ticks = ((uint32)RADIO_LBT_LISTEN_MS * TIMER_TIMEBASE_HZ + 999UL) / 1000UL;
+	uint32 ul_Settle = ((uint32)RADIO_LBT_SETTLE_MS * TIMER_TIMEBASE_HZ + 999UL) / 1000UL;
+	int16 rssi_max = RADIO_LBT_NO_RSSI;
+	int16 rssi;
+	uint8 rssi0;
+	uint8 rssi1;
+	uint8 i, j;
+
+	RADIO_power_wake();
+
+	// The RX values of the receive chain, once
+	if (u8_LbtNbRegs == 0)
+	{
+		for (i = 0; i < sizeof(LbtRegs) / sizeof(LbtRegs[0]); i++)
+		{
+			for (j = 0; j < sizeof(HighPerfModeRx) / sizeof(registerSetting_t); j++)
+			{
+				if (HighPerfModeRx[j].addr == LbtRegs[i])
+				{
+					LbtRx[u8_LbtNbRegs] = HighPerfModeRx[j];
+					LbtTx[u8_LbtNbRegs].addr = LbtRegs[i];
+					u8_LbtNbRegs++;
+				}
+			}
+		}
+	}
+	for (i = 0; i < u8_LbtNbRegs; i++)
+	{
+		cc112xSpiReadReg(LbtTx[i].addr, &LbtTx[i].data, 1);
+	}
+	cc112xSpiWriteRegs(LbtRx, u8_LbtNbRegs);
+
+#ifdef CC1190_PA_LNA
+	RF_PA_EN_PxOUT &= ~RF_PA_EN_PIN;
+	RF_LNA_EN_PxOUT |= RF_LNA_EN_PIN;
+#endif
+	trxSpiCmdStrobe(CC112X_SRX);
+	RADIO_power_enter(E_RADIO_PWR_ACTIVE);
+
+	// The AGC settles first
+	ul_Start = TIMER_timebase_get();
+	do
+	{
+		cc112xSpiReadReg(CC112X_RSSI0, &rssi0, 1);
+	}
+	while (!(rssi0 & RSSI0_RSSI_VALID) && ((TIMER_timebase_get() - ul_Start) < ul_Settle));
 
-			trx8BitWrite(CC112X_PA_CFG2, CC1120_etsi_profile[count][0]);
-            trx16BitWrite((uint8)(CC112X_FREQOFF0 >> 8), (uint8)(CC112X_FREQOFF0 & 0x00FF), u8_FreqValue);
-            __delay_cycles(58);
+	if (rssi0 & RSSI0_RSSI_VALID)
+	{
+		ul_Start = TIMER_timebase_get();
+		do
+		{
+			if (rssi0 & RSSI0_RSSI_VALID)
+			{
+				cc112xSpiReadReg(CC112X_RSSI1, &rssi1, 1);
+				rssi = (int16)(int8)rssi1 - RX_RSSI_OFFSET;
+				if (rssi <= RADIO_LBT_NO_RSSI)
+				{
+					// Down to -230 dBm in RSSI1, kept apart from no RSSI
+					rssi = RADIO_LBT_NO_RSSI + 1;
+				}
+				if (rssi > rssi_max)
+				{
+					rssi_max = (rssi < 127) ? rssi : 127;
+				}
+			}
+			cc112xSpiReadReg(CC112X_RSSI0, &rssi0, 1);
 		}
+		while ((TIMER_timebase_get() - ul_Start) < ul_Ticks);
 	}
 
+	trxSpiCmdStrobe(CC112X_SIDLE);
+	RADIO_power_enter(E_RADIO_PWR_IDLE);
+	cc112xSpiWriteRegs(LbtTx, u8_LbtNbRegs);
+	b_TxWarm = false;
+#ifdef CC1190_PA_LNA
+	RF_LNA_EN_PxOUT &= ~RF_LNA_EN_PIN;
+	RF_PA_EN_PxOUT |= RF_PA_EN_PIN;
 #endif
+
+	return (int8)rssi_max;
+}
+
+
+/**************************************************************************//**
+ *  @brief 		Draws a backoff between ::RADIO_LBT_BACKOFF_MIN and
+ *  			::RADIO_LBT_BACKOFF_MAX ms
+ *
+ *  @note		16-bit Galois LFSR, the noise of the RSSI and of the timebase
+ *  			stirred in: the devices sharing a channel draw apart.
+ *
+ *  @param 		u8_Seed 	is mixed into the generator
+ *
+ *  @return		the backoff in ms
+ ******************************************************************************/
+static uint16
+RADIO_lbt_backoff(uint8 u8_Seed)
+{
+	uint8 i;
+
+	u16_LbtRandom ^= ((uint16)u8_Seed << 8) ^ (uint16)TIMER_timebase_get();
+	for (i = 0; i < 16; i++)
+	{
+		u16_LbtRandom = (u16_LbtRandom >> 1) ^ ((u16_LbtRandom & 1) ? 0xB400 : 0);
+	}
+	if (u16_LbtRandom == 0)
+	{
+		u16_LbtRandom = 0xACE1;
+	}
+	return RADIO_LBT_BACKOFF_MIN
+			+ (uint16)(((uint32)u16_LbtRandom * (RADIO_LBT_BACKOFF_MAX - RADIO_LBT_BACKOFF_MIN + 1)) >> 16);
 }
+#endif
 
 
 /**************************************************************************//**
  *  @brief this function starts the oscillator, and generates the ramp-up
+ *  @note  With a hardware ramp profile, the chip ramps the PA up, the CPU
+ *         waits in LPM0
  ******************************************************************************/
 void
 RADIO_start_rf_carrier(void)
 {
 	int16 countStart;
+	uint16 point;
 	uint8 writeByte;
 
+	RADIO_power_wake();
+
+#ifdef RADIO_HW_PA_RAMP
+	if (pProfile->e_Ramp == E_RAMP_HARDWARE)
+	{
+		// Full level with ramp shaping, the ramp starts with STX
+		writeByte = PA_CFG2_RAMP_SHAPE_EN | PaLevel[PA_POWER_RAMP_MAX];
+		cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
+		trxSpiCmdStrobe(CC112X_STX);
+		RADIO_power_enter(E_RADIO_PWR_ACTIVE);
+		b_TxWarm = false;
+
+		RADIO_hw_ramp_wait();
+		return;
+	}
+#endif
+
 	writeByte = 0x00;
 	cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
 	trxSpiCmdStrobe(CC112X_STX);
+	RADIO_power_enter(E_RADIO_PWR_ACTIVE);
+	b_TxWarm = false;
 	writeByte = 0x00;
 	cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
 
-#if (defined(MODE_FCC) || defined(MODE_ETSI))
-	// Ramp up the PA
-	for (countStart = NB_PTS_PA-1; countStart >= (0); countStart--)
+	if (pProfile->e_Type == E_MOD_PA_RAMP)
 	{
-		cc112xSpiWriteReg(CC112X_PA_CFG2, (uint8*) &Table_Pa_600bps[countStart], 1);
-		__delay_cycles(320);
+		// Ramp up the PA
+		for (countStart = nb_ramp_pts-1; countStart >= (0); countStart--)
+		{
+			writeByte = Ramp_Pa[countStart];
+			cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
+			RADIO_spin(ModTiming.carrier_loops);
+		}
 	}
-#elif defined(MODE_ETSI_OPT)
-	// Ramp up the PA
-	for (countStart = MID_NB_PTS; countStart < (NB_POINTS); countStart++)
+	else
 	{
-		// Modulate using PA and FREQOFF
-		cc112xSpiWriteReg(CC112X_PA_CFG2, (uint8*) &CC1120_etsi_profile[countStart][0], 1);
-		__delay_cycles(320);
+		// Ramp up the PA with the second half of the profile
+		for (point = pProfile->u16_NbPoints/2; point < pProfile->u16_NbPoints; point++)
+		{
+			writeByte = Ramp_Pa[point];
+			cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
+			RADIO_spin(ModTiming.carrier_loops);
+		}
 	}
-#endif
 
-	writeByte = 63;
+	writeByte = PaLevel[PA_POWER_RAMP_MAX];
 	cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
+
+	// PA_CFG2 is then written by RADIO_modulate() behind the register shadow
+	cc112xSpiShadowInvalidate(CC112X_PA_CFG2);
 }
 
 
 /**************************************************************************//**
  *  @brief This function stops the radio and produces the ramp down
+ *  @note  In a TX session the synthesizer keeps running, see RADIO_tx_session()
+ *  @note  With a hardware ramp profile, the chip ramps the PA down when it
+ *         leaves TX, the CPU waits in LPM0
  ******************************************************************************/
 void
 RADIO_stop_rf_carrier(void)
@@ -496,26 +2649,64 @@ RADIO_stop_rf_carrier(void)
 	uint16 count_stop;
 	uint8 writeByte;
 
-#if (defined(MODE_FCC) || defined(MODE_ETSI	))
-	// Ramp down the PA
-	for (count_stop = 0; count_stop < (NB_PTS_PA); count_stop++)
+#ifdef RADIO_HW_PA_RAMP
+	if (pProfile->e_Ramp == E_RAMP_HARDWARE)
+	{
+		// Ramp shaping from the full level (the PA and FREQOFF
+		// profile writes PA_CFG2 without it)
+		writeByte = PA_CFG2_RAMP_SHAPE_EN | PaLevel[PA_POWER_RAMP_MAX];
+		cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
+	}
+	else
+#endif
+	if (pProfile->e_Type == E_MOD_PA_RAMP)
 	{
-		cc112xSpiWriteReg(CC112X_PA_CFG2, (uint8*) &Table_Pa_600bps[count_stop], 1);
-		__delay_cycles(320);
+		// Ramp down the PA
+		for (count_stop = 0; count_stop < (nb_ramp_pts); count_stop++)
+		{
+			writeByte = Ramp_Pa[count_stop];
+			cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
+			RADIO_spin(ModTiming.carrier_loops);
+		}
 	}
-#elif defined(MODE_ETSI_OPT)
-	// Ramp down the PA
-	for (count_stop = 0; count_stop < (MID_NB_PTS); count_stop++)
+	else
 	{
-		// Modulate using PA and FREQOFF
-		cc112xSpiWriteReg(CC112X_PA_CFG2, (uint8*) &CC1120_etsi_profile[count_stop][0], 1);
-		__delay_cycles(320);
+		// Ramp down the PA with the first half of the profile
+		for (count_stop = 0; count_stop < (pProfile->u16_NbPoints/2); count_stop++)
+		{
+			writeByte = Ramp_Pa[count_stop];
+			cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
+			RADIO_spin(ModTiming.carrier_loops);
+		}
 	}
+
+#ifdef RADIO_HW_PA_RAMP
+	if (pProfile->e_Ramp != E_RAMP_HARDWARE)
 #endif
+	{
+		writeByte = 0;
+		cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
+	}
+	if (b_TxSession == true)
+	{
+		// Keep the synthesizer running for the next frame of the session
+		trxSpiCmdStrobe(CC112X_SFSTXON);
+		b_TxReady = true;
+		b_TxWarm = true;
+	}
+	else
+	{
+		trxSpiCmdStrobe(CC112X_SIDLE);
+		RADIO_power_enter(E_RADIO_PWR_IDLE);
+	}
 
-	writeByte = 0;
-	cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
-	trxSpiCmdStrobe(CC112X_SIDLE);
+#ifdef RADIO_HW_PA_RAMP
+	if (pProfile->e_Ramp == E_RAMP_HARDWARE)
+	{
+		RADIO_hw_ramp_wait();
+		return;
+	}
+#endif
 	writeByte = 0;
 	cc112xSpiWriteReg(CC112X_PA_CFG2, &writeByte, 1);
 }
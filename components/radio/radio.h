@@ -53,13 +53,202 @@
 #include "device_config.h"
 
 
+/******************************************************************************
+ * TYPEDEFS
+ */
+/********************************
+ * \enum te_ModulationType
+ * \brief How a modulation profile produces the phase change of a '0' bit
+ *******************************/
+typedef enum {
+	E_MOD_PA_RAMP = 0,		/*!< PA ramp down, FREQOFF step, PA ramp up */
+	E_MOD_PA_FREQOFF		/*!< PA level and FREQOFF deviation written at each point */
+}te_ModulationType;
+
+/********************************
+ * \enum te_RampBackend
+ * \brief How the PA ramps of a modulation profile are produced
+ *******************************/
+typedef enum {
+	E_RAMP_SOFTWARE = 0,	/*!< PA_CFG2 written at each point of the ramp */
+	E_RAMP_HARDWARE			/*!< PA ramp shaping of the CC112X on TX entry and exit, see RADIO_HW_PA_RAMP */
+}te_RampBackend;
+
+/********************************
+ * \enum te_ModProfileId
+ * \brief Modulation profiles available, see RADIO_select_profile()
+ *******************************/
+typedef enum {
+	E_PROFILE_FCC = 0,		/*!< 600 bps, PA ramp */
+	E_PROFILE_ETSI,			/*!< 100 bps, PA ramp */
+	E_PROFILE_ETSI_OPT,		/*!< 100 bps, PA and FREQOFF profile */
+	E_PROFILE_NB
+}te_ModProfileId;
+
+/********************************
+ * \struct RadioProfile_t
+ * \brief Everything that differs between the modulation profiles
+ *******************************/
+typedef struct {
+	te_ModulationType e_Type;		/*!< Modulation engine used by the profile */
+	SFX_std_t e_Standard;			/*!< SigFox standard of the profile */
+	const unsigned char *pu8_Table;	/*!< PA_CFG2 levels (E_MOD_PA_RAMP) or { PA_CFG2, FREQOFF0 deviation } pairs (E_MOD_PA_FREQOFF) */
+	uint16 u16_NbPoints;			/*!< Number of points of the table */
+	uint16 u16_StepCycles;			/*!< Period between two points at MODULATION_REF_CLK, SPI writes included */
+	uint8 u8_StepLowFoff1;			/*!< FREQOFF1 of the frequency step down (E_MOD_PA_RAMP) */
+	uint8 u8_StepLowFoff0;			/*!< FREQOFF0 of the frequency step down (E_MOD_PA_RAMP) */
+	uint8 u8_StepHighFoff1;			/*!< FREQOFF1 of the frequency step up (E_MOD_PA_RAMP) */
+	uint8 u8_StepHighFoff0;			/*!< FREQOFF0 of the frequency step up (E_MOD_PA_RAMP) */
+	uint8 u8_DevFoff0;				/*!< FREQOFF0 the deviations apply to (E_MOD_PA_FREQOFF) */
+	uint16 u16_BitPeriod;			/*!< TA1CCR0 of the bit period with SMCLK = 24 MHz */
+	uint16 u16_BitClkDiv;			/*!< TA1CTL input divider of the bit period */
+	te_RampBackend e_Ramp;			/*!< Backend of the carrier ramps, and of the phase flip dips (E_MOD_PA_RAMP) */
+	uint8 u8_HwRampCfg;				/*!< PA_CFG1 of the hardware ramps: intermediate levels and RAMP_SHAPE */
+	uint8 u8_HwRampRate2;			/*!< SYMBOL_RATE2 giving the symbol time RAMP_SHAPE refers to */
+	uint8 u8_HwRampRate1;			/*!< SYMBOL_RATE1 */
+	uint8 u8_HwRampRate0;			/*!< SYMBOL_RATE0 */
+	uint16 u16_HwRampUs;			/*!< Duration of a hardware ramp in us */
+}RadioProfile_t;
+
+/********************************
+ * \enum te_RadioPowerState
+ * \brief Power states of the CC112X, see RADIO_power_sleep()
+ *******************************/
+typedef enum {
+	E_RADIO_PWR_ACTIVE = 0,	/*!< RX, TX or synthesizer running */
+	E_RADIO_PWR_IDLE,		/*!< IDLE: XOSC and digital core on */
+	E_RADIO_PWR_XOSC_OFF,	/*!< XOFF (SXOFF strobe): XOSC off, registers kept */
+	E_RADIO_PWR_DOWN,		/*!< SLEEP (SPWD strobe): registers kept */
+	E_RADIO_PWR_NB
+}te_RadioPowerState;
+
+/********************************
+ * \struct RadioPowerStats_t
+ * \brief Residency counters of the radio power states
+ *******************************/
+typedef struct {
+	uint32 ul_Residency[E_RADIO_PWR_NB];	/*!< Time spent in each state, TIMER_timebase_get() ticks */
+	uint16 u16_Entries[E_RADIO_PWR_NB];		/*!< Number of entries in each state */
+	uint16 u16_Wakeups;						/*!< Wake-ups from XOFF or SLEEP */
+	uint16 u16_WakeSettleMax;				/*!< Longest XOSC settle of a wake-up, TIMER_timebase_get() ticks */
+}RadioPowerStats_t;
+
+/* Frames of the RX engine, see RADIO_rx_pop() */
+#define RADIO_RX_FRAME_SIZE	17		// PKT_LEN bytes, then the RSSI and CRC_OK / LQI status bytes
+#define RADIO_RX_RING_SIZE	4		// Frames queued, a power of 2
+
+/********************************
+ * \struct RadioRxFrame_t
+ * \brief Frame queued by the RX interrupt
+ *******************************/
+typedef struct {
+	uint8 au8_Data[RADIO_RX_FRAME_SIZE];	/*!< Frame, then the appended status bytes */
+	uint32 ul_Time;							/*!< End of the frame, TIMER_timebase_get() ticks */
+	int8 s8_Rssi;							/*!< RSSI status byte, without the RSSI offset */
+	bool b_CrcOk;							/*!< CRC_OK status bit */
+#ifdef RADIO_XTAL_COMP
+	int16 s16_FreqOff;						/*!< FREQOFF_EST, see RADIO_xtal_learn() */
+#endif
+}RadioRxFrame_t;
+
+/********************************
+ * \struct RadioRxStats_t
+ * \brief Counters of the RX engine
+ *******************************/
+typedef struct {
+	uint16 u16_Frames;						/*!< Frames queued */
+	uint16 u16_Dropped;						/*!< Frames lost, ::RADIO_RX_RING_SIZE frames waiting */
+	uint16 u16_FifoErrors;					/*!< RX FIFO overflows and short packets */
+	uint8 u8_Queued;						/*!< Most frames waiting at once */
+}RadioRxStats_t;
+
+/* Link statistics, see RADIO_link_snapshot() */
+#define RADIO_LINK_RSSI_BINS	8		// RSSI histogram bins
+#define RADIO_LINK_RSSI_LOW		(-128)	// dBm, lower edge of the second bin: the first one takes below
+#define RADIO_LINK_RSSI_SHIFT	3		// Bins of 8 dB
+#define RADIO_LINK_CHANNELS		8		// RX frequencies followed
+#define RADIO_LINK_VERSION		1		// First byte of the snapshot
+#define RADIO_LINK_SNAPSHOT_SIZE	(1 + 2 * RADIO_LINK_RSSI_BINS + 2 + 2 + 3 * 2 + RADIO_LINK_CHANNELS * 8)
+
+/********************************
+ * \struct RadioLinkChannel_t
+ * \brief Downlink success of an RX frequency
+ *******************************/
+typedef struct {
+	unsigned long ul_Freq;					/*!< RX frequency in Hz, 0 if the entry is free */
+	uint16 u16_Windows;						/*!< RX windows opened */
+	uint16 u16_Hits;						/*!< Windows with a frame, CRC OK */
+}RadioLinkChannel_t;
+
+/********************************
+ * \struct RadioLinkStats_t
+ * \brief Link quality of the received frames. The counters are halved
+ * when one of them would overflow: they weigh the recent frames more.
+ *******************************/
+typedef struct {
+	uint16 u16_RssiHist[RADIO_LINK_RSSI_BINS];	/*!< Frames by RSSI, CRC OK */
+	int16 s16_RssiAvg;						/*!< RSSI moving average in 1/16 dBm, weight 1/8 */
+	int8 s8_RssiMin;						/*!< Lowest RSSI in dBm, ::RADIO_LINK_RSSI_LOW for below */
+	int8 s8_RssiMax;						/*!< Highest RSSI in dBm, ::RADIO_LINK_RSSI_LOW for below */
+	uint16 u16_CrcOk;						/*!< Frames with CRC OK */
+	uint16 u16_CrcFails;					/*!< Frames with a CRC error */
+	uint16 u16_Timeouts;					/*!< RX windows ended without a frame for the device */
+	RadioLinkChannel_t Channels[RADIO_LINK_CHANNELS];
+}RadioLinkStats_t;
+
+/* Listen before talk, see RADIO_lbt() */
+#define RADIO_LBT_THRESHOLD		(-100)	// dBm, the channel is busy from this RSSI
+#define RADIO_LBT_SETTLE_MS		10		// RSSI_VALID awaited for this time at most
+#define RADIO_LBT_LISTEN_MS		5		// RSSI sampled for this time, once valid
+#define RADIO_LBT_ATTEMPTS		3		// Listens before a frame is sent anyway
+#define RADIO_LBT_BACKOFF_MIN	100		// ms, random backoff after a busy channel
+#define RADIO_LBT_BACKOFF_MAX	1000
+#define RADIO_LBT_NO_RSSI		(-128)	// RSSI of a listen without RSSI_VALID, counted busy
+
+/********************************
+ * \struct RadioLbtStats_t
+ * \brief Counters of the listen before talk
+ *******************************/
+typedef struct {
+	uint16 u16_Listens;						/*!< RSSI listens */
+	uint16 u16_Busy;						/*!< Listens over ::RADIO_LBT_THRESHOLD */
+	uint16 u16_Clear[RADIO_LBT_ATTEMPTS];	/*!< Frames sent on a clear channel, by listen */
+	uint16 u16_Forced;						/*!< Frames sent after ::RADIO_LBT_ATTEMPTS busy listens */
+	uint32 ul_BackoffMs;					/*!< Time spent in backoff */
+	int8 s8_RssiLast;						/*!< RSSI of the last listen in dBm */
+	int8 s8_RssiMax;						/*!< Highest RSSI of a listen in dBm */
+}RadioLbtStats_t;
+
+
 /******************************************************************************
  * FUNCTION PROTOTYPES
  */
+bool RADIO_select_profile(te_ModProfileId e_Profile);
+const RadioProfile_t * RADIO_get_profile(void);
 void RADIO_init_chip(u32 ul_CentralFrequency, te_RxChipMode e_ChipMode);
 void RADIO_close_chip(void);
+void RADIO_tx_session(bool b_Enable);
+void RADIO_tx_session_park(void);
+void RADIO_power_next_tx(uint32 ul_NextMs);
+void RADIO_power_sleep(uint32 ul_IdleMs);
+const RadioPowerStats_t * RADIO_power_stats(void);
+void RADIO_start_rx(void);
+bool RADIO_rx_pop(RadioRxFrame_t *pFrame);
+const RadioRxStats_t * RADIO_rx_stats(void);
+const RadioLinkStats_t * RADIO_link_stats(void);
+void RADIO_rx_timeout(void);
+uint8 RADIO_link_snapshot(uint8 *pu8_Buf);
 void RADIO_change_frequency(unsigned long ul_Freq);
+void RADIO_xtal_temperature(int16 s16_Temp);
+void RADIO_xtal_learn(unsigned long ul_Freq, int16 s16_FreqOff);
+void RADIO_xtal_miss(void);
+int16 RADIO_xtal_correction(void);
 void RADIO_modulate(void);
+bool RADIO_modulation_busy(void);
+bool RADIO_set_ramp_resolution(uint8 u8_NbSteps);
+bool RADIO_set_power_ceiling(uint8 u8_Level);
+bool RADIO_lbt(void);
+const RadioLbtStats_t * RADIO_lbt_stats(void);
 void RADIO_start_rf_carrier(void);
 void RADIO_stop_rf_carrier(void);
 void RADIO_start_unmodulated_cw(unsigned long ul_Freq);
@@ -74,6 +263,8 @@ uint8  packetSemaphore;
 #define ISR_ACTION_REQUIRED 1
 #define ISR_IDLE            0
 
+#define RADIO_NEXT_UNKNOWN	0xFFFFFFFFUL	// No activity expected, see RADIO_power_next_tx()
+
 
 /******************************************************************************
 * CC112X Register Settings
@@ -180,6 +371,12 @@ static const registerSetting_t HighPerfModeTx[] =
 		- FOC_KI_FACTOR : Frequency offset correction : Frequency offset compensation
 		  during packet reception with loop gain factor = 1/64 						*/
 	{ CC112X_FREQOFF_CFG   ,   0x22 },
+#ifdef RADIO_FS_CAL_CACHE
+
+	/*! Frequency Synthesizer Calibration and Settling Configuration
+		- FS_AUTOCAL = 0 : Never (manually calibrate using SCAL strobe)			*/
+	{ CC112X_SETTLING_CFG  ,   0x03 },
+#endif
 };
 
 
@@ -328,6 +525,12 @@ static const registerSetting_t HighPerfModeRx[]=
 	/*! Serial Status
 		- IOC_SYNC_PINS_EN = 1 : Added to be able to read the GPIO_STATUS register 	*/
 	{ CC112X_SERIAL_STATUS	,   0x08 },
+#ifdef RADIO_FS_CAL_CACHE
+
+	/*! Frequency Synthesizer Calibration and Settling Configuration
+		- FS_AUTOCAL = 0 : Never (manually calibrate using SCAL strobe)			*/
+	{ CC112X_SETTLING_CFG	,   0x03 },
+#endif
 };
 #endif
 
@@ -490,6 +693,12 @@ static const registerSetting_t HighPerfModeRx[] =
 	/*! Serial Status
 		- IOC_SYNC_PINS_EN = 1 : Added to be able to read the GPIO_STATUS register 	*/
 	{ CC112X_SERIAL_STATUS	,	0x08 },
+#ifdef RADIO_FS_CAL_CACHE
+
+	/*! Frequency Synthesizer Calibration and Settling Configuration
+		- FS_AUTOCAL = 0 : Never (manually calibrate using SCAL strobe)			*/
+	{ CC112X_SETTLING_CFG	,   0x03 },
+#endif
 };
 #endif	// RF_XTAL_FREQ
 
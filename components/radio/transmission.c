@@ -20,6 +20,13 @@
 #include "stdbool.h"
 #include "radio.h"
 #include "hal_spi_rf_trxeb.h"
+#include "transmission.h"
+#ifdef TX_JITTER_STATS
+#include "msp430.h"
+#endif
+#ifdef ADC_MEASUREMENT
+#include "adc.h"
+#endif
 
 
 /******************************************************************************
@@ -30,87 +37,178 @@
 /******************************************************************************
  * LOCAL VARIABLES
  */
-static unsigned int bit_index_in_frame;
+/* Symbol schedule of the frame: tx_schedule[k] is the number of '1' bits
+ * sent before the k-th '0' bit, counted from the previous '0' bit. The
+ * entry after the last '0' bit holds the '1' bits ending the frame. */
+static unsigned char tx_schedule[TX_MAX_FRAME_SIZE*8 + 1];
+static unsigned char *tx_next_run;
+static unsigned int bits_left;
+static unsigned int zeros_left;
+static unsigned char ones_left;
+#ifdef ADC_MEASUREMENT
+/* bits_left at the middle '1' of the longest run, where the supply is measured */
+static unsigned int adc_bits_left;
+#endif
 
 
 /******************************************************************************
- * STATIC FUNCTIONS
+ * GLOBAL VARIABLES
  */
-static unsigned char Read_Bit(unsigned char * frame);
+#ifdef TX_JITTER_STATS
+TxJitterStats_t TxJitter; /*!< Bit timer ISR to modulation start latency */
+#endif
 
 
 /***************************************************************************//**
- *  @brief 		Initializes local paramters
+ *  @brief 		Initializes local paramters and compiles the frame into the
+ *  			symbol schedule used by TxProcess()
+ *  @note		With ADC_MEASUREMENT, the supply is measured in the middle of
+ *  			the longest run of '1' bits, the longest PA plateau.
+ *
+ *  @param 		frame 			is the pointer to the frame to send
+ *	@param 		u8_FrameSize 	is the frame size in bytes, at most ::TX_MAX_FRAME_SIZE
  ******************************************************************************/
 void
-TxInit(void)
+TxInit(unsigned char *frame, unsigned char u8_FrameSize)
 {
-    bit_index_in_frame = 0;
+    unsigned char index_byte;
+    unsigned char mask;
+    unsigned char run;
+#ifdef ADC_MEASUREMENT
+    unsigned int bit;
+    unsigned char run_max;
+#endif
+
+    run = 0;
+    zeros_left = 0;
+#ifdef ADC_MEASUREMENT
+    bit = 0;
+    run_max = 0;
+    adc_bits_left = 0;
+#endif
+
+    for (index_byte = 0; index_byte < u8_FrameSize; index_byte++)
+    {
+        for (mask = 0x80; mask != 0; mask >>= 1)
+        {
+            if (frame[index_byte] & mask)
+            {
+                run++;
+#ifdef ADC_MEASUREMENT
+                if (run > run_max)
+                {
+                    // Middle of the run, counted as bits_left before the bit
+                    run_max = run;
+                    adc_bits_left = (unsigned int)u8_FrameSize * 8 - (bit + 1 - run + run/2);
+                }
+#endif
+            }
+            else
+            {
+                tx_schedule[zeros_left++] = run;
+                run = 0;
+            }
+#ifdef ADC_MEASUREMENT
+            bit++;
+#endif
+        }
+    }
+
+    // Popped after the last '0' bit. A frame of '1' bits only wraps it to
+    // 0 at 32 bytes, no '0' bit is left to modulate then
+    tx_schedule[zeros_left] = run;
+
+    bits_left = (unsigned int)u8_FrameSize * 8;
+    ones_left = tx_schedule[0];
+    tx_next_run = &tx_schedule[1];
+
+#ifdef TX_JITTER_STATS
+    TxJitter.min = 0xFFFF;
+    TxJitter.max = 0;
+    TxJitter.count = 0;
+#endif
+
+#ifdef ADC_MEASUREMENT
+    if (adc_bits_left != 0)
+    {
+        ADC_arm_tx();
+    }
+#endif
 }
 
 
 /***************************************************************************//**
- *  @brief 		Function that reads the frame, and calls the modulation function
+ *  @brief 		Function that pops the next symbol of the schedule built by
+ *  			TxInit(). Called once per bit period, from the bit rate timer
+ *  			interrupt: the modulation of a '0' bit is left to TxModulate(),
+ *  			out of the interrupt.
  *
- *  @param 		frame 			is the pointer to the frame to send
- *	@param 		u8_FrameSize 	is the frame size in bytes
- *
- *  @return 	\li \b 0 if TX frame in progress
- *  @return		\li \b 1 if TX frame complete
+ *  @return 	\li \b E_TX_IN_PROGRESS if TX frame in progress
+ *  @return		\li \b E_TX_MODULATE if a '0' bit is due
+ *  @return		\li \b E_TX_END if TX frame complete
  ******************************************************************************/
 unsigned char
-TxProcess(unsigned char *frame, unsigned char u8_FrameSize)
+TxProcess(void)
 {
     unsigned char TxStatus;
 
-    TxStatus = 0;
+    TxStatus = E_TX_IN_PROGRESS;
 
-    if (bit_index_in_frame < (u8_FrameSize)*8)
+    if (bits_left != 0)
     {
-        //
-    	// If a 0 is read in the frame, call the modulation function
-        //
-    	if(0 ==  Read_Bit(frame))
+#ifdef ADC_MEASUREMENT
+        if (bits_left == adc_bits_left)
         {
-        	RADIO_modulate();
+            // Middle of the longest PA plateau
+            ADC_start_tx();
         }
+#endif
+        bits_left--;
 
-        //
-    	// TX frame in progress
-        //
-    	TxStatus = 0;
-        bit_index_in_frame++;
+        if (ones_left != 0)
+        {
+            //
+            // A '1' is sent, nothing to modulate
+            //
+            ones_left--;
+        }
+        else if (zeros_left != 0)
+        {
+            //
+        	// A '0' is sent, the modulation function has to be called
+            //
+            zeros_left--;
+            ones_left = *tx_next_run++;
+            TxStatus = E_TX_MODULATE;
+        }
     }
     else
     {
     	//
     	// End of the frame
         //
-    	TxStatus = 1;
+    	TxStatus = E_TX_END;
     }
     return TxStatus;
 }
 
 
 /***************************************************************************//**
- *  @brief 		Reads a bit in buffer to send to RF TX.
- *
- *  @param 		frame 		is the pointer to the TX frame.
- *
- *  @return 	\li \b 0 if modulation needs to be produced
- *  @return		\li \b 1 if not
+ *  @brief 		Modulates the '0' bit announced by TxProcess(). Called by
+ *  			sfx_send() once woken up, before the next bit period.
  ******************************************************************************/
-static unsigned char
-Read_Bit(unsigned char * frame)
+void
+TxModulate(void)
 {
-    register u8 index_bit;
-    register u8 index_byte;
-    u8 bit_to_send;
-
-    index_bit = bit_index_in_frame % 8;
-    index_byte = bit_index_in_frame / 8;
-    bit_to_send = ((frame[index_byte] >> (7 - index_bit)) & 0x01); 
-    return bit_to_send;
+#ifdef TX_JITTER_STATS
+	// TA1R restarts from 0 on the CCR0 match raising the bit interrupt
+	unsigned int latency = TA1R;
+
+	if (latency < TxJitter.min) TxJitter.min = latency;
+	if (latency > TxJitter.max) TxJitter.max = latency;
+	TxJitter.count++;
+#endif
+	RADIO_modulate();
 }
 
 
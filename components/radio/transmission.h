@@ -9,6 +9,10 @@
 #ifndef TRANSMISSION_H
 #define	TRANSMISSION_H
 
+/*! Largest frame accepted by TxInit(), in bytes. The '1' runs of the
+ *  symbol schedule are stored on 8 bits, so it cannot exceed 32. */
+#define TX_MAX_FRAME_SIZE	32
+
 /********************************
  * \enum e_mode
  * \brief TX mode
@@ -25,11 +29,28 @@ typedef enum{
  *******************************/
 typedef enum{
   E_TX_IN_PROGRESS = 0,	/*!< TX in progress */
-  E_TX_END = 1			/*!< TX complete */
+  E_TX_END = 1,			/*!< TX complete */
+  E_TX_MODULATE = 2		/*!< TX in progress, a '0' bit is due: call TxModulate() */
 }e_TxStatus;
 
-void TxInit(void);
-unsigned char TxProcess(unsigned char *frame, unsigned char u8_FrameSize);
+/********************************
+ * \struct TxJitterStats_t
+ * \brief Latency between the bit rate timer interrupt and the start of
+ *        the modulation, in bit rate timer ticks
+ *******************************/
+typedef struct{
+  unsigned int min;		/*!< Lowest latency of the frame */
+  unsigned int max;		/*!< Highest latency of the frame */
+  unsigned int count;	/*!< Number of modulated symbols */
+}TxJitterStats_t;
+
+#ifdef TX_JITTER_STATS
+extern TxJitterStats_t TxJitter;
+#endif
+
+void TxInit(unsigned char *frame, unsigned char u8_FrameSize);
+unsigned char TxProcess(void);
+void TxModulate(void);
 
 
 #endif	/* TRANSMISSION_H */
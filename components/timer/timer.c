@@ -6,6 +6,8 @@
 //!       \li \e Timer0 is used to ensure SigFox Downlink protocol timings are under control
 //!              \li \c 20 s Waiting time after the 1st INITIATE_DOWNLINK Uplink Frame
 //!              \li \c 25 s Reception windows to get the Downling frame
+//!              \li \c the delays of sfx_delay(), slept in LPM3
+//!       \li \e RTC_A counts ACLK as the time base of the statistics
 //!
 //****************************************************************************/
  
@@ -24,11 +26,24 @@
 #include "sigfox_demo.h"
 #include "sigfox_types.h"
 #include "device_config.h"
+#include "transmission.h"
+#include "bsp.h"
+#include "radio.h"
+#include "timer.h"
+#include "string.h"
 
 
 /******************************************************************************
  * DEFINES
  */
+/* The bit periods of the modulation profiles are tuned with SMCLK = BITRATE_REF_CLK */
+#define BITRATE_REF_CLK			BSP_SYS_CLK_24MHZ
+
+/* Timer0 counts ACLK in continuous mode: CCR0 ticks the seconds of the
+ * downlink timings, CCR1 ends the delays */
+#define TIMER0_SECOND			((uint16)TIMER_TIMEBASE_HZ)
+#define TIMER0_DELAY_MAX		0xC000u		// Longest compare of a delay, ticks
+#define TIMER0_DELAY_MIN		2u			// Shortest delay, the counter cannot pass it while CCR1 is written
 
 
 /******************************************************************************
@@ -40,6 +55,17 @@ u8 TIMER0_timeout = FALSE;
 static u8 interrupt_count = 0;
 static u8 nb_interrupt_to_wait_for = 0 ;
 
+static TimerWaitStats_t WaitFrame;		// Waits of the current frame
+static TimerWaitStats_t WaitLast;		// Waits of the last frame
+
+
+/******************************************************************************
+ * FUNCTION PROTOTYPE
+ */
+static void TIMER0_start(void);
+static void TIMER0_release(void);
+static uint16 TIMER0_count(void);
+
 
 /******************************************************************************
  * FUNCTIONS
@@ -48,10 +74,15 @@ static u8 nb_interrupt_to_wait_for = 0 ;
 *   @brief 		Initialize the Timer uses to produce the signal bitrate
 *          \li 	FCC bit rate  : 600bps => 1 bit each 1.66 ms
 *          \li 	ETSI bit rate : 100bps => 1 bit each 10 ms
+*   @note   The period comes from the modulation profile, see RADIO_select_profile().
+*   		It is tuned at 24 MHz and scaled to the SMCLK set by bspInit()
 ******************************************************************************/
 void
 TIMER_bitrate_init(void)
 {
+	const RadioProfile_t *profile = RADIO_get_profile();
+	uint32 clk_khz = bspSysClockSpeedGet() / 1000;
+
 	//
 	// Watchdog Timer Control Register
 	//
@@ -61,13 +92,9 @@ TIMER_bitrate_init(void)
 	// Timer Register Configuration
 	//
 	TA1CCTL0 = CCIE;	// CCR0 interrupt enabled
-#if defined(MODE_FCC)
-	TA1CCR0  = 39990;		// count depends on the MCU clock set to SMLK to create the bitrate (1.66 ms )
-	TA1CTL   = TASSEL_2 + TACLR; // Choose the SMCLK countmode, clear the timer counter
-#elif defined(MODE_ETSI)
-	TA1CCR0  = 29982;		// count depends on the MCU clock set to SMLK to create the bitrate (10 ms )
-	TA1CTL   = TASSEL_2 + ID_3 + TACLR; // Choose the SMCLK countmode, Devide the clock by 8, clear the timer counter
-#endif
+	TA1CCR0  = (uint16)(((profile->u16_BitPeriod + 1UL) * clk_khz + (BITRATE_REF_CLK / 2000))
+						/ (BITRATE_REF_CLK / 1000)) - 1;	// bitrate period in SMCLK (600 bps) or SMCLK/8 (100 bps) counts
+	TA1CTL   = TASSEL_2 + profile->u16_BitClkDiv + TACLR; // Choose the SMCLK countmode and the profile divider, clear the timer counter
 }
 
 
@@ -79,25 +106,20 @@ TIMER_bitrate_init(void)
 void
 TIMER_downlink_timing_init( uint16 time_in_seconds )
 {
-	//
-	// Timer0_A5 Capture/Compare 0
-	//
-	TA0CCR0 =  32700;	// Count 1 second
+	uint16 istate = __get_interrupt_state();
 
-	//
-	// Timer Control Register
-	//
-	TA0CTL |= TASSEL_1 + TACLR;	// ACLK (32kHz) Count mode and Clear the timer counter
-
-	//
-	// Timer Capture/Compare Control 0 Register
-	//
-	TA0CCTL0 |= CCIE;	// TAxCCR0 interrupt enabled
+	__disable_interrupt();
 
     //
-	// Activate the timer
+	// Activate the timer, a delay may already run it
     //
-	TA0CTL |= MC_1;		// Timer A mode control: 1 - Up to TAxCCR0
+	TIMER0_start();
+
+	//
+	// Timer0_A5 Capture/Compare 0: first second from now
+	//
+	TA0CCR0  = TIMER0_count() + TIMER0_SECOND;
+	TA0CCTL0 = CCIE;	// TAxCCR0 interrupt enabled
 
     //
 	// Initialize the number of interrupt to wait for
@@ -108,6 +130,8 @@ TIMER_downlink_timing_init( uint16 time_in_seconds )
 	// Reset the counter
 	//
 	interrupt_count = 0;
+
+	__set_interrupt_state(istate);
 }
 
 
@@ -117,16 +141,200 @@ TIMER_downlink_timing_init( uint16 time_in_seconds )
 void
 TIMER_downlink_timing_stop ( void )
 {
+	uint16 istate = __get_interrupt_state();
+
+	__disable_interrupt();
+
     //
 	// Reset the timeout value
     //
 	TIMER0_timeout = FALSE;
 
 	//
-	// Deactivate Timer0
+	// Deactivate the seconds of Timer0
 	//
-    TA0CTL &= ~MC_1;
-	TA0CTL |= TACLR;
+	TA0CCTL0 = 0;
+	TIMER0_release();
+
+	__set_interrupt_state(istate);
+}
+
+
+/***************************************************************************//**
+*   @brief  Returns the seconds left before the downlink timeout
+*   @return \b seconds, 0 once the timeout is reached
+*******************************************************************************/
+uint16
+TIMER_downlink_left(void)
+{
+	uint16 istate = __get_interrupt_state();
+	uint16 u16_Left;
+
+	__disable_interrupt();
+	u16_Left = nb_interrupt_to_wait_for - interrupt_count;
+	__set_interrupt_state(istate);
+
+	return u16_Left;
+}
+
+
+/***************************************************************************//**
+*   @brief  Waits with the CPU in LPM3, Timer0 CCR1 wakes it up
+*   @note   The wait counts ACLK: its length does not depend on MCLK. It is
+*           split in compares of at most ::TIMER0_DELAY_MAX ticks, the downlink
+*           seconds keep running on CCR0 meanwhile. The interrupts of the
+*           other peripherals (host UART) wake the CPU up on the way, the
+*           wait goes back to sleep till the compare.
+*   @param  u16_Ms  is the delay in ms
+*******************************************************************************/
+void
+TIMER_sleep_ms(uint16 u16_Ms)
+{
+	uint16 istate;
+	uint16 u16_Step;
+	uint32 ul_Delay;
+	uint32 ul_Ticks;
+	uint32 ul_Start;
+	uint32 ul_Late;
+
+	if (u16_Ms == 0)
+	{
+		return;
+	}
+	ul_Delay = ((uint32)u16_Ms * TIMER_TIMEBASE_HZ + 500UL) / 1000UL;
+	ul_Ticks = ul_Delay;
+
+	istate = __get_interrupt_state();
+	__disable_interrupt();
+
+	ul_Start = TIMER_timebase_get();
+	TIMER0_start();
+
+	//
+	// The compares follow each other from the first count: the wake-ups
+	// do not add up. The compares after the first one are long, the
+	// counter cannot pass them while the CPU wakes up.
+	//
+	TA0CCR1 = TIMER0_count();
+	if (ul_Ticks < TIMER0_DELAY_MIN)
+	{
+		ul_Ticks = TIMER0_DELAY_MIN;
+	}
+	while (ul_Ticks != 0)
+	{
+		if (ul_Ticks <= TIMER0_DELAY_MAX)
+		{
+			u16_Step = (uint16)ul_Ticks;
+		}
+		else if (ul_Ticks < 2UL * TIMER0_DELAY_MAX)
+		{
+			u16_Step = (uint16)(ul_Ticks / 2);
+		}
+		else
+		{
+			u16_Step = TIMER0_DELAY_MAX;
+		}
+		ul_Ticks -= u16_Step;
+
+		TA0CCR1 += u16_Step;
+		TA0CCTL1 = CCIE;
+		while (TA0CCTL1 & CCIE)
+		{
+			// GIE and LPM3 are set together, the interrupt cannot be missed
+			__bis_SR_register(LPM3_bits + GIE);
+			__disable_interrupt();
+		}
+	}
+
+	TIMER0_release();
+
+	//
+	// Account the sleep, and how much it overran the delay
+	//
+	ul_Start = TIMER_timebase_get() - ul_Start;
+	WaitFrame.ul_Sleep += ul_Start;
+	WaitFrame.u16_Delays++;
+	ul_Late = ul_Start - ul_Delay;
+	if (((int32)ul_Late > 0) && (ul_Late > WaitFrame.u16_LateMax))
+	{
+		WaitFrame.u16_LateMax = (uint16)ul_Late;
+	}
+
+	__set_interrupt_state(istate);
+}
+
+
+/***************************************************************************//**
+*   @brief  Accounts a wait of the CPU
+*   @param  ul_Total    is the length of the wait, TIMER_timebase_get() ticks
+*   @param  ul_Slept    is the part of the wait slept in LPM3
+*******************************************************************************/
+void
+TIMER_wait_done(uint32 ul_Total, uint32 ul_Slept)
+{
+	WaitFrame.ul_Sleep += ul_Slept;
+	WaitFrame.ul_Awake += ul_Total - ul_Slept;
+}
+
+
+/***************************************************************************//**
+*   @brief  Ends the frame of the wait counters: the counters of the frame
+*           become the ones returned by TIMER_wait_stats()
+*******************************************************************************/
+void
+TIMER_wait_frame_end(void)
+{
+	WaitLast = WaitFrame;
+	memset(&WaitFrame, 0, sizeof(WaitFrame));
+}
+
+
+/***************************************************************************//**
+*   @brief  Returns the wait counters of the last frame
+*   @return pointer to the counters
+*******************************************************************************/
+const TimerWaitStats_t *
+TIMER_wait_stats(void)
+{
+	return &WaitLast;
+}
+
+
+/***************************************************************************//**
+*   @brief  Start the time base: RTC_A in 32-bit counter mode on ACLK
+*   @note   The counter keeps running in LPM3 and wraps after 36 hours,
+*           differences of TIMER_timebase_get() values stay valid across
+*           the wrap.
+*******************************************************************************/
+void
+TIMER_timebase_init(void)
+{
+	RTCCTL01 = RTCHOLD;					// Counter mode, ACLK source, hold
+	RTCNT12  = 0;
+	RTCNT34  = 0;
+	RTCCTL01 = RTCSSEL_0 + RTCTEV_3;	// Release, 32-bit counter
+}
+
+
+/***************************************************************************//**
+*   @brief  Read the time base
+*   @note   The counter runs from ACLK, asynchronously to MCLK: it is read
+*           till two reads agree
+*   @return \b ticks of ::TIMER_TIMEBASE_HZ
+*******************************************************************************/
+uint32
+TIMER_timebase_get(void)
+{
+	uint16 u16_Low;
+	uint16 u16_High;
+
+	do
+	{
+		u16_Low  = RTCNT12;
+		u16_High = RTCNT34;
+	}while ((u16_Low != RTCNT12) || (u16_High != RTCNT34));
+
+	return ((uint32)u16_High << 16) | u16_Low;
 }
 
 
@@ -161,27 +369,62 @@ TIMER_bitrate_stop(void)
 
 /***************************************************************************//**
 *   @brief  Timer1 interrupt : a new bit has to be sent to the Radio
-*           Change the system state status to processing
+*           The next symbol is taken from the interrupt. On a '0' bit, the
+*           system state is set to TxProcessing and the CPU is woken up to
+*           modulate it, the busy-wait PA ramps are kept out of the
+*           interrupt. At the end of the frame, the system state is set to
+*           TxEnd and the CPU is woken up.
+*           With TX_POLLING_ENGINE, only the system state is changed to
+*           processing and sfx_send() takes the symbol.
 *******************************************************************************/
 #pragma vector=TIMER1_A0_VECTOR
 __interrupt void
 TIMER1_A0_ISR(void)
 {
+#if defined(TX_POLLING_ENGINE)
 	//
 	//update processing flag
 	//
 	SysState = TxProcessing;
+#else
+	//
+	// Take the bit, wake up sfx_send() to modulate a '0' or at the end of the frame
+	//
+	if (SysState == TxWaiting)
+	{
+		switch (TxProcess())
+		{
+		case E_TX_MODULATE:
+			SysState = TxProcessing;
+			__bic_SR_register_on_exit(LPM0_bits);
+			break;
+		case E_TX_END:
+			SysState = TxEnd;
+			__bic_SR_register_on_exit(LPM0_bits);
+			break;
+		default:
+			break;
+		}
+	}
+#endif
 }
 
 
 /***************************************************************************//**
 *   @brief  Timer0 interrupt : this interrupt will be used either for
 *           the 20s and 25 seconds Downlink timings
+*   @note   The CPU is woken up each second: the downlink waits sleep in
+*           LPM3 between the seconds, see sfx_WaitForTimeoutRx()
 *******************************************************************************/
 #pragma vector=TIMER0_A0_VECTOR
 __interrupt void
 TIMER0_A0_ISR(void)
 {
+	//
+	// Next second
+	//
+	TA0CCR0 += TIMER0_SECOND;
+
 	//
 	// Increment the base downlink interrupt counter
 	//
@@ -197,6 +440,77 @@ TIMER0_A0_ISR(void)
 		interrupt_count = 0;
 		nb_interrupt_to_wait_for = 0;		
         }
+
+	__bic_SR_register_on_exit(LPM3_bits);
+}
+
+
+
+/***************************************************************************//**
+*   @brief  Timer0 interrupt : end of a delay compare, wakes up
+*           TIMER_sleep_ms()
+*******************************************************************************/
+#pragma vector=TIMER0_A1_VECTOR
+__interrupt void
+TIMER0_A1_ISR(void)
+{
+	switch (__even_in_range(TA0IV, TA0IV_TA0IFG))
+	{
+	case TA0IV_TA0CCR1:
+		TA0CCTL1 = 0;
+		__bic_SR_register_on_exit(LPM3_bits);
+		break;
+	default:
+		break;
+	}
+}
+
+
+/***************************************************************************//**
+*   @brief  Runs Timer0 on ACLK in continuous mode, if it is stopped
+*   @note   Called with the interrupts disabled
+*******************************************************************************/
+static void
+TIMER0_start(void)
+{
+	if ((TA0CTL & MC_3) == MC_0)
+	{
+		TA0CTL = TASSEL_1 + MC_2 + TACLR;	// ACLK (32kHz), continuous mode, clear the counter
+	}
+}
+
+
+/***************************************************************************//**
+*   @brief  Stops Timer0 once neither the downlink seconds nor a delay use it
+*   @note   Called with the interrupts disabled
+*******************************************************************************/
+static void
+TIMER0_release(void)
+{
+	if (!(TA0CCTL0 & CCIE) && !(TA0CCTL1 & CCIE))
+	{
+		TA0CTL = TASSEL_1 + TACLR;			// Stop mode, clear the counter
+	}
+}
+
+
+/***************************************************************************//**
+*   @brief  Reads the Timer0 counter
+*   @note   The counter runs from ACLK, asynchronously to MCLK: it is read
+*           till two reads agree
+*   @return \b counter value
+*******************************************************************************/
+static uint16
+TIMER0_count(void)
+{
+	uint16 u16_Count;
+
+	do
+	{
+		u16_Count = TA0R;
+	}while (u16_Count != TA0R);
+
+	return u16_Count;
 }
 
 
@@ -6,6 +6,8 @@
 //!       \li \e Timer0 is used to ensure SigFox Downlink protocol timings are under control
 //!              \li \c 20 s Waiting time after the 1st INITIATE_DOWNLINK Uplink Frame
 //!              \li \c 25 s Reception windows to get the Downling frame
+//!              \li \c the delays of sfx_delay(), slept in LPM3
+//!       \li \e RTC_A counts ACLK as the time base of the statistics
 //!
 //****************************************************************************/
 
@@ -15,6 +17,28 @@
 #define TIMER_H
 
 
+/******************************************************************************
+ * DEFINES
+ */
+#define TIMER_TIMEBASE_HZ	32768UL		// TIMER_timebase_get() ticks per second
+
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+/**
+ * \struct TimerWaitStats_t
+ * \brief Waits of the CPU during a frame, see TIMER_wait_stats()
+ */
+typedef struct
+{
+	uint32 ul_Sleep;		/*!< Time slept in LPM3 by the waits, TIMER_timebase_get() ticks */
+	uint32 ul_Awake;		/*!< Time awake in the waits (wake-ups, wait hook), TIMER_timebase_get() ticks */
+	uint16 u16_Delays;		/*!< Number of TIMER_sleep_ms() calls */
+	uint16 u16_LateMax;		/*!< Longest overrun of a delay, TIMER_timebase_get() ticks */
+}TimerWaitStats_t;
+
+
 /******************************************************************************
  * FUNCTION PROTOTYPES
  */
@@ -23,8 +47,16 @@ void TIMER_bitrate_start(void);
 void TIMER_bitrate_stop(void);
 void TIMER_downlink_timing_init( uint16 time_in_seconds );
 void TIMER_downlink_timing_stop ( void );
+void TIMER_timebase_init(void);
+uint32 TIMER_timebase_get(void);
+void TIMER_sleep_ms(uint16 u16_Ms);
+void TIMER_wait_done(uint32 ul_Total, uint32 ul_Slept);
+uint16 TIMER_downlink_left(void);
+void TIMER_wait_frame_end(void);
+const TimerWaitStats_t * TIMER_wait_stats(void);
 __interrupt void TIMER1_A0_ISR(void);
 __interrupt void TIMER0_A0_ISR(void);
+__interrupt void TIMER0_A1_ISR(void);
 
 extern unsigned char TIMER0_timeout;
 
@@ -28,17 +28,44 @@
 #include "flash_drv.h"
 #include "cc112x_spi.h"
 #include "hal_spi_rf_trxeb.h"
+#ifdef ADC_MEASUREMENT
+#include "adc.h"
+#endif
 #include "../sigfox_library_api/sigfox.h"
 #include "stdlib.h"
 #include "stdio.h"
+#include "string.h"
 
 
 /******************************************************************************
  * DEFINES
  */
-#define RX_FIFO_ERROR       0x11
 #define RSSI_OFFSET			102		// RSSI offset for CC112x
 
+#define SFX_POOL_ENTRY(size, nb)	{ NULL, size, 0, nb, 0 },
+#define SFX_POOL_CHECK(size, nb)	+ ((nb) > 16)
+#define POOL_DEBRUIJN_16			0x09AF	// De Bruijn sequence of the 16 bit free bitmaps
+
+#if defined(TX_REPEAT_ADAPTIVE) || defined(TX_POWER_ADAPTIVE)
+#define LINK_ADAPT				// The link margin sets the repeats or the power
+#endif
+
+#define REPEAT_MAX				2		// Repeats of an uplink frame, at most
+#define LINK_RSSI_FLOOR			(-129)	// dBm, downlink RSSI of an uplink received at the base station sensitivity
+#define LINK_MARGIN_STEP		2		// dB, steps of LinkCopyLoss[]
+#define LINK_MARGIN_STEPS		16
+#define LINK_HYSTERESIS			3		// dB more margin to lower the repeats
+#define LINK_MISS_PENALTY		(6 * 16)	// 1/16 dB less margin after a missed ack
+#define LINK_ACK_MISS			(2 * (1000UL - TX_LINK_RELIABILITY))	// Acks missed per 1000 at the margin shown, downlink included
+#define LINK_ACK_CREDIT			((LINK_MISS_PENALTY * LINK_ACK_MISS + 1000UL - LINK_ACK_MISS - 1) \
+									/ (1000UL - LINK_ACK_MISS))		// 1/16 dB back after an ack
+#define LINK_PENALTY_MAX		(24 * 16)
+#define LINK_HOLD				2		// Acks received at most repeats after a miss
+#define LINK_RSSI_AGE			48		// Frames sent before the downlink RSSI is too old
+#define POWER_LEVEL_MAX			63		// PA level of the full power, 0.5 dB steps
+#define POWER_BACKOFF_STEP		2		// dB, steps of the power backoff
+#define POWER_BACKOFF_MAX		24		// dB below the full power, at most
+
 
 /******************************************************************************
  * GLOBAL VARIABLES
@@ -47,11 +74,6 @@ e_SystemState SysState; /*!< TX status */
 
 u8 DynamicMemoryTable[SFX_DYNAMIC_MEMORY];
 
-MemoryBlock Table_64bytes[NUMBER_BLOCKS_64BYTES];
-MemoryBlock Table_32bytes[NUMBER_BLOCKS_32BYTES];
-MemoryBlock Table_30bytes[NUMBER_BLOCKS_30BYTES];
-MemoryBlock Table_8bytes[NUMBER_BLOCKS_8BYTES];
-
 /*!
  * \struct Nvram
  * \brief Object stored into non volatile memory (Flash, Eeprom, ...).
@@ -62,7 +84,7 @@ struct
 	u16 SeqNbr; /*!< Number used for manage the frame sequencing */
 }Nvram;
 
-/* Needed to get the memory before writing into flash
+/* Cache of the non volatile memory, see sfx_nv_mem_flush()
  * [0]PN9
  * [1]SeqNb
  */
@@ -74,6 +96,62 @@ u16 NonVRam[2];
  */
 static int RSSI = 0;
 
+/* Memory pool classes, see SFX_MEMORY_POOL in sigfox_demo.h */
+static MemoryPool Pool[SFX_POOL_NB_CLASSES] = { SFX_MEMORY_POOL(SFX_POOL_ENTRY) };
+static u8 PoolRequest[SFX_POOL_NB_BLOCKS];		// Size asked for each block in use
+static MemoryPoolStats PoolStats;
+
+/* Free bitmaps hold 16 blocks */
+typedef char PoolClassCheck[(0 SFX_MEMORY_POOL(SFX_POOL_CHECK)) ? -1 : 1];
+
+/* Bit index of (bit * POOL_DEBRUIJN_16) >> 12 */
+static const u8 PoolBitIndex[16] = { 0, 1, 2, 5, 3, 9, 6, 11, 15, 4, 8, 10, 14, 7, 13, 12 };
+
+/* Application work run during the downlink waits, see sfx_set_wait_hook() */
+static SfxWaitHook WaitHook = NULL;
+
+/* State of the NonVRam cache */
+static u8 b_NvLoaded = FALSE;			// NonVRam holds the flash record
+static u8 b_NvDirty = FALSE;			// NonVRam differs from the flash record
+static u8 b_NvSeqDirty = FALSE;			// The sequence number differs
+static volatile u8 b_NvBusy = FALSE;	// A flash write is running
+
+#ifdef LINK_ADAPT
+/* Loss of one uplink copy by link margin, from 0 dB by LINK_MARGIN_STEP,
+ * on 65536: 1 - exp(-10^(-margin / 10)), Rayleigh fading */
+static const u16 LinkCopyLoss[LINK_MARGIN_STEPS] = {
+	41426, 30665, 21522, 14557, 9605, 6236, 4007, 2558,
+	1626, 1030, 652, 412, 260, 164, 104, 66
+};
+
+/* State of the link controller, see sfx_link_adapt() */
+static u16 u16_LinkPenalty = 0;		// 1/16 dB taken off the margin, raised by the missed acks
+static u8 u8_LinkHold = 0;			// Acks still due at most repeats
+static u8 u8_LinkAge = LINK_RSSI_AGE;	// Frames sent since the last downlink frame
+static u16 u16_LinkRssiFrames = 0;	// Downlink frames counted at the last frame
+static u8 b_LinkRx = FALSE;			// A downlink window was opened
+static u8 b_LinkMiss = FALSE;			// The window timed out
+#endif
+
+#ifdef TX_POWER_ADAPTIVE
+static u8 u8_PowerBackoff = 0;			// dB below the full power of the last frame
+#endif
+
+
+/******************************************************************************
+ * FUNCTION PROTOTYPE
+ */
+static void sfx_wait_downlink(u8 b_Frame);
+static void sfx_nv_mem_load(void);
+#ifdef LINK_ADAPT
+static u8 sfx_repeat_needed(s16 s16_Margin);
+static void sfx_link_result(u8 b_Acked);
+#endif
+#ifdef TX_POWER_ADAPTIVE
+static void sfx_power_select(s16 s16_Margin, u8 u8_Repeat);
+static void sfx_power_set(u8 u8_Backoff);
+#endif
+
 
 /******************************************************************************
 * FUNCTIONS
@@ -82,17 +160,43 @@ static int RSSI = 0;
  *	@brief  	This function is called to initialize the chipset in the correct mode
  *  @param  	e_ChipMode 		is the mode to use (RX or TX). ::te_RxChipMode
  *  @return  	error code ::SFX_error_t
+ *
+ *  @note		With RADIO_TX_SESSION, the TX init opens a session lasting
+ *  			till sfx_close() or the RX init: the repeats of the frame
+ *  			keep the radio configured and the synthesizer running,
+ *  			see RADIO_tx_session().
+ *  @note		With RADIO_XTAL_COMP, the XTAL correction follows the
+ *  			temperature given by sfx_get_voltage_temperature().
  *******************************************************************************/
 SFX_error_t
 sfx_init(te_RxChipMode e_ChipMode)
 {
+#ifdef RADIO_XTAL_COMP
+	u16 vdd_idle, vdd_tx, temperature;
+
+	sfx_get_voltage_temperature(&vdd_idle, &vdd_tx, &temperature);
+	RADIO_xtal_temperature((int16)temperature);
+#endif
+
 	if(e_ChipMode == E_TX_MODE)
 	{
+#ifdef RADIO_TX_SESSION
+		// The sends till sfx_close() are back-to-back
+		RADIO_tx_session(true);
+#endif
 		// Initialize the radio in TX mode
 		RADIO_init_chip(*TxCF, E_TX_MODE );
 	}
 	else if (e_ChipMode == E_RX_MODE )
 	{
+#ifdef RADIO_TX_SESSION
+		RADIO_tx_session(false);
+#endif
+#ifdef LINK_ADAPT
+		// The ack of the frame, or its miss, is recorded by sfx_close()
+		b_LinkRx = TRUE;
+		b_LinkMiss = FALSE;
+#endif
 		// Initialize the radio in RX mode
 		RADIO_init_chip(*RxCF, E_RX_MODE );
 	}
@@ -111,7 +215,31 @@ sfx_init(te_RxChipMode e_ChipMode)
 SFX_error_t
 sfx_close(void)
 {
+#ifdef RADIO_TX_SESSION
+	RADIO_tx_session(false);
+#endif
 	RADIO_close_chip();
+
+#ifdef LINK_ADAPT
+	if (b_LinkRx)
+	{
+		b_LinkRx = FALSE;
+		sfx_link_result(!b_LinkMiss);
+	}
+#endif
+
+	// The waits of the frame are over, see TIMER_wait_stats()
+	TIMER_wait_frame_end();
+
+	// Erase ahead, the next sequence number commit only writes
+	b_NvBusy = TRUE;
+	flash_log_prepare();
+	b_NvBusy = FALSE;
+
+#ifdef ADC_MEASUREMENT
+	// Supply and temperature with the radio idle, for the next frame
+	ADC_start_idle();
+#endif
 	return  SFX_ERR_NONE;
 }
 
@@ -140,14 +268,28 @@ sfx_change_frequency(u32 frequency)
  *   @param  	vdd_txptr 		is pointer to the voltage in tx mode
  *   @param  	tempptr 		is pointer to the temperature
  *   @return  	error code ::SFX_error_t
+ *   @note		With ADC_MEASUREMENT, the last measurements are given without
+ *   			waiting, see ADC_values(): mV and 1/10 degC.
  *******************************************************************************/
 SFX_error_t
 sfx_get_voltage_temperature(u16 *vdd_idleptr, u16 *vdd_txptr, u16 *tempptr)
 {
+#ifdef ADC_MEASUREMENT
+	const AdcValues_t *pAdc = ADC_values();
+	uint16 istate = __get_interrupt_state();
+
+	// Last measurements, updated from the DMA interrupt
+	__disable_interrupt();
+	*vdd_idleptr = pAdc->u16_VddIdle;
+	*vdd_txptr = pAdc->u16_VddTx;
+	*tempptr = (u16)pAdc->s16_Temp;
+	__set_interrupt_state(istate);
+#else
 	// TO BE IMPLEMENTED WITH PROPER VALUES
 	*vdd_idleptr = 0xCE4; // 3300mV
 	*vdd_txptr = 0xC1C;   // 3100mV
 	*tempptr = 0x00FA;    //250/10 degrees Celsius
+#endif
 
 	return  SFX_ERR_NONE;
 }
@@ -185,125 +327,171 @@ sfx_AES_128_cbc_encrypt(u8 *Encrypted_data, u8 *Data_To_Encrypt,
 }
 
 
+/***************************************************************************//**
+ *   @brief   	Initializes the memory pool: the classes of SFX_MEMORY_POOL
+ *   			follow each other in DynamicMemoryTable, all blocks free.
+ *******************************************************************************/
+void
+sfx_memory_init(void)
+{
+	u8 i;
+	u8 * mem_ptr = DynamicMemoryTable;
+	u8 first = 0;
+
+	for (i = 0; i < SFX_POOL_NB_CLASSES; i++)
+	{
+		Pool[i].memory_ptr = mem_ptr;
+		Pool[i].first = first;
+		Pool[i].free = (u16)((1UL << Pool[i].nb_blocks) - 1);
+		mem_ptr += Pool[i].size * Pool[i].nb_blocks;
+		first += Pool[i].nb_blocks;
+	}
+	memset(&PoolStats, 0, sizeof(PoolStats));
+}
+
+
+/***************************************************************************//**
+ *   @brief   	Gives the memory pool counters
+ *   @return  	pointer to the counters ::MemoryPoolStats
+ *******************************************************************************/
+const MemoryPoolStats *
+sfx_memory_stats(void)
+{
+	return &PoolStats;
+}
+
+
 /***************************************************************************//**
  *   @brief   	Function to manage the memory needed by the library to generate frames
  *   @param   	size 			is the size needed
  *   @return  	\b mem_ptr 		is pointer to the memory allocated
+ *
+ *   @note		The request takes a block of the smallest class that fits,
+ *   			or of the next larger class with a free block. The free
+ *   			block of a class is the lowest bit of its free bitmap, found
+ *   			without a loop (De Bruijn multiply).
  *******************************************************************************/
 u8*
 sfx_malloc(u16 size)
 {
+	MemoryPool * pool = Pool;
+	u16 bit;
+	u16 free_bytes = 0;
+	u8 best = SFX_POOL_NB_CLASSES;
+	u8 index;
 	u8 i;
-	MemoryBlock * mem_blk;
-	MemoryBlock * ptr;
-	u8 nb_block = 0;
-	u8 * mem_ptr = NULL;
 
-	switch(size)
+	for (i = 0; i < SFX_POOL_NB_CLASSES; i++, pool++)
 	{
-		case 30:
-			mem_blk = Table_30bytes;
-			nb_block = NUMBER_BLOCKS_30BYTES;
-			break;
-		case 32:
-			mem_blk = Table_32bytes;
-			nb_block = NUMBER_BLOCKS_32BYTES;
-			break;	
-		case 64:
-			mem_blk = Table_64bytes;
-			nb_block = NUMBER_BLOCKS_64BYTES;
-			break;
-		case 8:
-			mem_blk = Table_8bytes;
-			nb_block = NUMBER_BLOCKS_8BYTES;
-			break;
-		default:
-			// No block defined for that size
+		if (pool->size < size)
+		{
+			continue;
+		}
+		if (best == SFX_POOL_NB_CLASSES)
+		{
+			best = i;
+		}
+		if (pool->free != 0)
+		{
 			break;
+		}
 	}
 
-	if (nb_block != 0)
+	if (i == SFX_POOL_NB_CLASSES)
 	{
-		for (i=0; i < nb_block && mem_ptr== NULL; i++)
+		PoolStats.failed++;
+		for (i = 0; i < SFX_POOL_NB_CLASSES; i++)
 		{
-			ptr =  (mem_blk + i);
-
-			if ( ptr->allocated == FALSE)
+			for (bit = Pool[i].free; bit != 0; bit &= bit - 1)
 			{
-				// The memory block is free, we can allocate it
-				mem_ptr = ptr->memory_ptr ;
-				ptr->allocated = TRUE;
+				free_bytes += Pool[i].size;
 			}
 		}
+		if ((best != SFX_POOL_NB_CLASSES) && (free_bytes >= size))
+		{
+			// Enough free bytes, in the blocks of other classes
+			PoolStats.fragmented++;
+		}
+		return NULL;
 	}
 
-	return mem_ptr;
-}
+	// Lowest free block
+	bit = pool->free & (~pool->free + 1);
+	index = PoolBitIndex[(u16)(bit * POOL_DEBRUIJN_16) >> 12];
+	pool->free &= ~bit;
 
-
-/***************************************************************************//**
- *   @brief   	Function to free up a memory block
- *   @param   	p 			is a pointer to the memory to free
- *   @param 	nb_blocks 	is the number of blocks to free
- *   @param 	table_ptr 	is a pointer to the free memory
- *   @return  	error code ::SFX_error_t
- *******************************************************************************/
-static SFX_error_t free_memory_block (u8 *p, u8 nb_blocks , MemoryBlock *table_ptr )
-{
-	u8 i;
-	SFX_error_t status = SFX_ERR_INIT;
-
-	for (i=0 ; i< nb_blocks ; i++)
+	if (i != best)
 	{
-		if ( p == (table_ptr + i)->memory_ptr )
-		{
-			if ( (table_ptr + i)->allocated == TRUE )
-			{
-				(table_ptr + i )->allocated = FALSE;
-				status = SFX_ERR_NONE;            
-			}
-			else
-			{
-				status = SFX_ERR_INIT;
-			}
-		}
+		// The best fit was full
+		PoolStats.spilled++;
 	}
-	return status;
+	PoolRequest[pool->first + index] = (u8)size;
+	PoolStats.in_use += pool->size;
+	PoolStats.wasted += pool->size - size;
+	if (PoolStats.in_use > PoolStats.high_watermark)
+	{
+		PoolStats.high_watermark = PoolStats.in_use;
+	}
+	if (PoolStats.wasted > PoolStats.wasted_max)
+	{
+		PoolStats.wasted_max = PoolStats.wasted;
+	}
+
+	return pool->memory_ptr + index * pool->size;
 }
 
 
 /***************************************************************************//**
  *   @brief   	This function is used to free a memory space
  *   @param   	p 			is a pointer to the memory to free
- *   @return  	error code ::SFX_error_t
+ *   @return  	error code ::SFX_error_t, SFX_ERR_INIT if p is not an
+ *   			allocated block
 *******************************************************************************/
 SFX_error_t
 sfx_free(u8 *p)
 {
-	SFX_error_t status = SFX_ERR_INIT;
+	MemoryPool * pool = Pool;
+	u16 offset;
+	u16 bit;
+	u8 index;
+	u8 i;
+
 	// search at which memory area the pointer is assigned to be able to free the memory
-	if ( ( p >= Table_64bytes[0].memory_ptr) && ( p <= Table_64bytes[NUMBER_BLOCKS_64BYTES-1].memory_ptr) )
+	for (i = 0; i < SFX_POOL_NB_CLASSES; i++, pool++)
 	{
-		status = free_memory_block (p,NUMBER_BLOCKS_64BYTES, Table_64bytes);
-	}
-	else if ( ( p >= Table_32bytes[0].memory_ptr) && ( p <= Table_32bytes[NUMBER_BLOCKS_32BYTES-1].memory_ptr) )
-	{
-		status = free_memory_block (p, NUMBER_BLOCKS_32BYTES, Table_32bytes);
+		if ((p >= pool->memory_ptr) && (p < pool->memory_ptr + pool->size * pool->nb_blocks))
+		{
+			break;
+		}
 	}
-	else if ( ( p >= Table_30bytes[0].memory_ptr) && ( p <= Table_30bytes[NUMBER_BLOCKS_30BYTES-1].memory_ptr) )
+	if (i == SFX_POOL_NB_CLASSES)
 	{
-		status = free_memory_block (p, NUMBER_BLOCKS_30BYTES, Table_30bytes);
+		return SFX_ERR_INIT;
 	}
-	else if ( ( p >= Table_8bytes[0].memory_ptr) && ( p <= Table_8bytes[NUMBER_BLOCKS_8BYTES-1].memory_ptr) )
+
+	offset = (u16)(p - pool->memory_ptr);
+	index = (u8)(offset / pool->size);
+	bit = 1u << index;
+	if ((offset != index * pool->size) || (pool->free & bit))
 	{
-		status = free_memory_block (p,NUMBER_BLOCKS_8BYTES, Table_8bytes);
+		// Not the start of a block, or a block already free
+		return SFX_ERR_INIT;
 	}
-	return status;
+
+	pool->free |= bit;
+	PoolStats.in_use -= pool->size;
+	PoolStats.wasted -= pool->size - PoolRequest[pool->first + index];
+
+	return SFX_ERR_NONE;
 }
 
 
 /***************************************************************************//**
  *   @brief 	This function is used to manage the different delay used by the library
+ *   @note		The radio waits in the power state selected for the delay,
+ *   			see RADIO_power_sleep()
+ *   @note		The CPU sleeps in LPM3 on the ACLK timer, the delays do not
+ *   			depend on MCLK, see TIMER_sleep_ms()
  *   @param 	e_TypeDelay 		is the type of delay to call ::te_DelayType
  *   @return  	error code ::SFX_error_t
  *******************************************************************************/
@@ -313,13 +501,16 @@ sfx_delay(te_DelayType e_TypeDelay)
 	switch(e_TypeDelay)
 	{
 		case E_RX_DELAY :
-			__delay_cycles(10000000);  // 500 ms (20000000_SMCLK * 2)
+			RADIO_power_sleep(500);
+			TIMER_sleep_ms(500);
 			break;
 		case E_TX_DELAY:
-			__delay_cycles(20000000);  // 1000 ms (20000000_SMCLK)
+			RADIO_power_sleep(1000);
+			TIMER_sleep_ms(1000);
 			break;
 		case E_OOB_ACK_DELAY:
-			__delay_cycles(28000000);  // 1400 ms (20000000_SMCLK * 1.4)
+			RADIO_power_sleep(1400);
+			TIMER_sleep_ms(1400);
 			break;
 		default:
 			break;
@@ -334,19 +525,33 @@ sfx_delay(te_DelayType e_TypeDelay)
  *   @param  	e_DataTypeW 	is an enum ::te_DataType for the data type to write
  *   @param  	valueW 			is the data to write into the memory
  *   @return  	error code ::SFX_error_t
+ *
+ *   @note		The value is written to the NonVRam cache. The cache goes to
+ *   			flash as one record at the start of the next sfx_send() when
+ *   			the sequence number changed, see sfx_nv_mem_flush().
  *******************************************************************************/
 SFX_error_t
 sfx_set_nv_mem(te_DataType e_DataTypeW, u16 valueW)
 {
+	sfx_nv_mem_load();
+
 	if( e_DataTypeW == E_PN)
 	{
-		NonVRam[0] = valueW;
+		if (NonVRam[0] != valueW)
+		{
+			NonVRam[0] = valueW;
+			b_NvDirty = TRUE;
+		}
 	}
 	else
 	{
-		NonVRam[1] = valueW;
+		if (NonVRam[1] != valueW)
+		{
+			NonVRam[1] = valueW;
+			b_NvDirty = TRUE;
+			b_NvSeqDirty = TRUE;
+		}
 	}
-	flash_write_wear_level( (unsigned int *)NonVRam, 2);
 
 	return SFX_ERR_NONE;
 }
@@ -357,12 +562,15 @@ sfx_set_nv_mem(te_DataType e_DataTypeW, u16 valueW)
  *   @param  	e_DataTypeR 	is an enum ::te_DataType for the data type to get
  *   @param  	valueR 			is a pointer to the data read
  *   @return  	error code ::SFX_error_t
+ *
+ *   @note		The value is read from the NonVRam cache, the flash is only
+ *   			read the first time.
  *******************************************************************************/
 SFX_error_t
 sfx_get_nv_mem(te_DataType e_DataTypeR, u16 *valueR)
 {
-	//get a value from an index in non volatile memory
-	flash_read_wear_level((unsigned int *)NonVRam, 2);
+	sfx_nv_mem_load();
+
 	if( e_DataTypeR == E_PN)
 	{
 		*valueR = NonVRam[0];
@@ -375,17 +583,294 @@ sfx_get_nv_mem(te_DataType e_DataTypeR, u16 *valueR)
 	return SFX_ERR_NONE;
 }
 
+/***************************************************************************//**
+ *   @brief  	Loads the NonVRam cache, and arms the low voltage flush
+ *   @note		Called once the MCU is initialized, before SfxInit(). With
+ *   			NVM_LOW_VOLTAGE_FLUSH, the high side supply voltage monitor
+ *   			interrupt writes the cache to flash, see SYSNMI_ISR().
+ *******************************************************************************/
+void
+sfx_nv_mem_init(void)
+{
+	sfx_nv_mem_load();
+
+#if defined(NVM_LOW_VOLTAGE_FLUSH) && defined(__MSP430_HAS_PMM__)
+	// The SVM high side level is set with the core voltage, see bspMcuSetVCoreUp()
+	PMMCTL0_H = PMMPW_H;
+	PMMIFG &= ~SVMHIFG;
+	PMMRIE |= SVMHIE;
+	PMMCTL0_H = 0x00;
+#endif
+}
+
+/***************************************************************************//**
+ *   @brief  	Writes the NonVRam cache to flash, if it changed
+ *   @note		PN9 and the sequence number go in one record of the flash
+ *   			log, see flash_log_write(). sfx_send() calls it before the
+ *   			first symbol of a new sequence number: the sequence numbers
+ *   			sent are never reused after a power cut. A PN9 change alone
+ *   			waits for the next commit.
+ *******************************************************************************/
+void
+sfx_nv_mem_flush(void)
+{
+	unsigned int record[2];
+
+	if (!b_NvDirty)
+	{
+		return;
+	}
+	b_NvBusy = TRUE;
+	b_NvDirty = FALSE;
+	b_NvSeqDirty = FALSE;
+	record[0] = NonVRam[0];
+	record[1] = NonVRam[1];
+	flash_log_write(record, 2);
+	b_NvBusy = FALSE;
+}
+
+/***************************************************************************//**
+ *   @brief  	Reads the flash record into the NonVRam cache, the first time
+ *******************************************************************************/
+static void
+sfx_nv_mem_load(void)
+{
+	unsigned int record[2];
+
+	if (!b_NvLoaded)
+	{
+		if (flash_log_read(record, 2))
+		{
+			NonVRam[0] = record[0];
+			NonVRam[1] = record[1];
+		}
+		b_NvLoaded = TRUE;
+	}
+}
+
+/***************************************************************************//**
+ *   @brief  	Sets the repeats (TxRep) and the power of the next uplink
+ *   			frame, with TX_REPEAT_ADAPTIVE and TX_POWER_ADAPTIVE
+ *   @note		Called before SfxSendFrame() or SfxSendBit(). The link margin
+ *   			is the downlink RSSI average (RADIO_link_stats()) over
+ *   			LINK_RSSI_FLOOR, less a penalty raised by the missed acks
+ *   			and lowered by the acks received.
+ *   @note		The repeats are the fewest giving TX_LINK_RELIABILITY at full
+ *   			power, then the power is lowered as long as these repeats
+ *   			still give it, see sfx_power_select().
+ *   @note		The repeats go down one at a time, with LINK_HYSTERESIS dB
+ *   			more margin. Without a recent downlink frame, and after a
+ *   			missed ack till LINK_HOLD acks are received, the frames are
+ *   			sent with REPEAT_MAX repeats at full power.
+ *******************************************************************************/
+void
+sfx_link_adapt(void)
+{
+#ifdef LINK_ADAPT
+	const RadioLinkStats_t *pLink = RADIO_link_stats();
+	s16 margin;
+	u8 repeat;
+
+	// Age of the downlink RSSI, in frames sent
+	if (pLink->u16_CrcOk != u16_LinkRssiFrames)
+	{
+		u16_LinkRssiFrames = pLink->u16_CrcOk;
+		u8_LinkAge = 0;
+	}
+	else if (u8_LinkAge < LINK_RSSI_AGE)
+	{
+		u8_LinkAge++;
+	}
+
+	if ((u8_LinkHold > 0) || (u8_LinkAge >= LINK_RSSI_AGE))
+	{
+#ifdef TX_REPEAT_ADAPTIVE
+		*TxRepeat = REPEAT_MAX;
+#endif
+#ifdef TX_POWER_ADAPTIVE
+		sfx_power_set(0);
+#endif
+		return;
+	}
+
+	margin = (pLink->s16_RssiAvg - (s16)u16_LinkPenalty) / 16 - LINK_RSSI_FLOOR;
+	repeat = *TxRepeat;
+#ifdef TX_REPEAT_ADAPTIVE
+	repeat = sfx_repeat_needed(margin);
+	if (repeat > REPEAT_MAX)
+	{
+		repeat = REPEAT_MAX;
+	}
+	else if (repeat < *TxRepeat)
+	{
+		// Hysteresis, one repeat less at a time
+		if (sfx_repeat_needed(margin - LINK_HYSTERESIS) < *TxRepeat)
+		{
+			repeat = *TxRepeat - 1;
+		}
+		else
+		{
+			repeat = *TxRepeat;
+		}
+	}
+	*TxRepeat = repeat;
+#endif
+#ifdef TX_POWER_ADAPTIVE
+	sfx_power_select(margin, repeat);
+#endif
+#endif
+}
+
+#ifdef TX_POWER_ADAPTIVE
+/***************************************************************************//**
+ *   @brief  	Lowers the power of the next frame while its repeats still
+ *   			give TX_LINK_RELIABILITY
+ *   @param  	s16_Margin 	is the link margin at full power, in dB
+ *   @param  	u8_Repeat 	is the repeats of the frame
+ *   @note		The backoff goes up one POWER_BACKOFF_STEP at a time, with
+ *   			LINK_HYSTERESIS dB more margin, and down at once.
+ *******************************************************************************/
+static void
+sfx_power_select(s16 s16_Margin, u8 u8_Repeat)
+{
+	u8 backoff = 0;
+
+	// Highest backoff the margin allows
+	while ((backoff < POWER_BACKOFF_MAX)
+		&& (sfx_repeat_needed(s16_Margin - backoff - POWER_BACKOFF_STEP) <= u8_Repeat))
+	{
+		backoff += POWER_BACKOFF_STEP;
+	}
+
+	if (backoff > u8_PowerBackoff)
+	{
+		// Hysteresis, one step lower at a time
+		if (sfx_repeat_needed(s16_Margin - u8_PowerBackoff - POWER_BACKOFF_STEP - LINK_HYSTERESIS) <= u8_Repeat)
+		{
+			backoff = u8_PowerBackoff + POWER_BACKOFF_STEP;
+		}
+		else
+		{
+			backoff = u8_PowerBackoff;
+		}
+	}
+	sfx_power_set(backoff);
+}
+
+/***************************************************************************//**
+ *   @brief  	Sets the PA ceiling of the next frames, see
+ *   			RADIO_set_power_ceiling()
+ *   @param  	u8_Backoff 	is the dB below the full power
+ *******************************************************************************/
+static void
+sfx_power_set(u8 u8_Backoff)
+{
+	if (RADIO_set_power_ceiling(POWER_LEVEL_MAX - 2 * u8_Backoff))
+	{
+		u8_PowerBackoff = u8_Backoff;
+	}
+}
+#endif
+
+#ifdef LINK_ADAPT
+/***************************************************************************//**
+ *   @brief  	Gives the repeats reaching TX_LINK_RELIABILITY
+ *   @param  	s16_Margin 	is the link margin in dB
+ *   @return  	the repeats, REPEAT_MAX + 1 if REPEAT_MAX is not enough
+ *   @note		The copies are lost independently: the frame is lost with
+ *   			all its copies.
+ *******************************************************************************/
+static u8
+sfx_repeat_needed(s16 s16_Margin)
+{
+	u32 loss;
+	u16 copy;
+	u8 repeat;
+
+	s16_Margin /= LINK_MARGIN_STEP;
+	if (s16_Margin < 0)
+	{
+		s16_Margin = 0;
+	}
+	else if (s16_Margin >= LINK_MARGIN_STEPS)
+	{
+		s16_Margin = LINK_MARGIN_STEPS - 1;
+	}
+	copy = LinkCopyLoss[s16_Margin];
+
+	loss = copy;
+	for (repeat = 0; repeat <= REPEAT_MAX; repeat++)
+	{
+		if (loss * 1000UL <= (1000UL - TX_LINK_RELIABILITY) * 65536UL)
+		{
+			break;
+		}
+		loss = (loss * copy) >> 16;
+	}
+	return repeat;
+}
+
+/***************************************************************************//**
+ *   @brief  	Records the ack of a frame sent with a downlink request
+ *   @param  	b_Acked 	is TRUE if a downlink frame was received
+ *   @note		A miss may be the uplink or the downlink: more of them mean
+ *   			less margin than the RSSI shows. The penalty settles where
+ *   			the acks are missed LINK_ACK_MISS times in 1000: the
+ *   			uplink target, and as much again for the downlink frame,
+ *   			sent once.
+ *******************************************************************************/
+static void
+sfx_link_result(u8 b_Acked)
+{
+	if (b_Acked)
+	{
+		if (u8_LinkHold > 0)
+		{
+			u8_LinkHold--;
+		}
+		u16_LinkPenalty = (u16_LinkPenalty > LINK_ACK_CREDIT) ? u16_LinkPenalty - LINK_ACK_CREDIT : 0;
+	}
+	else
+	{
+		u8_LinkHold = LINK_HOLD;
+		u16_LinkPenalty += LINK_MISS_PENALTY;
+		if (u16_LinkPenalty > LINK_PENALTY_MAX)
+		{
+			u16_LinkPenalty = LINK_PENALTY_MAX;
+		}
+	}
+}
+#endif
+
 /***************************************************************************//**
  *   @brief 	This function manages the transmission in DBPSK to the radio
  *   @param 	message 	is pointer to the data buffer that is be modulated and sent
  *   @param 	size 		is number of bytes to send
  *   @return  	error code ::SFX_error_t
+ *
+ *   @note		The symbols are modulated from the bit rate timer interrupt,
+ *   			the CPU stays in LPM0 until the end of the frame.
+ *   			With TX_POLLING_ENGINE, the symbols are modulated from this
+ *   			function, polling the state set by the timer interrupt.
  *******************************************************************************/
+#if defined(TX_POLLING_ENGINE)
 SFX_error_t
 sfx_send(u8 *message, u8 size)
 {
 	uint8 End_Transmission = FALSE;
 	u8 marcStatus;
+
+	if (size > TX_MAX_FRAME_SIZE)
+	{
+		return SFX_ERR_SIZE;
+	}
+
+	// Commit a new sequence number before it goes on air
+	if (b_NvSeqDirty)
+	{
+		sfx_nv_mem_flush();
+	}
+
 	SysState = TxStart;
 
 	// Loop till the end of the transmission. Symbols are sent when interrupt is asserted.
@@ -395,7 +880,12 @@ sfx_send(u8 *message, u8 size)
 		switch(SysState)
 		{
 			case TxStart:
-				TxInit();
+				TxInit(message, size);
+
+#ifdef RADIO_LBT
+				// Listen before talk, the frame goes out even on a busy channel
+				RADIO_lbt();
+#endif
 
 				// Power up the radio
 				RADIO_start_rf_carrier();
@@ -416,13 +906,18 @@ sfx_send(u8 *message, u8 size)
 
 			case TxProcessing:
 				// Modulate the TX packet
-				if(TxProcess(message, size) == 1)
+				switch (TxProcess())
 				{
+				case E_TX_END:
 					SysState = TxEnd;
-				}
-				else
-				{
+					break;
+				case E_TX_MODULATE:
+					SysState = TxWaiting;
+					TxModulate();
+					break;
+				default:
 					SysState = TxWaiting;
+					break;
 				}
 				break;
 
@@ -430,6 +925,9 @@ sfx_send(u8 *message, u8 size)
 				// End of the transmission. Disable the timer interrupt
 				TIMER_bitrate_stop();
 
+				// Let the last modulation complete before ramping down
+				while(RADIO_modulation_busy());
+
 				// Power down the radio
 				RADIO_stop_rf_carrier();
 				End_Transmission = TRUE;
@@ -442,6 +940,72 @@ sfx_send(u8 *message, u8 size)
 	}
 	return SFX_ERR_NONE;
 }
+#else
+SFX_error_t
+sfx_send(u8 *message, u8 size)
+{
+	u8 marcStatus;
+
+	if (size > TX_MAX_FRAME_SIZE)
+	{
+		return SFX_ERR_SIZE;
+	}
+
+	// Commit a new sequence number before it goes on air
+	if (b_NvSeqDirty)
+	{
+		sfx_nv_mem_flush();
+	}
+
+	TxInit(message, size);
+
+#ifdef RADIO_LBT
+	// Listen before talk, the frame goes out even on a busy channel
+	RADIO_lbt();
+#endif
+
+	// Power up the radio
+	RADIO_start_rf_carrier();
+
+	// Start the bitrate timer. Symbols are sent from the timer interrupt.
+	SysState = TxWaiting;
+	TIMER_bitrate_start();
+	cc112xSpiReadReg(CC112X_MARCSTATE, &marcStatus, 1);
+
+	// Sleep till the end of the transmission, TIMER1_A0_ISR wakes the CPU up
+	// for each '0' bit. Interrupts are disabled while testing the state so
+	// the wake-up cannot be missed, and enabled while modulating so the
+	// next bit interrupts are taken on time.
+	__disable_interrupt();
+	while(SysState != TxEnd)
+	{
+		if (SysState == TxProcessing)
+		{
+			SysState = TxWaiting;
+			__enable_interrupt();
+			TxModulate();
+		}
+		else
+		{
+			__bis_SR_register(LPM0_bits + GIE);
+		}
+		__disable_interrupt();
+	}
+	__enable_interrupt();
+
+	// End of the transmission. Disable the timer interrupt
+	TIMER_bitrate_stop();
+
+	// Let the last modulation complete before ramping down
+	while(RADIO_modulation_busy());
+
+	// Power down the radio
+	RADIO_stop_rf_carrier();
+	SysState = IdleState;
+
+	return SFX_ERR_NONE;
+}
+#endif
 
 
 
@@ -455,10 +1019,8 @@ sfx_send(u8 *message, u8 size)
 void
 sfx_StopRxTimeout(void)
 {
-	// Reset the timeout value
-	TIMER0_timeout = FALSE;
-
-	TA0CTL &= ~MC_1;
+	// Reset the timeout value and stop the interrupt
+	TIMER_downlink_timing_stop();
 }
 
 /***************************************************************************//**
@@ -478,28 +1040,79 @@ sfx_StartWaitingTimeout(u16 time_in_seconds)
 /***************************************************************************//**
  *   @brief  	This Function waits (20s) before the RX Window
  *           	If there are additionnal handling to be executed for the application,
- *           	this can be done in this function.
+ *           	it is run by the hook registered with sfx_set_wait_hook().
+ *   @note		The CPU sleeps in LPM3 during the wait, see sfx_wait_downlink()
  *   @return  	error code ::SFX_error_t
  *******************************************************************************/
 SFX_error_t
 sfx_WaitForTimeoutRx(void)
 {
 	// Need to wait for the time set in sfx_StartWaitingTimeout
-	while( TIMER0_timeout == FALSE )
-	{
-		// Loop until timeout
-	}
-
-	// Reset the timeout value
-	TIMER0_timeout = FALSE;
+	sfx_wait_downlink(FALSE);
 
-	// Stop the interrupt
-	TA0CTL &= ~MC_1;
+	// Reset the timeout value and stop the interrupt
+	TIMER_downlink_timing_stop();
 
 	return SFX_ERR_NONE;
 }
 
 
+/***************************************************************************//**
+ *   @brief  	Registers the application work run during the downlink waits
+ *   @note		The hook is called after each wake-up of the CPU: once a
+ *   			second, and on the other interrupts. It runs with the
+ *   			interrupts enabled and must return within a few ms: a frame
+ *   			received meanwhile is read after it.
+ *   @param  	hook 			is the function to call, NULL for none
+ *******************************************************************************/
+void
+sfx_set_wait_hook(SfxWaitHook hook)
+{
+	WaitHook = hook;
+}
+
+
+/***************************************************************************//**
+ *   @brief  	Waits in LPM3 for the downlink timeout, or a received frame
+ *   @note		Timer0 wakes the CPU up each second, the radio GPIO on a
+ *   			frame. The time slept and awake is accounted, see
+ *   			TIMER_wait_stats().
+ *   @param  	b_Frame 		is TRUE to end the wait on a received frame
+ *******************************************************************************/
+static void
+sfx_wait_downlink(u8 b_Frame)
+{
+	uint16 istate;
+	uint32 ul_Start;
+	uint32 ul_Since;
+	uint32 ul_Slept = 0;
+
+	istate = __get_interrupt_state();
+	__disable_interrupt();
+
+	ul_Start = TIMER_timebase_get();
+	while ((TIMER0_timeout == FALSE) && !(b_Frame && (packetSemaphore != ISR_IDLE)))
+	{
+		ul_Since = TIMER_timebase_get();
+		// GIE and LPM3 are set together, the interrupt cannot be missed
+		__bis_SR_register(LPM3_bits + GIE);
+		__disable_interrupt();
+		ul_Slept += TIMER_timebase_get() - ul_Since;
+
+		if ((WaitHook != NULL) && (TIMER0_timeout == FALSE)
+				&& !(b_Frame && (packetSemaphore != ISR_IDLE)))
+		{
+			__enable_interrupt();
+			WaitHook(TIMER_downlink_left());
+			__disable_interrupt();
+		}
+	}
+	TIMER_wait_done(TIMER_timebase_get() - ul_Start, ul_Slept);
+
+	__set_interrupt_state(istate);
+}
+
+
 /***************************************************************************//**
  *   @brief 	This function returns the RSSI value from the last Rx frame
  *   @return 	\b Rssi value coded on a signed integer (with cc112x offset).
@@ -526,102 +1139,60 @@ sfx_StartRxTimeout(u16 WindowTime)
 
 /***************************************************************************//**
  *   @brief  	This function is dedicated to the reception of SigFox frame.
- *           	It loops on the frame reception signal and check that received frame
+ *           	It sleeps till the frame reception signal and check that received frame
  *           	is for our device.
+ *   @note		The frames are queued by the RX interrupt, see RADIO_rx_pop():
+ *   			the frames received while the library checks the previous
+ *   			one are returned by the next calls.
  *   @param  	frame 			is the buffer allocated to the reception of a frame
  *   @return 	Waiting Status ::SFX_ext_status
  *******************************************************************************/
 SFX_ext_status
 sfx_waitframe(u8 *frame)
 {
-	uint8 rxlastindex;
-	uint8 marcStatus;
+	RadioRxFrame_t rx;
 	SFX_ext_status status = E_FRAME_ERROR;
 
-	// Set radio in RX
-	trxSpiCmdStrobe(CC112X_SRX);
+	// Set radio in RX, unless it already is
+	RADIO_start_rx();
 
-	while ((packetSemaphore == ISR_IDLE ) && (TIMER0_timeout == FALSE ))
-	{
-		_NOP();// Loop - wait for the packet to be received or TIMER0 timeout
-	}
+	// Wait for the packet to be received or TIMER0 timeout
+	sfx_wait_downlink(TRUE);
 
 	// If a Sigfox frame has been received
-	if ( packetSemaphore == ISR_ACTION_REQUIRED)
+	if (RADIO_rx_pop(&rx) == true)
 	{
-		unsigned char ii;
-		unsigned char rx_last;
-
-		// Read number of bytes in rx fifo
-		/* IMPORTANT NOTE : using the register CC112X_NUM_RXBYTES gives wrong values concerning the packet length
-		 * DO NOT USE THIS REGISTER, use RXLAST instead which give the last index in the RX FIFO
-		 * and flush the FIFO after reading it   */
-		rxlastindex = 0;
-
-		// Read 3 times to get around a bug
-		for (ii=0; ii<3; ii++)
-		{
-			cc112xSpiReadReg(CC112X_RXLAST, &rx_last, 1);
-			rxlastindex |= rx_last;
-		}
+		// The frame, then the RSSI and CRC status bytes
+		memcpy(frame, rx.au8_Data, RADIO_RX_FRAME_SIZE);
 
-		// Check that we have bytes in fifo
-		if(rxlastindex != 0)
+		// Check CRC ok (CRC_OK: bit7 in second status byte)
+		// This assumes status bytes are appended in RX_FIFO (PKT_CFG1.APPEND_STATUS = 1.)
+		// If CRC is disabled the CRC_OK field will read 1
+		if (rx.b_CrcOk == true)
 		{
-			// Read marcstate to check for RX FIFO error
-			cc112xSpiReadReg(CC112X_MARCSTATE, &marcStatus, 1);
-
-			// Mask out marcstate bits and check if we have a RX FIFO error
-			if((marcStatus & 0x1F) == RX_FIFO_ERROR)
-			{
-				// Flush RX Fifo
-				trxSpiCmdStrobe(CC112X_SFRX);
-
-				status = E_FRAME_ERROR;
-			}
-			// No RX FIFO error
-			else
-			{
-				// Sigfox packet length is 16 bytes. Anything else after that in RXFIFO is useless.
-				if(rxlastindex>=16)
-				{
-					rxlastindex = 16;
-				}
-
-				// Read from RX FIFO
-				cc112xSpiReadRxFifo(frame, rxlastindex+1);
-				cc112xSpiReadReg(CC112X_MARCSTATE, &marcStatus, 1);
-
-				// Once read, Flush RX Fifo
-				trxSpiCmdStrobe(CC112X_SFRX);
-
-				// Check CRC ok (CRC_OK: bit7 in second status byte)
-				// This assumes status bytes are appended in RX_FIFO (PKT_CFG1.APPEND_STATUS = 1.)
-				// If CRC is disabled the CRC_OK field will read 1
-				if(frame[rxlastindex] & 0x80)
-				{
-					// Extract the RSSI value
-					RSSI = frame[15];
-				}
-
-				status = E_FRAME_RECEIVED;
-			}
+			// Extract the RSSI value
+			RSSI = (u8)rx.s8_Rssi;
+#ifdef RADIO_XTAL_COMP
+			// Learn the XTAL error from the frequency offset of the frame
+			RADIO_xtal_learn(*RxCF, rx.s16_FreqOff);
+#endif
 		}
 
-		// Reset packet semaphore
-		packetSemaphore = ISR_IDLE;
-
-		// Go back to receive mode
-		trxSpiCmdStrobe(CC112X_SRX);
-
+		status = E_FRAME_RECEIVED;
 	}
 	else if ( TIMER0_timeout == TRUE )
 	{
-		// Reset the timeout value
-		TIMER0_timeout = FALSE;
+		// Reset the timeout value and stop the interrupt
+		TIMER_downlink_timing_stop();
+		RADIO_rx_timeout();
+#ifdef LINK_ADAPT
+		b_LinkMiss = TRUE;
+#endif
 
-		// Stop the interrupt
-		TA0CTL &= ~MC_1;
+#ifdef RADIO_XTAL_COMP
+		// The next windows search around the XTAL correction
+		RADIO_xtal_miss();
+#endif
 
 		status = E_FRAME_TIMEOUT;
 	}
@@ -683,6 +1254,33 @@ sfx_PrintRxTestResult(u8* ReplyForm, u8 RssiValue)
 }
 
 
+#if defined(NVM_LOW_VOLTAGE_FLUSH) && defined(__MSP430_HAS_PMM__)
+/***************************************************************************//**
+*   @brief  System NMI interrupt : the supply dropped below the SVM high side
+*           level, the NonVRam cache is written to flash while it still can.
+*   @note   The interrupt stays disabled till the next reset. A flash
+*           operation of the application is not interrupted: the cache
+*           then goes to flash at the next commit.
+*******************************************************************************/
+#pragma vector=SYSNMI_VECTOR
+__interrupt void
+SYSNMI_ISR(void)
+{
+	if (SYSSNIV == SYSSNIV_SVMHIFG)
+	{
+		PMMCTL0_H = PMMPW_H;
+		PMMRIE &= ~SVMHIE;
+		PMMCTL0_H = 0x00;
+
+		if (!b_NvBusy)
+		{
+			sfx_nv_mem_flush();
+		}
+	}
+}
+#endif
+
+
 /**************************************************************************//**
  * Close the Doxygen group.
  * @}
@@ -0,0 +1,109 @@
+//*****************************************************************************
+//! @file       driverlib.h
+//! @brief      Host shim of the MSP430 DriverLib: the ADC12_A, REF, DMA and
+//!				TLV calls of adc.c, with the values of the target headers.
+//!				A test linking adc.c gives the functions, see test_adc.c.
+//****************************************************************************/
+#ifndef SIM_DRIVERLIB_H
+#define SIM_DRIVERLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+ * DEFINES
+ */
+/* ADC12_A */
+#define ADC12_A_BASE						(0x0700)
+#define ADC12_A_SAMPLEHOLDSOURCE_SC			(0x0000)
+#define ADC12_A_CLOCKSOURCE_ADC12OSC		(0x0000)
+#define ADC12_A_CLOCKDIVIDER_1				(0x0000)
+#define ADC12_A_CYCLEHOLD_16_CYCLES			(0x0200)
+#define ADC12_A_CYCLEHOLD_256_CYCLES		(0x0800)
+#define ADC12_A_MULTIPLESAMPLESENABLE		(0x0080)
+#define ADC12_A_VREFPOS_INT					(0x10)
+#define ADC12_A_VREFNEG_AVSS				(0x00)
+#define ADC12_A_NOTENDOFSEQUENCE			(0x00)
+#define ADC12_A_ENDOFSEQUENCE				(0x80)
+#define ADC12_A_INPUT_TEMPSENSOR			(0x0A)
+#define ADC12_A_INPUT_BATTERYMONITOR		(0x0B)
+#define ADC12_A_MEMORY_7					(0x7)
+#define ADC12_A_MEMORY_8					(0x8)
+#define ADC12_A_REPEATED_SINGLECHANNEL		(0x0004)
+#define ADC12_A_REPEATED_SEQOFCHANNELS		(0x0006)
+#define ADC12_A_PREEMPTCONVERSION			true
+#define ADC12IFG7							(0x0080)
+#define ADC12IFG8							(0x0100)
+
+/* REF */
+#define REF_BASE							(0x01B0)
+#define REF_VREF2_0V						(0x0010)
+
+/* DMA */
+#define DMA_CHANNEL_1						(0x10)
+#define DMA_CHANNEL_2						(0x20)
+#define DMA_TRIGGERSOURCE_24				(0x18)
+#define DMA_TRANSFER_SINGLE					(0x0000)
+#define DMA_SIZE_SRCWORD_DSTWORD			(0x00)
+#define DMA_TRIGGER_RISINGEDGE				(0x00)
+#define DMA_DIRECTION_UNCHANGED				(0x0000)
+#define DMA_DIRECTION_INCREMENT				(0x0300)
+
+/* TLV */
+#define TLV_TAG_ADC12CAL					(0x11)
+#define TLV_TAG_REFCAL						(0x12)
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct ADC12_A_configureMemoryParam
+{
+	uint8_t memoryBufferControlIndex;
+	uint8_t inputSourceSelect;
+	uint8_t positiveRefVoltageSourceSelect;
+	uint8_t negativeRefVoltageSourceSelect;
+	uint8_t endOfSequence;
+}ADC12_A_configureMemoryParam;
+
+typedef struct DMA_initParam
+{
+	uint8_t channelSelect;
+	uint16_t transferModeSelect;
+	uint16_t transferSize;
+	uint8_t triggerSourceSelect;
+	uint8_t transferUnitSelect;
+	uint8_t triggerTypeSelect;
+}DMA_initParam;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+bool ADC12_A_init(uint16_t baseAddress, uint16_t sampleHoldSignalSourceSelect, uint8_t clockSourceSelect,
+				  uint16_t clockSourceDivider);
+void ADC12_A_enable(uint16_t baseAddress);
+void ADC12_A_setupSamplingTimer(uint16_t baseAddress, uint16_t clockCycleHoldCountLowMem,
+								uint16_t clockCycleHoldCountHighMem, uint16_t multipleSamplesEnabled);
+void ADC12_A_configureMemory(uint16_t baseAddress, ADC12_A_configureMemoryParam *param);
+void ADC12_A_clearInterrupt(uint16_t baseAddress, uint16_t memoryInterruptFlagMask);
+void ADC12_A_startConversion(uint16_t baseAddress, uint16_t startingMemoryBufferIndex,
+							 uint8_t conversionSequenceModeSelect);
+void ADC12_A_disableConversions(uint16_t baseAddress, bool preempt);
+uint32_t ADC12_A_getMemoryAddressForDMA(uint16_t baseAddress, uint8_t memoryIndex);
+
+void Ref_setReferenceVoltage(uint16_t baseAddress, uint8_t referenceVoltageSelect);
+void Ref_enableTempSensor(uint16_t baseAddress);
+void Ref_enableReferenceVoltage(uint16_t baseAddress);
+void Ref_disableReferenceVoltage(uint16_t baseAddress);
+
+void DMA_init(DMA_initParam *param);
+void DMA_setTransferSize(uint8_t channelSelect, uint16_t transferSize);
+void DMA_setSrcAddress(uint8_t channelSelect, uint32_t srcAddress, uint16_t directionSelect);
+void DMA_setDstAddress(uint8_t channelSelect, uint32_t dstAddress, uint16_t directionSelect);
+void DMA_enableTransfers(uint8_t channelSelect);
+void DMA_disableTransfers(uint8_t channelSelect);
+void DMA_enableInterrupt(uint8_t channelSelect);
+void DMA_clearInterrupt(uint8_t channelSelect);
+
+void TLV_getInfo(uint8_t tag, uint8_t instance, uint8_t *length, uint16_t **data_address);
+
+#endif // SIM_DRIVERLIB_H
@@ -0,0 +1,31 @@
+//*****************************************************************************
+//! @file       hal_spi_rf_trxeb.h
+//! @brief      Host shim of the radio SPI macros. The target header is
+//!				used as is, the USCI_B0 accesses of its macros go to the
+//!				CC112x model of sim_cc112x.c.
+//****************************************************************************/
+#ifndef SIM_HAL_SPI_RF_TRXEB_H
+#define SIM_HAL_SPI_RF_TRXEB_H
+
+#include "../../../components/targets/trxeb_msp430f5438a/hal_spi_rf_trxeb.h"
+
+void sim_spi_begin(void);
+void sim_spi_tx(unsigned char byte);
+unsigned char sim_spi_rx(void);
+void sim_spi_end(void);
+
+#undef TRXEM_SPI_BEGIN
+#undef TRXEM_SPI_TX
+#undef TRXEM_SPI_WAIT_DONE
+#undef TRXEM_SPI_WAIT_TX_DONE
+#undef TRXEM_SPI_RX
+#undef TRXEM_SPI_END
+
+#define TRXEM_SPI_BEGIN()				sim_spi_begin()
+#define TRXEM_SPI_TX(x)					sim_spi_tx(x)
+#define TRXEM_SPI_WAIT_DONE()			st( ; )
+#define TRXEM_SPI_WAIT_TX_DONE()		st( ; )
+#define TRXEM_SPI_RX()					sim_spi_rx()
+#define TRXEM_SPI_END()					sim_spi_end()
+
+#endif // SIM_HAL_SPI_RF_TRXEB_H
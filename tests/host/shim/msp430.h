@@ -0,0 +1,195 @@
+//*****************************************************************************
+//! @file       msp430.h
+//! @brief      Host shim of the MSP430F5529 device header.
+//!				The peripheral registers are plain variables of sim_mcu.c,
+//!				the intrinsics and the counters of the timers call the MCU
+//!				model of sim/sim.h, which advances a virtual MCLK.
+//!
+//! @note		The host is LP64: \c int is 32-bit and \c long 64-bit. The
+//!				tests check the ranges where the 16/32-bit arithmetic of
+//!				the MSP430 matters.
+//****************************************************************************/
+#ifndef SIM_MSP430_H
+#define SIM_MSP430_H
+
+#include <stdint.h>
+
+/******************************************************************************
+ * MODEL ENTRY POINTS
+ */
+void sim_delay_cycles(unsigned long cycles);
+void sim_nop(void);
+unsigned short sim_get_interrupt_state(void);
+void sim_set_interrupt_state(unsigned short state);
+void sim_bis_sr(unsigned short bits);
+void sim_bic_sr(unsigned short bits);
+void sim_bic_sr_on_exit(unsigned short bits);
+void sim_data16_write_addr(unsigned short reg, unsigned long value);
+volatile unsigned int *sim_timer_counter(int timer);
+unsigned int sim_timer_iv(int timer);
+unsigned int sim_dma_iv(void);
+volatile unsigned int *sim_rtc_counter(int high);
+volatile unsigned int *sim_flash_ctl3(void);
+
+/******************************************************************************
+ * INTRINSICS
+ */
+#define __interrupt
+#define __delay_cycles(x)				sim_delay_cycles(x)
+#define __no_operation()				sim_nop()
+#define _NOP()							sim_nop()
+#define NOP()							sim_nop()
+#define __get_interrupt_state()			sim_get_interrupt_state()
+#define __set_interrupt_state(x)		sim_set_interrupt_state(x)
+#define __disable_interrupt()			sim_bic_sr(GIE)
+#define __enable_interrupt()			sim_bis_sr(GIE)
+#define _BIS_SR(x)						sim_bis_sr(x)
+#define __bis_SR_register(x)			sim_bis_sr(x)
+#define __bic_SR_register(x)			sim_bic_sr(x)
+#define __bic_SR_register_on_exit(x)	sim_bic_sr_on_exit(x)
+#define __low_power_mode_off_on_exit()	sim_bic_sr_on_exit(LPM4_bits)
+#define __even_in_range(x, y)			(x)
+#define __data16_write_addr(a, v)		sim_data16_write_addr((unsigned short)(a), (unsigned long)(v))
+
+/******************************************************************************
+ * REGISTERS
+ */
+#define SIM_REG(name)					extern volatile unsigned int name;
+#include "msp430_regs.h"
+#undef SIM_REG
+
+/* Source and destination address of the DMA channels, wide enough for a host pointer */
+extern volatile unsigned long DMA0SA, DMA0DA, DMA1SA, DMA1DA, DMA2SA, DMA2DA;
+
+/* Registers read from the model */
+#define SIM_TA0							0
+#define SIM_TA1							1
+#define SIM_TB0							2
+#define TA0R							(*sim_timer_counter(SIM_TA0))
+#define TA1R							(*sim_timer_counter(SIM_TA1))
+#define TB0R							(*sim_timer_counter(SIM_TB0))
+#define TA0IV							sim_timer_iv(SIM_TA0)
+#define TA1IV							sim_timer_iv(SIM_TA1)
+#define TB0IV							sim_timer_iv(SIM_TB0)
+#define DMAIV							sim_dma_iv()
+#define RTCNT12							(*sim_rtc_counter(0))
+#define RTCNT34							(*sim_rtc_counter(1))
+#define FCTL3							(*sim_flash_ctl3())
+
+/******************************************************************************
+ * BITS
+ */
+#define BIT0							(0x0001)
+#define BIT1							(0x0002)
+#define BIT2							(0x0004)
+#define BIT3							(0x0008)
+#define BIT4							(0x0010)
+#define BIT5							(0x0020)
+#define BIT6							(0x0040)
+#define BIT7							(0x0080)
+#define BIT8							(0x0100)
+#define BIT9							(0x0200)
+#define BITA							(0x0400)
+#define BITB							(0x0800)
+#define BITC							(0x1000)
+#define BITD							(0x2000)
+#define BITE							(0x4000)
+#define BITF							(0x8000)
+
+/* Status register */
+#define GIE								(0x0008)
+#define CPUOFF							(0x0010)
+#define OSCOFF							(0x0020)
+#define SCG0							(0x0040)
+#define SCG1							(0x0080)
+#define LPM0_bits						(CPUOFF)
+#define LPM1_bits						(SCG0+CPUOFF)
+#define LPM2_bits						(SCG1+CPUOFF)
+#define LPM3_bits						(SCG1+SCG0+CPUOFF)
+#define LPM4_bits						(SCG1+SCG0+OSCOFF+CPUOFF)
+
+/* Watchdog */
+#define WDTPW							(0x5A00)
+#define WDTHOLD							(0x0080)
+
+/* Timer_A / Timer_B */
+#define TASSEL_1						(0x0100)
+#define TASSEL_2						(0x0200)
+#define TBSSEL_1						(0x0100)
+#define TBSSEL_2						(0x0200)
+#define ID_0							(0x0000)
+#define ID_1							(0x0040)
+#define ID_2							(0x0080)
+#define ID_3							(0x00C0)
+#define MC_0							(0x0000)
+#define MC_1							(0x0010)
+#define MC_2							(0x0020)
+#define MC_3							(0x0030)
+#define MC__STOP						(MC_0)
+#define MC__UP							(MC_1)
+#define MC__CONTINUOUS					(MC_2)
+#define TACLR							(0x0004)
+#define TBCLR							(0x0004)
+#define TAIE							(0x0002)
+#define TAIFG							(0x0001)
+#define CCIE							(0x0010)
+#define CCIFG							(0x0001)
+#define TA0IV_NONE						(0x0000)
+#define TA0IV_TA0CCR1					(0x0002)
+#define TA0IV_TA0CCR2					(0x0004)
+#define TA0IV_TA0IFG					(0x000E)
+
+/* RTC_A */
+#define RTCHOLD							(0x4000)
+#define RTCSSEL_0						(0x0000)
+#define RTCTEV_3						(0x0300)
+
+/* USCI */
+#define UCSWRST							(0x01)
+#define UCSSEL_2						(0x80)
+#define UCCKPH							(0x80)
+#define UCMSB							(0x20)
+#define UCMST							(0x08)
+#define UCMODE_0						(0x00)
+#define UCSYNC							(0x01)
+#define UCRXIFG							(0x01)
+#define UCTXIFG							(0x02)
+#define UCBUSY							(0x01)
+
+/* DMA */
+#define DMAEN							(0x0010)
+#define DMAIFG							(0x0008)
+#define DMAIE							(0x0004)
+#define DMADT_0							(0x0000)
+#define DMASRCINCR_0					(0x0000)
+#define DMASRCINCR_2					(0x0200)
+#define DMASRCINCR_3					(0x0300)
+#define DMADSTINCR_0					(0x0000)
+#define DMADSTINCR_3					(0x0C00)
+#define DMASRCBYTE						(0x0040)
+#define DMADSTBYTE						(0x0080)
+#define DMAIV_NONE						(0x0000)
+#define DMAIV_DMA0IFG					(0x0002)
+#define DMAIV_DMA1IFG					(0x0004)
+#define DMAIV_DMA2IFG					(0x0006)
+
+/* Flash controller */
+#define FWKEY							(0xA500)
+#define ERASE							(0x0002)
+#define WRT								(0x0040)
+#define BLKWRT							(0x0080)
+#define LOCK							(0x0010)
+#define BUSY							(0x0001)
+
+/* REF / PMM */
+#define __MSP430_HAS_PMM__
+#define REFMSTR							(0x0080)
+#define REFON							(0x0001)
+#define SVSHIE							(0x1000)
+#define SVSHIFG							(0x0008)
+#define PMMPW_H							(0xA5)
+#define SVMHIE							(0x0020)
+#define SVMHIFG							(0x0020)
+#define SYSSNIV_SVMHIFG					(0x0004)
+
+#endif // SIM_MSP430_H
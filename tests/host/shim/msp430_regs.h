@@ -0,0 +1,113 @@
+//*****************************************************************************
+//! @file       msp430_regs.h
+//! @brief      Registers of the host shim, see msp430.h. Each SIM_REG()
+//!				is a variable of sim_mcu.c.
+//****************************************************************************/
+/* Watchdog, special functions */
+SIM_REG(WDTCTL)
+SIM_REG(SFRIE1)
+SIM_REG(SFRIFG1)
+SIM_REG(SYSSNIV)
+SIM_REG(SVSMHCTL)
+SIM_REG(PMMIFG)
+SIM_REG(PMMRIE)
+SIM_REG(PMMCTL0)
+SIM_REG(PMMCTL0_H)
+
+/* Ports */
+SIM_REG(P1IN)
+SIM_REG(P1OUT)
+SIM_REG(P1DIR)
+SIM_REG(P1SEL)
+SIM_REG(P1IE)
+SIM_REG(P1IES)
+SIM_REG(P1IFG)
+SIM_REG(P2IN)
+SIM_REG(P2OUT)
+SIM_REG(P2DIR)
+SIM_REG(P2SEL)
+SIM_REG(P2IE)
+SIM_REG(P2IES)
+SIM_REG(P2IFG)
+SIM_REG(P3IN)
+SIM_REG(P3OUT)
+SIM_REG(P3DIR)
+SIM_REG(P3SEL)
+SIM_REG(P4OUT)
+SIM_REG(P4DIR)
+SIM_REG(P5OUT)
+SIM_REG(P5DIR)
+SIM_REG(P8OUT)
+SIM_REG(P8DIR)
+SIM_REG(P8SEL)
+
+/* Timer0_A5: ACLK time outs and delays */
+SIM_REG(TA0CTL)
+SIM_REG(TA0CCTL0)
+SIM_REG(TA0CCTL1)
+SIM_REG(TA0CCTL2)
+SIM_REG(TA0CCR0)
+SIM_REG(TA0CCR1)
+SIM_REG(TA0CCR2)
+
+/* Timer1_A3: bit rate */
+SIM_REG(TA1CTL)
+SIM_REG(TA1CCTL0)
+SIM_REG(TA1CCTL1)
+SIM_REG(TA1CCTL2)
+SIM_REG(TA1CCR0)
+SIM_REG(TA1CCR1)
+SIM_REG(TA1CCR2)
+
+/* Timer0_B7: modulation timing, DMA pacing, hardware ramps */
+SIM_REG(TB0CTL)
+SIM_REG(TB0CCTL0)
+SIM_REG(TB0CCTL1)
+SIM_REG(TB0CCTL2)
+SIM_REG(TB0CCR0)
+SIM_REG(TB0CCR1)
+SIM_REG(TB0CCR2)
+
+/* RTC_A counter mode */
+SIM_REG(RTCCTL01)
+
+/* USCI_B0: radio SPI */
+SIM_REG(UCB0CTL0)
+SIM_REG(UCB0CTL1)
+SIM_REG(UCB0BR0)
+SIM_REG(UCB0BR1)
+SIM_REG(UCB0STAT)
+SIM_REG(UCB0TXBUF)
+SIM_REG(UCB0RXBUF)
+SIM_REG(UCB0IE)
+SIM_REG(UCB0IFG)
+
+/* DMA */
+SIM_REG(DMACTL0)
+SIM_REG(DMACTL1)
+SIM_REG(DMACTL2)
+SIM_REG(DMACTL4)
+SIM_REG(DMA0CTL)
+SIM_REG(DMA0SZ)
+SIM_REG(DMA1CTL)
+SIM_REG(DMA1SZ)
+SIM_REG(DMA2CTL)
+SIM_REG(DMA2SZ)
+
+/* Flash controller */
+SIM_REG(FCTL1)
+SIM_REG(FCTL4)
+
+/* REF, ADC12_A */
+SIM_REG(REFCTL0)
+SIM_REG(ADC12CTL0)
+SIM_REG(ADC12CTL1)
+SIM_REG(ADC12CTL2)
+SIM_REG(ADC12IFG)
+SIM_REG(ADC12IE)
+SIM_REG(ADC12MEM7)
+SIM_REG(ADC12MEM8)
+
+/* Clock system */
+SIM_REG(UCSCTL4)
+SIM_REG(UCSCTL5)
@@ -0,0 +1,14 @@
+//*****************************************************************************
+//! @file       stdlib.h
+//! @brief      Host shim of the C library header: the one of the build
+//!				machine, with the ltoa() of the TI run-time library that
+//!				host_cmd.c and manufacturer_api.c call, see sim_board.c.
+//****************************************************************************/
+#ifndef SIM_STDLIB_H
+#define SIM_STDLIB_H
+
+#include_next <stdlib.h>
+
+int ltoa(long val, char *buffer);
+
+#endif // SIM_STDLIB_H
@@ -0,0 +1,173 @@
+//*****************************************************************************
+//! @file       sim.h
+//! @brief      Host model of the board, for the tests of tests/host.
+//!       \li \e sim_mcu.c    virtual MCLK, interrupts and low power modes,
+//!                           Timer_A/B, RTC_A counter and DMA channel 0
+//!       \li \e sim_cc112x.c CC112x register file, strobes and states, fed
+//!                           by the SPI macros of shim/hal_spi_rf_trxeb.h
+//!       \li \e sim_flash.c  flash controller, with power cuts
+//!       \li \e sim_board.c  weak stand-ins of the board functions the
+//!                           sources under test call but do not link, the
+//!                           variables of sigfox_demo.c and random numbers
+//!
+//! @note		Time only moves in the model: SPI bytes, __delay_cycles(),
+//!				spin loop iterations and reads of the counters cost MCLK
+//!				cycles, the low power modes jump to the next event. The
+//!				cycle counts are estimates of the MSP430 code, the tests
+//!				compare paths against each other with the same costs.
+//****************************************************************************/
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/******************************************************************************
+ * DEFINES
+ */
+#define SIM_MCLK_HZ				24000000UL	// default MCLK = SMCLK, bspInit(BSP_SYS_CLK_24MHZ) of the demo
+#define SIM_ACLK_HZ				32768UL
+
+/* Cycle costs of the model */
+#define SIM_CYCLES_SPIN			4			// one iteration of a __no_operation() loop
+#define SIM_CYCLES_REG_READ		3			// read of a counter, MOV &abs
+#define SIM_CYCLES_CS			4			// chip select edge
+#define SIM_CYCLES_SPI_BYTE_SW	10			// TX, wait and RX of the byte loop, on top of the shift
+#define SIM_CYCLES_ISR			11			// interrupt entry (6) and RETI (5)
+#define SIM_CYCLES_LPM0_WAKE	0			// DCO kept on in LPM0
+#define SIM_CYCLES_LPM3_WAKE	100			// DCO restart from LPM3, about 4 us
+
+/* DMA trigger of Timer_B0 CCR0, MSP430F5529 datasheet */
+#define SIM_DMA_TSEL_TB0CCR0	7
+
+/* CC112x MARC_STATE values */
+#define SIM_MARC_SLEEP			0x00
+#define SIM_MARC_IDLE			0x01
+#define SIM_MARC_XOFF			0x02
+#define SIM_MARC_MANCAL			0x05
+#define SIM_MARC_RX				0x0D
+#define SIM_MARC_RX_FIFO_ERR	0x11
+#define SIM_MARC_FSTXON			0x12
+#define SIM_MARC_TX				0x13
+
+/* Board */
+#define SIM_SEED				0x2545F491u	// seed of sim_uniform() till sim_seed()
+#define SIM_FRAME_SIZE			26			// sim_frame[], longest uplink payload
+
+/* Kinds of the entries of the radio log */
+#define SIM_LOG_WRITE			0			// register written
+#define SIM_LOG_READ			1			// register read
+#define SIM_LOG_STROBE			2			// command strobe
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+/* Interrupt sources, highest priority first */
+typedef enum
+{
+	SIM_IRQ_SYSNMI = 0,
+	SIM_IRQ_TB0_0,
+	SIM_IRQ_TA0_0,
+	SIM_IRQ_TA0_1,
+	SIM_IRQ_DMA,
+	SIM_IRQ_TA1_0,
+	SIM_IRQ_RADIO,
+	SIM_IRQ_USER,				// test-defined source, see sim_user_isr
+	SIM_IRQ_NB
+}te_SimIrq;
+
+typedef struct
+{
+	uint64_t active;			// cycles with the CPU on
+	uint64_t lpm0;				// cycles slept in LPM0
+	uint64_t lpm3;				// cycles slept in LPM3
+	uint64_t isr;				// cycles in interrupt routines
+	unsigned long irq[SIM_IRQ_NB];	// interrupts taken, by source
+}SimCpuStats_t;
+
+typedef struct
+{
+	uint64_t t;					// MCLK cycle of the access
+	uint16_t addr;				// register, or strobe command
+	uint8_t value;				// byte written or read
+	uint8_t kind;				// SIM_LOG_WRITE, SIM_LOG_READ or SIM_LOG_STROBE
+	uint8_t dma;				// written by the DMA
+	uint8_t state;				// MARC_STATE after the access
+}SimRadioLog_t;
+
+typedef struct
+{
+	unsigned long frames;		// chip select frames
+	unsigned long bytes;		// bytes shifted
+	unsigned long strobes;		// command strobes
+	unsigned long writes;		// register bytes written
+	unsigned long reads;		// register bytes read
+	unsigned long overruns;		// DMA bytes written before the previous one was shifted
+	uint64_t busy;				// cycles with the chip select low
+}SimSpiStats_t;
+
+typedef struct
+{
+	unsigned long cals;			// synthesizer calibrations, SCAL and automatic
+	uint64_t cal;				// cycles calibrating
+	uint64_t on;				// cycles with the XOSC on, see sim_radio_on_cycles()
+	unsigned long wakes;		// chip select edges waking the chip from SLEEP or XOFF
+}SimRadioStats_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+extern uint32_t sim_mclk_hz;
+extern SimCpuStats_t sim_cpu;
+extern SimSpiStats_t sim_spi;
+extern SimRadioStats_t sim_radio;
+extern void (*sim_user_isr)(void);
+extern int sim_failures;
+extern uint8_t sim_frame[SIM_FRAME_SIZE];
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+/* MCU */
+void sim_reset(void);
+uint64_t sim_now(void);
+double sim_now_s(void);
+void sim_advance(uint64_t cycles);
+uint32_t sim_aclk_ticks(void);
+void sim_raise(te_SimIrq irq);
+void sim_at(uint64_t t, void (*fn)(void *), void *arg);
+int sim_in_isr(void);
+int sim_gie(void);
+
+/* CC112x */
+void sim_radio_reset(void);
+uint8_t sim_radio_reg(uint16_t addr);
+void sim_radio_set_reg(uint16_t addr, uint8_t value);
+uint8_t sim_radio_state(void);
+void sim_radio_set_rssi(int rssi_dbm, uint64_t valid_cycles);
+void sim_radio_set_cal_us(uint32_t us);
+void sim_radio_rx_frame(const uint8_t *data, unsigned len);
+void sim_radio_irq(void);
+uint64_t sim_radio_on_cycles(void);
+const SimRadioLog_t *sim_radio_log(unsigned long *n);
+void sim_radio_log_clear(void);
+void sim_spi_tx_dma(unsigned char byte);
+
+/* Flash */
+void sim_flash_attach(unsigned int *array, unsigned int words, unsigned int segment_words,
+					  unsigned int *cells);
+void sim_flash_cut_at(long op, void (*cut)(void));
+long sim_flash_ops(void);
+
+/* Board */
+void sim_seed(uint32_t value);
+double sim_uniform(void);
+double sim_gaussian(void);
+
+/* Checks */
+#define SIM_CHECK(cond, ...)	do { if (!(cond)) { sim_failures++;	\
+									printf("FAIL %s:%d: ", __FILE__, __LINE__);	\
+									printf(__VA_ARGS__); printf("\n"); } } while (0)
+int sim_result(const char *name);
+
+#endif // SIM_H
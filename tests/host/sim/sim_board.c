@@ -0,0 +1,215 @@
+//*****************************************************************************
+//! @file       sim_board.c
+//! @brief      Board part of the host model: stand-ins of the functions the
+//!				sources under test call and a test does not link. They are
+//!				weak, a test linking the real module gets the real one.
+//!				The variables of sigfox_demo.c the library and the engines
+//!				use, and the random numbers of the models, are here too.
+//****************************************************************************/
+#include <math.h>
+#include "msp430.h"
+#include "hal_types.h"
+#include "hal_defs.h"
+#include "device_config.h"
+#include "sigfox_demo.h"
+#include "transmission.h"
+#include "adc.h"
+#include "sigfox.h"
+#include "sim.h"
+
+/******************************************************************************
+ * VARIABLES
+ */
+static ISR_FUNC_PTR radio_isr;
+static uint8 radio_int_enabled;
+static uint32_t seed = SIM_SEED;
+
+/******************************************************************************
+ * RANDOM NUMBERS, xorshift32: the runs of a model are the same on every host
+ */
+void sim_seed(uint32_t value)
+{
+	seed = value;
+}
+
+/* Uniform in [0, 1) */
+double sim_uniform(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return (double)seed / 4294967296.0;
+}
+
+/* Normal, mean 0 and standard deviation 1 */
+double sim_gaussian(void)
+{
+	double u = sim_uniform();
+
+	return sqrt(-2.0 * log(1.0 - u)) * cos(2 * M_PI * sim_uniform());
+}
+
+/******************************************************************************
+ * DEMO APPLICATION, see sigfox_demo.c: the frequencies, repeats and id
+ * given to the library
+ */
+__attribute__((weak)) u32 id;
+__attribute__((weak)) u32 TxFrequency = ftx;
+__attribute__((weak)) u32 RxFrequency = frx;
+__attribute__((weak)) u8 TxRep = 2;
+
+__attribute__((weak)) u32 *TxCF = &TxFrequency;
+__attribute__((weak)) u32 *RxCF = &RxFrequency;
+__attribute__((weak)) u8 *TxRepeat = &TxRep;
+
+/* Uplink payload of the tests */
+u8 sim_frame[SIM_FRAME_SIZE];
+
+/******************************************************************************
+ * BSP
+ */
+__attribute__((weak)) uint32 bspSysClockSpeedGet(void)
+{
+	return sim_mclk_hz;
+}
+
+/******************************************************************************
+ * ADC, see adc.c
+ */
+__attribute__((weak)) void ADC_dma_isr(void)
+{
+}
+
+__attribute__((weak)) void ADC_start_idle(void)
+{
+}
+
+__attribute__((weak)) void ADC_arm_tx(void)
+{
+}
+
+__attribute__((weak)) void ADC_start_tx(void)
+{
+}
+
+__attribute__((weak)) const AdcValues_t *ADC_values(void)
+{
+	static const AdcValues_t values;
+
+	return &values;
+}
+
+/******************************************************************************
+ * UART, see uart_drv.c and host_cmd.c
+ */
+__attribute__((weak)) void uartPutStr(char *str, unsigned char length)
+{
+}
+
+__attribute__((weak)) void uartPutChar(char character)
+{
+}
+
+__attribute__((weak)) unsigned char dataToString(unsigned char *data, char *str, unsigned char length)
+{
+	return 0;
+}
+
+/* ltoa() of the TI run-time library */
+__attribute__((weak)) int ltoa(long val, char *buffer)
+{
+	return sprintf(buffer, "%ld", val);
+}
+
+/******************************************************************************
+ * SIGFOX LIBRARY, see sigfox.h: the frames and test modes of the AT
+ * commands of host_cmd.c do nothing
+ */
+__attribute__((weak)) SFX_error_t SfxInit(void)
+{
+	return SFX_ERR_NONE;
+}
+
+__attribute__((weak)) SFX_error_t SfxClose(void)
+{
+	return SFX_ERR_NONE;
+}
+
+__attribute__((weak)) SFX_error_t SfxSendFrame(u8 *customer_data, u8 customer_data_length, u8 *ReturnPayload,
+											   bool ack)
+{
+	return SFX_ERR_NONE;
+}
+
+__attribute__((weak)) SFX_error_t SfxSendBit(bool state, u8 *ReturnPayload, bool ack)
+{
+	return SFX_ERR_NONE;
+}
+
+__attribute__((weak)) void SfxTxTestMode(s16 frame_count, s16 channel)
+{
+}
+
+__attribute__((weak)) void SfxRxTestMode(s16 channel, u16 Sequence_nb, u16 Temps)
+{
+}
+
+/******************************************************************************
+ * TX ENGINE, see manufacturer_api.c and transmission.c
+ */
+#ifdef SysState
+/* SysState of the engines, built with -DSysState=(*sim_sys_state()): a load
+ * and a compare for each access */
+static e_SystemState sys_state;
+
+e_SystemState *sim_sys_state(void)
+{
+	sim_advance(SIM_CYCLES_SPIN);
+	return &sys_state;
+}
+#else
+__attribute__((weak)) e_SystemState SysState;
+#endif
+
+__attribute__((weak)) unsigned char TxProcess(void)
+{
+	return E_TX_END;
+}
+
+/******************************************************************************
+ * RADIO GPIO INTERRUPT, see trx_rf_int.c
+ */
+__attribute__((weak)) void trxIsrConnect(ISR_FUNC_PTR pF)
+{
+	radio_isr = pF;
+}
+
+__attribute__((weak)) void trxEnableInt(void)
+{
+	radio_int_enabled = 1;
+}
+
+__attribute__((weak)) void trxDisableInt(void)
+{
+	radio_int_enabled = 0;
+}
+
+__attribute__((weak)) void trxClearIntFlag(void)
+{
+}
+
+__attribute__((weak)) uint8 trxSampleSyncPin(void)
+{
+	return 0;
+}
+
+/* SIM_IRQ_RADIO: end of a packet on GPIO3, the port ISR of hal_digio2.c
+ * leaves the low power mode */
+void sim_board_radio_isr(void)
+{
+	if (radio_int_enabled && radio_isr)
+	{
+		radio_isr();
+		__low_power_mode_off_on_exit();
+	}
+}
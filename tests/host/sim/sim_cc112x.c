@@ -0,0 +1,524 @@
+//*****************************************************************************
+//! @file       sim_cc112x.c
+//! @brief      CC112x part of the host model: register file, SPI frames,
+//!				command strobes and MARC states, fed by the SPI macros of
+//!				shim/hal_spi_rf_trxeb.h and by the DMA of sim_mcu.c.
+//!
+//! @note		Only what the sources under test look at is modelled:
+//!				the status byte, MARCSTATE, RSSI1/0, RXLAST, NUM_RXBYTES
+//!				and the synthesizer calibration registers. Every access
+//!				is logged with its MCLK cycle.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "cc112x_spi.h"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define SIM_EXT_ADDR			0x2F
+#define SIM_FIFO_ADDR			0x3F
+#define SIM_STROBE_FIRST		0x30
+#define SIM_STROBE_LAST			0x3D
+#define SIM_FIFO_SIZE			128
+#define SIM_CAL_US				750			// SCAL or FS_AUTOCAL, the synthesizer calibration
+#define SIM_XOSC_START_US		300			// CS low from SLEEP, XOFF or SRES
+#define SIM_RSSI_SETTLE_US		1000		// SRX to RSSI_VALID, default settings
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef enum
+{
+	FRAME_IDLE = 0,			// chip select high
+	FRAME_HEADER,			// next byte is a header
+	FRAME_EXT_ADDR,			// next byte is an extended address
+	FRAME_DATA				// next bytes are data
+}te_Frame;
+
+/******************************************************************************
+ * VARIABLES
+ */
+SimSpiStats_t sim_spi;
+SimRadioStats_t sim_radio;
+
+static uint8_t reg8[0x40];
+static uint8_t ext[0x100];
+static uint8_t state;
+static uint8_t pending_off;			// SXOFF / SPWD / SRES, applied on CS high
+static uint64_t cal_end;
+static uint32_t cal_us = SIM_CAL_US;	// see sim_radio_set_cal_us()
+static uint8_t cal_next;				// state at the end of the calibration
+static uint64_t on_since;				// XOSC started
+static uint64_t rssi_valid_at;
+static int rssi_dbm = -120;
+static uint64_t rssi_valid_cycles;
+static uint8_t rx_fifo[SIM_FIFO_SIZE];
+static unsigned rx_len;
+
+static te_Frame frame;
+static uint8_t header;
+static uint16_t addr;
+static uint8_t rx_byte;
+static uint64_t shift_end;				// last DMA byte shifted out
+static uint64_t cs_low_at;
+
+static SimRadioLog_t *log_buf;
+static unsigned long log_len;
+static unsigned long log_size;
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void calibrate(void);
+
+static uint64_t us_to_cycles(uint32_t us)
+{
+	return ((uint64_t)us * sim_mclk_hz) / 1000000UL;
+}
+
+static uint64_t byte_cycles(void)
+{
+	return 8u * ((UCB0BR0 & 0xFF) ? (UCB0BR0 & 0xFF) : 1u);
+}
+
+static void update_state(void)
+{
+	if ((state == SIM_MARC_MANCAL) && (sim_now() >= cal_end))
+	{
+		state = cal_next;
+	}
+}
+
+/* Synthesizer calibration, then the chip goes to next */
+static void calibration_start(uint8_t next)
+{
+	calibrate();
+	state = SIM_MARC_MANCAL;
+	cal_next = next;
+	cal_end = sim_now() + us_to_cycles(cal_us);
+	sim_radio.cals++;
+	sim_radio.cal += us_to_cycles(cal_us);
+}
+
+/* Enters TX, RX or FSTXON: SETTLING_CFG.FS_AUTOCAL = 1 calibrates out of IDLE first */
+static void synthesizer_on(uint8_t next)
+{
+	update_state();
+	if ((state == SIM_MARC_IDLE) && (((reg8[CC112X_SETTLING_CFG] >> 3) & 0x03) == 1))
+	{
+		calibration_start(next);
+	}
+	else if (state == SIM_MARC_MANCAL)
+	{
+		cal_next = next;
+	}
+	else
+	{
+		state = next;
+	}
+}
+
+static void log_add(uint16_t a, uint8_t value, uint8_t kind, uint8_t dma)
+{
+	if (log_len == log_size)
+	{
+		log_size = log_size ? 2 * log_size : 4096;
+		log_buf = realloc(log_buf, log_size * sizeof(SimRadioLog_t));
+		if (log_buf == NULL)
+		{
+			printf("FATAL: radio log\n");
+			exit(2);
+		}
+	}
+	update_state();
+	log_buf[log_len].t = sim_now();
+	log_buf[log_len].addr = a;
+	log_buf[log_len].value = value;
+	log_buf[log_len].kind = kind;
+	log_buf[log_len].dma = dma;
+	log_buf[log_len].state = state;
+	log_len++;
+}
+
+/* Status byte: CHIP_RDYn, STATE[2:0], FIFO bytes */
+static uint8_t status_byte(void)
+{
+	uint8_t s;
+
+	update_state();
+	switch (state)
+	{
+	case SIM_MARC_RX:			s = CC112X_STATE_RX;			break;
+	case SIM_MARC_TX:			s = CC112X_STATE_TX;			break;
+	case SIM_MARC_FSTXON:		s = CC112X_STATE_FSTXON;		break;
+	case SIM_MARC_MANCAL:		s = CC112X_STATE_CALIBRATE;		break;
+	case SIM_MARC_RX_FIFO_ERR:	s = CC112X_STATE_RXFIFO_ERROR;	break;
+	default:					s = CC112X_STATE_IDLE;			break;
+	}
+	return s | (uint8_t)((rx_len > 0x0F) ? 0x0F : rx_len);
+}
+
+static void registers_reset(void)
+{
+	memset(reg8, 0, sizeof(reg8));
+	memset(ext, 0, sizeof(ext));
+	// Reset values the sources depend on
+	ext[CC112X_EXT_CTRL & 0xFF] = 0x01;			// BURST_ADDR_INCR_EN
+	reg8[CC112X_PA_CFG2] = 0x7F;
+	reg8[CC112X_PA_CFG1] = 0x56;
+	reg8[CC112X_PA_CFG0] = 0x7C;
+	reg8[CC112X_SETTLING_CFG] = 0x0B;			// FS_AUTOCAL = 1, IDLE to RX / TX
+	ext[CC112X_FREQ2 & 0xFF] = 0x00;
+	ext[CC112X_FREQOFF1 & 0xFF] = 0x00;
+	ext[CC112X_FREQOFF0 & 0xFF] = 0x00;
+	ext[CC112X_FS_CHP & 0xFF] = 0x28;
+	ext[CC112X_FS_VCO4 & 0xFF] = 0x14;
+	ext[CC112X_FS_VCO2 & 0xFF] = 0x00;
+}
+
+/* FS_CHP / FS_VCO4 / FS_VCO2 a calibration gives for the frequency set */
+static void calibrate(void)
+{
+	uint32_t freq = ((uint32_t)ext[CC112X_FREQ2 & 0xFF] << 16)
+			| ((uint32_t)ext[CC112X_FREQ1 & 0xFF] << 8) | ext[CC112X_FREQ0 & 0xFF];
+
+	ext[CC112X_FS_CHP & 0xFF] = (uint8_t)(0x20 + (freq >> 12) % 0x1F);
+	ext[CC112X_FS_VCO4 & 0xFF] = (uint8_t)(0x10 + (freq >> 8) % 0x0F);
+	ext[CC112X_FS_VCO2 & 0xFF] = (uint8_t)(0x40 + (freq >> 4) % 0x3F);
+}
+
+static void strobe(uint8_t cmd)
+{
+	sim_spi.strobes++;
+	update_state();
+	switch (cmd)
+	{
+	case CC112X_SRES:
+		// The XOSC restarts: the next access waits for it like out of XOFF
+		registers_reset();
+		state = SIM_MARC_IDLE;
+		pending_off = cmd;
+		rx_len = 0;
+		break;
+	case CC112X_SFSTXON:
+		synthesizer_on(SIM_MARC_FSTXON);
+		break;
+	case CC112X_SXOFF:
+	case CC112X_SPWD:
+		pending_off = cmd;
+		break;
+	case CC112X_SCAL:
+		calibration_start(SIM_MARC_IDLE);
+		break;
+	case CC112X_SRX:
+		synthesizer_on(SIM_MARC_RX);
+		rssi_valid_at = ((state == SIM_MARC_MANCAL) ? cal_end : sim_now()) + rssi_valid_cycles;
+		break;
+	case CC112X_STX:
+		synthesizer_on(SIM_MARC_TX);
+		break;
+	case CC112X_SIDLE:
+		state = SIM_MARC_IDLE;
+		break;
+	case CC112X_SFRX:
+		rx_len = 0;
+		if (state == SIM_MARC_RX_FIFO_ERR)
+		{
+			state = SIM_MARC_IDLE;
+		}
+		break;
+	default:
+		break;
+	}
+	log_add(cmd, status_byte(), SIM_LOG_STROBE, 0);
+}
+
+/* Register value at a read, the status registers are computed */
+static uint8_t reg_read(uint16_t a)
+{
+	update_state();
+	if ((a >> 8) == 0)
+	{
+		return reg8[a & 0xFF];
+	}
+	switch (a)
+	{
+	case CC112X_MARCSTATE:
+		return (uint8_t)(0x40 | state);
+	case CC112X_RSSI1:
+		return (uint8_t)(((rssi_dbm + 102) * 16) >> 4);
+	case CC112X_RSSI0:
+		return (uint8_t)(((((rssi_dbm + 102) * 16) & 0x0F) << 3)
+				| (((state == SIM_MARC_RX) && (sim_now() >= rssi_valid_at)) ? 0x01 : 0x00));
+	case CC112X_RXLAST:
+		return (uint8_t)(rx_len ? rx_len - 1 : 0);
+	case CC112X_NUM_RXBYTES:
+		return (uint8_t)rx_len;
+	default:
+		return ext[a & 0xFF];
+	}
+}
+
+static void reg_write(uint16_t a, uint8_t value, uint8_t dma)
+{
+	sim_spi.writes++;
+	if ((a >> 8) == 0)
+	{
+		reg8[a & 0xFF] = value;
+	}
+	else
+	{
+		ext[a & 0xFF] = value;
+	}
+	log_add(a, value, SIM_LOG_WRITE, dma);
+}
+
+/* One byte of a frame, returns the byte shifted back */
+static uint8_t frame_byte(uint8_t b, uint8_t dma)
+{
+	uint8_t out = 0;
+
+	sim_spi.bytes++;
+	switch (frame)
+	{
+	case FRAME_HEADER:
+		header = b;
+		out = status_byte();
+		if ((b & 0x3F) == SIM_EXT_ADDR)
+		{
+			frame = FRAME_EXT_ADDR;
+		}
+		else if (((b & 0x3F) >= SIM_STROBE_FIRST) && ((b & 0x3F) <= SIM_STROBE_LAST) && !(b & 0x40))
+		{
+			strobe(b & 0x3F);
+			frame = FRAME_HEADER;
+		}
+		else
+		{
+			addr = b & 0x3F;
+			frame = FRAME_DATA;
+		}
+		break;
+	case FRAME_EXT_ADDR:
+		addr = 0x2F00 | b;
+		frame = FRAME_DATA;
+		break;
+	case FRAME_DATA:
+		if (addr == SIM_FIFO_ADDR)
+		{
+			if (header & 0x80)
+			{
+				out = rx_len ? rx_fifo[0] : 0;
+				if (rx_len)
+				{
+					memmove(rx_fifo, rx_fifo + 1, --rx_len);
+				}
+				sim_spi.reads++;
+				log_add(addr, out, SIM_LOG_READ, dma);
+			}
+			break;
+		}
+		if (header & 0x80)
+		{
+			sim_spi.reads++;
+			out = reg_read(addr);
+			log_add(addr, out, SIM_LOG_READ, dma);
+		}
+		else
+		{
+			reg_write(addr, b, dma);
+		}
+		if ((header & 0x40) && (ext[CC112X_EXT_CTRL & 0xFF] & 0x01))
+		{
+			addr = (addr & 0xFF00) | ((addr + 1) & 0x00FF);
+		}
+		break;
+	default:
+		printf("FATAL at cycle %llu: SPI byte with the chip select high\n",
+			   (unsigned long long)sim_now());
+		exit(2);
+	}
+	return out;
+}
+
+/******************************************************************************
+ * ENTRY POINTS OF THE SPI SHIM
+ */
+void sim_spi_begin(void)
+{
+	sim_advance(SIM_CYCLES_CS);
+	if (frame != FRAME_IDLE)
+	{
+		printf("FATAL at cycle %llu: chip select already low\n", (unsigned long long)sim_now());
+		exit(2);
+	}
+	if ((state == SIM_MARC_SLEEP) || (state == SIM_MARC_XOFF))
+	{
+		on_since = sim_now();
+		sim_radio.wakes++;
+		// MISO stays high till the XOSC is stable
+		sim_advance(us_to_cycles(SIM_XOSC_START_US));
+		state = SIM_MARC_IDLE;
+	}
+	frame = FRAME_HEADER;
+	cs_low_at = sim_now();
+	sim_spi.frames++;
+}
+
+void sim_spi_tx(unsigned char byte)
+{
+	if (sim_now() < shift_end)
+	{
+		sim_advance(shift_end - sim_now());
+	}
+	rx_byte = frame_byte(byte, 0);
+	sim_advance(byte_cycles() + SIM_CYCLES_SPI_BYTE_SW);
+}
+
+unsigned char sim_spi_rx(void)
+{
+	return rx_byte;
+}
+
+void sim_spi_end(void)
+{
+	// UCBUSY: the last byte written by the DMA is still shifted out
+	if (sim_now() < shift_end)
+	{
+		sim_advance(shift_end - sim_now());
+	}
+	sim_advance(SIM_CYCLES_CS);
+	sim_spi.busy += sim_now() - cs_low_at;
+	frame = FRAME_IDLE;
+	if (pending_off)
+	{
+		state = (pending_off == CC112X_SPWD) ? SIM_MARC_SLEEP : SIM_MARC_XOFF;
+		sim_radio.on += sim_now() - on_since;
+		pending_off = 0;
+	}
+}
+
+/* Byte written to UCB0TXBUF by the DMA: the USCI shifts it without the CPU */
+void sim_spi_tx_dma(unsigned char byte)
+{
+	if (frame == FRAME_IDLE)
+	{
+		printf("FATAL at cycle %llu: DMA byte with the chip select high\n",
+			   (unsigned long long)sim_now());
+		exit(2);
+	}
+	if (sim_now() + byte_cycles() < shift_end)
+	{
+		// TXBUF still full
+		sim_spi.overruns++;
+	}
+	(void)frame_byte(byte, 1);
+	shift_end = ((shift_end > sim_now()) ? shift_end : sim_now()) + byte_cycles();
+}
+
+/******************************************************************************
+ * TEST API
+ */
+void sim_radio_reset(void)
+{
+	registers_reset();
+	memset(&sim_spi, 0, sizeof(sim_spi));
+	memset(&sim_radio, 0, sizeof(sim_radio));
+	state = SIM_MARC_IDLE;
+	pending_off = 0;
+	cal_end = 0;
+	cal_us = SIM_CAL_US;
+	cal_next = SIM_MARC_IDLE;
+	on_since = sim_now();
+	rssi_dbm = -120;
+	rssi_valid_cycles = us_to_cycles(SIM_RSSI_SETTLE_US);
+	rssi_valid_at = 0;
+	rx_len = 0;
+	frame = FRAME_IDLE;
+	shift_end = 0;
+	log_len = 0;
+}
+
+uint64_t sim_radio_on_cycles(void)
+{
+	if ((state == SIM_MARC_SLEEP) || (state == SIM_MARC_XOFF))
+	{
+		return sim_radio.on;
+	}
+	return sim_radio.on + (sim_now() - on_since);
+}
+
+uint8_t sim_radio_reg(uint16_t a)
+{
+	return ((a >> 8) == 0) ? reg8[a & 0xFF] : ext[a & 0xFF];
+}
+
+void sim_radio_set_reg(uint16_t a, uint8_t value)
+{
+	if ((a >> 8) == 0)
+	{
+		reg8[a & 0xFF] = value;
+	}
+	else
+	{
+		ext[a & 0xFF] = value;
+	}
+}
+
+uint8_t sim_radio_state(void)
+{
+	update_state();
+	return state;
+}
+
+/* Length of the next calibrations, a stuck synthesizer with a long one, 0 for the default */
+void sim_radio_set_cal_us(uint32_t us)
+{
+	cal_us = us ? us : SIM_CAL_US;
+}
+
+void sim_radio_set_rssi(int dbm, uint64_t valid_cycles)
+{
+	rssi_dbm = dbm;
+	rssi_valid_cycles = valid_cycles;
+}
+
+/* End of a received packet: the radio goes to IDLE (RXOFF_MODE) and raises GPIO3 */
+void sim_radio_rx_frame(const uint8_t *data, unsigned len)
+{
+	update_state();
+	if (state != SIM_MARC_RX)
+	{
+		return;
+	}
+	if (rx_len + len > SIM_FIFO_SIZE)
+	{
+		state = SIM_MARC_RX_FIFO_ERR;
+	}
+	else
+	{
+		memcpy(&rx_fifo[rx_len], data, len);
+		rx_len += len;
+		state = SIM_MARC_IDLE;
+	}
+	sim_radio_irq();
+}
+
+void sim_radio_irq(void)
+{
+	sim_raise(SIM_IRQ_RADIO);
+}
+
+const SimRadioLog_t *sim_radio_log(unsigned long *n)
+{
+	*n = log_len;
+	return log_buf;
+}
+
+void sim_radio_log_clear(void)
+{
+	log_len = 0;
+}
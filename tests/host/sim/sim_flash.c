@@ -0,0 +1,192 @@
+//*****************************************************************************
+//! @file       sim_flash.c
+//! @brief      Flash controller part of the host model.
+//!
+//! @note		The code writes the flash arrays as plain memory. Each
+//!				access to FCTL3 compares the arrays with the cells of the
+//!				model: a changed word is a write of the code, programmed
+//!				(bits only cleared) or erasing its segment as FCTL1 says.
+//!				A power cut can be set at any operation: the operation is
+//!				left half done and the test callback is called, which
+//!				does not return (longjmp).
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define SIM_FLASH_REGIONS		2
+#define SIM_PROGRAM_US			75			// word program, tWORD of the datasheet
+#define SIM_ERASE_US			25000		// segment erase, tERASE of the datasheet
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned int *array;		// memory the code reads and writes
+	unsigned int *cells;		// content of the flash
+	unsigned int words;
+	unsigned int segment_words;
+}SimFlashRegion_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static SimFlashRegion_t regions[SIM_FLASH_REGIONS];
+static int nb_regions;
+static long ops;
+static long cut_op = -1;
+static void (*cut_fn)(void);
+static volatile unsigned int fctl3;
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void cut_check(void)
+{
+	if ((cut_op >= 0) && (ops == cut_op))
+	{
+		cut_op = -1;
+		cut_fn();
+	}
+}
+
+static void program(SimFlashRegion_t *r, unsigned int i)
+{
+	unsigned int value = r->array[i] & 0xFFFF;
+
+	if (fctl3 & LOCK)
+	{
+		printf("FATAL at cycle %llu: flash written while locked\n", (unsigned long long)sim_now());
+		exit(2);
+	}
+	ops++;
+	if ((cut_op >= 0) && (ops == cut_op))
+	{
+		// Half of the bits to clear are cleared
+		r->cells[i] &= value | (~value & 0xAAAA);
+		memcpy(r->array, r->cells, r->words * sizeof(unsigned int));
+		cut_check();
+	}
+	r->cells[i] &= value;
+	r->array[i] = r->cells[i];
+	sim_advance((uint64_t)SIM_PROGRAM_US * sim_mclk_hz / 1000000UL);
+}
+
+static void erase(SimFlashRegion_t *r, unsigned int i)
+{
+	unsigned int first = i - (i % r->segment_words);
+	unsigned int n;
+
+	if (fctl3 & LOCK)
+	{
+		printf("FATAL at cycle %llu: flash erased while locked\n", (unsigned long long)sim_now());
+		exit(2);
+	}
+	ops++;
+	if ((cut_op >= 0) && (ops == cut_op))
+	{
+		// The first half of the segment is erased
+		for (n = 0; n < r->segment_words / 2; n++)
+		{
+			r->cells[first + n] = 0xFFFF;
+		}
+		memcpy(r->array, r->cells, r->words * sizeof(unsigned int));
+		cut_check();
+	}
+	for (n = 0; n < r->segment_words; n++)
+	{
+		r->cells[first + n] = 0xFFFF;
+		r->array[first + n] = 0xFFFF;
+	}
+	sim_advance((uint64_t)SIM_ERASE_US * sim_mclk_hz / 1000000UL);
+}
+
+/******************************************************************************
+ * ENTRY POINT OF THE SHIM
+ */
+volatile unsigned int *sim_flash_ctl3(void)
+{
+	SimFlashRegion_t *r;
+	unsigned int i;
+	int k;
+
+	for (k = 0; k < nb_regions; k++)
+	{
+		r = &regions[k];
+		for (i = 0; i < r->words; i++)
+		{
+			if (r->array[i] == r->cells[i])
+			{
+				continue;
+			}
+			if ((FCTL1 & 0xFF) & ERASE)
+			{
+				erase(r, i);
+			}
+			else if ((FCTL1 & 0xFF) & WRT)
+			{
+				program(r, i);
+			}
+			else
+			{
+				printf("FATAL at cycle %llu: flash written without WRT / ERASE\n",
+					   (unsigned long long)sim_now());
+				exit(2);
+			}
+		}
+	}
+	// The written value is taken at the next access: keep LOCK, BUSY stays 0
+	fctl3 &= ~BUSY;
+	return &fctl3;
+}
+
+/******************************************************************************
+ * TEST API
+ */
+void sim_flash_attach(unsigned int *array, unsigned int words, unsigned int segment_words,
+					  unsigned int *cells)
+{
+	SimFlashRegion_t *r;
+	int k;
+
+	for (k = 0; k < nb_regions; k++)
+	{
+		if (regions[k].array == array)
+		{
+			break;
+		}
+	}
+	if (k == nb_regions)
+	{
+		if (nb_regions == SIM_FLASH_REGIONS)
+		{
+			printf("FATAL: too many flash regions\n");
+			exit(2);
+		}
+		nb_regions++;
+	}
+	r = &regions[k];
+	r->array = array;
+	r->cells = cells;
+	r->words = words;
+	r->segment_words = segment_words;
+	memcpy(array, cells, words * sizeof(unsigned int));
+	fctl3 = LOCK;
+}
+
+void sim_flash_cut_at(long op, void (*cut)(void))
+{
+	ops = 0;
+	cut_op = op;
+	cut_fn = cut;
+}
+
+long sim_flash_ops(void)
+{
+	return ops;
+}
@@ -0,0 +1,707 @@
+//*****************************************************************************
+//! @file       sim_mcu.c
+//! @brief      MCU part of the host model: virtual MCLK, status register,
+//!				interrupt dispatch, low power modes, Timer_A/B, RTC_A
+//!				counter and DMA channel 0.
+//!
+//! @note		The registers written by the code are plain variables. The
+//!				model looks at them each time it runs: a TxCLR bit, a mode
+//!				change or a write of the counter is taken into account at
+//!				the next cycle the model accounts.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define SIM_EVENTS_MAX			64			// callbacks of sim_at() waiting
+#define SIM_NEVER				UINT64_MAX
+#define SIM_TIMERS				3
+#define SIM_CCRS				3
+
+/******************************************************************************
+ * REGISTERS
+ */
+#define SIM_REG(name)			volatile unsigned int name;
+#include "msp430_regs.h"
+#undef SIM_REG
+volatile unsigned long DMA0SA, DMA0DA, DMA1SA, DMA1DA, DMA2SA, DMA2DA;
+
+/******************************************************************************
+ * INTERRUPT ROUTINES OF THE SOURCES UNDER TEST
+ * Weak: a test links only the modules it needs
+ */
+extern void SYSNMI_ISR(void) __attribute__((weak));
+extern void RADIO_HW_RAMP_ISR(void) __attribute__((weak));
+extern void TIMER0_A0_ISR(void) __attribute__((weak));
+extern void TIMER0_A1_ISR(void) __attribute__((weak));
+extern void RADIO_DMA_ISR(void) __attribute__((weak));
+extern void ADC_DMA_ISR(void) __attribute__((weak));
+extern void TIMER1_A0_ISR(void) __attribute__((weak));
+extern void sim_board_radio_isr(void);
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	volatile unsigned int *ctl;
+	volatile unsigned int *cctl[SIM_CCRS];
+	volatile unsigned int *ccr[SIM_CCRS];
+	volatile unsigned int r;		// counter as the code reads and writes it
+	unsigned int r_seen;			// counter as the model last set it
+	unsigned int ctl_seen;			// control register the model runs with
+	int64_t origin;					// input clock tick of the count 0
+	unsigned int frozen;			// count while stopped
+}SimTimer_t;
+
+typedef struct
+{
+	uint64_t t;
+	void (*fn)(void *);
+	void *arg;
+}SimEvent_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+uint32_t sim_mclk_hz = SIM_MCLK_HZ;
+SimCpuStats_t sim_cpu;
+void (*sim_user_isr)(void);
+int sim_failures;
+
+static uint64_t now;
+static int gie;
+static int in_isr;
+static int waking;					// DCO restart of an interrupt out of LPM3
+static unsigned int lpm;				// LPM bits of the status register
+static unsigned int exit_clear;			// bits cleared from the SR on RETI
+static unsigned char raised[SIM_IRQ_NB];
+static SimTimer_t timers[SIM_TIMERS];
+static SimEvent_t events[SIM_EVENTS_MAX];
+static int nb_events;
+
+static int dma0_active;
+static uint64_t dma0_src;
+static unsigned int dma0_left;
+
+static volatile unsigned int rtc_reg[2];
+static unsigned int rtc_seen[2];
+static int64_t rtc_origin;
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void fatal(const char *msg)
+{
+	printf("FATAL at cycle %llu: %s\n", (unsigned long long)now, msg);
+	exit(2);
+}
+
+static uint64_t aclk_raw(uint64_t t)
+{
+	return (t * SIM_ACLK_HZ) / sim_mclk_hz;
+}
+
+/* Input clock ticks of a timer at MCLK cycle t */
+static int64_t timer_ticks(unsigned int ctl, uint64_t t)
+{
+	unsigned int div = 1u << ((ctl >> 6) & 0x03);
+
+	if ((ctl & 0x0300) == TASSEL_1)
+	{
+		return (int64_t)(aclk_raw(t) / div);
+	}
+	return (int64_t)(t / div);
+}
+
+/* First MCLK cycle where the input clock reaches a tick */
+static uint64_t timer_cycle(unsigned int ctl, int64_t tick)
+{
+	unsigned int div = 1u << ((ctl >> 6) & 0x03);
+	uint64_t raw = (uint64_t)tick * div;
+
+	if ((ctl & 0x0300) == TASSEL_1)
+	{
+		return (raw * sim_mclk_hz + SIM_ACLK_HZ - 1) / SIM_ACLK_HZ;
+	}
+	return raw;
+}
+
+static unsigned int timer_period(const SimTimer_t *tm, unsigned int ctl)
+{
+	return ((ctl & MC_3) == MC_2) ? 0x10000u : (*tm->ccr[0] & 0xFFFF) + 1u;
+}
+
+static unsigned int timer_value(const SimTimer_t *tm, unsigned int ctl, uint64_t t)
+{
+	int64_t elapsed;
+
+	if ((ctl & MC_3) == MC_0)
+	{
+		return tm->frozen;
+	}
+	elapsed = timer_ticks(ctl, t) - tm->origin;
+	return (unsigned int)(elapsed % timer_period(tm, ctl));
+}
+
+/* Takes the writes of the code to the control register and the counter */
+static void timer_sync(SimTimer_t *tm)
+{
+	unsigned int ctl = *tm->ctl;
+	unsigned int value;
+
+	if (tm->r != tm->r_seen)
+	{
+		value = tm->r & 0xFFFF;
+	}
+	else
+	{
+		value = timer_value(tm, tm->ctl_seen, now);
+	}
+	if (ctl & TACLR)
+	{
+		value = 0;
+		ctl &= ~TACLR;
+		*tm->ctl = ctl;
+	}
+	tm->frozen = value;
+	tm->origin = timer_ticks(ctl, now) - value;
+	tm->ctl_seen = ctl;
+	tm->r = tm->r_seen = value;
+}
+
+/* Next compare of a CCR, SIM_NEVER if the timer is stopped */
+static uint64_t timer_next(const SimTimer_t *tm, int n)
+{
+	unsigned int ctl = tm->ctl_seen;
+	unsigned int period, value, target, delta;
+
+	if ((ctl & MC_3) == MC_0)
+	{
+		return SIM_NEVER;
+	}
+	period = timer_period(tm, ctl);
+	target = *tm->ccr[n] & 0xFFFF;
+	if (target >= period)
+	{
+		return SIM_NEVER;
+	}
+	value = timer_value(tm, ctl, now);
+	delta = (target + period - value) % period;
+	if (delta == 0)
+	{
+		delta = period;
+	}
+	return timer_cycle(ctl, timer_ticks(ctl, now) + delta);
+}
+
+static int timer_dma_trigger(int timer, int n)
+{
+	return (timer == SIM_TB0) && (n == 0) && (DMA0CTL & DMAEN)
+			&& ((DMACTL0 & 0x1F) == SIM_DMA_TSEL_TB0CCR0);
+}
+
+static void dma0_transfer(void)
+{
+	unsigned char byte;
+
+	if (!dma0_active)
+	{
+		dma0_active = 1;
+		dma0_src = DMA0SA;
+		dma0_left = DMA0SZ;
+	}
+	byte = *(const unsigned char *)(uintptr_t)dma0_src;
+	if ((DMA0CTL & DMASRCINCR_3) == DMASRCINCR_3)
+	{
+		dma0_src++;
+	}
+	else if ((DMA0CTL & DMASRCINCR_3) == DMASRCINCR_2)
+	{
+		dma0_src--;
+	}
+	if (DMA0DA == (unsigned long)(uintptr_t)&UCB0TXBUF)
+	{
+		sim_spi_tx_dma(byte);
+	}
+	else
+	{
+		*(unsigned char *)(uintptr_t)DMA0DA = byte;
+	}
+	if (--dma0_left == 0)
+	{
+		dma0_active = 0;
+		DMA0CTL = (DMA0CTL & ~DMAEN) | DMAIFG;
+	}
+}
+
+/* Earliest event: compares with an interrupt or a DMA trigger, callbacks */
+static uint64_t next_event(void)
+{
+	uint64_t best = SIM_NEVER;
+	uint64_t t;
+	int i, n;
+
+	for (i = 0; i < SIM_TIMERS; i++)
+	{
+		timer_sync(&timers[i]);
+		for (n = 0; n < SIM_CCRS; n++)
+		{
+			if ((*timers[i].cctl[n] & CCIE) || timer_dma_trigger(i, n))
+			{
+				t = timer_next(&timers[i], n);
+				best = (t < best) ? t : best;
+			}
+		}
+	}
+	for (i = 0; i < nb_events; i++)
+	{
+		best = (events[i].t < best) ? events[i].t : best;
+	}
+	return best;
+}
+
+/* A compare is reached at the first MCLK cycle of the tick the counter takes its value */
+static int timer_due(const SimTimer_t *tm, int n)
+{
+	unsigned int ctl = tm->ctl_seen;
+
+	if ((ctl & MC_3) == MC_0)
+	{
+		return 0;
+	}
+	return (timer_value(tm, ctl, now) == (*tm->ccr[n] & 0xFFFF))
+			&& (timer_cycle(ctl, timer_ticks(ctl, now)) == now);
+}
+
+/* Runs the events due at the current cycle */
+static void fire_events(void)
+{
+	SimEvent_t ev;
+	int i, n;
+
+	for (i = 0; i < SIM_TIMERS; i++)
+	{
+		for (n = 0; n < SIM_CCRS; n++)
+		{
+			if (!timer_due(&timers[i], n))
+			{
+				continue;
+			}
+			if (timer_dma_trigger(i, n))
+			{
+				dma0_transfer();
+			}
+			*timers[i].cctl[n] |= CCIFG;
+		}
+	}
+	for (i = 0; i < nb_events; )
+	{
+		if (events[i].t <= now)
+		{
+			ev = events[i];
+			events[i] = events[--nb_events];
+			ev.fn(ev.arg);
+			i = 0;
+			continue;
+		}
+		i++;
+	}
+}
+
+static int irq_pending(te_SimIrq irq)
+{
+	switch (irq)
+	{
+	case SIM_IRQ_TB0_0:
+		return (TB0CCTL0 & (CCIE | CCIFG)) == (CCIE | CCIFG);
+	case SIM_IRQ_TA0_0:
+		return (TA0CCTL0 & (CCIE | CCIFG)) == (CCIE | CCIFG);
+	case SIM_IRQ_TA0_1:
+		return ((TA0CCTL1 & (CCIE | CCIFG)) == (CCIE | CCIFG))
+				|| ((TA0CCTL2 & (CCIE | CCIFG)) == (CCIE | CCIFG));
+	case SIM_IRQ_DMA:
+		return (DMA0CTL & (DMAIE | DMAIFG)) == (DMAIE | DMAIFG);
+	case SIM_IRQ_TA1_0:
+		return (TA1CCTL0 & (CCIE | CCIFG)) == (CCIE | CCIFG);
+	default:
+		return raised[irq];
+	}
+}
+
+static void irq_call(te_SimIrq irq)
+{
+	switch (irq)
+	{
+	case SIM_IRQ_SYSNMI:
+		if (SYSNMI_ISR) SYSNMI_ISR();
+		break;
+	case SIM_IRQ_TB0_0:
+		TB0CCTL0 &= ~CCIFG;
+		if (RADIO_HW_RAMP_ISR) RADIO_HW_RAMP_ISR(); else fatal("no Timer_B0 CCR0 routine");
+		break;
+	case SIM_IRQ_TA0_0:
+		TA0CCTL0 &= ~CCIFG;
+		if (TIMER0_A0_ISR) TIMER0_A0_ISR(); else fatal("no Timer0_A CCR0 routine");
+		break;
+	case SIM_IRQ_TA0_1:
+		if (TIMER0_A1_ISR) TIMER0_A1_ISR(); else fatal("no Timer0_A CCR1 routine");
+		break;
+	case SIM_IRQ_DMA:
+		if (RADIO_DMA_ISR) RADIO_DMA_ISR();
+		else if (ADC_DMA_ISR) ADC_DMA_ISR();
+		else fatal("no DMA routine");
+		break;
+	case SIM_IRQ_TA1_0:
+		TA1CCTL0 &= ~CCIFG;
+		if (TIMER1_A0_ISR) TIMER1_A0_ISR(); else fatal("no Timer1_A CCR0 routine");
+		break;
+	case SIM_IRQ_RADIO:
+		sim_board_radio_isr();
+		break;
+	case SIM_IRQ_USER:
+		if (sim_user_isr) sim_user_isr();
+		break;
+	default:
+		break;
+	}
+}
+
+static void run(uint64_t cycles);
+
+/* Takes the highest pending interrupt if the CPU accepts it, returns 1 if one ran */
+static int irq_take(void)
+{
+	unsigned int saved_gie;
+	int irq;
+
+	if (in_isr || waking)
+	{
+		return 0;
+	}
+	for (irq = 0; irq < SIM_IRQ_NB; irq++)
+	{
+		if (!irq_pending((te_SimIrq)irq) || (!gie && (irq != SIM_IRQ_SYSNMI)))
+		{
+			continue;
+		}
+		raised[irq] = 0;
+		if (lpm & (SCG0 | SCG1))
+		{
+			// The flag stays pending till the routine, no nesting meanwhile
+			waking = 1;
+			run(SIM_CYCLES_LPM3_WAKE);
+			waking = 0;
+		}
+		saved_gie = gie;
+		gie = 0;
+		in_isr = 1;
+		exit_clear = 0;
+		sim_cpu.irq[irq]++;
+		run(SIM_CYCLES_ISR);
+		irq_call((te_SimIrq)irq);
+		in_isr = 0;
+		gie = saved_gie;
+		lpm &= ~exit_clear;
+		return 1;
+	}
+	return 0;
+}
+
+/* Executes cycles of code, the interrupts taken on the way delay its end */
+static void run(uint64_t cycles)
+{
+	uint64_t end = now + cycles;
+	uint64_t start, t;
+
+	sim_cpu.active += cycles;
+	if (in_isr)
+	{
+		sim_cpu.isr += cycles;
+	}
+	for (;;)
+	{
+		start = now;
+		if (irq_take())
+		{
+			end += now - start;
+			continue;
+		}
+		t = next_event();
+		if ((t == SIM_NEVER) || (t > end))
+		{
+			break;
+		}
+		now = (t > now) ? t : now;
+		fire_events();
+	}
+	now = (end > now) ? end : now;
+}
+
+static void sleep(unsigned int bits)
+{
+	uint64_t t;
+
+	lpm = bits & LPM4_bits;
+	while (lpm)
+	{
+		if (irq_take())
+		{
+			continue;
+		}
+		if (!gie)
+		{
+			fatal("low power mode with the interrupts disabled");
+		}
+		t = next_event();
+		if (t == SIM_NEVER)
+		{
+			fatal("low power mode without a wake-up source");
+		}
+		if (t > now)
+		{
+			if (lpm & (SCG0 | SCG1))
+			{
+				sim_cpu.lpm3 += t - now;
+			}
+			else
+			{
+				sim_cpu.lpm0 += t - now;
+			}
+			now = t;
+		}
+		fire_events();
+	}
+}
+
+/******************************************************************************
+ * ENTRY POINTS OF THE SHIM
+ */
+void sim_delay_cycles(unsigned long cycles)
+{
+	run(cycles);
+}
+
+void sim_nop(void)
+{
+	run(SIM_CYCLES_SPIN);
+}
+
+unsigned short sim_get_interrupt_state(void)
+{
+	return gie ? GIE : 0;
+}
+
+void sim_set_interrupt_state(unsigned short state)
+{
+	gie = (state & GIE) ? 1 : 0;
+	run(1);
+}
+
+void sim_bis_sr(unsigned short bits)
+{
+	if (bits & GIE)
+	{
+		gie = 1;
+	}
+	if (bits & CPUOFF)
+	{
+		if (in_isr)
+		{
+			fatal("low power mode entered from an interrupt routine");
+		}
+		sleep(bits);
+	}
+	run(1);
+}
+
+void sim_bic_sr(unsigned short bits)
+{
+	if (bits & GIE)
+	{
+		gie = 0;
+	}
+	run(1);
+}
+
+void sim_bic_sr_on_exit(unsigned short bits)
+{
+	if (!in_isr)
+	{
+		fatal("__bic_SR_register_on_exit() out of an interrupt routine");
+	}
+	exit_clear |= bits;
+	if (bits & GIE)
+	{
+		fatal("GIE cleared on exit");
+	}
+}
+
+void sim_data16_write_addr(unsigned short reg, unsigned long value)
+{
+	static volatile unsigned long * const regs[] = { &DMA0SA, &DMA0DA, &DMA1SA, &DMA1DA, &DMA2SA, &DMA2DA };
+	unsigned int i;
+
+	for (i = 0; i < sizeof(regs) / sizeof(regs[0]); i++)
+	{
+		if ((unsigned short)(uintptr_t)regs[i] == reg)
+		{
+			*regs[i] = value;
+			return;
+		}
+	}
+	fatal("__data16_write_addr() to an unknown register");
+}
+
+volatile unsigned int *sim_timer_counter(int timer)
+{
+	run(SIM_CYCLES_REG_READ);
+	timer_sync(&timers[timer]);
+	return &timers[timer].r;
+}
+
+unsigned int sim_timer_iv(int timer)
+{
+	SimTimer_t *tm = &timers[timer];
+	int n;
+
+	run(SIM_CYCLES_REG_READ);
+	for (n = 1; n < SIM_CCRS; n++)
+	{
+		if ((*tm->cctl[n] & (CCIE | CCIFG)) == (CCIE | CCIFG))
+		{
+			*tm->cctl[n] &= ~CCIFG;
+			return 2 * n;
+		}
+	}
+	return 0;
+}
+
+unsigned int sim_dma_iv(void)
+{
+	run(SIM_CYCLES_REG_READ);
+	if ((DMA0CTL & (DMAIE | DMAIFG)) == (DMAIE | DMAIFG))
+	{
+		DMA0CTL &= ~DMAIFG;
+		return DMAIV_DMA0IFG;
+	}
+	return DMAIV_NONE;
+}
+
+volatile unsigned int *sim_rtc_counter(int high)
+{
+	uint32_t count;
+
+	run(SIM_CYCLES_REG_READ);
+	if ((rtc_reg[0] != rtc_seen[0]) || (rtc_reg[1] != rtc_seen[1]) || (RTCCTL01 & RTCHOLD))
+	{
+		count = ((uint32_t)(rtc_reg[1] & 0xFFFF) << 16) | (rtc_reg[0] & 0xFFFF);
+		rtc_origin = (int64_t)aclk_raw(now) - count;
+	}
+	count = (uint32_t)((int64_t)aclk_raw(now) - rtc_origin);
+	rtc_reg[0] = rtc_seen[0] = count & 0xFFFF;
+	rtc_reg[1] = rtc_seen[1] = count >> 16;
+	return &rtc_reg[high];
+}
+
+/******************************************************************************
+ * TEST API
+ */
+void sim_reset(void)
+{
+	int i;
+
+#define SIM_REG(name)	name = 0;
+#include "msp430_regs.h"
+#undef SIM_REG
+	DMA0SA = DMA0DA = DMA1SA = DMA1DA = DMA2SA = DMA2DA = 0;
+	now = 0;
+	gie = 0;
+	in_isr = 0;
+	waking = 0;
+	lpm = 0;
+	nb_events = 0;
+	dma0_active = 0;
+	memset(raised, 0, sizeof(raised));
+	memset(&sim_cpu, 0, sizeof(sim_cpu));
+	memset(timers, 0, sizeof(timers));
+	timers[SIM_TA0].ctl = &TA0CTL;
+	timers[SIM_TA0].cctl[0] = &TA0CCTL0; timers[SIM_TA0].cctl[1] = &TA0CCTL1; timers[SIM_TA0].cctl[2] = &TA0CCTL2;
+	timers[SIM_TA0].ccr[0] = &TA0CCR0; timers[SIM_TA0].ccr[1] = &TA0CCR1; timers[SIM_TA0].ccr[2] = &TA0CCR2;
+	timers[SIM_TA1].ctl = &TA1CTL;
+	timers[SIM_TA1].cctl[0] = &TA1CCTL0; timers[SIM_TA1].cctl[1] = &TA1CCTL1; timers[SIM_TA1].cctl[2] = &TA1CCTL2;
+	timers[SIM_TA1].ccr[0] = &TA1CCR0; timers[SIM_TA1].ccr[1] = &TA1CCR1; timers[SIM_TA1].ccr[2] = &TA1CCR2;
+	timers[SIM_TB0].ctl = &TB0CTL;
+	timers[SIM_TB0].cctl[0] = &TB0CCTL0; timers[SIM_TB0].cctl[1] = &TB0CCTL1; timers[SIM_TB0].cctl[2] = &TB0CCTL2;
+	timers[SIM_TB0].ccr[0] = &TB0CCR0; timers[SIM_TB0].ccr[1] = &TB0CCR1; timers[SIM_TB0].ccr[2] = &TB0CCR2;
+	for (i = 0; i < SIM_TIMERS; i++)
+	{
+		timers[i].r = timers[i].r_seen = 0;
+	}
+	rtc_reg[0] = rtc_reg[1] = rtc_seen[0] = rtc_seen[1] = 0;
+	rtc_origin = 0;
+	UCB0BR0 = 3;		// SCLK = SMCLK / 3, as set up by the demo
+	sim_radio_reset();
+}
+
+uint64_t sim_now(void)
+{
+	return now;
+}
+
+double sim_now_s(void)
+{
+	return (double)now / sim_mclk_hz;
+}
+
+void sim_advance(uint64_t cycles)
+{
+	run(cycles);
+}
+
+uint32_t sim_aclk_ticks(void)
+{
+	return (uint32_t)aclk_raw(now);
+}
+
+void sim_raise(te_SimIrq irq)
+{
+	raised[irq] = 1;
+}
+
+void sim_at(uint64_t t, void (*fn)(void *), void *arg)
+{
+	if (nb_events == SIM_EVENTS_MAX)
+	{
+		fatal("too many events");
+	}
+	events[nb_events].t = t;
+	events[nb_events].fn = fn;
+	events[nb_events].arg = arg;
+	nb_events++;
+}
+
+int sim_in_isr(void)
+{
+	return in_isr;
+}
+
+int sim_gie(void)
+{
+	return gie;
+}
+
+int sim_result(const char *name)
+{
+	if (sim_failures)
+	{
+		printf("%s: %d check(s) FAILED\n", name, sim_failures);
+		return 1;
+	}
+	printf("%s: passed\n", name);
+	return 0;
+}
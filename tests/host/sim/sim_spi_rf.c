@@ -0,0 +1,8 @@
+//*****************************************************************************
+//! @file       sim_spi_rf.c
+//! @brief      Radio SPI driver of the target built for the host: the shim
+//!				header comes first, the SPI macros of the driver then go to
+//!				the CC112x model.
+//****************************************************************************/
+#include "hal_spi_rf_trxeb.h"
+#include "../../../components/targets/trxeb_msp430f5438a/hal_spi_rf_trxeb.c"
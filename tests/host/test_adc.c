@@ -0,0 +1,392 @@
+//*****************************************************************************
+//! @file       test_adc.c
+//! @brief      Supply and temperature of ADC_vdd_mv() and ADC_temp(), from
+//!				the TLV calibration of a device and the ADC12MEM7 /
+//!				ADC12MEM8 conversions, against the voltage and temperature
+//!				they were made from.
+//!
+//!				No sample recorded on a device is available: the vectors
+//!				are synthetic, made by the model below from the formulas of
+//!				the datasheet and of the user's guide. Each device draws
+//!				its TLV words: CAL_ADC_20VREF_FACTOR within REF_ERR,
+//!				CAL_ADC_GAIN_FACTOR within GAIN_ERR, CAL_ADC_OFFSET within
+//!				OFFSET_LSB, and a temperature sensor spread around the
+//!				typical 680 mV + 2.55 mV/degC. A conversion is the code
+//!				the user's guide correction maps back to the ideal one,
+//!				plus up to NOISE_LSB of noise. CAL_ADC_20T30 and
+//!				CAL_ADC_20T85 are the sensor codes at 30 and 85 degC,
+//!				without noise. The sensor is linear, the errors are the
+//!				ones of the conversions. The first device has no TLV and
+//!				the typical sensor: the typical calibration applies.
+//!
+//!				adc.c is built into the test for its sample buffers: the
+//!				DriverLib calls are a model of the ADC12_A and of DMA
+//!				channels 1 and 2. A sequence writes ADC12MEM7 and
+//!				ADC12MEM8, the DMA moves them, the first ADC_SETTLE with
+//!				the reference not settled. The end of channel 2 calls
+//!				ADC_dma_isr().
+//!
+//!				For each device, from 1.8 to 3.6 V and -40 to 85 degC,
+//!				the idle measurement must be within VDD_ERR_MV and
+//!				TEMP_ERR of the model, the TX one within VDD_ERR_MV.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "adc.c"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_DEVICES				200
+#define REF_ERR					0.01		// CAL_ADC_20VREF_FACTOR within +-1 %
+#define GAIN_ERR				0.002		// CAL_ADC_GAIN_FACTOR within +-0.2 %
+#define OFFSET_LSB				4			// CAL_ADC_OFFSET within +-4 LSB
+#define SENSOR_MV				680.0		// typical sensor at 0 degC
+#define SENSOR_MV_C				2.55		// typical sensor slope, mV/degC
+#define SENSOR_MV_ERR			20.0		// sensor offset spread
+#define SENSOR_SLOPE_ERR		0.03		// sensor slope spread
+#define NOISE_LSB				2
+#define SETTLE_CODE				0x0FFF		// conversions before the reference settles
+
+#define VDD_MIN_MV				1800
+#define VDD_MAX_MV				3600
+#define VDD_STEP_MV				100
+#define TEMP_MIN				(-40)
+#define TEMP_MAX				85
+#define TEMP_STEP				5
+
+#define VDD_ERR_MV				3
+#define TEMP_ERR				5			// 1/10 degC
+
+#define NB_DMA					3
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	uint16_t adc[TLV_ADC12_WORDS];		// ADC12CAL tag
+	uint16_t ref[TLV_REF_WORDS];		// REFCAL tag
+	int b_Tlv;
+	double sensor_mv;					// at 0 degC
+	double sensor_mv_c;
+}Device_t;
+
+typedef struct
+{
+	uint32_t src;
+	uint32_t dst;
+	uint16_t size;
+	int b_Enabled;
+	int b_Interrupt;
+}Dma_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static Device_t Dev;
+static Dma_t Dma[NB_DMA];
+static uint8_t u8_Sequence;			// conversion mode started, 0 without
+static int b_RefOn;
+static double vdd_mv;
+static double temp_c;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+static double spread(double range)
+{
+	return range * (2 * sim_uniform() - 1);
+}
+
+/* Code of the device for vin mV: the user's guide correction of it is the ideal code */
+static double code(double vin)
+{
+	double ideal = vin * ADC_FULL_SCALE / ADC_VREF_MV;
+
+	return (ideal - (int16_t)Dev.adc[TLV_ADC12_OFFSET]) * 32768.0 / Dev.ref[TLV_REF_20VREF] * 32768.0
+		   / Dev.adc[TLV_ADC12_GAIN];
+}
+
+static uint16_t conversion(double vin)
+{
+	long c = lround(code(vin)) + (long)(sim_uniform() * (2 * NOISE_LSB + 1)) - NOISE_LSB;
+
+	return (uint16_t)((c < 0) ? 0 : (c >= ADC_FULL_SCALE) ? ADC_FULL_SCALE - 1 : c);
+}
+
+static double sensor(double t)
+{
+	return Dev.sensor_mv + Dev.sensor_mv_c * t;
+}
+
+static void new_device(int b_Tlv)
+{
+	memset(&Dev, 0, sizeof(Dev));
+	Dev.b_Tlv = b_Tlv;
+	Dev.ref[TLV_REF_20VREF] = 32768;
+	Dev.adc[TLV_ADC12_GAIN] = 32768;
+	Dev.sensor_mv = SENSOR_MV;
+	Dev.sensor_mv_c = SENSOR_MV_C;
+	if (b_Tlv)
+	{
+		Dev.ref[TLV_REF_20VREF] = (uint16_t)lround(32768 * (1 + spread(REF_ERR)));
+		Dev.adc[TLV_ADC12_GAIN] = (uint16_t)lround(32768 * (1 + spread(GAIN_ERR)));
+		Dev.adc[TLV_ADC12_OFFSET] = (uint16_t)(int16_t)lround(spread(OFFSET_LSB));
+		Dev.sensor_mv += spread(SENSOR_MV_ERR);
+		Dev.sensor_mv_c *= 1 + spread(SENSOR_SLOPE_ERR);
+	}
+	Dev.adc[TLV_ADC12_20T30] = (uint16_t)lround(code(sensor(ADC_CAL_T30)));
+	Dev.adc[TLV_ADC12_20T85] = (uint16_t)lround(code(sensor(ADC_CAL_T85)));
+}
+
+/******************************************************************************
+ * DRIVERLIB MODEL
+ */
+void TLV_getInfo(uint8_t tag, uint8_t instance, uint8_t *length, uint16_t **data_address)
+{
+	*length = 0;
+	*data_address = 0;
+	if (!Dev.b_Tlv)
+	{
+		return;
+	}
+	if (tag == TLV_TAG_ADC12CAL)
+	{
+		*length = sizeof(Dev.adc);
+		*data_address = Dev.adc;
+	}
+	else if (tag == TLV_TAG_REFCAL)
+	{
+		*length = sizeof(Dev.ref);
+		*data_address = Dev.ref;
+	}
+}
+
+bool ADC12_A_init(uint16_t baseAddress, uint16_t sampleHoldSignalSourceSelect, uint8_t clockSourceSelect,
+				  uint16_t clockSourceDivider)
+{
+	return false;
+}
+
+void ADC12_A_enable(uint16_t baseAddress)
+{
+}
+
+void ADC12_A_setupSamplingTimer(uint16_t baseAddress, uint16_t clockCycleHoldCountLowMem,
+								uint16_t clockCycleHoldCountHighMem, uint16_t multipleSamplesEnabled)
+{
+}
+
+void ADC12_A_configureMemory(uint16_t baseAddress, ADC12_A_configureMemoryParam *param)
+{
+}
+
+void ADC12_A_clearInterrupt(uint16_t baseAddress, uint16_t memoryInterruptFlagMask)
+{
+}
+
+void ADC12_A_startConversion(uint16_t baseAddress, uint16_t startingMemoryBufferIndex,
+							 uint8_t conversionSequenceModeSelect)
+{
+	SIM_CHECK(u8_Sequence == 0, "conversion started during a conversion");
+	SIM_CHECK(b_RefOn, "conversion started with the reference off");
+	SIM_CHECK((conversionSequenceModeSelect == ADC12_A_REPEATED_SEQOFCHANNELS)
+			  ? (startingMemoryBufferIndex == ADC_MEM_TEMP) : (startingMemoryBufferIndex == ADC_MEM_VDD),
+			  "conversion mode %u from ADC12MEM%u", conversionSequenceModeSelect, startingMemoryBufferIndex);
+	u8_Sequence = conversionSequenceModeSelect;
+}
+
+void ADC12_A_disableConversions(uint16_t baseAddress, bool preempt)
+{
+	u8_Sequence = 0;
+}
+
+uint32_t ADC12_A_getMemoryAddressForDMA(uint16_t baseAddress, uint8_t memoryIndex)
+{
+	return (uint32_t)(uintptr_t)((memoryIndex == ADC12_A_MEMORY_7) ? &ADC12MEM7 : &ADC12MEM8);
+}
+
+void Ref_setReferenceVoltage(uint16_t baseAddress, uint8_t referenceVoltageSelect)
+{
+}
+
+void Ref_enableTempSensor(uint16_t baseAddress)
+{
+}
+
+void Ref_enableReferenceVoltage(uint16_t baseAddress)
+{
+	b_RefOn = 1;
+}
+
+void Ref_disableReferenceVoltage(uint16_t baseAddress)
+{
+	b_RefOn = 0;
+}
+
+void DMA_init(DMA_initParam *param)
+{
+	memset(&Dma[param->channelSelect >> 4], 0, sizeof(Dma_t));
+	Dma[param->channelSelect >> 4].size = param->transferSize;
+}
+
+void DMA_setTransferSize(uint8_t channelSelect, uint16_t transferSize)
+{
+	Dma[channelSelect >> 4].size = transferSize;
+}
+
+void DMA_setSrcAddress(uint8_t channelSelect, uint32_t srcAddress, uint16_t directionSelect)
+{
+	Dma[channelSelect >> 4].src = srcAddress;
+}
+
+void DMA_setDstAddress(uint8_t channelSelect, uint32_t dstAddress, uint16_t directionSelect)
+{
+	Dma[channelSelect >> 4].dst = dstAddress;
+}
+
+void DMA_enableTransfers(uint8_t channelSelect)
+{
+	Dma[channelSelect >> 4].b_Enabled = 1;
+}
+
+void DMA_disableTransfers(uint8_t channelSelect)
+{
+	Dma[channelSelect >> 4].b_Enabled = 0;
+}
+
+void DMA_enableInterrupt(uint8_t channelSelect)
+{
+	Dma[channelSelect >> 4].b_Interrupt = 1;
+}
+
+void DMA_clearInterrupt(uint8_t channelSelect)
+{
+}
+
+/* Host pointers of the addresses adc.c gives the DMA, on 32 bits */
+static volatile unsigned int *dma_src(uint32_t addr)
+{
+	return (addr == (uint32_t)(uintptr_t)&ADC12MEM7) ? &ADC12MEM7 : &ADC12MEM8;
+}
+
+static uint16 *dma_dst(uint32_t addr)
+{
+	if ((addr >= (uint32_t)(uintptr_t)TempSamples) && (addr < (uint32_t)(uintptr_t)(TempSamples + ADC_SAMPLES)))
+	{
+		return TempSamples + (addr - (uint32_t)(uintptr_t)TempSamples) / sizeof(uint16);
+	}
+	return VddSamples + (addr - (uint32_t)(uintptr_t)VddSamples) / sizeof(uint16);
+}
+
+/* The sequence started, till DMA channel 2 is done */
+static void convert(void)
+{
+	Dma_t *d;
+	unsigned int n, ch;
+
+	SIM_CHECK(u8_Sequence != 0, "no conversion started");
+	for (n = 0; (u8_Sequence != 0) && (n < 4 * ADC_SAMPLES); n++)
+	{
+		// ADC12IFG8 at the end of the sequence
+		if (u8_Sequence == ADC12_A_REPEATED_SEQOFCHANNELS)
+		{
+			ADC12MEM7 = (n < ADC_SETTLE) ? SETTLE_CODE : conversion(sensor(temp_c));
+		}
+		ADC12MEM8 = (n < ADC_SETTLE) ? SETTLE_CODE : conversion(vdd_mv / 2);
+
+		for (ch = 1; ch < NB_DMA; ch++)
+		{
+			d = &Dma[ch];
+			if (!d->b_Enabled || (d->size == 0))
+			{
+				continue;
+			}
+			*dma_dst(d->dst) = (uint16)*dma_src(d->src);
+			d->dst += sizeof(uint16);
+			if (--d->size == 0)
+			{
+				d->b_Enabled = 0;
+				if (d->b_Interrupt)
+				{
+					ADC_dma_isr();
+				}
+			}
+		}
+	}
+	SIM_CHECK(u8_Sequence == 0, "conversions not stopped after %u sequences", n);
+	SIM_CHECK(!b_RefOn, "reference left on");
+}
+
+int main(void)
+{
+	const AdcValues_t *pAdc = ADC_values();
+	unsigned int d, v, t;
+	uint16 idle, tx;
+	int err, vdd_err = 0, temp_err = 0, tx_err = 0;
+	int b_Ok;
+
+	sim_reset();
+	__enable_interrupt();
+
+	for (d = 0; d < NB_DEVICES; d++)
+	{
+		new_device(d > 0);
+		vdd_mv = VDD_MIN_MV;
+		temp_c = TEMP_MIN;
+		ADC_init();
+		b_Ok = (AdcCal.u16_VrefFactor == Dev.ref[TLV_REF_20VREF]) && (AdcCal.u16_Gain == Dev.adc[TLV_ADC12_GAIN])
+			   && (AdcCal.s16_Offset == (int16_t)Dev.adc[TLV_ADC12_OFFSET])
+			   && (AdcCal.u16_T30 == (Dev.b_Tlv ? Dev.adc[TLV_ADC12_20T30] : ADC_TYP_T30))
+			   && (AdcCal.u16_T85 == (Dev.b_Tlv ? Dev.adc[TLV_ADC12_20T85] : ADC_TYP_T85));
+		SIM_CHECK(b_Ok, "device %u: calibration %u %d %u %u %u", d, AdcCal.u16_Gain, AdcCal.s16_Offset,
+				  AdcCal.u16_VrefFactor, AdcCal.u16_T30, AdcCal.u16_T85);
+		idle = pAdc->u16_Idle;
+		tx = pAdc->u16_Tx;
+
+		for (v = VDD_MIN_MV; v <= VDD_MAX_MV; v += VDD_STEP_MV)
+		{
+			for (t = 0; TEMP_MIN + (int)t <= TEMP_MAX; t += TEMP_STEP)
+			{
+				vdd_mv = v;
+				temp_c = TEMP_MIN + (int)t;
+				if ((v > VDD_MIN_MV) || (t > 0))
+				{
+					ADC_start_idle();
+				}
+				convert();
+
+				err = abs((int)pAdc->u16_VddIdle - (int)v);
+				SIM_CHECK(err <= VDD_ERR_MV, "device %u, %u mV, %d degC: %u mV", d, v, TEMP_MIN + (int)t,
+						  pAdc->u16_VddIdle);
+				vdd_err = (err > vdd_err) ? err : vdd_err;
+				err = abs(pAdc->s16_Temp - 10 * (TEMP_MIN + (int)t));
+				SIM_CHECK(err <= TEMP_ERR, "device %u, %u mV, %d degC: %.1f degC", d, v, TEMP_MIN + (int)t,
+						  pAdc->s16_Temp / 10.0);
+				temp_err = (err > temp_err) ? err : temp_err;
+				idle++;
+			}
+
+			// Supply in the PA plateau
+			ADC_arm_tx();
+			ADC_start_tx();
+			convert();
+			err = abs((int)pAdc->u16_VddTx - (int)v);
+			SIM_CHECK(err <= VDD_ERR_MV, "device %u, %u mV: %u mV in TX", d, v, pAdc->u16_VddTx);
+			tx_err = (err > tx_err) ? err : tx_err;
+			tx++;
+		}
+		SIM_CHECK((pAdc->u16_Idle == idle) && (pAdc->u16_Tx == tx) && (pAdc->u16_Skipped == 0),
+				  "device %u: %u idle, %u TX, %u skipped measurements", d, pAdc->u16_Idle, pAdc->u16_Tx,
+				  pAdc->u16_Skipped);
+	}
+
+	printf("%u synthetic devices, %u to %u mV, %d to %d degC: VDD error %d mV idle, %d mV TX, "
+		   "temperature error %.1f degC at most\n", NB_DEVICES, VDD_MIN_MV, VDD_MAX_MV, TEMP_MIN, TEMP_MAX,
+		   vdd_err, tx_err, temp_err / 10.0);
+
+	return sim_result("test_adc");
+}
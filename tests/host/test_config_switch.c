@@ -0,0 +1,145 @@
+//*****************************************************************************
+//! @file       test_config_switch.c
+//! @brief      Latency of the TX / RX configuration switches with the
+//!				register shadow, cc112xSpiConfigure(), against the SRES
+//!				and full table writes it replaced.
+//!
+//!				Each switch is made both ways from the same configured
+//!				chip: the register files must end equal, the SPI bytes,
+//!				chip select cycles and time of both are reported. SRES
+//!				restarts the XOSC, the next access waits for it.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define CONFIG_LAST				CC112X_PKT_LEN	// last register of the 8-bit space
+#define EXT_CONFIG_LAST			CC112X_PA_CFG3	// last register of the extended configuration
+#define NB_REGS					((CONFIG_LAST + 1) + (EXT_CONFIG_LAST & 0xFF) + 1 + 1)
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned long frames;
+	unsigned long bytes;
+	uint64_t t;
+}Cost_t;
+
+typedef struct
+{
+	const registerSetting_t *pRegs;
+	uint8 count;
+	const char *name;
+}Settings_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const Settings_t Tx = { HighPerfModeTx, sizeof(HighPerfModeTx) / sizeof(registerSetting_t), "TX" };
+static const Settings_t Rx = { HighPerfModeRx, sizeof(HighPerfModeRx) / sizeof(registerSetting_t), "RX" };
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static void snapshot(uint8_t *regs)
+{
+	unsigned int a, n = 0;
+
+	for (a = 0; a <= CONFIG_LAST; a++)
+	{
+		regs[n++] = sim_radio_reg(a);
+	}
+	for (a = 0x2F00; a <= EXT_CONFIG_LAST; a++)
+	{
+		regs[n++] = sim_radio_reg(a);
+	}
+	regs[n++] = sim_radio_reg(CC112X_SERIAL_STATUS);
+}
+
+static void cost_start(Cost_t *c)
+{
+	c->frames = sim_spi.frames;
+	c->bytes = sim_spi.bytes;
+	c->t = sim_now();
+}
+
+static void cost_end(Cost_t *c)
+{
+	c->frames = sim_spi.frames - c->frames;
+	c->bytes = sim_spi.bytes - c->bytes;
+	c->t = sim_now() - c->t;
+}
+
+/* Settings of radio.c before the shadow: SRES, then each register */
+static void configure_full(const Settings_t *s)
+{
+	uint8 data;
+	uint8 i;
+
+	trxSpiCmdStrobe(CC112X_SIDLE);
+	cc112xSpiReset();
+	for (i = 0; i < s->count; i++)
+	{
+		data = s->pRegs[i].data;
+		cc112xSpiWriteReg(s->pRegs[i].addr, &data, 1);
+	}
+}
+
+static void configure_shadow(const Settings_t *s)
+{
+	trxSpiCmdStrobe(CC112X_SIDLE);
+	cc112xSpiConfigure(s->pRegs, s->count);
+}
+
+static void switch_to(const Settings_t *from, const Settings_t *to)
+{
+	uint8_t regs_full[NB_REGS], regs_shadow[NB_REGS];
+	Cost_t full, shadow;
+
+	configure_shadow(from);
+	cost_start(&shadow);
+	configure_shadow(to);
+	cost_end(&shadow);
+	snapshot(regs_shadow);
+
+	configure_shadow(from);
+	cost_start(&full);
+	configure_full(to);
+	cost_end(&full);
+	snapshot(regs_full);
+
+	SIM_CHECK(memcmp(regs_full, regs_shadow, sizeof(regs_full)) == 0, "%s->%s: registers differ",
+			  from->name, to->name);
+	SIM_CHECK((shadow.bytes <= full.bytes) && (shadow.t < full.t), "%s->%s: slower with the shadow",
+			  from->name, to->name);
+	printf("%s->%s: SRES and table %3lu bytes, %2lu CS, %6.1f us; shadow %3lu bytes, %2lu CS, %6.1f us\n",
+		   from->name, to->name, full.bytes, full.frames, full.t * 1e6 / sim_mclk_hz,
+		   shadow.bytes, shadow.frames, shadow.t * 1e6 / sim_mclk_hz);
+}
+
+int main(void)
+{
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+
+	// The reset values are read on the first configuration
+	configure_shadow(&Tx);
+
+	switch_to(&Tx, &Rx);
+	switch_to(&Rx, &Tx);
+	switch_to(&Tx, &Tx);
+	switch_to(&Rx, &Rx);
+
+	return sim_result("test_config_switch");
+}
@@ -0,0 +1,236 @@
+//*****************************************************************************
+//! @file       test_dma_ramp.c
+//! @brief      RADIO_modulate() with RADIO_DMA_MODULATION against the
+//!				busy-wait PA ramps.
+//!
+//!				Built twice. The busy-wait build writes the PA_CFG2 and
+//!				FREQOFF1/0 writes of the modulation to a file, the DMA
+//!				build checks its DMA descriptors and compares its own
+//!				writes with the file: same bytes in the same order, and
+//!				PA levels as far apart.
+//!
+//!				Usage:	test_dma_ramp_busy <log to write>
+//!						test_dma_ramp_dma <log of the busy-wait build>
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+#include "modulation_table.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_BITS					6			// '0' bits modulated per case
+#define STEP_TOLERANCE			3			// % between the PA steps of the two builds
+#define STEP_SLACK				16			// cycles, SPI byte and interrupt latency
+#define LOG_MAX					20000
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	uint16_t addr;
+	uint8_t value;
+	uint64_t t;				// cycles from the start of the modulation
+}Write_t;
+
+typedef struct
+{
+	te_ModProfileId e_Profile;
+	uint8 u8_NbSteps;
+}Case_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const Case_t Cases[] = {
+	{ E_PROFILE_FCC, NB_PTS_PA },
+	{ E_PROFILE_FCC, 32 },
+	{ E_PROFILE_FCC, 2 },
+	{ E_PROFILE_ETSI, NB_PTS_PA },
+	{ E_PROFILE_ETSI, 16 },
+};
+
+static Write_t Writes[LOG_MAX];
+static unsigned long nb_writes;
+static uint64_t cpu_cycles;				// in RADIO_modulate() and the DMA interrupts
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static int modulation_write(const SimRadioLog_t *e)
+{
+	return (e->kind == SIM_LOG_WRITE)
+			&& ((e->addr == CC112X_PA_CFG2) || (e->addr == CC112X_FREQOFF1) || (e->addr == CC112X_FREQOFF0));
+}
+
+#ifdef RADIO_DMA_MODULATION
+/* Descriptor of the ramp in progress */
+static void check_descriptor(uint8 u8_NbSteps, unsigned int u16_SrcIncr)
+{
+	SIM_CHECK((DMACTL0 & 0x1F) == SIM_DMA_TSEL_TB0CCR0, "DMA trigger %u", DMACTL0 & 0x1F);
+	SIM_CHECK(DMA0SZ == u8_NbSteps, "DMA0SZ %u for %u points", DMA0SZ, u8_NbSteps);
+	SIM_CHECK(DMA0DA == (unsigned long)(uintptr_t)&UCB0TXBUF, "DMA0DA is not UCB0TXBUF");
+	SIM_CHECK((DMA0CTL & 0x7000) == DMADT_0, "DMA transfer mode %04X", DMA0CTL);
+	SIM_CHECK((DMA0CTL & DMADSTINCR_3) == DMADSTINCR_0, "DMA destination moves %04X", DMA0CTL);
+	SIM_CHECK((DMA0CTL & DMASRCINCR_3) == u16_SrcIncr, "DMA source increment %04X", DMA0CTL);
+	SIM_CHECK((DMA0CTL & (DMASRCBYTE | DMADSTBYTE)) == (DMASRCBYTE | DMADSTBYTE), "DMA word transfer %04X", DMA0CTL);
+	SIM_CHECK((DMA0CTL & (DMAIE | DMAEN)) == (DMAIE | DMAEN), "DMA not armed %04X", DMA0CTL);
+	SIM_CHECK(!(TB0CCTL0 & CCIE), "Timer_B0 CCR0 interrupt left on");
+}
+#endif
+
+/* Modulates NB_BITS '0' bits of a case, the writes are appended to Writes */
+static void run_case(const Case_t *c)
+{
+	const SimRadioLog_t *log;
+	unsigned long n, i;
+	uint64_t t0;
+	uint64_t isr;
+	int bit;
+
+	SIM_CHECK(RADIO_select_profile(c->e_Profile), "profile %d", c->e_Profile);
+	RADIO_init_chip(ftx, E_TX_MODE);
+	SIM_CHECK(RADIO_set_ramp_resolution(c->u8_NbSteps), "resolution %u", c->u8_NbSteps);
+	RADIO_start_rf_carrier();
+	__enable_interrupt();
+
+	for (bit = 0; bit < NB_BITS; bit++)
+	{
+		sim_radio_log_clear();
+		t0 = sim_now();
+		isr = sim_cpu.isr;
+		RADIO_modulate();
+		cpu_cycles += sim_now() - t0;
+#ifdef RADIO_DMA_MODULATION
+		SIM_CHECK(RADIO_modulation_busy(), "DMA modulation not queued");
+		check_descriptor(c->u8_NbSteps, DMASRCINCR_3);
+		// Ramp up queued by the DMA interrupt, the table is read backward
+		while ((DMA0CTL & DMASRCINCR_3) != DMASRCINCR_2)
+		{
+			sim_advance(8);
+			SIM_CHECK(RADIO_modulation_busy(), "no ramp up");
+			if (!RADIO_modulation_busy())
+			{
+				break;
+			}
+		}
+		check_descriptor(c->u8_NbSteps, DMASRCINCR_2);
+		while (RADIO_modulation_busy())
+		{
+			sim_advance(8);
+		}
+#else
+		SIM_CHECK(!RADIO_modulation_busy(), "busy-wait modulation still running");
+#endif
+		cpu_cycles += sim_cpu.isr - isr;
+		log = sim_radio_log(&n);
+		for (i = 0; i < n; i++)
+		{
+			if (modulation_write(&log[i]) && (nb_writes < LOG_MAX))
+			{
+				Writes[nb_writes].addr = log[i].addr;
+				Writes[nb_writes].value = log[i].value;
+				Writes[nb_writes].t = log[i].t - t0;
+				nb_writes++;
+			}
+		}
+	}
+	__disable_interrupt();
+	RADIO_stop_rf_carrier();
+}
+
+int main(int argc, char **argv)
+{
+	FILE *f;
+	unsigned int i;
+	unsigned long n;
+#ifdef RADIO_DMA_MODULATION
+	unsigned int addr, value;
+	unsigned long long t;
+	Write_t ref;
+	Write_t prev = { 0, 0, 0 };
+	uint64_t step, ref_step;
+#endif
+
+	if (argc != 2)
+	{
+		printf("usage: %s <log>\n", argv[0]);
+		return 2;
+	}
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+
+	for (i = 0; i < sizeof(Cases) / sizeof(Cases[0]); i++)
+	{
+		run_case(&Cases[i]);
+	}
+	SIM_CHECK(nb_writes > 0, "no modulation write logged");
+	SIM_CHECK(nb_writes < LOG_MAX, "log full");
+	SIM_CHECK(sim_spi.overruns == 0, "%lu SPI TX buffer overruns", sim_spi.overruns);
+
+#ifndef RADIO_DMA_MODULATION
+	f = fopen(argv[1], "w");
+	if (f == NULL)
+	{
+		printf("cannot write %s\n", argv[1]);
+		return 2;
+	}
+	for (n = 0; n < nb_writes; n++)
+	{
+		fprintf(f, "%04X %02X %llu\n", Writes[n].addr, Writes[n].value, (unsigned long long)Writes[n].t);
+	}
+	fclose(f);
+	printf("busy-wait: %lu writes, %llu CPU cycles\n", nb_writes, (unsigned long long)cpu_cycles);
+	return sim_result("test_dma_ramp_busy");
+#else
+	f = fopen(argv[1], "r");
+	if (f == NULL)
+	{
+		printf("cannot read %s, run test_dma_ramp_busy first\n", argv[1]);
+		return 2;
+	}
+	for (n = 0; fscanf(f, "%x %x %llu", &addr, &value, &t) == 3; n++)
+	{
+		ref.addr = (uint16_t)addr;
+		ref.value = (uint8_t)value;
+		ref.t = t;
+		if (n >= nb_writes)
+		{
+			SIM_CHECK(0, "DMA stream ends at write %lu", n);
+			break;
+		}
+		if ((Writes[n].addr != ref.addr) || (Writes[n].value != ref.value))
+		{
+			SIM_CHECK(0, "write %lu: %04X=%02X, busy-wait %04X=%02X", n,
+					  Writes[n].addr, Writes[n].value, ref.addr, ref.value);
+			break;
+		}
+		// Spacing of the PA levels inside a ramp. The DMA ramp starts one
+		// step later, at the first trigger of Timer_B0
+		if ((ref.addr == CC112X_PA_CFG2) && (n > 0) && (prev.addr == CC112X_PA_CFG2)
+			&& (ref.t > prev.t) && (Writes[n].t > Writes[n-1].t))
+		{
+			step = Writes[n].t - Writes[n-1].t;
+			ref_step = ref.t - prev.t;
+			SIM_CHECK((step * 100 <= ref_step * (100 + STEP_TOLERANCE) + 100 * STEP_SLACK)
+					  && (step * 100 + 100 * STEP_SLACK >= ref_step * (100 - STEP_TOLERANCE)),
+					  "write %lu: PA step of %llu cycles, busy-wait %llu", n,
+					  (unsigned long long)step, (unsigned long long)ref_step);
+		}
+		prev = ref;
+	}
+	fclose(f);
+	SIM_CHECK(n == nb_writes, "%lu writes, busy-wait %lu", nb_writes, n);
+	printf("DMA: %lu writes compared, %llu CPU cycles\n", n, (unsigned long long)cpu_cycles);
+	return sim_result("test_dma_ramp_dma");
+#endif
+}
@@ -0,0 +1,263 @@
+//*****************************************************************************
+//! @file       test_downlink_wait.c
+//! @brief      CPU active time of a frame with a downlink, the waits of
+//!				sfx_WaitForTimeoutRx() and sfx_waitframe() slept in LPM3
+//!				against the busy loops they replaced.
+//!
+//!				The library calls of SfxSendFrame(..., ack=TRUE) are
+//!				replayed: three repeats of the uplink with
+//!				sfx_delay(E_TX_DELAY), the 20 s wait, the RX window of
+//!				25 s, then sfx_delay(E_OOB_ACK_DELAY) and the out of band
+//!				frame. The downlink comes 5 s or 12 s into the window, or
+//!				not at all. The same calls run with the loops of the
+//!				previous sfx_WaitForTimeoutRx() and sfx_waitframe(),
+//!				polling TIMER0_timeout and packetSemaphore.
+//!				The waits of both must end at the same time with the same
+//!				result. A wait hook taking HOOK_MS is then registered: it
+//!				must run at least once a second of the waits, with the
+//!				seconds left never going up within a wait.
+//!
+//!				SysState is read through sim_sys_state() (-DSysState in the
+//!				Makefile) so the polling loops move the time of the model.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "sigfox_demo.h"
+#include "radio.h"
+#include "timer.h"
+#include "../../sigfox_library_api/sigfox.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define FRAME_SIZE				12			// uplink payload of the frame
+#define OOB_SIZE				8
+#define NB_REPEATS				3
+#define WAIT_S					20			// uplink to RX window
+#define WINDOW_S				25
+#define POLL_CYCLES				(16 * SIM_CYCLES_SPIN)	// loops of the previous waits, polled in batches
+#define HOOK_MS					2
+#define WAIT_ACTIVE_MAX_MS		20.0		// CPU on in the waits of a frame, without hook
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	const char *name;
+	int at_s;					// downlink into the RX window, < 0 for none
+}Case_t;
+
+typedef struct
+{
+	uint64_t active;			// cycles with the CPU on, whole frame
+	uint64_t wait;				// cycles with the CPU on in the downlink waits
+	uint64_t span;				// cycles of the downlink waits
+	uint64_t end;				// cycle the RX window closed, from the start of the frame
+	SFX_ext_status status;
+}Run_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const Case_t Cases[] = { { "downlink at 5 s", 5 }, { "downlink at 12 s", 12 }, { "no downlink", -1 } };
+
+static u8 Oob[OOB_SIZE];
+static u8 Downlink[RADIO_RX_FRAME_SIZE];
+
+static unsigned long hook_calls;
+static uint16 hook_left;
+static int hook_rises;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static void deliver(void *arg)
+{
+	sim_radio_rx_frame(Downlink, RADIO_RX_FRAME_SIZE);
+}
+
+/* Bounded work of the application, the seconds left never go up in a wait */
+static void hook(u16 seconds_left)
+{
+	hook_calls++;
+	if (seconds_left > hook_left)
+	{
+		hook_rises++;
+	}
+	hook_left = seconds_left;
+	sim_advance((uint64_t)HOOK_MS * sim_mclk_hz / 1000);
+}
+
+/* sfx_WaitForTimeoutRx() before the LPM3 wait */
+static SFX_error_t ref_WaitForTimeoutRx(void)
+{
+	while (TIMER0_timeout == FALSE)
+	{
+		sim_advance(POLL_CYCLES);
+	}
+	TIMER_downlink_timing_stop();
+	return SFX_ERR_NONE;
+}
+
+/* sfx_waitframe() before the LPM3 wait */
+static SFX_ext_status ref_waitframe(u8 *frame)
+{
+	RadioRxFrame_t rx;
+
+	RADIO_start_rx();
+	while ((packetSemaphore == ISR_IDLE) && (TIMER0_timeout == FALSE))
+	{
+		sim_advance(POLL_CYCLES);
+	}
+	if (RADIO_rx_pop(&rx) == true)
+	{
+		memcpy(frame, rx.au8_Data, RADIO_RX_FRAME_SIZE);
+		return E_FRAME_RECEIVED;
+	}
+	if (TIMER0_timeout == TRUE)
+	{
+		TIMER_downlink_timing_stop();
+		RADIO_rx_timeout();
+		return E_FRAME_TIMEOUT;
+	}
+	return E_FRAME_ERROR;
+}
+
+/* Calls of SfxSendFrame(..., ack=TRUE) */
+static void frame(const Case_t *c, int b_Before, Run_t *pRun)
+{
+	uint64_t t0 = sim_now(), active = sim_cpu.active, wait, start;
+	u8 rx[RADIO_RX_FRAME_SIZE];
+	unsigned int repeat;
+
+	for (repeat = 0; repeat < NB_REPEATS; repeat++)
+	{
+		sfx_init(E_TX_MODE);
+		SIM_CHECK(sfx_send(sim_frame, FRAME_SIZE) == SFX_ERR_NONE, "%s: sfx_send, repeat %u", c->name, repeat);
+		if (repeat == 0)
+		{
+			sfx_StartWaitingTimeout(WAIT_S);
+		}
+		if (repeat < NB_REPEATS - 1)
+		{
+			sfx_delay(E_TX_DELAY);
+		}
+	}
+	sfx_close();
+
+	wait = sim_cpu.active;
+	start = sim_now();
+	hook_left = 0xFFFF;
+	if (b_Before)
+	{
+		ref_WaitForTimeoutRx();
+	}
+	else
+	{
+		sfx_WaitForTimeoutRx();
+	}
+	pRun->wait = sim_cpu.active - wait;
+	pRun->span = sim_now() - start;
+
+	sfx_init(E_RX_MODE);
+	sfx_StartRxTimeout(WINDOW_S);
+	if (c->at_s >= 0)
+	{
+		sim_at(sim_now() + (uint64_t)c->at_s * sim_mclk_hz, deliver, NULL);
+	}
+	wait = sim_cpu.active;
+	start = sim_now();
+	hook_left = 0xFFFF;
+	do
+	{
+		pRun->status = b_Before ? ref_waitframe(rx) : sfx_waitframe(rx);
+	} while (pRun->status == E_FRAME_ERROR);
+	pRun->wait += sim_cpu.active - wait;
+	pRun->span += sim_now() - start;
+	pRun->end = sim_now() - t0;
+	if (pRun->status == E_FRAME_RECEIVED)
+	{
+		sfx_StopRxTimeout();
+	}
+	sfx_close();
+
+	sfx_delay(E_OOB_ACK_DELAY);
+	sfx_init(E_TX_MODE);
+	SIM_CHECK(sfx_send(Oob, OOB_SIZE) == SFX_ERR_NONE, "%s: sfx_send of the out of band frame", c->name);
+	sfx_close();
+	TIMER_wait_frame_end();
+	pRun->active = sim_cpu.active - active;
+}
+
+static double ms(uint64_t cycles)
+{
+	return cycles * 1e3 / sim_mclk_hz;
+}
+
+int main(void)
+{
+	const TimerWaitStats_t *stats;
+	Run_t before, after, hooked;
+	unsigned int i;
+	double awake;
+
+	for (i = 0; i < FRAME_SIZE; i++)
+	{
+		sim_frame[i] = (u8)(0x5A ^ (i * 29));
+	}
+	Downlink[RADIO_RX_FRAME_SIZE - 2] = (u8)(-80);
+	Downlink[RADIO_RX_FRAME_SIZE - 1] = 0x80;		// CRC_OK
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	SIM_CHECK(RADIO_select_profile(E_PROFILE_FCC), "profile FCC");
+	TIMER_bitrate_init();
+	TIMER_timebase_init();
+	__enable_interrupt();
+
+	printf("SfxSendFrame(..., ack=TRUE) of %u repeats, CPU on in the downlink waits (whole frame):\n",
+		   NB_REPEATS);
+	for (i = 0; i < sizeof(Cases) / sizeof(Cases[0]); i++)
+	{
+		frame(&Cases[i], 1, &before);
+		frame(&Cases[i], 0, &after);
+		stats = TIMER_wait_stats();
+		awake = (double)stats->ul_Awake * 1e3 / TIMER_TIMEBASE_HZ;
+
+		sfx_set_wait_hook(hook);
+		hook_calls = 0;
+		hook_rises = 0;
+		frame(&Cases[i], 0, &hooked);
+		sfx_set_wait_hook(NULL);
+
+		printf("%-17s busy loops %9.2f ms (%9.2f ms), LPM3 %6.2f ms (%8.2f ms), "
+			   "%2u ms hook %6.2f ms for %lu calls\n", Cases[i].name, ms(before.wait), ms(before.active),
+			   ms(after.wait), ms(after.active), HOOK_MS, ms(hooked.wait), hook_calls);
+
+		SIM_CHECK(after.status == ((Cases[i].at_s >= 0) ? E_FRAME_RECEIVED : E_FRAME_TIMEOUT), "%s: status %u",
+				  Cases[i].name, after.status);
+		SIM_CHECK((after.status == before.status) && (hooked.status == before.status),
+				  "%s: status %u, %u with the hook, %u before", Cases[i].name, after.status, hooked.status,
+				  before.status);
+		SIM_CHECK((after.end + sim_mclk_hz / 1000 >= before.end) && (after.end <= before.end + sim_mclk_hz / 1000),
+				  "%s: window closed at %.3f s, %.3f s before", Cases[i].name, after.end / (double)sim_mclk_hz,
+				  before.end / (double)sim_mclk_hz);
+		SIM_CHECK(ms(after.wait) <= WAIT_ACTIVE_MAX_MS, "%s: CPU on %.2f ms in the waits", Cases[i].name,
+				  ms(after.wait));
+		SIM_CHECK(awake <= ms(after.wait) + 1, "%s: %.2f ms awake counted, %.2f ms on", Cases[i].name, awake,
+				  ms(after.wait));
+		SIM_CHECK(after.active < before.active, "%s: CPU on longer than with the busy loops", Cases[i].name);
+		// A call a second, but for the wake-up ending each of the two waits
+		SIM_CHECK(hook_calls + 2 >= hooked.span / sim_mclk_hz, "%s: %lu hook calls in %.3f s of waits",
+				  Cases[i].name, hook_calls, hooked.span / (double)sim_mclk_hz);
+		SIM_CHECK(hook_rises == 0, "%s: the seconds left went up %d times", Cases[i].name, hook_rises);
+	}
+
+	return sim_result("test_downlink_wait");
+}
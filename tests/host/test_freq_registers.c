@@ -0,0 +1,147 @@
+//*****************************************************************************
+//! @file       test_freq_registers.c
+//! @brief      FREQ2/1/0 written by RADIO_change_frequency() against the
+//!				floating point computation it replaced, at every 100 Hz
+//!				step of the 868 MHz and 902 MHz bands.
+//!
+//!				FREQ = STEP_MULTIPLICATOR * Freq_rf - STPMoverFSR * FREQOFF,
+//!				both products truncated, as the code before the integer
+//!				computation did. It must match the double precision
+//!				result exactly; single precision float, which the MSP430
+//!				compilers may use for double, is reported.
+//!				Then random hops between a few more channels than the
+//!				cache holds: the cached registers must be the right ones.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#if defined(RF_XTAL_FREQ_40MHZ)
+#define STEP_MULTIPLICATOR	0.0065536	// ((2^16)*4)/40000000
+#elif defined(RF_XTAL_FREQ_32MHZ)
+#define STEP_MULTIPLICATOR	0.008192	// ((2^16)*4)/32000000
+#endif
+#define STPMoverFSR			0.25
+#define FREQOFF				0x0258		// FOFF1, FOFF0 of radio.c
+
+#define FREQ_STEP			100			// Hz
+#define HOP_CHANNELS		12			// more than the cache holds
+#define HOPS				10000
+#define HOP_SPACING			25000		// Hz
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned long ul_First;
+	unsigned long ul_Last;
+	const char *name;
+}Band_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const Band_t Bands[] = {
+	{ 863000000UL, 870000000UL, "868 MHz" },
+	{ 902000000UL, 928000000UL, "902 MHz" },
+};
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static unsigned long written(void)
+{
+	return ((unsigned long)sim_radio_reg(CC112X_FREQ2) << 16)
+			| ((unsigned long)sim_radio_reg(CC112X_FREQ1) << 8)
+			| sim_radio_reg(CC112X_FREQ0);
+}
+
+static unsigned long reference_double(unsigned long freq)
+{
+	return ((unsigned long)(STEP_MULTIPLICATOR * freq) - (unsigned long)(STPMoverFSR * FREQOFF)) & 0xFFFFFF;
+}
+
+static unsigned long reference_float(unsigned long freq)
+{
+	return ((unsigned long)((float)STEP_MULTIPLICATOR * (float)freq)
+			- (unsigned long)((float)STPMoverFSR * (float)FREQOFF)) & 0xFFFFFF;
+}
+
+static void sweep(const Band_t *band)
+{
+	unsigned long freq, reg, ref;
+	unsigned long steps = 0, float_diff = 0;
+	long diff, float_max = 0;
+
+	for (freq = band->ul_First; freq <= band->ul_Last; freq += FREQ_STEP)
+	{
+		RADIO_change_frequency(freq);
+		reg = written();
+		ref = reference_double(freq);
+		if (reg != ref)
+		{
+			SIM_CHECK(0, "%s: %lu Hz gives %06lX, double %06lX", band->name, freq, reg, ref);
+			break;
+		}
+		diff = (long)reference_float(freq) - (long)reg;
+		if (diff != 0)
+		{
+			float_diff++;
+			float_max = labs(diff) > float_max ? labs(diff) : float_max;
+		}
+		if ((++steps % 4096) == 0)
+		{
+			sim_radio_log_clear();
+		}
+	}
+	printf("%s: %lu steps of %u Hz equal to double, single precision float off on %lu of them "
+		   "(up to %ld)\n", band->name, steps, FREQ_STEP, float_diff, float_max);
+}
+
+/* Hops between channels in and out of the cache: the cached registers
+ * must be the ones of the channel */
+static void hops(unsigned long ul_Base)
+{
+	unsigned long freq;
+	unsigned int n, k;
+
+	srand(1);
+	for (n = 0; n < HOPS; n++)
+	{
+		k = (unsigned int)rand() % HOP_CHANNELS;
+		freq = ul_Base + k * HOP_SPACING;
+		RADIO_change_frequency(freq);
+		if (written() != reference_double(freq))
+		{
+			SIM_CHECK(0, "hop %u to %lu Hz: %06lX, double %06lX", n, freq, written(), reference_double(freq));
+			break;
+		}
+	}
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	RADIO_init_chip(ftx, E_TX_MODE);
+
+	for (i = 0; i < sizeof(Bands) / sizeof(Bands[0]); i++)
+	{
+		sweep(&Bands[i]);
+	}
+	hops(902200000UL);
+
+	return sim_result("test_freq_registers");
+}
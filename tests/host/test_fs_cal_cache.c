@@ -0,0 +1,203 @@
+//*****************************************************************************
+//! @file       test_fs_cal_cache.c
+//! @brief      Synthesizer calibrations and radio-on time of multi-repeat
+//!				frames, with RADIO_FS_CAL_CACHE against the automatic
+//!				calibration of the chip.
+//!
+//!				Built twice. Each frame is sent NB_REPEATS times on random
+//!				frequencies of the 192 kHz band, every RX_EVERY frame
+//!				opens a downlink window, then the radio sleeps. The chip
+//!				calibrates for SIM_CAL_US when entering TX or RX with
+//!				FS_AUTOCAL, the firmware does not wait for it: the start of
+//!				the carrier is cut, what a driver sending the whole frame
+//!				would add to the radio-on time.
+//!				The build without the cache writes its counts to a file,
+//!				the cache build compares its own with them. The cache
+//!				build then stalls a calibration: the wait must end after
+//!				FS_CAL_TIMEOUT_MS and the channel be calibrated again.
+//!
+//!				Usage:	test_fs_cal_cache_off <results to write>
+//!						test_fs_cal_cache_on <results of the build without>
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+#include "timer.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_FRAMES				200
+#define NB_REPEATS				3
+#define RX_EVERY				4			// frames
+#define BAND_WIDTH				192000		// Hz, around ftx
+#define FREQ_STEP				100			// Hz
+#define FRAME_BITS				(26 * 8)	// longest uplink frame
+#define FRAME_BITRATE			600			// bps, FCC
+#define RX_WINDOW_MS			20			// shortened, the calibration is at its start
+#define NEXT_FRAME_MS			10000
+#define STALL_US				100000		// calibration of a stuck synthesizer
+#define STALL_WAIT_MS			8			// FS_CAL_TIMEOUT_MS and a margin
+#define STALL_FREQ				(ftx + 1000000)		// not in the cache
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned long cals;			// calibrations
+	uint64_t cal;				// cycles calibrating
+	uint64_t cut;				// cycles of carrier or RX window lost to a calibration
+	uint64_t on;				// cycles with the XOSC on
+}Counts_t;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static uint32 random_frequency(void)
+{
+	return ftx - BAND_WIDTH / 2 + FREQ_STEP * ((uint32)rand() % (BAND_WIDTH / FREQ_STEP + 1));
+}
+
+static void cycles_to_ms(const char *name, const Counts_t *c)
+{
+	printf("%-10s %5.2f calibrations, %6.3f ms calibrating, %6.3f ms cut, radio on %8.3f ms "
+		   "(%8.3f ms with the cut)\n", name, (double)c->cals / NB_FRAMES,
+		   c->cal * 1e3 / sim_mclk_hz / NB_FRAMES, c->cut * 1e3 / sim_mclk_hz / NB_FRAMES,
+		   c->on * 1e3 / sim_mclk_hz / NB_FRAMES, (c->on + c->cut) * 1e3 / sim_mclk_hz / NB_FRAMES);
+}
+
+/* The frames, the counts per frame go to *pCounts */
+static void run(Counts_t *pCounts)
+{
+	uint64_t cal;
+	unsigned int frame, repeat;
+
+	srand(1);
+	memset(pCounts, 0, sizeof(*pCounts));
+	for (frame = 0; frame < NB_FRAMES; frame++)
+	{
+		for (repeat = 0; repeat < NB_REPEATS; repeat++)
+		{
+			RADIO_init_chip(random_frequency(), E_TX_MODE);
+			cal = sim_radio.cal;
+			RADIO_start_rf_carrier();
+			pCounts->cut += sim_radio.cal - cal;
+			sim_advance(((uint64_t)FRAME_BITS * sim_mclk_hz) / FRAME_BITRATE);
+			RADIO_stop_rf_carrier();
+		}
+		if ((frame % RX_EVERY) == (RX_EVERY - 1))
+		{
+			RADIO_init_chip(frx, E_RX_MODE);
+			cal = sim_radio.cal;
+			RADIO_start_rx();
+			pCounts->cut += sim_radio.cal - cal;
+			sim_advance(((uint64_t)RX_WINDOW_MS * sim_mclk_hz) / 1000);
+		}
+		RADIO_power_next_tx(NEXT_FRAME_MS);
+		RADIO_close_chip();
+		sim_radio_log_clear();
+		sim_advance(((uint64_t)NEXT_FRAME_MS * sim_mclk_hz) / 1000);
+	}
+	pCounts->cals = sim_radio.cals;
+	pCounts->cal = sim_radio.cal;
+	pCounts->on = sim_radio_on_cycles();
+}
+
+#ifdef RADIO_FS_CAL_CACHE
+/* A calibration not back to IDLE in time: not cached, calibrated again */
+static void check_stall(void)
+{
+	uint64_t t0;
+	unsigned long cals;
+
+	TIMER_timebase_init();
+	__enable_interrupt();
+
+	sim_radio_set_cal_us(STALL_US);
+	t0 = sim_now();
+	RADIO_init_chip(STALL_FREQ, E_TX_MODE);
+	SIM_CHECK(sim_now() - t0 < (uint64_t)STALL_WAIT_MS * sim_mclk_hz / 1000, "stalled calibration: %.1f ms waited",
+			  (sim_now() - t0) * 1e3 / sim_mclk_hz);
+	sim_advance((uint64_t)STALL_US * sim_mclk_hz / 1000000);
+	sim_radio_set_cal_us(0);
+
+	cals = sim_radio.cals;
+	RADIO_init_chip(STALL_FREQ, E_TX_MODE);
+	SIM_CHECK(sim_radio.cals == cals + 1, "after a stalled calibration: %lu calibrations, 1 expected",
+			  sim_radio.cals - cals);
+	RADIO_init_chip(STALL_FREQ, E_TX_MODE);
+	SIM_CHECK(sim_radio.cals == cals + 1, "after a calibration: %lu calibrations in two hops, 1 expected",
+			  sim_radio.cals - cals);
+	RADIO_close_chip();
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	FILE *f;
+	Counts_t counts;
+#ifdef RADIO_FS_CAL_CACHE
+	Counts_t ref;
+	unsigned long long cal, cut, on;
+#endif
+
+	if (argc != 2)
+	{
+		printf("usage: %s <results>\n", argv[0]);
+		return 2;
+	}
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	run(&counts);
+
+#ifndef RADIO_FS_CAL_CACHE
+	SIM_CHECK(counts.cals >= NB_FRAMES * NB_REPEATS, "%lu calibrations for %u carriers", counts.cals,
+			  NB_FRAMES * NB_REPEATS);
+	f = fopen(argv[1], "w");
+	if (f == NULL)
+	{
+		printf("cannot write %s\n", argv[1]);
+		return 2;
+	}
+	fprintf(f, "%lu %llu %llu %llu\n", counts.cals, (unsigned long long)counts.cal,
+			(unsigned long long)counts.cut, (unsigned long long)counts.on);
+	fclose(f);
+	printf("per frame of %u repeats, RX every %u:\n", NB_REPEATS, RX_EVERY);
+	cycles_to_ms("autocal", &counts);
+	return sim_result("test_fs_cal_cache_off");
+#else
+	f = fopen(argv[1], "r");
+	if (f == NULL)
+	{
+		printf("cannot read %s, run test_fs_cal_cache_off first\n", argv[1]);
+		return 2;
+	}
+	if (fscanf(f, "%lu %llu %llu %llu", &ref.cals, &cal, &cut, &on) != 4)
+	{
+		printf("cannot parse %s\n", argv[1]);
+		fclose(f);
+		return 2;
+	}
+	fclose(f);
+	ref.cal = cal;
+	ref.cut = cut;
+	ref.on = on;
+
+	printf("per frame of %u repeats, RX every %u:\n", NB_REPEATS, RX_EVERY);
+	cycles_to_ms("autocal", &ref);
+	cycles_to_ms("cache", &counts);
+	SIM_CHECK(counts.cut == 0, "%llu cycles of carrier cut with the cache", (unsigned long long)counts.cut);
+	SIM_CHECK(counts.cals < ref.cals, "%lu calibrations, %lu without the cache", counts.cals, ref.cals);
+	SIM_CHECK(counts.on + counts.cut < ref.on + ref.cut, "radio on longer with the cache");
+	check_stall();
+	return sim_result("test_fs_cal_cache_on");
+#endif
+}
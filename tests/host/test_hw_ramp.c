@@ -0,0 +1,430 @@
+//*****************************************************************************
+//! @file       test_hw_ramp.c
+//! @brief      SPI traffic, CPU time and PA envelope of the software ramps
+//!				against the hardware ramps of RADIO_HW_PA_RAMP.
+//!
+//!				Built twice. For each profile a frame of three repeats is
+//!				sent with sfx_send(), the SPI accesses, PA_CFG2 writes and
+//!				CPU busy time are counted. Then the carrier start, a '0' bit
+//!				and the carrier stop are modulated alone and the envelope of
+//!				the PA is rebuilt from the chip accesses:
+//!				\li PA_CFG2 without PA_RAMP_SHAPE_EN: the written level from
+//!					the write, in TX
+//!				\li PA_CFG2 with PA_RAMP_SHAPE_EN: the chip ramps on TX
+//!					entry and exit, in three equal steps of PA_POWER_RAMP
+//!					through FIRST_IPL/16 and (8 + SECOND_IPL)/16 of PA_CFG1,
+//!					over the RAMP_SHAPE fraction of the SYMBOL_RATE symbol
+//!				A PA_POWER_RAMP level is (level + 1) / 2 - 18 dBm. With
+//!				the PA ramp profiles the FREQOFF steps of the bit must be
+//!				made in the dip (ETSI_OPT steps FREQOFF all along the
+//!				bit), the bit must end at the full level.
+//!				The software build writes its results to a file, the
+//!				hardware build compares its own with them.
+//!
+//!				Usage:	test_hw_ramp_sw <results to write>
+//!						test_hw_ramp_hw <results of the software build>
+//!
+//!				SysState is read through sim_sys_state() (-DSysState in the
+//!				Makefile) so the polling loops move the time of the model.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "sigfox_demo.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+#include "timer.h"
+#include "transmission.h"
+#include "../../sigfox_library_api/sigfox.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define FRAME_SIZE				SIM_FRAME_SIZE	// longest uplink frame
+#define NB_REPEATS				3
+#define NB_PROFILES				3
+#define NB_SAMPLES				17			// envelope samples across a '0' bit
+#define OFF_DB					-99.0		// PA off
+#define DIP_MAX_DB				-25.0		// highest level of a FREQOFF step
+#define FULL_MIN_DB				-0.5		// lowest level at the end of a bit
+#define DIP_DB					-20.0		// level of the dip width
+#define RAMP_WAIT_MS			10			// after the carrier stop
+
+#define PA_CFG2_RAMP_SHAPE_EN	0x40
+#define PA_POWER_RAMP_MAX		0x3F
+
+#if defined(RF_XTAL_FREQ_40MHZ)
+#define XOSC_HZ					40000000.0
+#else
+#define XOSC_HZ					32000000.0
+#endif
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned long spi;			// chip select frames
+	unsigned long pa;			// PA_CFG2 writes
+	uint64_t cpu;				// cycles with the CPU on
+	double env[NB_SAMPLES];		// dB of the full level across a '0' bit
+	double dip;					// us below DIP_DB in the bit
+}Result_t;
+
+/* PA state rebuilt from the chip accesses */
+typedef struct
+{
+	uint8_t pa_cfg2;
+	uint8_t pa_cfg1;
+	uint8_t rate[3];			// SYMBOL_RATE2, 1, 0
+	int tx;						// in TX
+	int level;					// PA_POWER_RAMP of the level written without shaping
+	uint64_t edge;				// cycle of the last TX entry or exit
+}Pa_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const te_ModProfileId Profiles[NB_PROFILES] = { E_PROFILE_FCC, E_PROFILE_ETSI, E_PROFILE_ETSI_OPT };
+static const char *const Names[NB_PROFILES] = { "FCC", "ETSI", "ETSI_OPT" };
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* Length of a hardware ramp in cycles: RAMP_SHAPE of the symbol time */
+static double ramp_cycles(const Pa_t *pa)
+{
+	static const double Shape[4] = { 3.0 / 8, 3.0 / 2, 3.0, 6.0 };
+	uint32_t m = ((uint32_t)(pa->rate[0] & 0x0F) << 16) | ((uint32_t)pa->rate[1] << 8) | pa->rate[2];
+	double rate = ((double)(1UL << 20) + m) * (double)(1UL << (pa->rate[0] >> 4)) / ldexp(1.0, 39) * XOSC_HZ;
+
+	return Shape[pa->pa_cfg1 & 0x03] / rate * sim_mclk_hz;
+}
+
+/* PA_POWER_RAMP of a hardware ramp at f (0 to 1) of its length */
+static double ramp_level(const Pa_t *pa, double f)
+{
+	double ipl1 = (double)(pa->pa_cfg1 >> 5) / 16;
+	double ipl2 = (double)(8 + ((pa->pa_cfg1 >> 2) & 0x07)) / 16;
+	double target = pa->pa_cfg2 & PA_POWER_RAMP_MAX;
+
+	if (f < 1.0 / 3)
+	{
+		return target * ipl1 * f * 3;
+	}
+	if (f < 2.0 / 3)
+	{
+		return target * (ipl1 + (ipl2 - ipl1) * (f * 3 - 1));
+	}
+	return target * (ipl2 + (1.0 - ipl2) * ((f < 1.0) ? f * 3 - 2 : 1.0));
+}
+
+/* Level at t, dB of the full level */
+static double level_db(const Pa_t *pa, uint64_t t)
+{
+	double f;
+
+	if (pa->pa_cfg2 & PA_CFG2_RAMP_SHAPE_EN)
+	{
+		f = (double)(t - pa->edge) / ramp_cycles(pa);
+		if (!pa->tx)
+		{
+			if (f >= 1.0)
+			{
+				return OFF_DB;
+			}
+			f = 1.0 - f;
+		}
+		return (ramp_level(pa, f) - PA_POWER_RAMP_MAX) / 2;
+	}
+	return pa->tx ? (double)(pa->level - PA_POWER_RAMP_MAX) / 2 : OFF_DB;
+}
+
+/* PA off, the ramp settings are the ones of the configuration: the log
+ * starts at the carrier start */
+static void pa_reset(Pa_t *pa)
+{
+	memset(pa, 0, sizeof(*pa));
+	pa->pa_cfg1 = sim_radio_reg(CC112X_PA_CFG1);
+	pa->rate[0] = sim_radio_reg(CC112X_SYMBOL_RATE2);
+	pa->rate[1] = sim_radio_reg(CC112X_SYMBOL_RATE2 + 1);
+	pa->rate[2] = sim_radio_reg(CC112X_SYMBOL_RATE2 + 2);
+}
+
+/* Applies the accesses of the log up to t */
+static void pa_update(Pa_t *pa, const SimRadioLog_t *log, unsigned long n, unsigned long *pi, uint64_t t)
+{
+	const SimRadioLog_t *e;
+
+	for (; (*pi < n) && (log[*pi].t <= t); (*pi)++)
+	{
+		e = &log[*pi];
+		if (e->kind == SIM_LOG_WRITE)
+		{
+			switch (e->addr)
+			{
+			case CC112X_PA_CFG2:
+				pa->pa_cfg2 = e->value;
+				if (!(e->value & PA_CFG2_RAMP_SHAPE_EN))
+				{
+					pa->level = e->value & PA_POWER_RAMP_MAX;
+				}
+				break;
+			case CC112X_PA_CFG1:
+				pa->pa_cfg1 = e->value;
+				break;
+			case CC112X_SYMBOL_RATE2:
+			case CC112X_SYMBOL_RATE2 + 1:
+			case CC112X_SYMBOL_RATE2 + 2:
+				pa->rate[e->addr - CC112X_SYMBOL_RATE2] = e->value;
+				break;
+			default:
+				break;
+			}
+		}
+		else if (e->kind == SIM_LOG_STROBE)
+		{
+			if (!pa->tx && (e->addr == CC112X_STX))
+			{
+				pa->tx = 1;
+				pa->edge = e->t;
+				pa->level = pa->pa_cfg2 & PA_POWER_RAMP_MAX;
+			}
+			else if (pa->tx && (e->state != SIM_MARC_TX))
+			{
+				pa->tx = 0;
+				pa->edge = e->t;
+			}
+		}
+	}
+}
+
+/* A frame of NB_REPEATS repeats, the counts go to *pResult */
+static void frame(Result_t *pResult)
+{
+	const SimRadioLog_t *log;
+	unsigned long spi = sim_spi.frames, n, i;
+	uint64_t cpu = sim_cpu.active;
+	unsigned int repeat;
+
+	pResult->pa = 0;
+	for (repeat = 0; repeat < NB_REPEATS; repeat++)
+	{
+		sim_radio_log_clear();
+		sfx_init(E_TX_MODE);
+		SIM_CHECK(sfx_send(sim_frame, FRAME_SIZE) == SFX_ERR_NONE, "repeat %u: sfx_send", repeat);
+		log = sim_radio_log(&n);
+		for (i = 0; i < n; i++)
+		{
+			pResult->pa += (log[i].kind == SIM_LOG_WRITE) && (log[i].addr == CC112X_PA_CFG2);
+		}
+	}
+	sfx_close();
+	sim_radio_log_clear();
+	pResult->spi = sim_spi.frames - spi;
+	pResult->cpu = sim_cpu.active - cpu;
+}
+
+/* Carrier start, a '0' bit and carrier stop, the envelope of the bit goes
+ * to *pResult. b_Dip: the FREQOFF steps are made in a dip of the PA */
+static void envelope(const char *name, bool b_Dip, Result_t *pResult)
+{
+	const SimRadioLog_t *log;
+	Pa_t pa;
+	unsigned long n, i = 0, k;
+	uint64_t t_bit, period, t, t_end, dip = 0;
+	double db;
+	unsigned int s, foff = 0;
+
+	RADIO_init_chip(ftx, E_TX_MODE);
+	TIMER_bitrate_init();
+	period = (uint64_t)(TA1CCR0 + 1) * (1u << ((TA1CTL >> 6) & 0x03));
+
+	// Synthesizer calibrated first, the carrier ramps are not cut by it
+	trxSpiCmdStrobe(CC112X_SFSTXON);
+	while (sim_radio_state() != SIM_MARC_FSTXON)
+	{
+		sim_advance(64);
+	}
+	__enable_interrupt();
+	sim_radio_log_clear();
+
+	RADIO_start_rf_carrier();
+	sim_advance(period);
+	t_bit = sim_now();
+	RADIO_modulate();
+	while (RADIO_modulation_busy())
+	{
+		sim_advance(8);
+	}
+	sim_advance(t_bit + period - sim_now());
+	RADIO_stop_rf_carrier();
+	sim_advance(((uint64_t)RAMP_WAIT_MS * sim_mclk_hz) / 1000);
+	t_end = sim_now();
+	__disable_interrupt();
+
+	log = sim_radio_log(&n);
+	pa_reset(&pa);
+	pa_update(&pa, log, n, &i, t_bit);
+	SIM_CHECK(level_db(&pa, t_bit) >= FULL_MIN_DB, "%s: %.1f dB at the start of the bit", name,
+			  level_db(&pa, t_bit));
+	for (s = 0; s < NB_SAMPLES; s++)
+	{
+		t = t_bit + (period * s) / (NB_SAMPLES - 1);
+		pa_update(&pa, log, n, &i, t);
+		pResult->env[s] = level_db(&pa, t);
+	}
+
+	// Dip width and level at the FREQOFF steps
+	pa_reset(&pa);
+	i = 0;
+	for (t = t_bit; t < t_bit + period; t += sim_mclk_hz / 1000000)
+	{
+		pa_update(&pa, log, n, &i, t);
+		dip += (level_db(&pa, t) < DIP_DB);
+	}
+	pResult->dip = (double)dip;
+	pa_reset(&pa);
+	i = 0;
+	for (k = 0; k < n; k++)
+	{
+		if (!b_Dip || (log[k].t < t_bit) || (log[k].kind != SIM_LOG_WRITE) || (log[k].addr != CC112X_FREQOFF0))
+		{
+			continue;
+		}
+		pa_update(&pa, log, n, &i, log[k].t);
+		db = level_db(&pa, log[k].t);
+		foff++;
+		SIM_CHECK(db <= DIP_MAX_DB, "%s: FREQOFF0 step %u at %.1f dB", name, foff, db);
+	}
+	SIM_CHECK(!b_Dip || (foff > 0), "%s: no FREQOFF0 step in the bit", name);
+	SIM_CHECK(pResult->env[NB_SAMPLES - 1] >= FULL_MIN_DB, "%s: %.1f dB at the end of the bit", name,
+			  pResult->env[NB_SAMPLES - 1]);
+	pa_update(&pa, log, n, &i, t_end);
+	SIM_CHECK(level_db(&pa, t_end) == OFF_DB, "%s: PA on %u ms after the carrier stop", name, RAMP_WAIT_MS);
+}
+
+static void print(const char *build, const char *name, const Result_t *r)
+{
+	unsigned int s;
+
+	printf("%-8s %-8s %7lu SPI accesses, %6lu PA_CFG2 writes, CPU busy %8.3f ms, dip %5.0f us\n", build, name,
+		   r->spi, r->pa, r->cpu * 1e3 / sim_mclk_hz, r->dip);
+	printf("         envelope dB:");
+	for (s = 0; s < NB_SAMPLES; s++)
+	{
+		if (r->env[s] <= OFF_DB)
+		{
+			printf("   off");
+		}
+		else
+		{
+			printf(" %5.1f", r->env[s]);
+		}
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	FILE *f;
+	Result_t results[NB_PROFILES];
+	unsigned int p, s;
+#ifdef RADIO_HW_PA_RAMP
+	Result_t ref;
+	unsigned long long cpu;
+#endif
+
+	if (argc != 2)
+	{
+		printf("usage: %s <results>\n", argv[0]);
+		return 2;
+	}
+	srand(1);
+	for (s = 0; s < FRAME_SIZE; s++)
+	{
+		sim_frame[s] = (u8)rand();
+	}
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	for (p = 0; p < NB_PROFILES; p++)
+	{
+		SIM_CHECK(RADIO_select_profile(Profiles[p]), "profile %s", Names[p]);
+		TIMER_bitrate_init();
+		__enable_interrupt();
+		frame(&results[p]);
+		__disable_interrupt();
+		envelope(Names[p], Profiles[p] != E_PROFILE_ETSI_OPT, &results[p]);
+	}
+
+	printf("per frame of %u repeats of %u bytes, envelope of a '0' bit:\n", NB_REPEATS, FRAME_SIZE);
+#ifndef RADIO_HW_PA_RAMP
+	f = fopen(argv[1], "w");
+	if (f == NULL)
+	{
+		printf("cannot write %s\n", argv[1]);
+		return 2;
+	}
+	for (p = 0; p < NB_PROFILES; p++)
+	{
+		fprintf(f, "%lu %lu %llu %.1f", results[p].spi, results[p].pa, (unsigned long long)results[p].cpu,
+				results[p].dip);
+		for (s = 0; s < NB_SAMPLES; s++)
+		{
+			fprintf(f, " %.2f", results[p].env[s]);
+		}
+		fprintf(f, "\n");
+		print("software", Names[p], &results[p]);
+	}
+	fclose(f);
+	return sim_result("test_hw_ramp_sw");
+#else
+	f = fopen(argv[1], "r");
+	if (f == NULL)
+	{
+		printf("cannot read %s, run test_hw_ramp_sw first\n", argv[1]);
+		return 2;
+	}
+	for (p = 0; p < NB_PROFILES; p++)
+	{
+		if (fscanf(f, "%lu %lu %llu %lf", &ref.spi, &ref.pa, &cpu, &ref.dip) != 4)
+		{
+			printf("cannot parse %s\n", argv[1]);
+			fclose(f);
+			return 2;
+		}
+		ref.cpu = cpu;
+		for (s = 0; s < NB_SAMPLES; s++)
+		{
+			if (fscanf(f, "%lf", &ref.env[s]) != 1)
+			{
+				printf("cannot parse %s\n", argv[1]);
+				fclose(f);
+				return 2;
+			}
+		}
+		print("software", Names[p], &ref);
+		print("hardware", Names[p], &results[p]);
+
+		SIM_CHECK(results[p].spi <= ref.spi, "%s: %lu SPI accesses, %lu with the software ramps", Names[p],
+				  results[p].spi, ref.spi);
+		SIM_CHECK(results[p].cpu <= ref.cpu, "%s: CPU busy longer with the hardware ramps", Names[p]);
+		if (Profiles[p] != E_PROFILE_ETSI_OPT)
+		{
+			// Two PA_CFG2 writes per repeat, the carrier start and stop, and
+			// one of RADIO_calibrate_timing() after the profile change
+			SIM_CHECK(results[p].pa <= 2 * NB_REPEATS + 1, "%s: %lu PA_CFG2 writes", Names[p], results[p].pa);
+			SIM_CHECK(results[p].spi * 10 < ref.spi, "%s: %lu SPI accesses, %lu with the software ramps",
+					  Names[p], results[p].spi, ref.spi);
+		}
+	}
+	fclose(f);
+	return sim_result("test_hw_ramp_hw");
+#endif
+}
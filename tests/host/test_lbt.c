@@ -0,0 +1,623 @@
+//*****************************************************************************
+//! @file       test_lbt.c
+//! @brief      Listen before talk: the listen of RADIO_lbt() on the CC112x
+//!				model, then the messages delivered by a cell of nodes with
+//!				and without it.
+//!
+//!				The listen must run with the receive chain of the RX
+//!				settings, wait for RSSI_VALID, and leave every register of
+//!				the TX settings as it found them: the shadow of
+//!				cc112xSpiConfigure() must still match the chip. An RSSI
+//!				valid only after RADIO_LBT_LISTEN_MS must still be seen,
+//!				a listen without a valid RSSI must count busy.
+//!
+//!				The cell is a model: nodes in a disk of CELL_KM around the
+//!				base station send MSG_PER_H messages an hour, each of
+//!				NB_COPIES copies of COPY_S on a random frequency of the
+//!				band. A copy is lost at the base station when a copy
+//!				within UNB_COLLIDE_HZ, or a wideband interferer burst over
+//!				its frequency, overlaps it without CAPTURE_DB of margin.
+//!				The interferers are in a disk of INT_KM.
+//!				With LBT, the nodes replay RADIO_lbt(): a listen returns
+//!				what RADIO_lbt_listen() returned on the CC112x model for
+//!				the RSSI the node hears in LISTEN_BW_HZ at that time (once
+//!				per RSSI value, the channel held for the listen), each
+//!				backoff is RADIO_lbt_backoff(). The same messages,
+//!				frequencies and bursts are drawn for both runs.
+//!				These are models, the counts show how LBT behaves, not
+//!				what a network gets on the field.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "radio.c"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define SETTLE_LATE_MS			8			// RSSI_VALID after RADIO_LBT_LISTEN_MS
+#define HOUR_S					3600.0
+#define CELL_KM					3.0
+#define INT_KM					10.0		// interferers, around the base station
+#define MSG_PER_H				6
+#define NB_COPIES				3
+#define COPY_S					2.08		// 26 bytes at 100 bps
+#define COPY_GAP_S				0.5			// sfx_delay(E_TX_DELAY)
+#define BAND_HZ					192000.0
+#define UNB_COLLIDE_HZ			200.0
+#define CAPTURE_DB				6.0
+#define TX_DBM					14.0
+#define NODE_EXTRA_DB			10.0		// node to node, both at ground level
+#define NOISE_DBM				(-133.0)	// in LISTEN_BW_HZ, 4 dB noise figure
+#define LISTEN_BW_HZ			4700.0		// CHAN_BW of the RX settings, 40 MHz XTAL
+#define WB_HZ					125000.0	// wideband interferer
+#define WB_BURST_S				0.4
+#define RSSI_MIN				(-140)		// RSSI values of the listens
+#define RSSI_MAX				20
+#define LBT_SLACK				0.002		// of the messages, LBT may lose to the other draws
+#define NB_CASES				(sizeof(Cases) / sizeof(Cases[0]))
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned int nodes;
+	unsigned int interferers;
+	double duty;				// of each interferer
+}Case_t;
+
+typedef struct
+{
+	double x, y;				// km from the base station
+}Pos_t;
+
+typedef struct
+{
+	double start;
+	double freq;				// Hz in the band, the low edge for a burst
+	double dbm;					// at the base station
+	unsigned int src;			// node, or nodes + interferer
+	unsigned long msg;			// of a copy
+}Tx_t;
+
+typedef struct
+{
+	double t;
+	unsigned int msg;
+	unsigned int copy;
+	unsigned int attempt;
+	double first;				// time the message was due
+}Event_t;
+
+typedef struct
+{
+	unsigned long msgs;
+	unsigned long delivered;
+	unsigned long copies;
+	unsigned long listens;
+	unsigned long busy;
+	unsigned long forced;
+	double delay;				// of the first copies, s
+	double delay_max;
+	double listen_s;			// radio on in the listens
+}Run_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const Case_t Cases[] = { { 5000, 0, 0 }, { 5000, 50, 0.01 }, { 2000, 20, 0.10 } };
+
+static Pos_t *Nodes;
+static Pos_t *Ints;
+static double *MsgTime;			// due time of each message
+static unsigned int *MsgNode;
+static double *MsgFreq;			// NB_COPIES frequencies a message
+static Tx_t *Bursts;
+static unsigned long nb_bursts;
+static Tx_t *Copies;
+static unsigned long nb_copies;
+static Event_t *Heap;
+static unsigned long heap_len;
+static int8 ListenRssi[RSSI_MAX - RSSI_MIN + 1];	// RADIO_lbt_listen() at each RSSI, 0 till known
+static double ListenS[RSSI_MAX - RSSI_MIN + 1];
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static void *alloc(size_t size)
+{
+	void *p = calloc(1, size);
+
+	if (p == NULL)
+	{
+		printf("FATAL: out of memory\n");
+		exit(2);
+	}
+	return p;
+}
+
+static Pos_t in_disk(double km)
+{
+	Pos_t p;
+	double r = km * sqrt(sim_uniform()), a = 2 * M_PI * sim_uniform();
+
+	p.x = r * cos(a);
+	p.y = r * sin(a);
+	return p;
+}
+
+/* Path loss at 868 MHz, dB */
+static double path_loss(double km)
+{
+	return 128.1 + 37.6 * log10((km < 0.01) ? 0.01 : km);
+}
+
+static double distance(Pos_t a, Pos_t b)
+{
+	return hypot(a.x - b.x, a.y - b.y);
+}
+
+/******************************************************************************
+ * THE LISTEN
+ */
+/* Registers of the listen, sampled in RX */
+static int in_rx;
+static uint8 rx_regs[sizeof(LbtRegs) / sizeof(LbtRegs[0])];
+
+static void sample(void *arg)
+{
+	unsigned int i;
+
+	in_rx = (sim_radio_state() == SIM_MARC_RX);
+	for (i = 0; i < sizeof(LbtRegs) / sizeof(LbtRegs[0]); i++)
+	{
+		rx_regs[i] = sim_radio_reg(LbtRegs[i]);
+	}
+}
+
+/* Configuration space of the chip, 8-bit then extended, but for the calibration results */
+static void registers(uint8_t *regs)
+{
+	unsigned int i;
+
+	for (i = 0; i <= CC112X_PKT_LEN; i++)
+	{
+		regs[i] = sim_radio_reg(i);
+	}
+	for (i = 0; i <= (CC112X_PA_CFG3 & 0xFF); i++)
+	{
+		regs[CC112X_PKT_LEN + 1 + i] = sim_radio_reg(0x2F00 | i);
+	}
+	regs[CC112X_PKT_LEN + 1 + (CC112X_FS_CHP & 0xFF)] = 0;
+	for (i = CC112X_FS_VCO4 & 0xFF; i <= (CC112X_FS_VCO1 & 0xFF); i++)
+	{
+		regs[CC112X_PKT_LEN + 1 + i] = 0;
+	}
+}
+
+/* Registers cc112xSpiConfigure() writes for the TX settings */
+static unsigned long configure_tx(void)
+{
+	unsigned long writes = sim_spi.writes;
+
+	cc112xSpiConfigure(HighPerfModeTx, sizeof(HighPerfModeTx) / sizeof(registerSetting_t));
+	return sim_spi.writes - writes;
+}
+
+static void check_listen(void)
+{
+	uint8_t before[CC112X_PKT_LEN + 1 + (CC112X_PA_CFG3 & 0xFF) + 1];
+	uint8_t after[sizeof(before)];
+	unsigned long writes;
+	unsigned int i, j, nb = 0;
+	uint64_t t0;
+	int8 rssi;
+
+	// What the TX settings write over a TX frame set up, no listen
+	RADIO_init_chip(ftx, E_TX_MODE);
+	RADIO_init_chip(ftx, E_TX_MODE);
+	writes = configure_tx();
+	RADIO_init_chip(ftx, E_TX_MODE);
+	registers(before);
+
+	// A listen on a busy channel, RSSI_VALID on time
+	sim_radio_set_rssi(-90, (uint64_t)sim_mclk_hz / 1000);
+	in_rx = 0;
+	sim_at(sim_now() + 3 * (uint64_t)sim_mclk_hz / 1000, sample, NULL);
+	rssi = RADIO_lbt_listen();
+	SIM_CHECK(rssi == -90, "listen: RSSI %d dBm, -90 expected", rssi);
+	SIM_CHECK(in_rx, "listen: the chip was not in RX");
+	for (i = 0; i < sizeof(LbtRegs) / sizeof(LbtRegs[0]); i++)
+	{
+		for (j = 0; j < sizeof(HighPerfModeRx) / sizeof(registerSetting_t); j++)
+		{
+			if (HighPerfModeRx[j].addr == LbtRegs[i])
+			{
+				SIM_CHECK(rx_regs[i] == HighPerfModeRx[j].data, "listen: register %04X at %02X in RX, %02X in "
+						  "the RX settings", LbtRegs[i], rx_regs[i], HighPerfModeRx[j].data);
+				nb++;
+			}
+		}
+	}
+	SIM_CHECK(nb > 0, "listen: no receive chain register in the RX settings");
+
+	// Back to the TX settings, the shadow matching the chip
+	registers(after);
+	for (i = 0; i < sizeof(before); i++)
+	{
+		SIM_CHECK(after[i] == before[i], "listen: register %u at %02X after, %02X before", i, after[i], before[i]);
+	}
+	SIM_CHECK(sim_radio_state() == SIM_MARC_IDLE, "listen: chip %02X after", sim_radio_state());
+	j = configure_tx();
+	SIM_CHECK(j == writes, "listen: %u registers of the TX settings written after, %lu without", j, writes);
+	RADIO_init_chip(ftx, E_TX_MODE);
+
+	// Below the int8 range: clear
+	sim_radio_set_rssi(-133, (uint64_t)sim_mclk_hz / 1000);
+	rssi = RADIO_lbt_listen();
+	SIM_CHECK(rssi == RADIO_LBT_NO_RSSI + 1, "-133 dBm: RSSI %d dBm", rssi);
+
+	// RSSI_VALID after the listen time: still sampled
+	sim_radio_set_rssi(-90, (uint64_t)SETTLE_LATE_MS * sim_mclk_hz / 1000);
+	rssi = RADIO_lbt_listen();
+	SIM_CHECK(rssi == -90, "RSSI valid after %u ms: %d dBm, -90 expected", SETTLE_LATE_MS, rssi);
+
+	// Never valid: bounded, and busy
+	sim_radio_set_rssi(-120, (uint64_t)10 * sim_mclk_hz);
+	t0 = sim_now();
+	rssi = RADIO_lbt_listen();
+	SIM_CHECK(rssi == RADIO_LBT_NO_RSSI, "RSSI never valid: %d dBm", rssi);
+	SIM_CHECK(sim_now() - t0 <= (uint64_t)(RADIO_LBT_SETTLE_MS + 2) * sim_mclk_hz / 1000,
+			  "RSSI never valid: listen of %.1f ms", (sim_now() - t0) * 1e3 / sim_mclk_hz);
+	SIM_CHECK(RADIO_lbt() == false, "RSSI never valid: channel clear");
+	SIM_CHECK(RADIO_lbt_stats()->u16_Forced == 1, "RSSI never valid: %u frames forced",
+			  RADIO_lbt_stats()->u16_Forced);
+
+	// A clear channel
+	sim_radio_set_rssi(-120, (uint64_t)sim_mclk_hz / 1000);
+	SIM_CHECK(RADIO_lbt() == true, "-120 dBm: channel busy");
+	SIM_CHECK(RADIO_lbt_stats()->u16_Clear[0] == 1, "-120 dBm: %u frames clear at the first listen",
+			  RADIO_lbt_stats()->u16_Clear[0]);
+	sim_radio_log_clear();
+}
+
+/******************************************************************************
+ * THE CELL
+ */
+/* RADIO_lbt_listen() at an RSSI, returns its time in s */
+static int8 listen(int dbm, double *pSeconds)
+{
+	unsigned int i;
+	uint64_t t0;
+
+	dbm = (dbm < RSSI_MIN) ? RSSI_MIN : (dbm > RSSI_MAX) ? RSSI_MAX : dbm;
+	i = dbm - RSSI_MIN;
+	if (ListenS[i] == 0)
+	{
+		sim_radio_set_rssi(dbm, (uint64_t)sim_mclk_hz / 1000);
+		t0 = sim_now();
+		ListenRssi[i] = RADIO_lbt_listen();
+		ListenS[i] = (double)(sim_now() - t0) / sim_mclk_hz;
+		sim_radio_log_clear();
+	}
+	*pSeconds = ListenS[i];
+	return ListenRssi[i];
+}
+
+static void heap_push(Event_t e)
+{
+	unsigned long i = heap_len++;
+
+	while ((i > 0) && (Heap[(i - 1) / 2].t > e.t))
+	{
+		Heap[i] = Heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	Heap[i] = e;
+}
+
+static Event_t heap_pop(void)
+{
+	Event_t top = Heap[0], last = Heap[--heap_len];
+	unsigned long i = 0, c;
+
+	while ((c = 2 * i + 1) < heap_len)
+	{
+		if ((c + 1 < heap_len) && (Heap[c + 1].t < Heap[c].t))
+		{
+			c++;
+		}
+		if (Heap[c].t >= last.t)
+		{
+			break;
+		}
+		Heap[i] = Heap[c];
+		i = c;
+	}
+	Heap[i] = last;
+	return top;
+}
+
+static double add_dbm(double mw, double dbm)
+{
+	return mw + pow(10.0, dbm / 10.0);
+}
+
+/* First burst still on the air at t */
+static unsigned long first_burst(double t)
+{
+	unsigned long lo = 0, hi = nb_bursts, mid;
+
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if (Bursts[mid].start + WB_BURST_S <= t)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/* RSSI a node hears at t, on LISTEN_BW_HZ around freq */
+static int heard(unsigned int node, double t, double freq, unsigned int nb_nodes)
+{
+	double mw = pow(10.0, NOISE_DBM / 10.0), lo = freq - LISTEN_BW_HZ / 2, hi = freq + LISTEN_BW_HZ / 2;
+	unsigned long b;
+	long i;
+
+	for (i = (long)nb_copies - 1; (i >= 0) && (Copies[i].start > t - COPY_S); i--)
+	{
+		if ((Copies[i].src != node) && (Copies[i].start <= t) && (Copies[i].freq > lo) && (Copies[i].freq < hi))
+		{
+			mw = add_dbm(mw, TX_DBM - path_loss(distance(Nodes[node], Nodes[Copies[i].src])) - NODE_EXTRA_DB);
+		}
+	}
+	for (b = first_burst(t); (b < nb_bursts) && (Bursts[b].start <= t); b++)
+	{
+		if ((Bursts[b].start + WB_BURST_S > t) && (Bursts[b].freq < hi) && (Bursts[b].freq + WB_HZ > lo))
+		{
+			mw = add_dbm(mw, TX_DBM - path_loss(distance(Nodes[node], Ints[Bursts[b].src - nb_nodes]))
+						 - NODE_EXTRA_DB);
+		}
+	}
+	return (int)lround(10.0 * log10(mw));
+}
+
+static int collides(const Tx_t *c, const Tx_t *o)
+{
+	return (fabs(o->freq - c->freq) < UNB_COLLIDE_HZ) && (c->dbm - o->dbm < CAPTURE_DB);
+}
+
+/* A copy survives the other copies and the bursts at the base station, the copies sorted by start */
+static int survives(unsigned long k)
+{
+	const Tx_t *c = &Copies[k];
+	unsigned long i;
+
+	for (i = k; (i-- > 0) && (c->start - Copies[i].start < COPY_S);)
+	{
+		if (collides(c, &Copies[i]))
+		{
+			return 0;
+		}
+	}
+	for (i = k + 1; (i < nb_copies) && (Copies[i].start - c->start < COPY_S); i++)
+	{
+		if (collides(c, &Copies[i]))
+		{
+			return 0;
+		}
+	}
+	for (i = first_burst(c->start); (i < nb_bursts) && (Bursts[i].start < c->start + COPY_S); i++)
+	{
+		if ((Bursts[i].freq <= c->freq) && (Bursts[i].freq + WB_HZ >= c->freq) && (c->dbm - Bursts[i].dbm < CAPTURE_DB))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static double gap(double duty)
+{
+	return -log(1.0 - sim_uniform()) * WB_BURST_S * (1.0 - duty) / duty;
+}
+
+static int by_start(const void *a, const void *b)
+{
+	double d = ((const Tx_t *)a)->start - ((const Tx_t *)b)->start;
+
+	return (d > 0) - (d < 0);
+}
+
+/* The nodes, messages and bursts of a case, the same for both runs */
+static unsigned long draw(const Case_t *c)
+{
+	unsigned long nb_msgs = (unsigned long)c->nodes * MSG_PER_H, m;
+	unsigned int i, k;
+	double t;
+
+	sim_seed(0x2545F491u + c->nodes * 31u + c->interferers);
+	for (i = 0; i < c->nodes; i++)
+	{
+		Nodes[i] = in_disk(CELL_KM);
+	}
+	for (i = 0; i < c->interferers; i++)
+	{
+		Ints[i] = in_disk(INT_KM);
+	}
+	for (m = 0; m < nb_msgs; m++)
+	{
+		MsgNode[m] = (unsigned int)(m / MSG_PER_H);
+		MsgTime[m] = HOUR_S * sim_uniform();
+		for (k = 0; k < NB_COPIES; k++)
+		{
+			MsgFreq[m * NB_COPIES + k] = BAND_HZ * sim_uniform();
+		}
+	}
+	nb_bursts = 0;
+	for (i = 0; i < c->interferers; i++)
+	{
+		// Bursts of WB_BURST_S, exponential gaps for the duty cycle
+		for (t = gap(c->duty); t < HOUR_S + 20; t += WB_BURST_S + gap(c->duty))
+		{
+			Bursts[nb_bursts].start = t;
+			Bursts[nb_bursts].freq = (BAND_HZ + WB_HZ) * sim_uniform() - WB_HZ;
+			Bursts[nb_bursts].dbm = TX_DBM - path_loss(distance(Ints[i], (Pos_t){ 0, 0 }));
+			Bursts[nb_bursts].src = c->nodes + i;
+			nb_bursts++;
+		}
+	}
+	qsort(Bursts, nb_bursts, sizeof(Tx_t), by_start);
+	return nb_msgs;
+}
+
+static void run(const Case_t *c, int b_Lbt, Run_t *pRun)
+{
+	unsigned long nb_msgs = draw(c), m, k;
+	unsigned char *Delivered = alloc(nb_msgs);
+	unsigned int node;
+	double listen_s;
+	Event_t e;
+	int8 rssi;
+
+	memset(pRun, 0, sizeof(Run_t));
+	pRun->msgs = nb_msgs;
+	nb_copies = 0;
+	heap_len = 0;
+	for (m = 0; m < nb_msgs; m++)
+	{
+		heap_push((Event_t){ MsgTime[m], (unsigned int)m, 0, 0, MsgTime[m] });
+	}
+
+	while (heap_len > 0)
+	{
+		e = heap_pop();
+		node = MsgNode[e.msg];
+		if (b_Lbt)
+		{
+			// RADIO_lbt(), the channel of the node at e.t
+			rssi = listen(heard(node, e.t, MsgFreq[e.msg * NB_COPIES + e.copy], c->nodes), &listen_s);
+			pRun->listen_s += listen_s;
+			pRun->listens++;
+			e.t += listen_s;
+			if ((rssi == RADIO_LBT_NO_RSSI) || (rssi >= RADIO_LBT_THRESHOLD))
+			{
+				pRun->busy++;
+				if (e.attempt < RADIO_LBT_ATTEMPTS - 1)
+				{
+					e.t += RADIO_lbt_backoff((uint8)rssi) / 1000.0;
+					e.attempt++;
+					heap_push(e);
+					continue;
+				}
+				pRun->forced++;
+			}
+		}
+		if (e.copy == 0)
+		{
+			pRun->delay += e.t - e.first;
+			if (e.t - e.first > pRun->delay_max)
+			{
+				pRun->delay_max = e.t - e.first;
+			}
+		}
+
+		// The copy on the air
+		Copies[nb_copies].start = e.t;
+		Copies[nb_copies].freq = MsgFreq[e.msg * NB_COPIES + e.copy];
+		Copies[nb_copies].dbm = TX_DBM - path_loss(distance(Nodes[node], (Pos_t){ 0, 0 }));
+		Copies[nb_copies].src = node;
+		Copies[nb_copies].msg = e.msg;
+		nb_copies++;
+		if (e.copy < NB_COPIES - 1)
+		{
+			heap_push((Event_t){ e.t + COPY_S + COPY_GAP_S, e.msg, e.copy + 1, 0, e.first });
+		}
+	}
+
+	// The copies start in the order of their listens, a listen is not always as long
+	qsort(Copies, nb_copies, sizeof(Tx_t), by_start);
+	for (k = 0; k < nb_copies; k++)
+	{
+		if (survives(k))
+		{
+			Delivered[Copies[k].msg] = 1;
+		}
+	}
+	pRun->copies = nb_copies;
+	for (m = 0; m < nb_msgs; m++)
+	{
+		pRun->delivered += Delivered[m];
+	}
+	pRun->delay /= nb_msgs;
+	free(Delivered);
+}
+
+int main(void)
+{
+	unsigned int max_nodes = 0, max_ints = 0, i;
+	unsigned long max_bursts;
+	Run_t off, on;
+	double lost_off, lost_on;
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	SIM_CHECK(RADIO_select_profile(E_PROFILE_FCC), "profile FCC");
+	TIMER_timebase_init();
+	__enable_interrupt();
+
+	check_listen();
+
+	for (i = 0; i < NB_CASES; i++)
+	{
+		max_nodes = (Cases[i].nodes > max_nodes) ? Cases[i].nodes : max_nodes;
+		max_ints = (Cases[i].interferers > max_ints) ? Cases[i].interferers : max_ints;
+	}
+	max_bursts = (unsigned long)(max_ints * (HOUR_S + 20) / WB_BURST_S) + 1;
+	Nodes = alloc(max_nodes * sizeof(Pos_t));
+	Ints = alloc((max_ints + 1) * sizeof(Pos_t));
+	MsgTime = alloc(max_nodes * MSG_PER_H * sizeof(double));
+	MsgNode = alloc(max_nodes * MSG_PER_H * sizeof(unsigned int));
+	MsgFreq = alloc(max_nodes * MSG_PER_H * NB_COPIES * sizeof(double));
+	Bursts = alloc(max_bursts * sizeof(Tx_t));
+	Copies = alloc(max_nodes * MSG_PER_H * NB_COPIES * sizeof(Tx_t));
+	Heap = alloc(max_nodes * MSG_PER_H * sizeof(Event_t));
+
+	printf("%.0f km cell, %u messages/h of %u copies, an hour, delivered messages:\n", CELL_KM, MSG_PER_H,
+		   NB_COPIES);
+	printf("nodes  wideband interferers     no LBT      LBT   busy listens  forced  delay of 1st copy (max)  "
+		   "radio on a listen\n");
+	for (i = 0; i < NB_CASES; i++)
+	{
+		run(&Cases[i], 0, &off);
+		run(&Cases[i], 1, &on);
+		lost_off = 1.0 - (double)off.delivered / off.msgs;
+		lost_on = 1.0 - (double)on.delivered / on.msgs;
+
+		printf("%5u  %4u x %4.1f %%        %9lu %9lu  %10.1f %%  %6lu  %8.0f ms (%5.0f ms)  %10.2f ms\n",
+			   Cases[i].nodes, Cases[i].interferers, Cases[i].duty * 100, off.delivered, on.delivered,
+			   on.busy * 100.0 / on.listens, on.forced, on.delay * 1e3, on.delay_max * 1e3,
+			   on.listen_s * 1e3 / on.listens);
+
+		SIM_CHECK((off.copies == off.msgs * NB_COPIES) && (on.copies == on.msgs * NB_COPIES),
+				  "%u nodes: %lu and %lu copies sent of %lu", Cases[i].nodes, off.copies, on.copies,
+				  off.msgs * NB_COPIES);
+		SIM_CHECK(lost_on <= lost_off + LBT_SLACK, "%u nodes, %u interferers: %.2f %% lost with LBT, %.2f %% without",
+				  Cases[i].nodes, Cases[i].interferers, lost_on * 100, lost_off * 100);
+		SIM_CHECK(on.delay_max <= (RADIO_LBT_ATTEMPTS - 1) * RADIO_LBT_BACKOFF_MAX / 1000.0
+				  + RADIO_LBT_ATTEMPTS * (RADIO_LBT_SETTLE_MS + RADIO_LBT_LISTEN_MS + 5) / 1000.0,
+				  "%u nodes: first copy %.0f ms late", Cases[i].nodes, on.delay_max * 1e3);
+	}
+
+	return sim_result("test_lbt");
+}
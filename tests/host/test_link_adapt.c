@@ -0,0 +1,318 @@
+//*****************************************************************************
+//! @file       test_link_adapt.c
+//! @brief      Uplink frames delivered and energy per delivered frame with
+//!				the repeats set by sfx_link_adapt() (TX_REPEAT_ADAPTIVE),
+//!				and the power with TX_POWER_ADAPTIVE, against TxRep fixed
+//!				at 2 at full power, over a lossy channel.
+//!
+//!				Each frame is sent with the repeats of sfx_link_adapt().
+//!				The channel is a model: each frame draws a shadowing of
+//!				SHADOW_DB rms around the link margin, each copy a Rayleigh
+//!				fading, and is lost below 0 dB or to INTERFERENCE. The
+//!				frame is delivered if a copy is. One frame in ACK_EVERY asks
+//!				for a downlink: if it was delivered, the downlink frame
+//!				draws its own fading and interference, with the RSSI of
+//!				the margin over LINK_RSSI_FLOOR, plus dl_extra dB for a link
+//!				stronger down than up. It is injected in the RX
+//!				window of the CC112x model, read by sfx_waitframe() as
+//!				SfxSendFrame() does, the window closed by sfx_close().
+//!				The uplink itself is not modulated: a copy lasts COPY_S at
+//!				the TX current of its power, CC1120 at 3.3 V from TxCurrent[]
+//!				(datasheet typicals, linear in dB in between), and sees the
+//!				margin less the backoff. The RX window costs RX_MW for the
+//!				time it stays open.
+//!				These are models, the rates show how the controller
+//!				behaves, not what a device gets on the field.
+//!
+//!				Per case, after WARMUP frames: the adaptive repeats must
+//!				deliver what the fixed ones do, or TX_LINK_RELIABILITY,
+//!				within DELIVERY_SLACK. After a missed ack the frames must
+//!				go out with REPEAT_MAX repeats till LINK_HOLD acks. With
+//!				margin to spare, the energy per delivered frame must drop.
+//!				With TX_POWER_ADAPTIVE, the backoff must be 0 while the
+//!				frames go out with REPEAT_MAX repeats after a miss, and
+//!				with POWER_MARGIN_DB of margin the TX current must drop
+//!				by POWER_SAVING_MIN.
+//!
+//!				manufacturer_api.c is built into the test to start each
+//!				case as a new device.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "flash_drv.h"
+#include "../../manufacturer_api/manufacturer_api.c"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_FRAMES				20000
+#define WARMUP					1000		// frames before the counts
+#define SHADOW_DB				4.0			// rms, a frame and its downlink
+#define INTERFERENCE			0.01		// copies and downlinks lost whatever the margin
+#define TX_V					3.3
+#define COPY_S					2.08		// 26 bytes at 100 bps
+#define TX_DBM_MAX				14			// PA level 63
+#define RX_MW					(3.3 * 22.0)
+#define DOWNLINK_AT_MS			1500		// in the RX window
+#define WINDOW_S				25
+#define DELIVERY_SLACK			0.005
+#define SAVING_MARGIN_DB		25			// and over, the adaptive repeats must save energy
+#define SAVING_MIN				0.25		// of the energy per delivered frame
+#define POWER_MARGIN_DB			30			// and over, TX_POWER_ADAPTIVE must lower the current
+#define POWER_SAVING_MIN		0.12		// of the TX current
+#define NB_CASES				(sizeof(Cases) / sizeof(Cases[0]))
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	int margin;					// dB of the uplink at the base station
+	unsigned int ack_every;		// frames per downlink request
+	int dl_extra;				// dB more margin the downlink RSSI shows
+}Case_t;
+
+typedef struct
+{
+	unsigned long frames;
+	unsigned long delivered;
+	unsigned long copies;
+	unsigned long acks;			// downlink requests
+	unsigned long acked;
+	unsigned long held;			// frames sent with less than REPEAT_MAX or under full power after a miss, before LINK_HOLD acks
+	double backoff;				// dB below the full power, sum over the frames
+	double ma;					// TX current, sum over the frames
+	double mj;
+}Run_t;
+
+typedef struct
+{
+	int dbm;
+	double ma;
+}TxCurrent_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const Case_t Cases[] = { { 10, 32, 0 }, { 20, 32, 0 }, { 25, 32, 0 }, { 30, 32, 0 }, { 40, 32, 0 },
+								{ 30, 4, 0 }, { 15, 8, 10 } };
+
+/* CC1120 TX current at 3.3 V by output power, high to low */
+static const TxCurrent_t TxCurrent[] = { { 14, 45.0 }, { 10, 34.0 }, { 0, 24.0 }, { -10, 20.0 } };
+
+static int dl_rssi;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* Margin of a copy, dB: Rayleigh fading, exponential power */
+static double faded(double margin)
+{
+	return margin + 10.0 * log10(-log(1.0 - sim_uniform()) + 1e-12);
+}
+
+static int received(double margin)
+{
+	return (faded(margin) >= 0) && (sim_uniform() >= INTERFERENCE);
+}
+
+/* TX current, mA, at backoff dB below the full power */
+static double tx_ma(double backoff)
+{
+	double dbm = TX_DBM_MAX - backoff;
+	unsigned int i;
+
+	for (i = 1; i < sizeof(TxCurrent) / sizeof(TxCurrent[0]) - 1; i++)
+	{
+		if (dbm >= TxCurrent[i].dbm)
+		{
+			break;
+		}
+	}
+	return TxCurrent[i].ma + (TxCurrent[i - 1].ma - TxCurrent[i].ma) * (dbm - TxCurrent[i].dbm)
+		   / (TxCurrent[i - 1].dbm - TxCurrent[i].dbm);
+}
+
+/* Backoff of the frame sfx_link_adapt() set, dB */
+static unsigned int backoff(int b_Adaptive)
+{
+#ifdef TX_POWER_ADAPTIVE
+	return b_Adaptive ? u8_PowerBackoff : 0;
+#else
+	return 0;
+#endif
+}
+
+/* End of the downlink frame on the air */
+static void deliver(void *arg)
+{
+	u8 data[RADIO_RX_FRAME_SIZE];
+	int raw = dl_rssi + RSSI_OFFSET;
+
+	memset(data, 0x5A, sizeof(data));
+	data[RADIO_RX_FRAME_SIZE - 2] = (u8)((raw > 127) ? 127 : (raw < -128) ? -128 : raw);
+	data[RADIO_RX_FRAME_SIZE - 1] = 0x80;		// CRC_OK
+	sim_radio_rx_frame(data, RADIO_RX_FRAME_SIZE);
+}
+
+/* RX window of SfxSendFrame(..., ack=TRUE), returns TRUE on a frame */
+static int window(int b_Downlink, Run_t *pRun)
+{
+	u8 frame[RADIO_RX_FRAME_SIZE];
+	SFX_ext_status status;
+	uint64_t t0;
+
+	sfx_init(E_RX_MODE);
+	sfx_StartRxTimeout(WINDOW_S);
+	t0 = sim_now();
+	if (b_Downlink)
+	{
+		sim_at(t0 + (uint64_t)DOWNLINK_AT_MS * sim_mclk_hz / 1000, deliver, NULL);
+	}
+	do
+	{
+		status = sfx_waitframe(frame);
+	} while (status == E_FRAME_ERROR);
+	if (status == E_FRAME_RECEIVED)
+	{
+		sfx_StopRxTimeout();
+	}
+	pRun->mj += RX_MW * (sim_now() - t0) / sim_mclk_hz;
+	sfx_close();
+	return (status == E_FRAME_RECEIVED);
+}
+
+/* A new device: the controller starts over, the RSSI average is too old */
+static void new_device(void)
+{
+	u16_LinkPenalty = 0;
+	u8_LinkHold = 0;
+	u8_LinkAge = LINK_RSSI_AGE;
+	u16_LinkRssiFrames = RADIO_link_stats()->u16_CrcOk;
+	*TxRepeat = REPEAT_MAX;
+#ifdef TX_POWER_ADAPTIVE
+	sfx_power_set(0);
+#endif
+}
+
+static void run(const Case_t *c, int b_Adaptive, Run_t *pRun)
+{
+	unsigned long f;
+	unsigned int copy, holding = 0, db;
+	double shadow, dl, ma;
+	int b_Delivered, b_Acked;
+
+	memset(pRun, 0, sizeof(Run_t));
+	new_device();
+	sim_seed(0x9E3779B9u + c->margin * 7919u + c->ack_every);
+
+	for (f = 0; f < WARMUP + NB_FRAMES; f++)
+	{
+		if (f == WARMUP)
+		{
+			memset(pRun, 0, sizeof(Run_t));
+		}
+		if (b_Adaptive)
+		{
+			sfx_link_adapt();
+		}
+		db = backoff(b_Adaptive);
+		if (holding && ((*TxRepeat < REPEAT_MAX) || (db > 0)))
+		{
+			pRun->held++;
+		}
+
+		shadow = c->margin + SHADOW_DB * sim_gaussian();
+		b_Delivered = 0;
+		for (copy = 0; copy <= *TxRepeat; copy++)
+		{
+			b_Delivered |= received(shadow - db);
+		}
+		ma = tx_ma(db);
+		pRun->frames++;
+		pRun->copies += *TxRepeat + 1;
+		pRun->delivered += b_Delivered;
+		pRun->backoff += db;
+		pRun->ma += ma;
+		pRun->mj += (*TxRepeat + 1) * TX_V * ma * COPY_S;
+
+		if ((f % c->ack_every) == 0)
+		{
+			// The downlink, its RSSI from the same fading
+			dl = faded(shadow + c->dl_extra);
+			dl_rssi = (int)lround(LINK_RSSI_FLOOR + dl);
+			b_Acked = window(b_Delivered && (dl >= 0) && (sim_uniform() >= INTERFERENCE), pRun);
+			pRun->acks++;
+			pRun->acked += b_Acked;
+			holding = b_Acked ? ((holding > 0) ? holding - 1 : 0) : LINK_HOLD;
+		}
+	}
+}
+
+static double mj_per_msg(const Run_t *r)
+{
+	return r->delivered ? r->mj / r->delivered : 0;
+}
+
+int main(void)
+{
+	Run_t fixed, adaptive;
+	double target = TX_LINK_RELIABILITY / 1000.0, ref, saving, ma;
+	unsigned int i;
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	SIM_CHECK(RADIO_select_profile(E_PROFILE_FCC), "profile FCC");
+	TIMER_bitrate_init();
+	TIMER_timebase_init();
+	__enable_interrupt();
+
+	printf("%u frames, %.0f dB shadowing, Rayleigh fading, %.0f %% interference, target %.1f %%:\n", NB_FRAMES,
+		   SHADOW_DB, INTERFERENCE * 100, target * 100);
+	printf("margin  down  acks   TxRep 2: delivered  mA  J/msg   adaptive: delivered  backoff  mA  J/msg  repeats  acked\n");
+	for (i = 0; i < NB_CASES; i++)
+	{
+		run(&Cases[i], 0, &fixed);
+		run(&Cases[i], 1, &adaptive);
+		saving = 1.0 - mj_per_msg(&adaptive) / mj_per_msg(&fixed);
+		ma = adaptive.ma / adaptive.frames;
+
+		printf("%3d dB  %+3d  1/%-2u  %15.2f %%  %4.1f  %5.3f  %17.2f %%  %4.1f dB  %4.1f  %5.3f  %7.2f  %5.1f %%\n",
+			   Cases[i].margin, Cases[i].dl_extra, Cases[i].ack_every, fixed.delivered * 100.0 / fixed.frames,
+			   fixed.ma / fixed.frames, mj_per_msg(&fixed) / 1000, adaptive.delivered * 100.0 / adaptive.frames,
+			   adaptive.backoff / adaptive.frames, ma, mj_per_msg(&adaptive) / 1000,
+			   (double)adaptive.copies / adaptive.frames - 1, adaptive.acked * 100.0 / adaptive.acks);
+
+		ref = (double)fixed.delivered / fixed.frames;
+		ref = (ref < target) ? ref : target;
+		SIM_CHECK((double)adaptive.delivered / adaptive.frames >= ref - DELIVERY_SLACK,
+				  "%d dB, ack 1/%u: %.2f %% delivered, %.2f %% expected", Cases[i].margin, Cases[i].ack_every,
+				  adaptive.delivered * 100.0 / adaptive.frames, ref * 100);
+		SIM_CHECK(adaptive.copies <= adaptive.frames * (REPEAT_MAX + 1), "%d dB, ack 1/%u: %.2f copies a frame",
+				  Cases[i].margin, Cases[i].ack_every, (double)adaptive.copies / adaptive.frames);
+		SIM_CHECK(adaptive.held == 0, "%d dB, ack 1/%u: %lu frames with fewer repeats after a missed ack",
+				  Cases[i].margin, Cases[i].ack_every, adaptive.held);
+		if (Cases[i].margin >= SAVING_MARGIN_DB)
+		{
+			SIM_CHECK(saving >= SAVING_MIN, "%d dB, ack 1/%u: %.1f %% of the energy saved", Cases[i].margin,
+					  Cases[i].ack_every, saving * 100);
+		}
+#ifdef TX_POWER_ADAPTIVE
+		if (Cases[i].margin >= POWER_MARGIN_DB)
+		{
+			SIM_CHECK(ma <= tx_ma(0) * (1.0 - POWER_SAVING_MIN), "%d dB, ack 1/%u: %.1f mA on average",
+					  Cases[i].margin, Cases[i].ack_every, ma);
+		}
+#endif
+	}
+
+#ifdef TX_POWER_ADAPTIVE
+	return sim_result("test_link_power");
+#else
+	return sim_result("test_link_adapt");
+#endif
+}
@@ -0,0 +1,433 @@
+//*****************************************************************************
+//! @file       test_link_stats.c
+//! @brief      Link statistics of the RX interrupt, against a model of the
+//!				frames the CC112x model received.
+//!
+//!				RX windows are opened with sfx_init(E_RX_MODE) on a few
+//!				RX frequencies, with 0 to 3 frames each at the line rate,
+//!				of a random RSSI, some with a CRC error. The library reads
+//!				them with sfx_waitframe() and ends the window on the first
+//!				frame with CRC OK, or on the timeout. Each frame the radio
+//!				receives updates the model: RSSI histogram, average with a
+//!				weight of 1/8, min and max, CRC OK and error counts, RX
+//!				windows and windows with a frame of each frequency, and
+//!				the timeouts. RADIO_link_stats() must give the same counts,
+//!				the average within LINK_AVG_ERR dB (integer 1/16 dBm).
+//!				Then:
+//!				\li a window where the ring fills up: the frames dropped
+//!					are counted all the same
+//!				\li a ninth frequency replaces the first one followed
+//!				\li each counter about to overflow halves its group
+//!				\li RADIO_link_snapshot() and AT$PL? give the same bytes,
+//!					decoded back to RADIO_link_stats()
+//!
+//!				radio.c is built into the test to set the counters next to
+//!				their overflow.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "radio.c"
+#include "sim.h"
+#include "sigfox_demo.h"
+#include "host_cmd.h"
+#include "../../sigfox_library_api/sigfox.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_WINDOWS				120
+#define NB_FREQS				6			// RX frequencies of the random windows
+#define FREQ_STEP				25000UL		// Hz between them
+#define FRAMES_MAX				3			// frames of a window
+#define CRC_ERRORS				0.15		// frames with a CRC error
+#define RSSI_MIN				(-140)		// dBm of the frames
+#define RSSI_MAX				(-40)
+#define FRAME_CYCLES			((uint64_t)224 * sim_mclk_hz / 600)	// 224 bits at 600 bps
+#define FIRST_MS				500			// SRX to the end of the first frame
+#define CHECK_MS				50			// check of a frame by the library
+#define WINDOW_S				25
+#define LINK_AVG_ERR			0.5			// dB, truncation of the 1/16 dBm average
+#define UART_SIZE				512
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned long freq;
+	unsigned int windows;
+	unsigned int hits;
+}RefChannel_t;
+
+/* What the RX interrupt has seen, computed again */
+typedef struct
+{
+	unsigned int hist[RADIO_LINK_RSSI_BINS];
+	double avg;
+	int min;
+	int max;
+	unsigned int crc_ok;
+	unsigned int crc_fails;
+	unsigned int timeouts;
+	RefChannel_t channels[RADIO_LINK_CHANNELS + 1];
+	RefChannel_t *pChannel;		// channel of the window
+	int b_Hit;
+}Ref_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static Ref_t ref;
+
+static int Rssi[8];			// frames of the window
+static int CrcOk[8];
+
+static char uart[UART_SIZE];
+static unsigned int uart_len;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+extern void byteToHex(unsigned char byte, char *hex);
+
+/* UART of the AT commands */
+void uartPutStr(char *str, unsigned char length)
+{
+	while (length-- && (uart_len < UART_SIZE))
+	{
+		uart[uart_len++] = *str++;
+	}
+}
+
+void uartPutChar(char character)
+{
+	uartPutStr(&character, 1);
+}
+
+/* The model of a frame read by the RX interrupt */
+static void ref_frame(int rssi, int b_CrcOk)
+{
+	int bin;
+
+	if (!b_CrcOk)
+	{
+		ref.crc_fails++;
+		return;
+	}
+	if (ref.crc_ok == 0)
+	{
+		ref.avg = rssi;
+		ref.min = rssi;
+		ref.max = rssi;
+	}
+	ref.avg += (rssi - ref.avg) / 8;
+	ref.min = (rssi < ref.min) ? rssi : ref.min;
+	ref.max = (rssi > ref.max) ? rssi : ref.max;
+	// 8-bit in the statistics
+	ref.min = (ref.min < -128) ? -128 : ref.min;
+	ref.max = (ref.max < -128) ? -128 : ref.max;
+	ref.crc_ok++;
+
+	bin = (int)floor((rssi - RADIO_LINK_RSSI_LOW) / (double)(1 << RADIO_LINK_RSSI_SHIFT)) + 1;
+	bin = (bin < 0) ? 0 : (bin >= RADIO_LINK_RSSI_BINS) ? RADIO_LINK_RSSI_BINS - 1 : bin;
+	ref.hist[bin]++;
+
+	if (!ref.b_Hit)
+	{
+		ref.b_Hit = 1;
+		ref.pChannel->hits++;
+	}
+}
+
+/* End of a frame on the air */
+static void deliver(void *arg)
+{
+	u8 data[RADIO_RX_FRAME_SIZE];
+	unsigned int i = (unsigned int)(uintptr_t)arg;
+
+	if (sim_radio_state() != SIM_MARC_RX)
+	{
+		return;
+	}
+	memset(data, 0x3C, sizeof(data));
+	data[RADIO_RX_FRAME_SIZE - 2] = (u8)(Rssi[i] + RX_RSSI_OFFSET);
+	data[RADIO_RX_FRAME_SIZE - 1] = CrcOk[i] ? 0x80 : 0x00;
+	sim_radio_rx_frame(data, RADIO_RX_FRAME_SIZE);
+	ref_frame(Rssi[i], CrcOk[i]);
+}
+
+static RefChannel_t *ref_channel(unsigned long freq)
+{
+	unsigned int i;
+
+	for (i = 0; (i < RADIO_LINK_CHANNELS + 1) && (ref.channels[i].freq != 0); i++)
+	{
+		if (ref.channels[i].freq == freq)
+		{
+			return &ref.channels[i];
+		}
+	}
+	ref.channels[i].freq = freq;
+	return &ref.channels[i];
+}
+
+/* A RX window of nb frames, as SfxSendFrame(..., ack=TRUE) reads it */
+static void window(unsigned long freq, unsigned int nb, uint16 check_ms)
+{
+	u8 frame[RADIO_RX_FRAME_SIZE];
+	SFX_ext_status status;
+	uint64_t t0;
+	unsigned int i;
+
+	*RxCF = freq;
+	ref.pChannel = ref_channel(freq);
+	ref.pChannel->windows++;
+	ref.b_Hit = 0;
+
+	sfx_init(E_RX_MODE);
+	sfx_StartRxTimeout(WINDOW_S);
+	t0 = sim_now() + (uint64_t)FIRST_MS * sim_mclk_hz / 1000;
+	for (i = 0; i < nb; i++)
+	{
+		sim_at(t0 + i * FRAME_CYCLES, deliver, (void *)(uintptr_t)i);
+	}
+	do
+	{
+		status = sfx_waitframe(frame);
+		if (status == E_FRAME_RECEIVED)
+		{
+			sim_advance((uint64_t)check_ms * sim_mclk_hz / 1000);
+			if (frame[RADIO_RX_FRAME_SIZE - 1] & 0x80)
+			{
+				sfx_StopRxTimeout();
+				break;
+			}
+		}
+	} while (status != E_FRAME_TIMEOUT);
+	if (status == E_FRAME_TIMEOUT)
+	{
+		ref.timeouts++;
+	}
+	sfx_close();
+
+	// The frames after the end of the window find the radio off
+	sim_advance((uint64_t)nb * FRAME_CYCLES + (uint64_t)FIRST_MS * sim_mclk_hz / 1000);
+}
+
+static void random_window(unsigned long freq)
+{
+	unsigned int nb = (unsigned int)(sim_uniform() * (FRAMES_MAX + 1)), i;
+
+	for (i = 0; i < nb; i++)
+	{
+		Rssi[i] = RSSI_MIN + (int)(sim_uniform() * (RSSI_MAX - RSSI_MIN + 1));
+		CrcOk[i] = (sim_uniform() >= CRC_ERRORS);
+	}
+	window(freq, nb, CHECK_MS);
+}
+
+static const RadioLinkChannel_t *channel(unsigned long freq)
+{
+	const RadioLinkStats_t *pStats = RADIO_link_stats();
+	unsigned int i;
+
+	for (i = 0; i < RADIO_LINK_CHANNELS; i++)
+	{
+		if (pStats->Channels[i].ul_Freq == freq)
+		{
+			return &pStats->Channels[i];
+		}
+	}
+	return NULL;
+}
+
+static void compare(const char *step)
+{
+	const RadioLinkStats_t *pStats = RADIO_link_stats();
+	const RadioLinkChannel_t *pChannel;
+	unsigned int i;
+
+	for (i = 0; i < RADIO_LINK_RSSI_BINS; i++)
+	{
+		SIM_CHECK(pStats->u16_RssiHist[i] == ref.hist[i], "%s: RSSI bin %u, %u frames, %u expected", step, i,
+				  pStats->u16_RssiHist[i], ref.hist[i]);
+	}
+	SIM_CHECK(fabs(pStats->s16_RssiAvg / 16.0 - ref.avg) <= LINK_AVG_ERR, "%s: RSSI average %.2f dBm, %.2f expected",
+			  step, pStats->s16_RssiAvg / 16.0, ref.avg);
+	SIM_CHECK((pStats->s8_RssiMin == ref.min) && (pStats->s8_RssiMax == ref.max),
+			  "%s: RSSI from %d to %d dBm, %d to %d expected", step, pStats->s8_RssiMin, pStats->s8_RssiMax, ref.min,
+			  ref.max);
+	SIM_CHECK((pStats->u16_CrcOk == ref.crc_ok) && (pStats->u16_CrcFails == ref.crc_fails),
+			  "%s: %u frames CRC OK, %u errors, %u and %u expected", step, pStats->u16_CrcOk, pStats->u16_CrcFails,
+			  ref.crc_ok, ref.crc_fails);
+	SIM_CHECK(pStats->u16_Timeouts == ref.timeouts, "%s: %u timeouts, %u expected", step, pStats->u16_Timeouts,
+			  ref.timeouts);
+	for (i = 0; (i < RADIO_LINK_CHANNELS + 1) && (ref.channels[i].freq != 0); i++)
+	{
+		if (ref.channels[i].windows == 0)
+		{
+			continue;
+		}
+		pChannel = channel(ref.channels[i].freq);
+		SIM_CHECK((pChannel != NULL) && (pChannel->u16_Windows == ref.channels[i].windows)
+				  && (pChannel->u16_Hits == ref.channels[i].hits), "%s: %lu Hz, %u of %u windows with a frame "
+				  "expected", step, ref.channels[i].freq, ref.channels[i].hits, ref.channels[i].windows);
+	}
+}
+
+/* Snapshot bytes, decoded back */
+static void check_snapshot(const uint8 *pu8_Buf)
+{
+	const RadioLinkStats_t *pStats = RADIO_link_stats();
+	const uint8 *p = pu8_Buf + 1;
+	unsigned int i, errors = 0;
+
+#define LE16(p)		((uint16)((p)[0] | ((p)[1] << 8)))
+#define LE32(p)		((unsigned long)LE16(p) | ((unsigned long)LE16((p) + 2) << 16))
+	SIM_CHECK(pu8_Buf[0] == RADIO_LINK_VERSION, "snapshot: version %u", pu8_Buf[0]);
+	for (i = 0; i < RADIO_LINK_RSSI_BINS; i++, p += 2)
+	{
+		errors += (LE16(p) != pStats->u16_RssiHist[i]);
+	}
+	errors += ((int16)LE16(p) != pStats->s16_RssiAvg);
+	errors += ((int8)p[2] != pStats->s8_RssiMin) + ((int8)p[3] != pStats->s8_RssiMax);
+	p += 4;
+	errors += (LE16(p) != pStats->u16_CrcOk) + (LE16(p + 2) != pStats->u16_CrcFails)
+			+ (LE16(p + 4) != pStats->u16_Timeouts);
+	p += 6;
+	for (i = 0; i < RADIO_LINK_CHANNELS; i++, p += 8)
+	{
+		errors += (LE32(p) != pStats->Channels[i].ul_Freq) + (LE16(p + 4) != pStats->Channels[i].u16_Windows)
+				+ (LE16(p + 6) != pStats->Channels[i].u16_Hits);
+	}
+	SIM_CHECK((errors == 0) && (p - pu8_Buf == RADIO_LINK_SNAPSHOT_SIZE), "snapshot: %u fields differ, %ld bytes",
+			  errors, (long)(p - pu8_Buf));
+}
+
+/* Counters next to their overflow */
+static void check_halving(void)
+{
+	u8 frame[RADIO_RX_FRAME_SIZE];
+	unsigned long freq = frx + RADIO_LINK_CHANNELS * FREQ_STEP;		// still followed
+	unsigned int i;
+
+	// A frame in the top bin, the others halved with it
+	for (i = 0; i < RADIO_LINK_RSSI_BINS; i++)
+	{
+		LinkStats.u16_RssiHist[i] = (uint16)(1000 * i + 1);
+	}
+	LinkStats.u16_RssiHist[RADIO_LINK_RSSI_BINS - 1] = 0xFFFE;
+	LinkStats.u16_CrcOk = 0xFFFE;
+	LinkStats.u16_CrcFails = 0xFFFE;
+	LinkStats.u16_Timeouts = 0xFFFE;
+	for (i = 0; i < RADIO_LINK_CHANNELS; i++)
+	{
+		if (LinkStats.Channels[i].ul_Freq == freq)
+		{
+			LinkStats.Channels[i].u16_Windows = 0xFFFE;
+			LinkStats.Channels[i].u16_Hits = 0x8000;
+		}
+	}
+
+	// A frame with a CRC error, then one at -40 dBm
+	Rssi[0] = -60;
+	CrcOk[0] = 0;
+	Rssi[1] = RSSI_MAX;
+	CrcOk[1] = 1;
+	*RxCF = freq;
+	sfx_init(E_RX_MODE);
+	sfx_StartRxTimeout(WINDOW_S);
+	sim_at(sim_now() + (uint64_t)FIRST_MS * sim_mclk_hz / 1000, deliver, (void *)0);
+	sim_at(sim_now() + (uint64_t)FIRST_MS * sim_mclk_hz / 1000 + FRAME_CYCLES, deliver, (void *)1);
+	while (sfx_waitframe(frame) != E_FRAME_TIMEOUT);
+	sfx_close();
+
+	for (i = 0; i < RADIO_LINK_RSSI_BINS - 1; i++)
+	{
+		SIM_CHECK(LinkStats.u16_RssiHist[i] == (uint16)((1000 * i + 1) >> 1), "halving: RSSI bin %u, %u frames", i,
+				  LinkStats.u16_RssiHist[i]);
+	}
+	SIM_CHECK(LinkStats.u16_RssiHist[RADIO_LINK_RSSI_BINS - 1] == 0x7FFF, "halving: top RSSI bin, %u frames",
+			  LinkStats.u16_RssiHist[RADIO_LINK_RSSI_BINS - 1]);
+	SIM_CHECK((LinkStats.u16_CrcOk == 0x7FFF) && (LinkStats.u16_CrcFails == 0x7FFF)
+			  && (LinkStats.u16_Timeouts == 0x7FFF), "halving: %u CRC OK, %u errors, %u timeouts",
+			  LinkStats.u16_CrcOk, LinkStats.u16_CrcFails, LinkStats.u16_Timeouts);
+	SIM_CHECK((channel(freq) != NULL) && (channel(freq)->u16_Windows == 0x7FFF)
+			  && (channel(freq)->u16_Hits == 0x4001), "halving: %u of %u windows with a frame",
+			  channel(freq) ? channel(freq)->u16_Hits : 0, channel(freq) ? channel(freq)->u16_Windows : 0);
+}
+
+int main(void)
+{
+	const RadioRxStats_t *pRx;
+	uint8 snapshot[RADIO_LINK_SNAPSHOT_SIZE];
+	char hex[2 * RADIO_LINK_SNAPSHOT_SIZE + 1];
+	char expected[2 * RADIO_LINK_SNAPSHOT_SIZE + 8];
+	unsigned char cmd[] = "AT$PL?\r";
+	unsigned long evicted;
+	uint16 dropped;
+	unsigned int w, i;
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	SIM_CHECK(RADIO_select_profile(E_PROFILE_FCC), "profile FCC");
+	TIMER_bitrate_init();
+	TIMER_timebase_init();
+	__enable_interrupt();
+
+	// Random windows on NB_FREQS frequencies
+	sim_seed(0x1234567u);
+	for (w = 0; w < NB_WINDOWS; w++)
+	{
+		random_window(frx + (w % NB_FREQS) * FREQ_STEP);
+	}
+	compare("random windows");
+
+	// Frames on a full ring: the library checks each in 1.5 s
+	pRx = RADIO_rx_stats();
+	dropped = pRx->u16_Dropped;
+	for (i = 0; i < 7; i++)
+	{
+		Rssi[i] = -100 + 3 * (int)i;
+		CrcOk[i] = 0;
+	}
+	window(frx, 7, 1500);
+	SIM_CHECK(pRx->u16_Dropped > dropped, "full ring: no frame dropped");
+	compare("full ring");
+
+	// A ninth frequency: the first one is dropped, in turn
+	for (i = NB_FREQS; i < RADIO_LINK_CHANNELS + 1; i++)
+	{
+		random_window(frx + i * FREQ_STEP);
+	}
+	evicted = frx;
+	SIM_CHECK(channel(evicted) == NULL, "channels: %lu Hz still followed", evicted);
+	ref_channel(evicted)->windows = 0;
+	compare("nine frequencies");
+
+	// Snapshot and AT$PL?
+	SIM_CHECK(RADIO_link_snapshot(snapshot) == RADIO_LINK_SNAPSHOT_SIZE, "snapshot: size");
+	check_snapshot(snapshot);
+	for (i = 0; i < RADIO_LINK_SNAPSHOT_SIZE; i++)
+	{
+		byteToHex(snapshot[i], &hex[2 * i]);
+	}
+	hex[2 * RADIO_LINK_SNAPSHOT_SIZE] = 0;
+	sprintf(expected, "\n%s\r\nOK\r\n", hex);
+	uart_len = 0;
+	parseHostCmd(cmd, sizeof(cmd) - 1);
+	SIM_CHECK((uart_len == strlen(expected)) && (memcmp(uart, expected, uart_len) == 0), "AT$PL?: %.*s", uart_len,
+			  uart);
+
+	printf("%u windows on %u frequencies: %u frames CRC OK, %u errors, %u timeouts, RSSI %d to %d dBm, "
+		   "average %.2f dBm (%.2f dBm computed)\n", NB_WINDOWS, NB_FREQS, ref.crc_ok, ref.crc_fails, ref.timeouts,
+		   ref.min, ref.max, LinkStats.s16_RssiAvg / 16.0, ref.avg);
+	printf("AT$PL?: %u bytes of snapshot, %u frames dropped by the full ring counted\n", RADIO_LINK_SNAPSHOT_SIZE,
+		   pRx->u16_Dropped - dropped);
+
+	check_halving();
+
+	return sim_result("test_link_stats");
+}
@@ -0,0 +1,194 @@
+//*****************************************************************************
+//! @file       test_mod_timing.c
+//! @brief      Symbol timing of the modulation for every MCLK of bsp.h and
+//!				SPI prescaler, with the delays of RADIO_calibrate_timing()
+//!				and the bit period of TIMER_bitrate_init().
+//!
+//!				A '0' bit of each profile is modulated and timed on the
+//!				writes to the chip: the spacing of the PA levels, the phase
+//!				accumulation between the two ramps and the whole bit. They
+//!				are compared with the same measures at the tuning point,
+//!				24 MHz and SMCLK/3. The bit period is TA1CCR0 against the
+//!				bit rate. The combinations where the SPI writes alone are
+//!				longer than a tuned duration are reported, not checked:
+//!				the modulation is slower there by construction.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+#include "timer.h"
+#include "bsp.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define REF_CLK					BSP_SYS_CLK_24MHZ
+#define REF_PRESCALER			3
+#define SPI_CLK_MAX				10000000UL	// CC112x SCLK
+#define STEP_TOLERANCE			3.0			// %, ramp step and bit, plus one RADIO_spin() loop
+#define PHASE_TOLERANCE			5.0			// degrees
+#define BIT_PERIOD_TOLERANCE	250.0		// ppm
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	double step;				// s between two PA levels of a ramp
+	double phase;				// s from the FREQOFF0 step to its restore
+	double bit;					// s from the first PA level to the last
+}Timing_t;
+
+typedef struct
+{
+	te_ModProfileId e_Profile;
+	const char *name;
+	unsigned int u16_Bitrate;
+}Profile_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const uint32 Clocks[] = {
+	BSP_SYS_CLK_1MHZ, BSP_SYS_CLK_4MHZ, BSP_SYS_CLK_8MHZ, BSP_SYS_CLK_12MHZ,
+	BSP_SYS_CLK_16MHZ, BSP_SYS_CLK_20MHZ, BSP_SYS_CLK_24MHZ, BSP_SYS_CLK_25MHZ,
+};
+static const uint8 Prescalers[] = { 1, 2, 3, 4, 8 };
+static const Profile_t Profiles[] = {
+	{ E_PROFILE_FCC, "FCC", 600 },
+	{ E_PROFILE_ETSI, "ETSI", 100 },
+	{ E_PROFILE_ETSI_OPT, "ETSI_OPT", 100 },
+};
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* Modulates a '0' bit at clk and prescaler, *pTiming gets its timing.
+ * Returns the bit period of Timer1_A0 in s */
+static double measure(const Profile_t *p, uint32 clk, uint8 prescaler, Timing_t *pTiming)
+{
+	const SimRadioLog_t *log;
+	unsigned long n, i;
+	unsigned int n_pa = 0, n_ramp = 0, n_foff = 0;
+	uint64_t t_first = 0, t_ramp = 0, t_last = 0, t_foff[2] = { 0, 0 };
+
+	sim_mclk_hz = clk;
+	trxRfSpiInterfaceInit(prescaler);
+	RADIO_select_profile(p->e_Profile);
+	RADIO_init_chip(ftx, E_TX_MODE);
+	TIMER_bitrate_init();
+	RADIO_start_rf_carrier();
+	__enable_interrupt();
+
+	sim_radio_log_clear();
+	RADIO_modulate();
+	while (RADIO_modulation_busy())
+	{
+		sim_advance(8);
+	}
+	__disable_interrupt();
+
+	// The PA levels before the first FREQOFF0 write are the first ramp,
+	// the phase accumulates from that write to the next one
+	log = sim_radio_log(&n);
+	for (i = 0; i < n; i++)
+	{
+		if (log[i].kind != SIM_LOG_WRITE)
+		{
+			continue;
+		}
+		if (log[i].addr == CC112X_PA_CFG2)
+		{
+			t_first = n_pa++ ? t_first : log[i].t;
+			t_last = log[i].t;
+			if (n_foff == 0)
+			{
+				t_ramp = log[i].t;
+				n_ramp++;
+			}
+		}
+		else if ((log[i].addr == CC112X_FREQOFF0) && (n_foff < 2))
+		{
+			t_foff[n_foff++] = log[i].t;
+		}
+	}
+	RADIO_stop_rf_carrier();
+
+	if (p->e_Profile == E_PROFILE_ETSI_OPT)
+	{
+		// PA and FREQOFF steps all along, no accumulation
+		t_ramp = t_last;
+		n_ramp = n_pa;
+		t_foff[1] = t_foff[0];
+	}
+	pTiming->step = (n_ramp > 1) ? (double)(t_ramp - t_first) / clk / (n_ramp - 1) : 0;
+	pTiming->phase = (double)(t_foff[1] - t_foff[0]) / clk;
+	pTiming->bit = (double)(t_last - t_first) / clk;
+
+	return (double)(TA1CCR0 + 1) * (1u << ((TA1CTL >> 6) & 0x03)) / clk;
+}
+
+static void run(const Profile_t *p)
+{
+	Timing_t ref, t;
+	double ref_period, period, period_ppm, nominal_ppm, step_err, phase_deg, bit_err, tolerance;
+	unsigned int c, k;
+	int slow;
+
+	ref_period = measure(p, REF_CLK, REF_PRESCALER, &ref);
+	printf("%s: ramp step %.2f us, phase accumulation %.2f us, bit %.3f ms, period %.1f us "
+		   "at %lu MHz SMCLK/%u\n", p->name, ref.step * 1e6, ref.phase * 1e6, ref.bit * 1e3,
+		   ref_period * 1e6, REF_CLK / 1000000UL, REF_PRESCALER);
+	printf("   MHz  /p   step %%   phase deg   bit %%   period ppm (to %u bps)\n", p->u16_Bitrate);
+	for (c = 0; c < sizeof(Clocks) / sizeof(Clocks[0]); c++)
+	{
+		for (k = 0; k < sizeof(Prescalers); k++)
+		{
+			if (Clocks[c] / Prescalers[k] > SPI_CLK_MAX)
+			{
+				continue;
+			}
+			period = measure(p, Clocks[c], Prescalers[k], &t);
+			period_ppm = (period / ref_period - 1.0) * 1e6;
+			nominal_ppm = (period * p->u16_Bitrate - 1.0) * 1e6;
+			step_err = (t.step / ref.step - 1.0) * 100;
+			phase_deg = (ref.phase > 0) ? (t.phase / ref.phase - 1.0) * 180 : 0;
+			bit_err = (t.bit / ref.bit - 1.0) * 100;
+
+			// Slower than tuned when the writes do not fit in the durations
+			tolerance = STEP_TOLERANCE + 100.0 * SIM_CYCLES_SPIN / (ref.step * Clocks[c]);
+			slow = (step_err > tolerance) || (phase_deg > PHASE_TOLERANCE);
+			printf("  %4.0f  %2u  %+7.2f  %+9.2f  %+7.2f  %+7.1f (%+.1f)%s\n", Clocks[c] / 1e6,
+				   Prescalers[k], step_err, phase_deg, bit_err, period_ppm, nominal_ppm,
+				   slow ? "  SPI bound" : "");
+
+			SIM_CHECK(fabs(period_ppm) <= BIT_PERIOD_TOLERANCE, "%s %lu Hz: bit period off by %.1f ppm",
+					  p->name, Clocks[c], period_ppm);
+			SIM_CHECK(slow || ((step_err >= -tolerance) && (phase_deg >= -PHASE_TOLERANCE)
+					  && (fabs(bit_err) <= tolerance)),
+					  "%s %lu Hz /%u: step %+.2f %%, phase %+.2f deg, bit %+.2f %%", p->name, Clocks[c],
+					  Prescalers[k], step_err, phase_deg, bit_err);
+		}
+	}
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	sim_reset();
+	for (i = 0; i < sizeof(Profiles) / sizeof(Profiles[0]); i++)
+	{
+		run(&Profiles[i]);
+	}
+	sim_mclk_hz = SIM_MCLK_HZ;
+
+	return sim_result("test_mod_timing");
+}
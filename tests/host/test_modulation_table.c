@@ -0,0 +1,195 @@
+//*****************************************************************************
+//! @file       test_modulation_table.c
+//! @brief      Byte tables of modulation_table.h against the unsigned int
+//!				tables they replaced, and decoded back from the writes of
+//!				RADIO_modulate().
+//!
+//!				The values of the unsigned int tables are kept as a hash of
+//!				their 16-bit little endian image, the MSP430 layout. Each
+//!				byte table is widened the same way and must give the hash.
+//!				Then a '0' bit of each profile is modulated at full power
+//!				and the PA_CFG2 and FREQOFF0 writes must give the table back,
+//!				and again under a power ceiling set once the chip is
+//!				initialised: the PA levels must be moved down by the
+//!				same number of steps, clamped at 0.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+#include "modulation_table.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+/* FNV-1a of the unsigned int tables, before they were stored as bytes */
+#define TABLE_PA_600BPS_HASH		0xE62FC8F1UL
+#define ETSI_PROFILE_HASH			0xA94F7F74UL
+
+#define PA_LEVEL_MAX				0x3F		// PA_CFG2.PA_POWER_RAMP
+#define CEILING						40			// 11.5 dB below the full power
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static uint32_t hash_u16(const unsigned char *table, unsigned int n)
+{
+	uint32_t h = 0x811C9DC5UL;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+	{
+		h = (h ^ table[i]) * 0x01000193UL;		// low byte
+		h = (h ^ 0x00) * 0x01000193UL;			// high byte of the unsigned int
+	}
+	return h;
+}
+
+/* Modulates a '0' bit, the PA_CFG2 and FREQOFF0 writes go to pa[] and foff[] */
+static unsigned int modulate(uint8_t *pa, uint8_t *foff, unsigned int max)
+{
+	const SimRadioLog_t *log;
+	unsigned long n, i;
+	unsigned int n_pa = 0, n_foff = 0;
+
+	sim_radio_log_clear();
+	RADIO_modulate();
+	while (RADIO_modulation_busy())
+	{
+		sim_advance(8);
+	}
+	log = sim_radio_log(&n);
+	for (i = 0; i < n; i++)
+	{
+		if (log[i].kind != SIM_LOG_WRITE)
+		{
+			continue;
+		}
+		if ((log[i].addr == CC112X_PA_CFG2) && (n_pa < max))
+		{
+			pa[n_pa++] = log[i].value;
+		}
+		else if ((log[i].addr == CC112X_FREQOFF0) && (foff != NULL) && (n_foff < max))
+		{
+			foff[n_foff++] = log[i].value;
+		}
+	}
+	SIM_CHECK((foff == NULL) || (n_foff == n_pa), "%u FREQOFF0 writes for %u PA levels", n_foff, n_pa);
+	return n_pa;
+}
+
+/* PA level of a table level under the ceiling */
+static uint8_t level(uint8_t table, uint8_t ceiling)
+{
+	uint8_t offset = PA_LEVEL_MAX - ceiling;
+
+	return (table > offset) ? table - offset : 0;
+}
+
+static void start(te_ModProfileId e_Profile, uint8_t ceiling)
+{
+	uint8_t pa;
+
+	SIM_CHECK(RADIO_select_profile(e_Profile), "profile %d", e_Profile);
+	RADIO_init_chip(ftx, E_TX_MODE);
+	SIM_CHECK(RADIO_set_power_ceiling(ceiling), "ceiling %u", ceiling);
+	RADIO_start_rf_carrier();
+	pa = sim_radio_reg(CC112X_PA_CFG2);
+	SIM_CHECK(pa == ceiling, "profile %d: carrier at PA level %u, ceiling %u", e_Profile, pa, ceiling);
+	__enable_interrupt();
+}
+
+static void stop(void)
+{
+	__disable_interrupt();
+	RADIO_stop_rf_carrier();
+}
+
+/* PA ramp profiles: down the table then back up */
+static void check_pa_ramp(te_ModProfileId e_Profile, const char *name, uint8_t ceiling)
+{
+	uint8_t pa[2 * NB_PTS_PA + 1];
+	uint8_t expected;
+	unsigned int n, i;
+
+	start(e_Profile, ceiling);
+	n = modulate(pa, NULL, sizeof(pa));
+	stop();
+	SIM_CHECK(n == 2 * NB_PTS_PA, "%s: %u PA levels written", name, n);
+	for (i = 0; (i < NB_PTS_PA) && (n == 2 * NB_PTS_PA); i++)
+	{
+		expected = level(Table_Pa_600bps[i], ceiling);
+		if ((pa[i] != expected) || (pa[2 * NB_PTS_PA - 1 - i] != expected))
+		{
+			SIM_CHECK(0, "%s, ceiling %u: point %u written %u / %u, table %u", name, ceiling, i,
+					  pa[i], pa[2 * NB_PTS_PA - 1 - i], Table_Pa_600bps[i]);
+			break;
+		}
+	}
+}
+
+/* PA and FREQOFF profile: FREQOFF0 moves up on a bit, down on the next one */
+static void check_pa_freqoff(uint8_t ceiling)
+{
+	static uint8_t pa[NB_POINTS + 1], foff[NB_POINTS + 1];
+	uint8_t u8_DevFoff0;
+	unsigned int n, i, bit;
+	int sign;
+	uint8_t delta;
+
+	start(E_PROFILE_ETSI_OPT, ceiling);
+	u8_DevFoff0 = RADIO_get_profile()->u8_DevFoff0;
+	for (bit = 0; bit < 2; bit++)
+	{
+		n = modulate(pa, foff, NB_POINTS + 1);
+		SIM_CHECK(n == NB_POINTS, "ETSI_OPT bit %u: %u points written", bit, n);
+		sign = (foff[NB_POINTS / 2] >= u8_DevFoff0) ? 1 : -1;
+		for (i = 0; (i < NB_POINTS) && (n == NB_POINTS); i++)
+		{
+			delta = (uint8_t)(sign * (foff[i] - u8_DevFoff0));
+			if ((pa[i] != level(CC1120_etsi_profile[i][0], ceiling)) || (delta != CC1120_etsi_profile[i][1]))
+			{
+				SIM_CHECK(0, "ETSI_OPT, ceiling %u, bit %u, point %u: written %u / %+d, table %u / %u", ceiling, bit, i,
+						  pa[i], sign * (foff[i] - u8_DevFoff0), CC1120_etsi_profile[i][0],
+						  CC1120_etsi_profile[i][1]);
+				break;
+			}
+		}
+	}
+	stop();
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	SIM_CHECK(hash_u16(Table_Pa_600bps, NB_PTS_PA) == TABLE_PA_600BPS_HASH,
+			  "Table_Pa_600bps differs from the unsigned int table");
+	SIM_CHECK(hash_u16(&CC1120_etsi_profile[0][0], 2 * NB_POINTS) == ETSI_PROFILE_HASH,
+			  "CC1120_etsi_profile differs from the unsigned int table");
+	for (i = 0; i < NB_PTS_PA; i++)
+	{
+		SIM_CHECK(Table_Pa_600bps[i] <= PA_LEVEL_MAX, "Table_Pa_600bps[%u] = %u", i, Table_Pa_600bps[i]);
+	}
+	for (i = 0; i < NB_POINTS; i++)
+	{
+		SIM_CHECK(CC1120_etsi_profile[i][0] <= PA_LEVEL_MAX, "CC1120_etsi_profile[%u] = %u", i,
+				  CC1120_etsi_profile[i][0]);
+	}
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	check_pa_ramp(E_PROFILE_FCC, "FCC", PA_LEVEL_MAX);
+	check_pa_ramp(E_PROFILE_ETSI, "ETSI", PA_LEVEL_MAX);
+	check_pa_freqoff(PA_LEVEL_MAX);
+	check_pa_ramp(E_PROFILE_FCC, "FCC", CEILING);
+	check_pa_ramp(E_PROFILE_ETSI, "ETSI", CEILING);
+	check_pa_freqoff(CEILING);
+
+	return sim_result("test_modulation_table");
+}
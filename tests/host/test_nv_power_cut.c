@@ -0,0 +1,507 @@
+//*****************************************************************************
+//! @file       test_nv_power_cut.c
+//! @brief      Power cuts in the flash writes of the PN9 / sequence number
+//!				cache: the counters recovered never move backwards.
+//!
+//!				NB_FRAMES frames of the library are replayed on a new
+//!				device and on devices with the wear level records of an
+//!				older firmware, past a full turn of the flash log. The
+//!				power is then cut at each flash operation of the run, word
+//!				program or segment erase, left half done by the model of
+//!				sim_flash.c. After each cut the device powers on again:
+//!				\li the PN9 and sequence number read are those of the last
+//!					record written, or of the one the cut interrupted
+//!				\li no sequence number that went on air is read again
+//!				\li FRAMES_AFTER frames later the last of them is read
+//!				Each cut starts from a snapshot of the flash and of the
+//!				state of the run at the start of its frame.
+//!
+//!				The modulation of sfx_send() takes 28 ms of host time a
+//!				repeat: the sweep runs its commit only, see send(). The
+//!				frames of REAL_FROM with the real sfx_init(), sfx_send()
+//!				and sfx_close() are swept as well, the repeats that reached
+//!				STX being on air.
+//!
+//!				With NVM_LOW_VOLTAGE_FLUSH, the SVM interrupt comes in the
+//!				middle of each frame and the power is cut at each flash
+//!				operation of SYSNMI_ISR() or after it: a flush that ends
+//!				gives the cache back. The interrupt also comes during each
+//!				flash operation of the frames: it writes nothing then.
+//!
+//!				flash_drv.c and manufacturer_api.c are built into the test
+//!				to restart their state as a power cut does.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+/* The searches of the wear level records always set 'index', see FLASH_DRV
+ * in the Makefile */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include "flash_drv.c"
+#pragma GCC diagnostic pop
+#include "../../manufacturer_api/manufacturer_api.c"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_FRAMES				300			// past a turn of the log, 4 segments of 63 records
+#define NB_REPEATS				3
+#define FRAMES_AFTER			3			// frames run after a cut
+#define REAL_FROM				62			// frames with the real sfx_send(), around a segment change
+#define REAL_FRAMES				2
+#define FRAME_SIZE				12
+#define OLD_COUNT				3			// write count of the older firmware records
+#define OLD_SEQ					1000		// sequence number of its first record
+#define NB_IMAGES				(sizeof(Images) / sizeof(Images[0]))
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	const char *name;
+	unsigned int old_records;	// wear level records {count, PN9, SeqNb} of an older firmware
+}Image_t;
+
+typedef struct
+{
+	u16 pn;
+	u16 seq;
+}Pair_t;
+
+/* What the test knows of the run */
+typedef struct
+{
+	Pair_t last;				// last record written to the end
+	Pair_t writing;				// record the cut may interrupt
+	u8 b_Writing;
+	u16 aired;					// sequence number stored when the last repeat went on air
+}Model_t;
+
+/* State at the start of a frame */
+typedef struct
+{
+	unsigned int cells[SIZE_OF_STORAGE_ARRAY];
+	unsigned int log_segment, log_index, log_count;
+	unsigned char log_loaded, log_erase;
+	u16 cache[2];
+	u8 b_NvLoaded, b_NvDirty, b_NvSeqDirty;
+	unsigned int pmmrie;
+	Model_t model;
+	long ops;					// flash operations of the run before the frame
+}Snapshot_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const Image_t Images[] = {
+	{ "new device", 0 },
+	{ "older records in 2 segments", 150 },
+	{ "older records in the whole array", (SIZE_OF_STORAGE_ARRAY - 1) / 3 },
+};
+
+static unsigned int cells[SIZE_OF_STORAGE_ARRAY];
+static Snapshot_t *Snap;
+static Model_t model;
+static jmp_buf PowerCut;
+static int b_Real;
+#if defined(NVM_LOW_VOLTAGE_FLUSH)
+static int b_SvmDone;
+#endif
+static unsigned long nb_cuts;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* Supply gone: the RAM is lost */
+static void cut(void)
+{
+	longjmp(PowerCut, 1);
+}
+
+static void mcu_start(void)
+{
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	RADIO_select_profile(E_PROFILE_FCC);
+	TIMER_bitrate_init();
+	TIMER_timebase_init();
+	__enable_interrupt();
+	sim_flash_attach(flash_array, SIZE_OF_STORAGE_ARRAY, SEGMENT_SIZE, cells);
+	sim_flash_cut_at(-1, NULL);
+}
+
+/* Reset with the flash as the cut left it, the RAM zeroed by the C startup */
+static void power_on(void)
+{
+	mcu_start();
+	log_segment = log_index = log_count = 0;
+	log_loaded = 0;
+	log_erase = 0;
+	NonVRam[0] = NonVRam[1] = 0;
+	b_NvLoaded = FALSE;
+	b_NvDirty = FALSE;
+	b_NvSeqDirty = FALSE;
+	b_NvBusy = FALSE;
+	sfx_nv_mem_init();
+}
+
+static void snapshot(Snapshot_t *s)
+{
+	memcpy(s->cells, cells, sizeof(cells));
+	s->log_segment = log_segment;
+	s->log_index = log_index;
+	s->log_count = log_count;
+	s->log_loaded = log_loaded;
+	s->log_erase = log_erase;
+	s->cache[0] = NonVRam[0];
+	s->cache[1] = NonVRam[1];
+	s->b_NvLoaded = b_NvLoaded;
+	s->b_NvDirty = b_NvDirty;
+	s->b_NvSeqDirty = b_NvSeqDirty;
+	s->pmmrie = PMMRIE;
+	s->model = model;
+	s->ops = sim_flash_ops();
+}
+
+static void restore(const Snapshot_t *s)
+{
+	memcpy(cells, s->cells, sizeof(cells));
+	mcu_start();
+	log_segment = s->log_segment;
+	log_index = s->log_index;
+	log_count = s->log_count;
+	log_loaded = s->log_loaded;
+	log_erase = s->log_erase;
+	NonVRam[0] = s->cache[0];
+	NonVRam[1] = s->cache[1];
+	b_NvLoaded = s->b_NvLoaded;
+	b_NvDirty = s->b_NvDirty;
+	b_NvSeqDirty = s->b_NvSeqDirty;
+	b_NvBusy = FALSE;
+	PMMRIE = s->pmmrie;
+	model = s->model;
+}
+
+static void image(const Image_t *img)
+{
+	unsigned int i;
+
+	// Erased words of the 16-bit flash
+	for (i = 0; i < SIZE_OF_STORAGE_ARRAY; i++)
+	{
+		cells[i] = 0xFFFF;
+	}
+	for (i = 0; i < img->old_records; i++)
+	{
+		cells[3 * i] = OLD_COUNT;
+		cells[3 * i + 1] = (0x1A5 * (i + 1)) & 0x1FF;
+		cells[3 * i + 2] = OLD_SEQ + i;
+	}
+	memset(&model, 0, sizeof(model));
+	if (img->old_records)
+	{
+		model.last.pn = cells[3 * (img->old_records - 1) + 1];
+		model.last.seq = cells[3 * (img->old_records - 1) + 2];
+		model.aired = model.last.seq;
+	}
+}
+
+/* Next PN9 of change_frequency(), XNOR feedback: it goes on from 0 */
+static u16 next_pn(u16 pn)
+{
+	return (u16)(((pn << 1) | (~((pn >> 8) ^ (pn >> 4)) & 1)) & 0x1FF);
+}
+
+static void commit_start(void)
+{
+	model.writing.pn = NonVRam[0];
+	model.writing.seq = NonVRam[1];
+	model.b_Writing = TRUE;
+}
+
+static void commit_end(void)
+{
+	model.last = model.writing;
+	model.b_Writing = FALSE;
+}
+
+/* What sfx_send() does before the first symbol */
+static void send(void)
+{
+	if (b_NvSeqDirty)
+	{
+		commit_start();
+		sfx_nv_mem_flush();
+		commit_end();
+	}
+	model.aired = NonVRam[1];
+}
+
+/* A repeat of the real sfx_send(), the commit then the modulation */
+static void send_real(void)
+{
+	if (b_NvSeqDirty)
+	{
+		commit_start();
+	}
+	sfx_init(E_TX_MODE);
+	SIM_CHECK(sfx_send(sim_frame, FRAME_SIZE) == SFX_ERR_NONE, "sfx_send");
+	if (model.b_Writing)
+	{
+		commit_end();
+	}
+	model.aired = NonVRam[1];
+	sfx_close();
+	sim_radio_log_clear();
+}
+
+#if defined(NVM_LOW_VOLTAGE_FLUSH)
+/* SVM high side interrupt, the supply going down */
+static void svm(void)
+{
+	if (b_NvDirty && !b_NvBusy)
+	{
+		commit_start();
+	}
+	SYSSNIV = SYSSNIV_SVMHIFG;
+	sim_raise(SIM_IRQ_SYSNMI);
+	sim_advance(1);
+	if (model.b_Writing)
+	{
+		commit_end();
+	}
+	SYSSNIV = 0;
+	b_SvmDone = 1;
+}
+#endif
+
+/* SfxSendFrame() of the library: MakeFrame() takes the sequence number,
+ * change_frequency() the PN9 of each repeat */
+static void frame(int b_Svm)
+{
+	u16 seq, pn;
+	unsigned int repeat;
+
+	sfx_get_nv_mem(E_SEQ_CPT, &seq);
+	sfx_set_nv_mem(E_SEQ_CPT, (u16)(seq + 1));
+	for (repeat = 0; repeat < NB_REPEATS; repeat++)
+	{
+		sfx_get_nv_mem(E_PN, &pn);
+		sfx_set_nv_mem(E_PN, next_pn(pn));
+#if defined(NVM_LOW_VOLTAGE_FLUSH)
+		if (b_Svm && (repeat == 1))
+		{
+			svm();
+			cut();
+		}
+#endif
+		if (b_Real)
+		{
+			send_real();
+		}
+		else
+		{
+			send();
+			sfx_close();
+		}
+	}
+}
+
+/* After a cut: the last record or the one the cut interrupted is read,
+ * then the log goes on */
+static void check_recovery(const char *name, const char *where, unsigned int f, long op, const Model_t *m)
+{
+	u16 seq, pn, first;
+	unsigned int i;
+
+	nb_cuts++;
+	power_on();
+	sfx_get_nv_mem(E_SEQ_CPT, &seq);
+	sfx_get_nv_mem(E_PN, &pn);
+	SIM_CHECK(((pn == m->last.pn) && (seq == m->last.seq))
+			  || (m->b_Writing && (pn == m->writing.pn) && (seq == m->writing.seq)),
+			  "%s, cut at op %ld of %s %u: PN9 %03X SeqNb %u read, last record %03X %u", name, op, where, f, pn,
+			  seq, m->last.pn, m->last.seq);
+	SIM_CHECK((signed short)(seq - m->aired) >= 0, "%s, cut at op %ld of %s %u: SeqNb %u read, %u went on air",
+			  name, op, where, f, seq, m->aired);
+
+	// The log goes on past the record the cut left
+	first = seq;
+	memset(&model, 0, sizeof(model));
+	b_Real = 0;
+	for (i = 0; i < FRAMES_AFTER; i++)
+	{
+		frame(0);
+	}
+	power_on();
+	sfx_get_nv_mem(E_SEQ_CPT, &seq);
+	sfx_get_nv_mem(E_PN, &pn);
+	SIM_CHECK((seq == (u16)(first + FRAMES_AFTER)) && (seq == model.last.seq) && (pn == model.last.pn),
+			  "%s, cut at op %ld of %s %u: PN9 %03X SeqNb %u read %u frames later, %03X %u written", name, op,
+			  where, f, pn, seq, FRAMES_AFTER, model.last.pn, model.last.seq);
+}
+
+/* Cuts at each flash operation of the frames [first, last) */
+static void sweep(const char *name, unsigned int first, unsigned int last, int b_RealSend)
+{
+	volatile unsigned int f;
+	volatile long op;
+	Model_t m;
+
+	for (f = first; f < last; f++)
+	{
+		for (op = 1;; op++)
+		{
+			restore(&Snap[f]);
+			b_Real = b_RealSend;
+			sim_radio_log_clear();
+			sim_flash_cut_at(op, cut);
+			if (setjmp(PowerCut) == 0)
+			{
+				frame(0);
+				break;
+			}
+			m = model;
+			if (b_Real)
+			{
+				// The repeats that reached STX went on air
+				unsigned long n, i;
+				const SimRadioLog_t *log = sim_radio_log(&n);
+
+				for (i = 0; i < n; i++)
+				{
+					if ((log[i].kind == SIM_LOG_STROBE) && (log[i].addr == CC112X_STX))
+					{
+						m.aired = NonVRam[1];
+					}
+				}
+			}
+			check_recovery(name, b_Real ? "sfx_send(), frame" : "frame", f, op, &m);
+		}
+	}
+}
+
+#if defined(NVM_LOW_VOLTAGE_FLUSH)
+/* The SVM interrupt in the middle of each frame, cuts at each operation of
+ * its flush or after it */
+static void sweep_svm(const char *name)
+{
+	volatile unsigned int f;
+	volatile long op;
+	Model_t m;
+	u16 seq, pn, cache[2];
+
+	for (f = 0; f < NB_FRAMES; f++)
+	{
+		for (op = 1;; op++)
+		{
+			restore(&Snap[f]);
+			b_SvmDone = 0;
+			sim_flash_cut_at(op, cut);
+			if (setjmp(PowerCut) == 0)
+			{
+				frame(1);
+			}
+			m = model;
+			cache[0] = NonVRam[0];
+			cache[1] = NonVRam[1];
+			if (b_SvmDone)
+			{
+				// The flush ended, the cache comes back as it was
+				power_on();
+				sfx_get_nv_mem(E_SEQ_CPT, &seq);
+				sfx_get_nv_mem(E_PN, &pn);
+				nb_cuts++;
+				SIM_CHECK((seq == cache[1]) && (pn == cache[0]), "%s, SVM in frame %u: PN9 %03X SeqNb %u read, "
+						  "%03X %u in the cache", name, f, pn, seq, cache[0], cache[1]);
+				break;
+			}
+			check_recovery(name, "SYSNMI_ISR(), frame", f, op, &m);
+		}
+	}
+}
+
+/* The SVM interrupt while the frames write: it waits for the next commit */
+static void svm_in_write(void)
+{
+	SYSSNIV = SYSSNIV_SVMHIFG;
+	sim_raise(SIM_IRQ_SYSNMI);
+}
+
+static void sweep_svm_busy(const char *name)
+{
+	volatile unsigned int f;
+	volatile long op;
+	long ops;
+	Model_t m;
+
+	for (f = 0; f < NB_FRAMES; f++)
+	{
+		ops = Snap[f + 1].ops - Snap[f].ops;
+		for (op = 1; op <= ops; op++)
+		{
+			restore(&Snap[f]);
+			sim_flash_cut_at(op, svm_in_write);
+			frame(0);
+			SIM_CHECK(sim_flash_ops() == ops, "%s, SVM at op %ld of frame %u: %ld flash operations, %ld without",
+					  name, op, f, sim_flash_ops(), ops);
+			SIM_CHECK(!(PMMRIE & SVMHIE), "%s, SVM at op %ld of frame %u: not taken", name, op, f);
+			m = model;
+			check_recovery(name, "the SVM interrupt, frame", f, op, &m);
+		}
+	}
+}
+#endif
+
+int main(void)
+{
+	unsigned int i, f;
+	unsigned long cuts;
+
+	Snap = malloc((NB_FRAMES + 1) * sizeof(Snapshot_t));
+	if (Snap == NULL)
+	{
+		return 2;
+	}
+	for (i = 0; i < FRAME_SIZE; i++)
+	{
+		sim_frame[i] = (u8)(0x3C ^ (i * 41));
+	}
+
+	printf("%u frames of %u repeats, power cut at each flash operation:\n", NB_FRAMES, NB_REPEATS);
+	for (i = 0; i < NB_IMAGES; i++)
+	{
+		// Run without cut, snapshot at the start of each frame
+		image(&Images[i]);
+		power_on();
+		b_Real = 0;
+		for (f = 0; f < NB_FRAMES; f++)
+		{
+			snapshot(&Snap[f]);
+			frame(0);
+		}
+		snapshot(&Snap[NB_FRAMES]);
+
+		cuts = nb_cuts;
+		sweep(Images[i].name, 0, NB_FRAMES, 0);
+		sweep(Images[i].name, REAL_FROM, REAL_FROM + REAL_FRAMES, 1);
+#if defined(NVM_LOW_VOLTAGE_FLUSH)
+		sweep_svm(Images[i].name);
+		sweep_svm_busy(Images[i].name);
+#endif
+		printf("%-33s %ld flash operations, %lu power cuts\n", Images[i].name, Snap[NB_FRAMES].ops,
+			   nb_cuts - cuts);
+	}
+	free(Snap);
+
+#if defined(NVM_LOW_VOLTAGE_FLUSH)
+	return sim_result("test_nv_power_cut_svm");
+#else
+	return sim_result("test_nv_power_cut");
+#endif
+}
@@ -0,0 +1,211 @@
+//*****************************************************************************
+//! @file       test_profile_engine.c
+//! @brief      RADIO_modulate() dispatched on the run time profile against
+//!				the loops compiled in by MODE_FCC / MODE_ETSI and
+//!				MODE_ETSI_OPT before the profiles.
+//!
+//!				radio.c is built into the test to run the reference loops
+//!				on its statics: the ramp, the calibrated delays and the
+//!				phase state. The reference loops are the #if ones, with
+//!				the FREQOFF constants instead of the profile fields.
+//!				For each profile, bits are modulated by both from the same
+//!				state: the chip accesses must be the same, in the same
+//!				order and at the same cycle. The model counts the SPI
+//!				bytes and the delay loops, the cycles of both are
+//!				reported per bit.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "radio.c"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_BITS					4			// both FREQOFF directions, twice
+#define LOG_MAX					8192
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	te_ModProfileId e_Profile;
+	const char *name;
+	void (*reference)(void);
+}Case_t;
+
+typedef struct
+{
+	SimRadioLog_t log[LOG_MAX];
+	unsigned long n;
+	uint64_t cycles;
+}Run_t;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* RADIO_modulate() of MODE_FCC and MODE_ETSI */
+static void ref_modulate_pa_ramp(void)
+{
+	s16 count;
+	uint8 writeByte_FOFF0;
+	uint8 writeByte_FOFF1;
+
+	if (b_Diff == false)
+	{
+		b_Diff = true;
+		// Frequency step down
+		writeByte_FOFF1 = FREQ_STEP_LOW_FOFF1;
+		writeByte_FOFF0 = FREQ_STEP_LOW_FOFF0;
+	}
+	else
+	{
+		b_Diff = false;
+		// Frequency step high
+		writeByte_FOFF1 = FREQ_STEP_HIGH_FOFF1;
+		writeByte_FOFF0 = FREQ_STEP_HIGH_FOFF0;
+	}
+	// deacrease PA
+	for (count = (nb_ramp_pts-1); count >= 0; count--)
+	{
+		trx8BitWrite(CC112X_PA_CFG2, Ramp_Pa[nb_ramp_pts-count-1]);
+		RADIO_spin(ModTiming.ramp_loops);
+	}
+
+	// Program the frequency offset
+	cc112xSpiWriteReg(CC112X_FREQOFF1, &writeByte_FOFF1, 1);
+	cc112xSpiWriteReg(CC112X_FREQOFF0, &writeByte_FOFF0, 1);
+
+	RADIO_spin(ModTiming.phase_loops);
+
+	writeByte_FOFF1 = FOFF1;
+	cc112xSpiWriteReg(CC112X_FREQOFF1, &writeByte_FOFF1, 1);
+	writeByte_FOFF0 = FOFF0;
+	cc112xSpiWriteReg(CC112X_FREQOFF0, &writeByte_FOFF0, 1);
+
+	// increase PA
+	for (count = nb_ramp_pts-1; count >= (0); count--)
+	{
+		trx8BitWrite(CC112X_PA_CFG2, Ramp_Pa[count]);
+		RADIO_spin(ModTiming.ramp_loops);
+	}
+}
+
+/* RADIO_modulate() of MODE_ETSI_OPT */
+static void ref_modulate_etsi_opt(void)
+{
+	s16 count;
+	uint8 u8_FreqValue;
+
+	if(b_Diff == true)
+	{
+		b_Diff = false;
+
+		for (count = 0; count < (NB_POINTS); count++)
+		{
+			// Modulate using PA and FREQOFF
+			u8_FreqValue = FOFF0_ETSI + CC1120_etsi_profile[count][1];
+
+			trx8BitWrite(CC112X_PA_CFG2, CC1120_etsi_profile[count][0]);
+			trx16BitWrite((uint8)(CC112X_FREQOFF0 >> 8), (uint8)(CC112X_FREQOFF0 & 0x00FF), u8_FreqValue);
+			RADIO_spin(ModTiming.ramp_loops);
+		}
+	}
+	else
+	{
+		b_Diff = true;
+
+		for (count = 0; count < (NB_POINTS); count++)
+		{
+			// Modulate using PA and FREQOFF
+			u8_FreqValue = FOFF0_ETSI - CC1120_etsi_profile[count][1];
+
+			trx8BitWrite(CC112X_PA_CFG2, CC1120_etsi_profile[count][0]);
+			trx16BitWrite((uint8)(CC112X_FREQOFF0 >> 8), (uint8)(CC112X_FREQOFF0 & 0x00FF), u8_FreqValue);
+			RADIO_spin(ModTiming.ramp_loops);
+		}
+	}
+}
+
+/* NB_BITS '0' bits from the same chip and phase state, *pRun gets the
+ * accesses, their cycle from the first bit, and the cycles of the bits */
+static void run(const Case_t *c, void (*modulate)(void), Run_t *pRun)
+{
+	const SimRadioLog_t *log;
+	unsigned long n, i;
+	uint64_t t0;
+	unsigned int bit;
+
+	SIM_CHECK(RADIO_select_profile(c->e_Profile), "profile %s", c->name);
+	RADIO_init_chip(ftx, E_TX_MODE);
+	RADIO_start_rf_carrier();
+	b_Diff = false;
+
+	sim_radio_log_clear();
+	t0 = sim_now();
+	for (bit = 0; bit < NB_BITS; bit++)
+	{
+		modulate();
+	}
+	pRun->cycles = sim_now() - t0;
+	log = sim_radio_log(&n);
+	pRun->n = (n < LOG_MAX) ? n : LOG_MAX;
+	for (i = 0; i < pRun->n; i++)
+	{
+		pRun->log[i] = log[i];
+		pRun->log[i].t -= t0;
+	}
+	SIM_CHECK(n < LOG_MAX, "%s: %lu accesses", c->name, n);
+
+	RADIO_stop_rf_carrier();
+}
+
+static void compare(const Case_t *c)
+{
+	static Run_t profile, builtin;
+	unsigned long i;
+
+	run(c, RADIO_modulate, &profile);
+	run(c, c->reference, &builtin);
+
+	SIM_CHECK(profile.n == builtin.n, "%s: %lu accesses, %lu compiled in", c->name, profile.n, builtin.n);
+	for (i = 0; (i < profile.n) && (i < builtin.n); i++)
+	{
+		if ((profile.log[i].kind != builtin.log[i].kind) || (profile.log[i].addr != builtin.log[i].addr)
+			|| (profile.log[i].value != builtin.log[i].value) || (profile.log[i].t != builtin.log[i].t))
+		{
+			SIM_CHECK(0, "%s access %lu: %u %04X=%02X at %llu, compiled in %u %04X=%02X at %llu", c->name, i,
+					  profile.log[i].kind, profile.log[i].addr, profile.log[i].value,
+					  (unsigned long long)profile.log[i].t, builtin.log[i].kind, builtin.log[i].addr,
+					  builtin.log[i].value, (unsigned long long)builtin.log[i].t);
+			break;
+		}
+	}
+	SIM_CHECK(profile.cycles == builtin.cycles, "%s: %llu cycles, %llu compiled in", c->name,
+			  (unsigned long long)profile.cycles, (unsigned long long)builtin.cycles);
+	printf("%-8s %4lu accesses per bit, %6llu cycles per bit, compiled in %6llu\n", c->name,
+		   profile.n / NB_BITS, (unsigned long long)(profile.cycles / NB_BITS),
+		   (unsigned long long)(builtin.cycles / NB_BITS));
+}
+
+int main(void)
+{
+	static const Case_t Cases[] = {
+		{ E_PROFILE_FCC, "FCC", ref_modulate_pa_ramp },
+		{ E_PROFILE_ETSI, "ETSI", ref_modulate_pa_ramp },
+		{ E_PROFILE_ETSI_OPT, "ETSI_OPT", ref_modulate_etsi_opt },
+	};
+	unsigned int i;
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	for (i = 0; i < sizeof(Cases) / sizeof(Cases[0]); i++)
+	{
+		compare(&Cases[i]);
+	}
+
+	return sim_result("test_profile_engine");
+}
@@ -0,0 +1,259 @@
+//*****************************************************************************
+//! @file       test_radio_power.c
+//! @brief      Power states of the radio between frames, RADIO_power_sleep()
+//!				and RADIO_close_chip(), against the states of the CC112x
+//!				model.
+//!
+//!				radio.c is built into the test to read the state of the
+//!				manager. Frames of three repeats are sent with the next TX
+//!				announced unknown, 1, 10, 100 and 2000 ms ahead, with and
+//!				without a TX session, a downlink window every RX_EVERY
+//!				frame. After each call the state of the manager must be
+//!				the one of the chip, SXOFF and SPWD must be strobed in
+//!				IDLE, the GPIO interrupt must be off while the chip sleeps
+//!				and every wake-up of the chip must be one of
+//!				RADIO_power_wake().
+//!				The residency counters must add up to the elapsed ACLK
+//!				ticks. The charge of the radio between the carriers is
+//!				reported against staying in IDLE.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "radio.c"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_FRAMES				20
+#define NB_REPEATS				3
+#define RX_EVERY				5			// frames
+#define CARRIER_MS				5			// shortened, the states between the carriers are checked
+#define RX_WINDOW_MS			25			// shortened
+#define UNKNOWN_WAIT_MS			10000		// wait after a frame with no next TX announced
+
+/* Currents of the CC1120 datasheet (typical, 3 V), uA */
+#define CURRENT_IDLE_UA			1500.0
+#define CURRENT_XOFF_UA			170.0
+#define CURRENT_SLEEP_UA		0.3
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const uint32 NextTx[] = { RADIO_NEXT_UNKNOWN, 1, 10, 100, 2000 };
+static bool b_IntEnabled;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* GPIO interrupt of the radio, see trx_rf_int.c */
+void trxEnableInt(void)
+{
+	b_IntEnabled = true;
+}
+
+void trxDisableInt(void)
+{
+	b_IntEnabled = false;
+}
+
+static void wait_ms(uint32 ul_Ms)
+{
+	sim_advance(((uint64_t)ul_Ms * sim_mclk_hz) / 1000);
+}
+
+/* State of the manager against the one of the chip, after a radio call */
+static void check_state(const char *call, const char *name, unsigned int frame)
+{
+	uint8_t marc = sim_radio_state();
+	int match;
+
+	switch (e_PwrState)
+	{
+	case E_RADIO_PWR_ACTIVE:
+		match = (marc == SIM_MARC_TX) || (marc == SIM_MARC_RX) || (marc == SIM_MARC_FSTXON)
+				|| (marc == SIM_MARC_MANCAL);
+		break;
+	case E_RADIO_PWR_IDLE:
+		match = (marc == SIM_MARC_IDLE);
+		break;
+	case E_RADIO_PWR_XOSC_OFF:
+		match = (marc == SIM_MARC_XOFF);
+		break;
+	default:
+		match = (marc == SIM_MARC_SLEEP);
+		break;
+	}
+	SIM_CHECK(match, "%s frame %u, %s: manager state %u, chip %02X", name, frame, call, e_PwrState, marc);
+	SIM_CHECK(!b_IntEnabled || ((marc != SIM_MARC_SLEEP) && (marc != SIM_MARC_XOFF)),
+			  "%s frame %u, %s: GPIO interrupt on, chip %02X", name, frame, call, marc);
+}
+
+/* The strobes to XOFF and SLEEP of the log are made from IDLE */
+static void check_strobes(const char *name, unsigned int frame)
+{
+	const SimRadioLog_t *log;
+	unsigned long n, i;
+
+	log = sim_radio_log(&n);
+	for (i = 0; i < n; i++)
+	{
+		if ((log[i].kind == SIM_LOG_STROBE) && ((log[i].addr == CC112X_SXOFF) || (log[i].addr == CC112X_SPWD)))
+		{
+			SIM_CHECK(log[i].state == SIM_MARC_IDLE, "%s frame %u: %s strobed in state %02X", name, frame,
+					  (log[i].addr == CC112X_SXOFF) ? "SXOFF" : "SPWD", log[i].state);
+		}
+	}
+	sim_radio_log_clear();
+}
+
+static uint32 residency(const RadioPowerStats_t *s)
+{
+	uint32 sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < E_RADIO_PWR_NB; i++)
+	{
+		sum += s->ul_Residency[i];
+	}
+	return sum;
+}
+
+/* Frames announcing the next one ul_NextMs ahead */
+static void run(uint32 ul_NextMs, bool b_Session)
+{
+	static const te_RadioPowerState Expected[] = { E_RADIO_PWR_DOWN, E_RADIO_PWR_IDLE, E_RADIO_PWR_XOSC_OFF,
+												   E_RADIO_PWR_DOWN, E_RADIO_PWR_DOWN };
+	RadioPowerStats_t start;
+	const RadioPowerStats_t *s;
+	char name[40];
+	uint32 aclk, wait_ms_next, ticks, on_ticks;
+	unsigned long wakes;
+	uint64_t on;
+	double charge, charge_idle, off;
+	unsigned int frame, repeat, i;
+
+	if (ul_NextMs == RADIO_NEXT_UNKNOWN)
+	{
+		sprintf(name, "unknown%s", b_Session ? " session" : "");
+		wait_ms_next = UNKNOWN_WAIT_MS;
+	}
+	else
+	{
+		sprintf(name, "%lu ms%s", (unsigned long)ul_NextMs, b_Session ? " session" : "");
+		wait_ms_next = ul_NextMs;
+	}
+	for (i = 0; NextTx[i] != ul_NextMs; i++);
+
+	start = *RADIO_power_stats();
+	aclk = sim_aclk_ticks();
+	wakes = sim_radio.wakes;
+	on = sim_radio_on_cycles();
+	RADIO_tx_session(b_Session);
+	RADIO_power_next_tx(ul_NextMs);
+
+	for (frame = 0; frame < NB_FRAMES; frame++)
+	{
+		for (repeat = 0; repeat < NB_REPEATS; repeat++)
+		{
+			RADIO_init_chip(ftx + 1000 * repeat, E_TX_MODE);
+			check_state("RADIO_init_chip(TX)", name, frame);
+			RADIO_start_rf_carrier();
+			check_state("RADIO_start_rf_carrier()", name, frame);
+			wait_ms(CARRIER_MS);
+			RADIO_stop_rf_carrier();
+			check_state("RADIO_stop_rf_carrier()", name, frame);
+			if (repeat < NB_REPEATS - 1)
+			{
+				// sfx_delay(E_TX_DELAY)
+				RADIO_power_sleep(1000);
+				check_state("RADIO_power_sleep(1000)", name, frame);
+				wait_ms(1000);
+			}
+		}
+		if ((frame % RX_EVERY) == (RX_EVERY - 1))
+		{
+			// sfx_delay(E_RX_DELAY), then the downlink window
+			RADIO_power_sleep(500);
+			check_state("RADIO_power_sleep(500)", name, frame);
+			wait_ms(500);
+			RADIO_init_chip(frx, E_RX_MODE);
+			check_state("RADIO_init_chip(RX)", name, frame);
+			RADIO_start_rx();
+			check_state("RADIO_start_rx()", name, frame);
+			SIM_CHECK(b_IntEnabled, "%s frame %u: GPIO interrupt off in RX", name, frame);
+			wait_ms(RX_WINDOW_MS);
+		}
+		RADIO_close_chip();
+		check_state("RADIO_close_chip()", name, frame);
+		SIM_CHECK(e_PwrState == Expected[i], "%s frame %u: state %u after RADIO_close_chip(), %u expected",
+				  name, frame, e_PwrState, Expected[i]);
+		check_strobes(name, frame);
+		wait_ms(wait_ms_next);
+	}
+	RADIO_tx_session(false);
+	RADIO_power_next_tx(RADIO_NEXT_UNKNOWN);
+
+	// The residency adds up to the ACLK ticks: one tick off at each end
+	s = RADIO_power_stats();
+	aclk = sim_aclk_ticks() - aclk;
+	ticks = residency(s) - residency(&start);
+	SIM_CHECK((ticks + 1 >= aclk) && (ticks <= aclk + 1), "%s: %lu ticks of residency, %lu elapsed", name,
+			  (unsigned long)ticks, (unsigned long)aclk);
+	SIM_CHECK(sim_radio.wakes - wakes == (unsigned long)(s->u16_Wakeups - start.u16_Wakeups),
+			  "%s: %lu wake-ups of the chip, %u by RADIO_power_wake()", name, sim_radio.wakes - wakes,
+			  s->u16_Wakeups - start.u16_Wakeups);
+
+	// The XOSC runs in ACTIVE and IDLE, and while a wake-up settles
+	on_ticks = (uint32)(((sim_radio_on_cycles() - on) * SIM_ACLK_HZ) / sim_mclk_hz);
+	ticks = (s->ul_Residency[E_RADIO_PWR_ACTIVE] - start.ul_Residency[E_RADIO_PWR_ACTIVE])
+			+ (s->ul_Residency[E_RADIO_PWR_IDLE] - start.ul_Residency[E_RADIO_PWR_IDLE]);
+	SIM_CHECK((on_ticks + 1 >= ticks)
+			  && (on_ticks <= ticks + 1 + (uint32)(s->u16_Wakeups - start.u16_Wakeups) * (s->u16_WakeSettleMax + 1)),
+			  "%s: XOSC on %lu ticks, %lu ticks ACTIVE and IDLE", name, (unsigned long)on_ticks,
+			  (unsigned long)ticks);
+
+	// Charge between the carriers, against IDLE all along
+	charge = 0;
+	off = 0;
+	for (i = E_RADIO_PWR_IDLE; i < E_RADIO_PWR_NB; i++)
+	{
+		ticks = s->ul_Residency[i] - start.ul_Residency[i];
+		off += (double)ticks / SIM_ACLK_HZ;
+		charge += (double)ticks / SIM_ACLK_HZ * ((i == E_RADIO_PWR_IDLE) ? CURRENT_IDLE_UA
+												 : (i == E_RADIO_PWR_XOSC_OFF) ? CURRENT_XOFF_UA : CURRENT_SLEEP_UA);
+	}
+	charge_idle = off * CURRENT_IDLE_UA;
+	printf("%-18s IDLE %8.3f s, XOFF %8.3f s, SLEEP %8.3f s, %3u wake-ups, %7.2f uC per frame (IDLE %8.2f uC)\n",
+		   name, (double)(s->ul_Residency[E_RADIO_PWR_IDLE] - start.ul_Residency[E_RADIO_PWR_IDLE]) / SIM_ACLK_HZ,
+		   (double)(s->ul_Residency[E_RADIO_PWR_XOSC_OFF] - start.ul_Residency[E_RADIO_PWR_XOSC_OFF]) / SIM_ACLK_HZ,
+		   (double)(s->ul_Residency[E_RADIO_PWR_DOWN] - start.ul_Residency[E_RADIO_PWR_DOWN]) / SIM_ACLK_HZ,
+		   s->u16_Wakeups - start.u16_Wakeups, charge / NB_FRAMES, charge_idle / NB_FRAMES);
+	SIM_CHECK(charge <= charge_idle, "%s: more charge than in IDLE", name);
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	TIMER_timebase_init();
+
+	// The first configuration resets the chip, its XOSC restart is not a wake-up
+	RADIO_init_chip(ftx, E_TX_MODE);
+	RADIO_close_chip();
+	sim_radio_log_clear();
+
+	printf("radio between the carriers, %u frames of %u repeats, RX every %u (datasheet currents):\n",
+		   NB_FRAMES, NB_REPEATS, RX_EVERY);
+	for (i = 0; i < sizeof(NextTx) / sizeof(NextTx[0]); i++)
+	{
+		run(NextTx[i], false);
+		run(NextTx[i], true);
+	}
+
+	return sim_result("test_radio_power");
+}
@@ -0,0 +1,176 @@
+//*****************************************************************************
+//! @file       test_ramp_resolution.c
+//! @brief      PA envelope of the ramps of RADIO_set_ramp_resolution()
+//!				against Table_Pa_600bps, the reference ramp.
+//!
+//!				For each profile and resolution a '0' bit is modulated,
+//!				the PA_CFG2 levels of each ramp are laid over the length of
+//!				the ramp and linearly interpolated at the points of the
+//!				reference. The deviation is reported and bounded by the
+//!				distance of the reference to the chords of the resampled
+//!				ramp, what linear interpolation misses, plus the rounding
+//!				of the levels.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+#include "modulation_table.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define ROUNDING				0.51		// PA level, rounding and 8-bit fraction of the interpolated levels
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const uint8 Resolutions[] = { NB_PTS_PA, 64, 32, 16 };
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* Level of the ramp pa[0..n-1] at x, 0 at the first point and 1 at the last */
+static double envelope(const uint8_t *pa, unsigned int n, double x)
+{
+	double pos = x * (n - 1);
+	unsigned int i = (unsigned int)pos;
+
+	if (i >= n - 1)
+	{
+		return pa[n - 1];
+	}
+	return pa[i] + (pa[i + 1] - pa[i]) * (pos - i);
+}
+
+/* Reference at position x of the table, linear between its points */
+static double reference(double x)
+{
+	unsigned int i = (unsigned int)x;
+
+	if (i >= NB_PTS_PA - 1)
+	{
+		return Table_Pa_600bps[NB_PTS_PA - 1];
+	}
+	return Table_Pa_600bps[i] + (Table_Pa_600bps[i + 1] - Table_Pa_600bps[i]) * (x - i);
+}
+
+/* Largest distance of the reference points to the chords of a ramp of n
+ * points: what linear interpolation between exact levels misses */
+static double reference_bound(unsigned int n)
+{
+	double a, b, chord, dev = 0;
+	unsigned int i, k;
+
+	for (i = 0; i + 1 < n; i++)
+	{
+		a = (double)i * (NB_PTS_PA - 1) / (n - 1);
+		b = (double)(i + 1) * (NB_PTS_PA - 1) / (n - 1);
+		for (k = (unsigned int)ceil(a); (k <= b) && (k < NB_PTS_PA); k++)
+		{
+			chord = reference(a) + (reference(b) - reference(a)) * (k - a) / (b - a);
+			dev = fmax(dev, fabs(Table_Pa_600bps[k] - chord));
+		}
+	}
+	return dev;
+}
+
+static void run(te_ModProfileId e_Profile, const char *name, uint8 u8_NbSteps)
+{
+	const SimRadioLog_t *log;
+	uint8_t pa[2 * NB_PTS_PA + 1];
+	unsigned long n, i;
+	unsigned int n_pa = 0, k, ramp;
+	uint64_t t_first = 0, t_last = 0;
+	unsigned long bytes;
+	double err, max_err = 0, sq = 0, bound;
+	const uint8_t *p;
+
+	SIM_CHECK(RADIO_select_profile(e_Profile), "profile %s", name);
+	RADIO_init_chip(ftx, E_TX_MODE);
+	SIM_CHECK(RADIO_set_ramp_resolution(u8_NbSteps), "resolution %u", u8_NbSteps);
+	RADIO_start_rf_carrier();
+	__enable_interrupt();
+
+	sim_radio_log_clear();
+	bytes = sim_spi.bytes;
+	RADIO_modulate();
+	while (RADIO_modulation_busy())
+	{
+		sim_advance(8);
+	}
+	bytes = sim_spi.bytes - bytes;
+	log = sim_radio_log(&n);
+	for (i = 0; i < n; i++)
+	{
+		if ((log[i].kind == SIM_LOG_WRITE) && (log[i].addr == CC112X_PA_CFG2) && (n_pa < sizeof(pa)))
+		{
+			t_first = n_pa ? t_first : log[i].t;
+			t_last = log[i].t;
+			pa[n_pa++] = log[i].value;
+		}
+	}
+	__disable_interrupt();
+	RADIO_stop_rf_carrier();
+
+	SIM_CHECK(n_pa == 2 * u8_NbSteps, "%s/%u: %u PA levels written", name, u8_NbSteps, n_pa);
+	if (n_pa != 2 * u8_NbSteps)
+	{
+		return;
+	}
+	SIM_CHECK((pa[0] == Table_Pa_600bps[0]) && (pa[n_pa - 1] == Table_Pa_600bps[0])
+			  && (pa[u8_NbSteps - 1] == Table_Pa_600bps[NB_PTS_PA - 1]) && (pa[u8_NbSteps] == Table_Pa_600bps[NB_PTS_PA - 1]),
+			  "%s/%u: ramp ends %u..%u..%u", name, u8_NbSteps, pa[0], pa[u8_NbSteps - 1], pa[n_pa - 1]);
+
+	// Ramp down, then the ramp up read backward
+	for (ramp = 0; ramp < 2; ramp++)
+	{
+		p = &pa[ramp * u8_NbSteps];
+		for (k = 0; k < NB_PTS_PA; k++)
+		{
+			if (ramp == 0)
+			{
+				err = envelope(p, u8_NbSteps, (double)k / (NB_PTS_PA - 1)) - Table_Pa_600bps[k];
+			}
+			else
+			{
+				err = envelope(p, u8_NbSteps, 1.0 - (double)k / (NB_PTS_PA - 1)) - Table_Pa_600bps[k];
+			}
+			max_err = fmax(max_err, fabs(err));
+			sq += err * err;
+		}
+		for (k = 1; k < u8_NbSteps; k++)
+		{
+			SIM_CHECK((ramp == 0) ? (p[k] <= p[k - 1]) : (p[k] >= p[k - 1]),
+					  "%s/%u: ramp %u not monotonic at %u", name, u8_NbSteps, ramp, k);
+		}
+	}
+	bound = reference_bound(u8_NbSteps) + ROUNDING;
+	printf("%-4s %3u steps: max %.2f, rms %.2f PA levels (bound %.2f), %lu SPI bytes, "
+		   "ramps over %.2f ms\n", name, u8_NbSteps, max_err, sqrt(sq / (2 * NB_PTS_PA)), bound, bytes,
+		   (t_last - t_first) * 1e3 / sim_mclk_hz);
+	SIM_CHECK(max_err <= bound, "%s/%u: deviation %.2f above %.2f", name, u8_NbSteps, max_err, bound);
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	for (i = 0; i < sizeof(Resolutions); i++)
+	{
+		run(E_PROFILE_FCC, "FCC", Resolutions[i]);
+	}
+	for (i = 0; i < sizeof(Resolutions); i++)
+	{
+		run(E_PROFILE_ETSI, "ETSI", Resolutions[i]);
+	}
+	return sim_result("test_ramp_resolution");
+}
@@ -0,0 +1,277 @@
+//*****************************************************************************
+//! @file       test_rx_ring.c
+//! @brief      Downlink frames lost by sfx_waitframe(), with the frames
+//!				queued by the RX interrupt against the previous receive path.
+//!
+//!				NB_FRAMES frames are injected back-to-back at the line rate
+//!				in a RX window of sfx_init(E_RX_MODE): 224 bits at 600 bps
+//!				(preamble, sync word, then the 15 bytes with the RSSI and
+//!				CRC_OK status bytes appended). The library takes CHECK_MS
+//!				to check each frame sfx_waitframe() returns, the CPU on,
+//!				before it asks for the next one.
+//!				The previous path is replayed: an interrupt setting
+//!				packetSemaphore only, then RXLAST read three times, the
+//!				FIFO read with one call, flushed, and SRX strobed again.
+//!				A frame is lost when the radio is not in RX at its end, or
+//!				when it is not returned by sfx_waitframe(). Each frame
+//!				returned must be the next one injected, intact.
+//!				With the ring, the radio must be in RX again within
+//!				RESTART_MS of each frame, the frames lost must be the ones
+//!				counted dropped by RADIO_rx_stats(), and none is lost while
+//!				the library checks a frame faster than the line rate.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "sigfox_demo.h"
+#include "radio.h"
+#include "trx_rf_int.h"
+#include "timer.h"
+#include "cc112x_spi.h"
+#include "../../sigfox_library_api/sigfox.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_FRAMES				8
+#define FRAME_BITS				224			// 91 bits of preamble, 13 of sync word, 15 bytes
+#define LINE_BPS				600
+#define FRAME_CYCLES			((uint64_t)FRAME_BITS * sim_mclk_hz / LINE_BPS)
+#define FIRST_MS				500			// SRX to the end of the first frame
+#define WINDOW_S				25
+#define RESTART_MS				2			// end of a frame to RX again, with the ring
+#define RSSI_RAW				((u8)(-60))	// RSSI status byte of the frames
+#define NB_CHECKS				(sizeof(CheckMs) / sizeof(CheckMs[0]))
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned int received;		// frames returned by sfx_waitframe(), in order and intact
+	unsigned int missed;		// frames ending with the radio out of RX
+	unsigned int dropped;		// frames counted dropped by RADIO_rx_stats()
+	unsigned int late;			// frames after which the radio was not in RX again within RESTART_MS
+}Run_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const uint16 CheckMs[] = { 5, 50, 200, 400, 600, 1000 };
+
+static Run_t *pCur;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static void frame_data(unsigned int index, u8 *data)
+{
+	unsigned int i;
+
+	data[0] = (u8)index;
+	for (i = 1; i < RADIO_RX_FRAME_SIZE - 2; i++)
+	{
+		data[i] = (u8)(0xA5 ^ (index * 31) ^ (i * 7));
+	}
+	data[RADIO_RX_FRAME_SIZE - 2] = RSSI_RAW;
+	data[RADIO_RX_FRAME_SIZE - 1] = 0x80;		// CRC_OK
+}
+
+static void check_restart(void *arg)
+{
+	if (sim_radio_state() != SIM_MARC_RX)
+	{
+		pCur->late++;
+	}
+}
+
+/* End of a frame on the air */
+static void deliver(void *arg)
+{
+	u8 data[RADIO_RX_FRAME_SIZE];
+
+	if (sim_radio_state() != SIM_MARC_RX)
+	{
+		pCur->missed++;
+		return;
+	}
+	frame_data((unsigned int)(uintptr_t)arg, data);
+	sim_radio_rx_frame(data, RADIO_RX_FRAME_SIZE);
+	sim_at(sim_now() + (uint64_t)RESTART_MS * sim_mclk_hz / 1000, check_restart, NULL);
+}
+
+/* Interrupt of the previous path */
+static void ref_isr(void)
+{
+	packetSemaphore = ISR_ACTION_REQUIRED;
+}
+
+/* sfx_waitframe() before the RX ring */
+static SFX_ext_status ref_waitframe(u8 *frame)
+{
+	uint8 rxlastindex;
+	uint8 rx_last;
+	uint8 marcStatus;
+	unsigned char ii;
+	SFX_ext_status status = E_FRAME_ERROR;
+
+	trxSpiCmdStrobe(CC112X_SRX);
+
+	__disable_interrupt();
+	while ((TIMER0_timeout == FALSE) && (packetSemaphore == ISR_IDLE))
+	{
+		__bis_SR_register(LPM3_bits + GIE);
+		__disable_interrupt();
+	}
+	__enable_interrupt();
+
+	if (packetSemaphore == ISR_ACTION_REQUIRED)
+	{
+		// Read 3 times to get around a bug
+		rxlastindex = 0;
+		for (ii = 0; ii < 3; ii++)
+		{
+			cc112xSpiReadReg(CC112X_RXLAST, &rx_last, 1);
+			rxlastindex |= rx_last;
+		}
+		if (rxlastindex != 0)
+		{
+			cc112xSpiReadReg(CC112X_MARCSTATE, &marcStatus, 1);
+			if ((marcStatus & 0x1F) == SIM_MARC_RX_FIFO_ERR)
+			{
+				trxSpiCmdStrobe(CC112X_SFRX);
+			}
+			else
+			{
+				if (rxlastindex >= 16)
+				{
+					rxlastindex = 16;
+				}
+				cc112xSpiReadRxFifo(frame, rxlastindex + 1);
+				cc112xSpiReadReg(CC112X_MARCSTATE, &marcStatus, 1);
+				trxSpiCmdStrobe(CC112X_SFRX);
+				status = E_FRAME_RECEIVED;
+			}
+		}
+		packetSemaphore = ISR_IDLE;
+		trxSpiCmdStrobe(CC112X_SRX);
+	}
+	else if (TIMER0_timeout == TRUE)
+	{
+		TIMER_downlink_timing_stop();
+		status = E_FRAME_TIMEOUT;
+	}
+	return status;
+}
+
+/* A RX window with NB_FRAMES frames, each checked in check_ms by the library */
+static void window(uint16 check_ms, int b_Ring, Run_t *pRun)
+{
+	u8 frame[RADIO_RX_FRAME_SIZE];
+	u8 expected[RADIO_RX_FRAME_SIZE];
+	SFX_ext_status status;
+	unsigned int next = 0, i;
+	uint16 dropped;
+	uint64_t t0;
+
+	memset(pRun, 0, sizeof(Run_t));
+	pCur = pRun;
+
+	sfx_init(E_RX_MODE);
+	if (!b_Ring)
+	{
+		trxIsrConnect(ref_isr);
+	}
+	dropped = RADIO_rx_stats()->u16_Dropped;
+	sfx_StartRxTimeout(WINDOW_S);
+	t0 = sim_now() + (uint64_t)FIRST_MS * sim_mclk_hz / 1000;
+	for (i = 0; i < NB_FRAMES; i++)
+	{
+		sim_at(t0 + i * FRAME_CYCLES, deliver, (void *)(uintptr_t)i);
+	}
+
+	do
+	{
+		status = b_Ring ? sfx_waitframe(frame) : ref_waitframe(frame);
+		if (status == E_FRAME_RECEIVED)
+		{
+			// The next frame not lost
+			while ((next < NB_FRAMES) && (frame[0] != next))
+			{
+				next++;
+			}
+			frame_data(next, expected);
+			SIM_CHECK(memcmp(frame, expected, RADIO_RX_FRAME_SIZE) == 0, "check %u ms%s: frame %u returned out of order "
+					  "or damaged", check_ms, b_Ring ? "" : " before", frame[0]);
+			if (b_Ring)
+			{
+				SIM_CHECK(sfx_getrssivalue() == (s8)RSSI_RAW, "check %u ms: RSSI %d", check_ms, sfx_getrssivalue());
+			}
+			next++;
+			pRun->received++;
+
+			// The library checks the frame
+			sim_advance((uint64_t)check_ms * sim_mclk_hz / 1000);
+		}
+	} while (status != E_FRAME_TIMEOUT);
+	sfx_close();
+
+	pRun->dropped = RADIO_rx_stats()->u16_Dropped - dropped;
+}
+
+int main(void)
+{
+	Run_t before[NB_CHECKS], after[NB_CHECKS];
+	unsigned int i;
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	SIM_CHECK(RADIO_select_profile(E_PROFILE_FCC), "profile FCC");
+	TIMER_bitrate_init();
+	TIMER_timebase_init();
+	__enable_interrupt();
+
+	for (i = 0; i < NB_CHECKS; i++)
+	{
+		window(CheckMs[i], 0, &before[i]);
+		window(CheckMs[i], 1, &after[i]);
+
+		SIM_CHECK(after[i].missed == 0, "check %u ms: %u frames ended out of RX", CheckMs[i], after[i].missed);
+		SIM_CHECK(after[i].late == 0, "check %u ms: RX not restarted within %u ms of %u frames", CheckMs[i],
+				  RESTART_MS, after[i].late);
+		SIM_CHECK(after[i].received + after[i].dropped == NB_FRAMES, "check %u ms: %u frames received, %u dropped "
+				  "of %u", CheckMs[i], after[i].received, after[i].dropped, NB_FRAMES);
+		SIM_CHECK(after[i].received >= before[i].received, "check %u ms: %u frames received, %u before",
+				  CheckMs[i], after[i].received, before[i].received);
+		if ((uint64_t)CheckMs[i] * sim_mclk_hz / 1000 < FRAME_CYCLES)
+		{
+			SIM_CHECK(after[i].received == NB_FRAMES, "check %u ms: %u frames lost", CheckMs[i],
+					  NB_FRAMES - after[i].received);
+		}
+	}
+
+	printf("%u frames back-to-back at %u bps (%.0f ms each), frames lost for the check time of a frame:\n",
+		   NB_FRAMES, LINE_BPS, FRAME_CYCLES * 1e3 / sim_mclk_hz);
+	printf("check time     ");
+	for (i = 0; i < NB_CHECKS; i++)
+	{
+		printf(" %5u ms", CheckMs[i]);
+	}
+	printf("\nbefore         ");
+	for (i = 0; i < NB_CHECKS; i++)
+	{
+		printf(" %8u", NB_FRAMES - before[i].received);
+	}
+	printf("\nring of %u      ", RADIO_RX_RING_SIZE);
+	for (i = 0; i < NB_CHECKS; i++)
+	{
+		printf(" %8u", NB_FRAMES - after[i].received);
+	}
+	printf("\n");
+
+	return sim_result("test_rx_ring");
+}
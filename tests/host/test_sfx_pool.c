@@ -0,0 +1,361 @@
+//*****************************************************************************
+//! @file       test_sfx_pool.c
+//! @brief      Memory pool of sfx_malloc() / sfx_free() against the
+//!				allocations of the SigFox library.
+//!
+//!				The library pattern, seen in the relocations of
+//!				sigfox_frame.obj, is replayed: SfxInit() asks 2 x 30 bytes
+//!				freed by SfxClose(), MakeFrame() 32 bytes per frame and
+//!				OutOfBandFrame() 8 bytes. Then every size up to past the
+//!				largest class, the spill to a larger class, the
+//!				fragmentation counter, the bad frees and random
+//!				allocations checked against a model of the blocks.
+//!
+//!				Built twice: with the address sanitizer, which checks the
+//!				blocks stay in DynamicMemoryTable, and with SFX_POOL_BENCH,
+//!				which also times the library pattern on the host against
+//!				the exact size tables sfx_malloc() used before the pool.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "sigfox_demo.h"
+#include "../../sigfox_library_api/sigfox.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define SESSIONS				10000
+#define FRAMES_PER_SESSION		4
+#define OOB_EVERY				10			// sessions
+#define RANDOM_OPS				200000
+#define RANDOM_SIZE_MAX			70
+#define BENCH_SESSIONS			1000000
+#define LIBRARY_HIGH_WATERMARK	(2 * 30 + 32)
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	u8 *p;
+	u16 size;
+	u8 tag;
+}Block_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const u16 ClassSize[] = { 8, 30, 32, 64 };
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+#ifdef SFX_POOL_BENCH
+/* Reference, the exact size tables of sfx_malloc() before the pool */
+typedef struct
+{
+	u8 * memory_ptr;
+	u8  allocated;
+}RefBlock;
+
+static u8 RefMemory[64 + 32 + 2 * 30 + 8];
+static RefBlock Ref_64bytes[1] = { { RefMemory, FALSE } };
+static RefBlock Ref_32bytes[1] = { { RefMemory + 64, FALSE } };
+static RefBlock Ref_30bytes[2] = { { RefMemory + 96, FALSE }, { RefMemory + 126, FALSE } };
+static RefBlock Ref_8bytes[1] = { { RefMemory + 156, FALSE } };
+
+static u8 *ref_malloc(u16 size)
+{
+	RefBlock *mem_blk = NULL;
+	u8 nb_block = 0;
+	u8 i;
+
+	switch (size)
+	{
+	case 30: mem_blk = Ref_30bytes; nb_block = 2; break;
+	case 32: mem_blk = Ref_32bytes; nb_block = 1; break;
+	case 64: mem_blk = Ref_64bytes; nb_block = 1; break;
+	case 8: mem_blk = Ref_8bytes; nb_block = 1; break;
+	default: break;
+	}
+	for (i = 0; i < nb_block; i++)
+	{
+		if (mem_blk[i].allocated == FALSE)
+		{
+			mem_blk[i].allocated = TRUE;
+			return mem_blk[i].memory_ptr;
+		}
+	}
+	return NULL;
+}
+
+static SFX_error_t ref_free_block(u8 *p, u8 nb_blocks, RefBlock *table_ptr)
+{
+	SFX_error_t status = SFX_ERR_INIT;
+	u8 i;
+
+	for (i = 0; i < nb_blocks; i++)
+	{
+		if (p == table_ptr[i].memory_ptr)
+		{
+			status = (table_ptr[i].allocated == TRUE) ? SFX_ERR_NONE : SFX_ERR_INIT;
+			table_ptr[i].allocated = FALSE;
+		}
+	}
+	return status;
+}
+
+static SFX_error_t ref_free(u8 *p)
+{
+	if ((p >= RefMemory) && (p < RefMemory + 64))
+	{
+		return ref_free_block(p, 1, Ref_64bytes);
+	}
+	if ((p >= RefMemory + 64) && (p < RefMemory + 96))
+	{
+		return ref_free_block(p, 1, Ref_32bytes);
+	}
+	if ((p >= RefMemory + 96) && (p < RefMemory + 156))
+	{
+		return ref_free_block(p, 2, Ref_30bytes);
+	}
+	if ((p >= RefMemory + 156) && (p < RefMemory + sizeof(RefMemory)))
+	{
+		return ref_free_block(p, 1, Ref_8bytes);
+	}
+	return SFX_ERR_INIT;
+}
+
+static double elapsed_ns(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+#endif
+
+/* Sessions of the library: SfxInit(), frames, an out of band frame
+ * every OOB_EVERY, SfxClose(). Gives the failed calls. */
+static unsigned long replay(u8 *(*alloc)(u16), SFX_error_t (*release)(u8 *), unsigned long sessions)
+{
+	unsigned long failed = 0, s;
+	unsigned int f;
+	u8 *init[2], *frame, *oob;
+
+	for (s = 0; s < sessions; s++)
+	{
+		init[0] = alloc(30);
+		init[1] = alloc(30);
+		failed += (init[0] == NULL) + (init[1] == NULL);
+		for (f = 0; f < FRAMES_PER_SESSION; f++)
+		{
+			frame = alloc(32);
+			failed += (frame == NULL) || (release(frame) != SFX_ERR_NONE);
+		}
+		if ((s % OOB_EVERY) == 0)
+		{
+			oob = alloc(8);
+			failed += (oob == NULL) || (release(oob) != SFX_ERR_NONE);
+		}
+		failed += (release(init[1]) != SFX_ERR_NONE) + (release(init[0]) != SFX_ERR_NONE);
+	}
+	return failed;
+}
+
+static void check_library(void)
+{
+	const MemoryPoolStats *stats = sfx_memory_stats();
+
+	sfx_memory_init();
+	SIM_CHECK(replay(sfx_malloc, sfx_free, SESSIONS) == 0, "library pattern: failed calls");
+	SIM_CHECK(stats->high_watermark == LIBRARY_HIGH_WATERMARK, "library pattern: high watermark %u, %u expected",
+			  stats->high_watermark, LIBRARY_HIGH_WATERMARK);
+	SIM_CHECK((stats->in_use == 0) && (stats->wasted == 0), "library pattern: %u bytes in use, %u wasted at the end",
+			  stats->in_use, stats->wasted);
+	SIM_CHECK((stats->wasted_max == 0) && (stats->spilled == 0) && (stats->failed == 0),
+			  "library pattern: %u wasted, %u spilled, %u failed", stats->wasted_max, stats->spilled, stats->failed);
+	printf("library pattern, %u sessions: high watermark %u of %u bytes\n", SESSIONS, stats->high_watermark,
+		   SFX_DYNAMIC_MEMORY);
+}
+
+/* Each size from an empty pool lands in the smallest class that fits */
+static void check_sizes(void)
+{
+	const MemoryPoolStats *stats = sfx_memory_stats();
+	u8 *p, *start;
+	u16 size, cls;
+	unsigned int i;
+
+	for (size = 1; size <= RANDOM_SIZE_MAX; size++)
+	{
+		sfx_memory_init();
+		p = sfx_malloc(size);
+		for (i = 0, start = DynamicMemoryTable; (i < sizeof(ClassSize) / sizeof(ClassSize[0]))
+											   && (ClassSize[i] < size); i++)
+		{
+			start += ClassSize[i] * ((i == 1) ? 2 : 1);
+		}
+		if (i == sizeof(ClassSize) / sizeof(ClassSize[0]))
+		{
+			SIM_CHECK(p == NULL, "size %u: allocated past the largest class", size);
+			SIM_CHECK((stats->failed == 1) && (stats->fragmented == 0), "size %u: %u failed, %u fragmented", size,
+					  stats->failed, stats->fragmented);
+			continue;
+		}
+		cls = ClassSize[i];
+		SIM_CHECK(p == start, "size %u: block at %d, class %u at %d", size, (int)(p - DynamicMemoryTable), cls,
+				  (int)(start - DynamicMemoryTable));
+		SIM_CHECK((stats->in_use == cls) && (stats->wasted == cls - size), "size %u: %u in use, %u wasted", size,
+				  stats->in_use, stats->wasted);
+		SIM_CHECK(sfx_free(p) == SFX_ERR_NONE, "size %u: sfx_free", size);
+		SIM_CHECK((stats->in_use == 0) && (stats->wasted == 0), "size %u: %u in use, %u wasted after sfx_free",
+				  size, stats->in_use, stats->wasted);
+	}
+}
+
+/* A full class spills to the next one, a request no free block holds is
+ * fragmented when the free bytes would have held it */
+static void check_spill(void)
+{
+	const MemoryPoolStats *stats = sfx_memory_stats();
+	u8 *small, *spill[4], *large, *huge;
+
+	sfx_memory_init();
+	small = sfx_malloc(8);
+	spill[0] = sfx_malloc(5);
+	spill[1] = sfx_malloc(5);
+	spill[2] = sfx_malloc(5);
+	spill[3] = sfx_malloc(5);
+	SIM_CHECK((small != NULL) && (spill[0] != NULL) && (spill[1] != NULL) && (spill[2] != NULL)
+			  && (spill[3] != NULL), "spill: NULL");
+	SIM_CHECK(stats->spilled == 4, "spill: %u spilled, 4 expected", stats->spilled);
+	SIM_CHECK(sfx_malloc(1) == NULL, "spill: pool full");
+	SIM_CHECK((stats->failed == 1) && (stats->fragmented == 0), "spill: %u failed, %u fragmented", stats->failed,
+			  stats->fragmented);
+
+	sfx_memory_init();
+	large = sfx_malloc(32);
+	huge = sfx_malloc(64);
+	SIM_CHECK(sfx_malloc(31) == NULL, "fragmented: 31 bytes without a 32 or 64 byte block");
+	SIM_CHECK((stats->failed == 1) && (stats->fragmented == 1), "fragmented: %u failed, %u fragmented",
+			  stats->failed, stats->fragmented);
+	SIM_CHECK((sfx_free(large) == SFX_ERR_NONE) && (sfx_free(huge) == SFX_ERR_NONE), "fragmented: sfx_free");
+}
+
+/* Frees of a pointer which is not an allocated block leave the pool as is */
+static void check_bad_frees(void)
+{
+	const MemoryPoolStats *stats = sfx_memory_stats();
+	MemoryPoolStats before;
+	u8 *p;
+
+	sfx_memory_init();
+	p = sfx_malloc(30);
+	before = *stats;
+	SIM_CHECK(sfx_free(NULL) == SFX_ERR_INIT, "sfx_free(NULL)");
+	SIM_CHECK(sfx_free(p + 1) == SFX_ERR_INIT, "sfx_free() inside a block");
+	SIM_CHECK(sfx_free(p + 30) == SFX_ERR_INIT, "sfx_free() of a free block");
+	SIM_CHECK(sfx_free(DynamicMemoryTable + SFX_DYNAMIC_MEMORY) == SFX_ERR_INIT, "sfx_free() past the pool");
+	SIM_CHECK(memcmp(stats, &before, sizeof(before)) == 0, "bad frees changed the counters");
+	SIM_CHECK(sfx_free(p) == SFX_ERR_NONE, "sfx_free()");
+	SIM_CHECK(sfx_free(p) == SFX_ERR_INIT, "double sfx_free()");
+	SIM_CHECK(stats->in_use == 0, "%u bytes in use after a double free", stats->in_use);
+}
+
+/* Random allocations: the blocks hold their tag till freed, the counters
+ * add up the blocks of the model */
+static void check_random(void)
+{
+	const MemoryPoolStats *stats = sfx_memory_stats();
+	static Block_t blocks[SFX_POOL_NB_BLOCKS + 1];		// and the request of a full pool
+	unsigned int n = 0, op, i, j;
+	u16 in_use, wasted, cls;
+	u8 *p;
+
+	sfx_memory_init();
+	srand(1);
+	for (op = 0; op < RANDOM_OPS; op++)
+	{
+		if ((n > 0) && (rand() & 1))
+		{
+			i = (unsigned int)rand() % n;
+			for (j = 0; j < blocks[i].size; j++)
+			{
+				if (blocks[i].p[j] != blocks[i].tag)
+				{
+					SIM_CHECK(0, "op %u: block of %u bytes overwritten", op, blocks[i].size);
+					return;
+				}
+			}
+			SIM_CHECK(sfx_free(blocks[i].p) == SFX_ERR_NONE, "op %u: sfx_free", op);
+			blocks[i] = blocks[--n];
+		}
+		else
+		{
+			blocks[n].size = (u16)(1 + (unsigned int)rand() % RANDOM_SIZE_MAX);
+			p = sfx_malloc(blocks[n].size);
+			if (p == NULL)
+			{
+				continue;
+			}
+			blocks[n].p = p;
+			blocks[n].tag = (u8)op;
+			memset(p, blocks[n].tag, blocks[n].size);
+			n++;
+		}
+
+		in_use = 0;
+		wasted = 0;
+		for (i = 0; i < n; i++)
+		{
+			cls = (blocks[i].p < DynamicMemoryTable + 8) ? 8 : (blocks[i].p < DynamicMemoryTable + 68) ? 30
+				: (blocks[i].p < DynamicMemoryTable + 100) ? 32 : 64;
+			in_use += cls;
+			wasted += cls - blocks[i].size;
+		}
+		if ((stats->in_use != in_use) || (stats->wasted != wasted))
+		{
+			SIM_CHECK(0, "op %u: %u in use, %u wasted, model %u and %u", op, stats->in_use, stats->wasted, in_use,
+					  wasted);
+			return;
+		}
+	}
+	printf("random, %u operations: high watermark %u, %u wasted at most, %u spilled, %u failed, %u fragmented\n",
+		   RANDOM_OPS, stats->high_watermark, stats->wasted_max, stats->spilled, stats->failed, stats->fragmented);
+}
+
+int main(void)
+{
+#ifdef SFX_POOL_BENCH
+	struct timespec t0, t1;
+	double pool_ns, ref_ns;
+	unsigned long calls;
+#endif
+
+	check_library();
+	check_sizes();
+	check_spill();
+	check_bad_frees();
+	check_random();
+
+#ifdef SFX_POOL_BENCH
+	// Calls of a session: 2 + 2 x FRAMES_PER_SESSION + 2, and the out of band frame
+	calls = BENCH_SESSIONS * (4 + 2 * FRAMES_PER_SESSION) + 2 * (BENCH_SESSIONS / OOB_EVERY);
+	sfx_memory_init();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	SIM_CHECK(replay(sfx_malloc, sfx_free, BENCH_SESSIONS) == 0, "bench: failed calls");
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	pool_ns = elapsed_ns(&t0, &t1) / calls;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	SIM_CHECK(replay(ref_malloc, ref_free, BENCH_SESSIONS) == 0, "bench: failed calls of the reference");
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ref_ns = elapsed_ns(&t0, &t1) / calls;
+	printf("host, library pattern: %.1f ns per sfx_malloc() / sfx_free() call, exact size tables %.1f ns\n",
+		   pool_ns, ref_ns);
+	return sim_result("test_sfx_pool_bench");
+#else
+	return sim_result("test_sfx_pool");
+#endif
+}
@@ -0,0 +1,213 @@
+//*****************************************************************************
+//! @file       test_sleep_delay.c
+//! @brief      Length of the delays of sfx_delay() / TIMER_sleep_ms(), slept
+//!				in LPM3 on the ACLK of Timer0, against the MCLK.
+//!
+//!				Delays from 1 ms to 65535 ms are slept at MCLK 1, 8, 20 and
+//!				24 MHz, from a random ACLK phase, with and without the
+//!				interrupts of the host UART waking the CPU UART_RATE times a
+//!				second. Each delay must last its ms within 1.5 ACLK tick
+//!				(rounding to ticks, phase of the first tick) and the code
+//!				of the call, DELAY_CODE_CYCLES of MCLK, with the CPU on for
+//!				a few wake-ups only.
+//!				The wait counters of a frame of sfx_delay(E_TX_DELAY) x 2,
+//!				sfx_delay(E_RX_DELAY) and sfx_delay(E_OOB_ACK_DELAY) must
+//!				give the ticks slept, and the downlink seconds on CCR0 must
+//!				keep their period while delays run on CCR1.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "sigfox_demo.h"
+#include "radio.h"
+#include "timer.h"
+#include "../../sigfox_library_api/sigfox.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define NB_PHASES				8			// random ACLK phases per delay
+#define UART_RATE				20			// host UART interrupts per second
+#define TICK_US					(1e6 / SIM_ACLK_HZ)
+#define DELAY_CODE_CYCLES		250			// wake-up and code of TIMER_sleep_ms()
+#define DELAY_ERR_US			(1.5 * TICK_US + DELAY_CODE_CYCLES * 1e6 / sim_mclk_hz)
+#define ACTIVE_US_PER_WAKE		20.0		// CPU on per wake-up of the delay
+#define DOWNLINK_S				20
+#define DOWNLINK_POLL_MS		7			// delays run while the seconds count
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const uint32_t MclkHz[] = { 1000000, 8000000, 20000000, 24000000 };
+static const uint16 DelayMs[] = { 1, 2, 10, 100, 500, 1000, 1400, 2000, 10000, 30000, 65535 };
+
+static int b_Uart;
+static unsigned long uart_irqs;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* Host UART receive interrupt: wakes the CPU, as the AT command one does */
+static void uart_isr(void)
+{
+	uart_irqs++;
+	__bic_SR_register_on_exit(LPM3_bits);
+}
+
+static void uart_next(void *arg)
+{
+	if (b_Uart)
+	{
+		sim_raise(SIM_IRQ_USER);
+		sim_at(sim_now() + sim_mclk_hz / UART_RATE, uart_next, NULL);
+	}
+}
+
+static void start(uint32_t mclk_hz, int b_WithUart)
+{
+	sim_mclk_hz = mclk_hz;
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	TIMER_timebase_init();
+	__enable_interrupt();
+	sim_user_isr = uart_isr;
+	b_Uart = b_WithUart;
+	uart_irqs = 0;
+	if (b_Uart)
+	{
+		sim_at(sim_now() + sim_mclk_hz / UART_RATE / 3, uart_next, NULL);
+	}
+}
+
+/* Delays of each length at a MCLK, returns the largest error in us */
+static double sweep(uint32_t mclk_hz, int b_WithUart, double *pActiveMax)
+{
+	double err, err_max = 0, active_us, wakes;
+	uint64_t t0, active;
+	unsigned long irqs;
+	unsigned int i, phase;
+
+	start(mclk_hz, b_WithUart);
+	srand(mclk_hz + b_WithUart);
+	for (i = 0; i < sizeof(DelayMs) / sizeof(DelayMs[0]); i++)
+	{
+		for (phase = 0; phase < NB_PHASES; phase++)
+		{
+			// Random point of the ACLK period
+			sim_advance(1 + (uint64_t)rand() % (sim_mclk_hz / SIM_ACLK_HZ + 1));
+			irqs = uart_irqs;
+			active = sim_cpu.active;
+			t0 = sim_now();
+			TIMER_sleep_ms(DelayMs[i]);
+			err = (double)(sim_now() - t0) * 1e6 / sim_mclk_hz - DelayMs[i] * 1000.0;
+			SIM_CHECK((err >= -DELAY_ERR_US) && (err <= DELAY_ERR_US), "MCLK %lu Hz%s, %u ms: %+.1f us",
+					  (unsigned long)mclk_hz, b_WithUart ? " UART" : "", DelayMs[i], err);
+			if (err > err_max || -err > err_max)
+			{
+				err_max = (err < 0) ? -err : err;
+			}
+
+			// A wake-up for each compare and each UART interrupt
+			wakes = 1 + DelayMs[i] / 2000.0 + (uart_irqs - irqs);
+			active_us = (double)(sim_cpu.active - active) * 1e6 / sim_mclk_hz;
+			SIM_CHECK(active_us <= wakes * ACTIVE_US_PER_WAKE * 24e6 / mclk_hz,
+					  "MCLK %lu Hz%s, %u ms: CPU on %.1f us for %.0f wake-ups", (unsigned long)mclk_hz,
+					  b_WithUart ? " UART" : "", DelayMs[i], active_us, wakes);
+			if (active_us / wakes > *pActiveMax)
+			{
+				*pActiveMax = active_us / wakes;
+			}
+		}
+	}
+	return err_max;
+}
+
+/* Wait counters of the delays of a frame */
+static void check_frame(void)
+{
+	static const te_DelayType Delays[] = { E_TX_DELAY, E_TX_DELAY, E_RX_DELAY, E_OOB_ACK_DELAY };
+	static const uint16 Ms[] = { 1000, 1000, 500, 1400 };
+	const TimerWaitStats_t *stats;
+	uint32 requested = 0, aclk;
+	unsigned int i;
+
+	start(SIM_MCLK_HZ, 0);
+	TIMER_wait_frame_end();
+	aclk = sim_aclk_ticks();
+	for (i = 0; i < sizeof(Delays) / sizeof(Delays[0]); i++)
+	{
+		SIM_CHECK(sfx_delay(Delays[i]) == SFX_ERR_NONE, "sfx_delay(%u)", Delays[i]);
+		requested += ((uint32)Ms[i] * TIMER_TIMEBASE_HZ + 500) / 1000;
+	}
+	aclk = sim_aclk_ticks() - aclk;
+	TIMER_wait_frame_end();
+	stats = TIMER_wait_stats();
+
+	SIM_CHECK(stats->u16_Delays == sizeof(Delays) / sizeof(Delays[0]), "frame: %u delays counted", stats->u16_Delays);
+	SIM_CHECK((stats->ul_Sleep + 1 >= requested) && (stats->ul_Sleep <= requested + 2 * stats->u16_Delays),
+			  "frame: %lu ticks slept, %lu requested", (unsigned long)stats->ul_Sleep, (unsigned long)requested);
+	SIM_CHECK((stats->ul_Sleep <= aclk + 1) && (stats->u16_LateMax <= 2), "frame: %lu ticks slept in %lu, %u late",
+			  (unsigned long)stats->ul_Sleep, (unsigned long)aclk, stats->u16_LateMax);
+	SIM_CHECK(stats->ul_Awake == 0, "frame: %lu ticks awake", (unsigned long)stats->ul_Awake);
+	printf("frame of 2 x 1000 + 500 + 1400 ms: %lu ticks slept, %lu requested, %u ticks late at most\n",
+		   (unsigned long)stats->ul_Sleep, (unsigned long)requested, stats->u16_LateMax);
+}
+
+/* Downlink seconds on CCR0 while delays run on CCR1 */
+static void check_downlink(void)
+{
+	uint64_t t0, t;
+	double err;
+
+	start(SIM_MCLK_HZ, 1);
+	t0 = sim_now();
+	TIMER_downlink_timing_init(DOWNLINK_S);
+	while (!TIMER0_timeout)
+	{
+		TIMER_sleep_ms(DOWNLINK_POLL_MS);
+		SIM_CHECK(sim_now() - t0 < (uint64_t)(DOWNLINK_S + 1) * sim_mclk_hz, "downlink: no timeout");
+		if (sim_now() - t0 >= (uint64_t)(DOWNLINK_S + 1) * sim_mclk_hz)
+		{
+			return;
+		}
+	}
+	t = sim_now();
+	err = (double)(t - t0) * 1e6 / sim_mclk_hz - DOWNLINK_S * 1e6;
+	SIM_CHECK((err >= -TICK_US) && (err <= DOWNLINK_POLL_MS * 1000 + DELAY_ERR_US),
+			  "downlink: timeout seen %+.1f us after %u s", err, DOWNLINK_S);
+	printf("downlink of %u s with %u ms delays and the UART: timeout seen %+.1f us late\n", DOWNLINK_S,
+		   DOWNLINK_POLL_MS, err);
+	TIMER_downlink_timing_stop();
+	SIM_CHECK((TA0CTL & MC_3) == MC_0, "downlink: Timer0 runs after its last user");
+	b_Uart = 0;
+}
+
+int main(void)
+{
+	double err, active;
+	unsigned int i, uart;
+
+	printf("TIMER_sleep_ms() from 1 to 65535 ms, %u ACLK phases each:\n", NB_PHASES);
+	for (i = 0; i < sizeof(MclkHz) / sizeof(MclkHz[0]); i++)
+	{
+		for (uart = 0; uart < 2; uart++)
+		{
+			active = 0;
+			err = sweep(MclkHz[i], uart, &active);
+			printf("MCLK %2lu MHz%-5s: error %5.1f us at most, CPU on %5.1f us per wake-up; "
+				   "__delay_cycles() of 500/1000/1400 ms: %.0f/%.0f/%.0f ms\n",
+				   (unsigned long)(MclkHz[i] / 1000000), uart ? " UART" : "", err, active,
+				   10000000.0 * 1e3 / MclkHz[i], 20000000.0 * 1e3 / MclkHz[i], 28000000.0 * 1e3 / MclkHz[i]);
+			b_Uart = 0;
+		}
+	}
+	check_frame();
+	check_downlink();
+	sim_mclk_hz = SIM_MCLK_HZ;
+
+	return sim_result("test_sleep_delay");
+}
@@ -0,0 +1,181 @@
+//*****************************************************************************
+//! @file       test_spi_burst.c
+//! @brief      cc112xSpiWriteRegs() against one cc112xSpiWriteReg() per
+//!				register, the writes it replaced.
+//!
+//!				Each list is written both ways from the same reset chip
+//!				and burst address increment setting: the register files
+//!				must end equal. The chip select cycles and SPI bytes of
+//!				both are counted, for random lists of the 8-bit and 0x2F
+//!				extended spaces and for the lists of radio.c: the TX and
+//!				RX settings and a frequency change.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "cc112x_spi.h"
+#include "radio.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define RANDOM_LISTS			5000
+#define CONFIG_LAST				CC112X_PKT_LEN	// last register of the 8-bit space
+#define EXT_CONFIG_LAST			0x2F39			// last register of the extended configuration
+#define BURST_ADDR_INCR_EN		0x01			// EXT_CTRL.BURST_ADDR_INCR_EN, its reset value
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned long frames;
+	unsigned long bytes;
+}Count_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static uint8_t Regs[2][0x40 + 0x40];
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static void snapshot(uint8_t *regs)
+{
+	unsigned int a;
+
+	for (a = 0; a <= CONFIG_LAST; a++)
+	{
+		regs[a] = sim_radio_reg(a);
+	}
+	for (a = 0; a <= (EXT_CONFIG_LAST & 0xFF); a++)
+	{
+		regs[0x40 + a] = sim_radio_reg(0x2F00 + a);
+	}
+}
+
+/* Reset chip and driver, then the burst address increment as the list finds it */
+static void restart(uint8 u8_ExtCtrl)
+{
+	sim_radio_reset();
+	cc112xSpiReset();
+	cc112xSpiWriteReg(CC112X_EXT_CTRL, &u8_ExtCtrl, 1);
+}
+
+static Count_t count_since(const Count_t *c)
+{
+	Count_t d = { sim_spi.frames - c->frames, sim_spi.bytes - c->bytes };
+	return d;
+}
+
+/* Writes the list both ways, *pBurst and *pSingle get the accesses of each */
+static int compare(const registerSetting_t *pRegs, uint8 count, uint8 u8_ExtCtrl,
+				   Count_t *pBurst, Count_t *pSingle)
+{
+	Count_t c;
+	uint8 i;
+
+	restart(u8_ExtCtrl);
+	c.frames = sim_spi.frames;
+	c.bytes = sim_spi.bytes;
+	cc112xSpiWriteRegs(pRegs, count);
+	*pBurst = count_since(&c);
+	snapshot(Regs[0]);
+
+	restart(u8_ExtCtrl);
+	c.frames = sim_spi.frames;
+	c.bytes = sim_spi.bytes;
+	for (i = 0; i < count; i++)
+	{
+		uint8 data = pRegs[i].data;
+
+		cc112xSpiWriteReg(pRegs[i].addr, &data, 1);
+	}
+	*pSingle = count_since(&c);
+	snapshot(Regs[1]);
+
+	return memcmp(Regs[0], Regs[1], sizeof(Regs[0])) == 0;
+}
+
+static void random_lists(void)
+{
+	registerSetting_t list[CC112X_WRITE_REGS_MAX];
+	uint8 used[0x80];
+	Count_t burst, single;
+	unsigned long burst_frames = 0, single_frames = 0;
+	unsigned int n, i, k;
+	uint8 count, ext_ctrl;
+	uint16 addr;
+
+	srand(1);
+	for (n = 0; n < RANDOM_LISTS; n++)
+	{
+		memset(used, 0, sizeof(used));
+		count = 1 + (uint8)(rand() % CC112X_WRITE_REGS_MAX);
+		for (i = 0; i < count; i++)
+		{
+			// Distinct registers, runs are likely with that many of them
+			do
+			{
+				k = (unsigned int)rand() % ((CONFIG_LAST + 1) + ((EXT_CONFIG_LAST & 0xFF) + 1));
+			} while (used[k]);
+			used[k] = 1;
+			addr = (k <= CONFIG_LAST) ? k : 0x2F00 + (k - (CONFIG_LAST + 1));
+			list[i].addr = addr;
+			list[i].data = (uint8)rand();
+			if (addr == CC112X_EXT_CTRL)
+			{
+				list[i].data &= BURST_ADDR_INCR_EN;
+			}
+		}
+		ext_ctrl = (uint8)(rand() & BURST_ADDR_INCR_EN);
+		if (!compare(list, count, ext_ctrl, &burst, &single))
+		{
+			SIM_CHECK(0, "list %u of %u registers, EXT_CTRL %02X: registers differ", n, count, ext_ctrl);
+			break;
+		}
+		SIM_CHECK(burst.frames <= single.frames + 2, "list %u: %lu CS cycles, %lu one by one", n,
+				  burst.frames, single.frames);
+		burst_frames += burst.frames;
+		single_frames += single.frames;
+	}
+	printf("%u random lists: %lu CS cycles, %lu one by one\n", RANDOM_LISTS, burst_frames, single_frames);
+}
+
+static void radio_list(const char *name, const registerSetting_t *pRegs, uint8 count, uint8 u8_ExtCtrl)
+{
+	Count_t burst, single;
+
+	SIM_CHECK(compare(pRegs, count, u8_ExtCtrl, &burst, &single), "%s: registers differ", name);
+	SIM_CHECK(burst.frames <= single.frames, "%s: more CS cycles", name);
+	printf("%-18s %2lu -> %2lu CS cycles, %3lu -> %3lu bytes\n", name, single.frames, burst.frames,
+		   single.bytes, burst.bytes);
+}
+
+int main(void)
+{
+	/* Frequency change of radio.c, FREQOFF and FREQ of a 902.2 MHz channel */
+	static const registerSetting_t Frequency[] = {
+		{ CC112X_FREQOFF1, 0x02 }, { CC112X_FREQOFF0, 0x58 },
+		{ CC112X_FREQ2, 0x70 }, { CC112X_FREQ1, 0xC6 }, { CC112X_FREQ0, 0x4A },
+	};
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+
+	random_lists();
+	radio_list("TX settings", HighPerfModeTx, sizeof(HighPerfModeTx) / sizeof(registerSetting_t),
+			   BURST_ADDR_INCR_EN);
+	radio_list("RX settings", HighPerfModeRx, sizeof(HighPerfModeRx) / sizeof(registerSetting_t),
+			   BURST_ADDR_INCR_EN);
+	radio_list("frequency, TX", Frequency, sizeof(Frequency) / sizeof(registerSetting_t), 0x00);
+	radio_list("frequency, RX", Frequency, sizeof(Frequency) / sizeof(registerSetting_t),
+			   BURST_ADDR_INCR_EN);
+
+	return sim_result("test_spi_burst");
+}
@@ -0,0 +1,111 @@
+//*****************************************************************************
+//! @file       test_tx_jitter.c
+//! @brief      Jitter of the '0' bit modulation of sfx_send(), with the
+//!				LPM0 engine and with TX_POLLING_ENGINE.
+//!
+//!				Built twice with TX_JITTER_STATS. A frame is sent with each
+//!				profile, TxJitter gives the latency between the bit rate
+//!				interrupt and the start of each modulation. Both engines
+//!				modulate out of TIMER1_A0_ISR(): its routine stays short,
+//!				and the LPM0 engine sleeps between the bits.
+//!
+//!				SysState is read through sim_sys_state() (-DSysState in the
+//!				Makefile) so the polling loop moves the time of the model.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "sigfox_demo.h"
+#include "radio.h"
+#include "timer.h"
+#include "transmission.h"
+#include "../../sigfox_library_api/sigfox.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define FRAME_SIZE				12
+#define LATENCY_MAX_US			20			// bit interrupt to modulation start
+#define ISR_MAX_CYCLES			200			// mean TIMER1_A0_ISR() routine, entry and RETI included
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const u8 Frame[FRAME_SIZE] = {
+	0x00, 0xFF, 0x5A, 0xA5, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0
+};
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static unsigned int zero_bits(void)
+{
+	unsigned int i, n = 0;
+	u8 mask;
+
+	for (i = 0; i < FRAME_SIZE; i++)
+	{
+		for (mask = 0x80; mask != 0; mask >>= 1)
+		{
+			n += !(Frame[i] & mask);
+		}
+	}
+	return n;
+}
+
+static void run_profile(te_ModProfileId e_Profile, const char *name)
+{
+	SimCpuStats_t cpu = sim_cpu;
+	unsigned int div;
+	double tick_us;
+	unsigned long isr_count;
+	uint64_t isr_mean;
+
+	SIM_CHECK(RADIO_select_profile(e_Profile), "profile %s", name);
+	div = 1U << ((RADIO_get_profile()->u16_BitClkDiv >> 6) & 3);
+	tick_us = 1e6 * div / sim_mclk_hz;
+
+	sfx_init(E_TX_MODE);
+	TIMER_bitrate_init();
+	__enable_interrupt();
+	SIM_CHECK(sfx_send((u8 *)Frame, FRAME_SIZE) == SFX_ERR_NONE, "%s: sfx_send", name);
+
+	isr_count = sim_cpu.irq[SIM_IRQ_TA1_0] - cpu.irq[SIM_IRQ_TA1_0];
+	isr_mean = isr_count ? (sim_cpu.isr - cpu.isr) / isr_count : 0;
+	printf("%s: %u '0' bits, latency %.2f..%.2f us, %lu bit interrupts of %llu cycles, "
+		   "active %.1f ms, LPM0 %.1f ms\n", name, TxJitter.count,
+		   TxJitter.min * tick_us, TxJitter.max * tick_us, isr_count, (unsigned long long)isr_mean,
+		   (sim_cpu.active - cpu.active) * 1e3 / sim_mclk_hz, (sim_cpu.lpm0 - cpu.lpm0) * 1e3 / sim_mclk_hz);
+
+	SIM_CHECK(TxJitter.count == zero_bits(), "%s: %u modulations for %u '0' bits", name,
+			  TxJitter.count, zero_bits());
+	SIM_CHECK(TxJitter.max * tick_us <= LATENCY_MAX_US, "%s: latency up to %.2f us", name,
+			  TxJitter.max * tick_us);
+	SIM_CHECK(isr_count >= FRAME_SIZE * 8, "%s: %lu bit interrupts", name, isr_count);
+	SIM_CHECK(isr_mean <= ISR_MAX_CYCLES, "%s: bit interrupt of %llu cycles", name,
+			  (unsigned long long)isr_mean);
+#ifndef TX_POLLING_ENGINE
+	SIM_CHECK(sim_cpu.lpm0 - cpu.lpm0 > (sim_cpu.active - cpu.active) / 2, "%s: the CPU does not sleep", name);
+#endif
+	SIM_CHECK(sim_radio_state() == SIM_MARC_IDLE, "%s: radio state %02X after the frame", name,
+			  sim_radio_state());
+}
+
+int main(void)
+{
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+
+	run_profile(E_PROFILE_FCC, "FCC");
+	run_profile(E_PROFILE_ETSI, "ETSI");
+
+#ifdef TX_POLLING_ENGINE
+	return sim_result("test_tx_jitter_polling");
+#else
+	return sim_result("test_tx_jitter_lpm0");
+#endif
+}
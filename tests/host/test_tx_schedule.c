@@ -0,0 +1,205 @@
+//*****************************************************************************
+//! @file       test_tx_schedule.c
+//! @brief      Symbol schedule of TxInit() / TxProcess() against the per-bit
+//!				walk of the frame it replaced (Read_Bit()).
+//!
+//!				Every frame length from 0 to TX_MAX_FRAME_SIZE is sent as
+//!				all '0', all '1', '1' runs of 255 and 256 bits and random
+//!				frames: the status of each bit period must be the one of
+//!				the reference.
+//!
+//!				Built twice: with the address sanitizer, which checks the
+//!				reads of the schedule, and with TX_SCHEDULE_BENCH, which
+//!				also times both on the host, per bit period.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "msp430.h"
+#include "sim.h"
+#include "sigfox_types.h"
+#include "transmission.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define RANDOM_FRAMES			2000		// random frames per length
+#define BENCH_FRAMES			20000
+
+/******************************************************************************
+ * VARIABLES
+ */
+/* Reference, the walk of transmission.c before the schedule */
+static unsigned int bit_index_in_frame;
+static unsigned char *tx_frame;
+static unsigned char tx_frame_size;
+
+static unsigned long modulations;
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+void RADIO_modulate(void)
+{
+	modulations++;
+}
+
+static unsigned char Read_Bit(unsigned char *frame)
+{
+	u8 index_bit;
+	u8 index_byte;
+
+	index_bit = bit_index_in_frame % 8;
+	index_byte = bit_index_in_frame / 8;
+	return ((frame[index_byte] >> (7 - index_bit)) & 0x01);
+}
+
+static void RefInit(unsigned char *frame, unsigned char u8_FrameSize)
+{
+	bit_index_in_frame = 0;
+	tx_frame = frame;
+	tx_frame_size = u8_FrameSize;
+}
+
+/* E_TX_MODULATE instead of calling RADIO_modulate() */
+static unsigned char RefProcess(void)
+{
+	unsigned char TxStatus = E_TX_IN_PROGRESS;
+
+	if (bit_index_in_frame < (tx_frame_size)*8)
+	{
+		if (0 == Read_Bit(tx_frame))
+		{
+			TxStatus = E_TX_MODULATE;
+		}
+		bit_index_in_frame++;
+	}
+	else
+	{
+		TxStatus = E_TX_END;
+	}
+	return TxStatus;
+}
+
+/* Sends the frame with both, returns 0 on the first different bit period */
+static int compare(const unsigned char *frame, unsigned char size, const char *kind)
+{
+	unsigned char *copy = malloc(size ? size : 1);	// exact size for the sanitizer
+	unsigned char status, ref;
+	unsigned int bit;
+
+	memcpy(copy, frame, size);
+	TxInit(copy, size);
+	RefInit(copy, size);
+	for (bit = 0; bit <= (unsigned int)size * 8; bit++)
+	{
+		status = TxProcess();
+		ref = RefProcess();
+		if (status != ref)
+		{
+			SIM_CHECK(0, "%s frame of %u bytes, bit %u: status %u, reference %u", kind, size, bit, status, ref);
+			free(copy);
+			return 0;
+		}
+	}
+	SIM_CHECK(status == E_TX_END, "%s frame of %u bytes not ended", kind, size);
+	free(copy);
+	return 1;
+}
+
+#ifdef TX_SCHEDULE_BENCH
+static double elapsed_ns(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+/* ns of the init, per frame, and of the bit periods, per bit */
+static void bench(unsigned char (*process)(void), void (*init)(unsigned char *, unsigned char),
+				  unsigned char frames[][TX_MAX_FRAME_SIZE], double *init_ns, double *bit_ns)
+{
+	struct timespec t0, t1;
+	unsigned int i;
+	unsigned long bits = 0;
+	unsigned char status;
+
+	*init_ns = 0;
+	*bit_ns = 0;
+	for (i = 0; i < BENCH_FRAMES; i++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		init(frames[i], TX_MAX_FRAME_SIZE);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		*init_ns += elapsed_ns(&t0, &t1);
+		do
+		{
+			status = process();
+			if (status == E_TX_MODULATE)
+			{
+				modulations++;
+			}
+			bits++;
+		} while (status != E_TX_END);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		*bit_ns += elapsed_ns(&t1, &t0);
+	}
+	*init_ns /= BENCH_FRAMES;
+	*bit_ns /= bits;
+}
+#endif
+
+int main(void)
+{
+	unsigned char frame[TX_MAX_FRAME_SIZE];
+	unsigned int size, n, i;
+#ifdef TX_SCHEDULE_BENCH
+	static unsigned char frames[BENCH_FRAMES][TX_MAX_FRAME_SIZE];
+	double init_ns, bit_ns, ref_init_ns, ref_bit_ns;
+#endif
+
+	srand(1);
+	for (size = 0; size <= TX_MAX_FRAME_SIZE; size++)
+	{
+		memset(frame, 0x00, sizeof(frame));
+		compare(frame, size, "all '0'");
+		memset(frame, 0xFF, sizeof(frame));
+		compare(frame, size, "all '1'");
+		// '1' runs longer than 255 bits, ended by a '0' bit or not
+		if (size == TX_MAX_FRAME_SIZE)
+		{
+			frame[size - 1] = 0xFE;
+			compare(frame, size, "255 '1' and '0'");
+			frame[0] = 0x7F;
+			frame[size - 1] = 0xFF;
+			compare(frame, size, "'0' and 255 '1'");
+		}
+		for (n = 0; n < RANDOM_FRAMES; n++)
+		{
+			for (i = 0; i < size; i++)
+			{
+				frame[i] = (unsigned char)rand();
+			}
+			if (!compare(frame, size, "random"))
+			{
+				break;
+			}
+		}
+	}
+
+#ifdef TX_SCHEDULE_BENCH
+	for (n = 0; n < BENCH_FRAMES; n++)
+	{
+		for (i = 0; i < TX_MAX_FRAME_SIZE; i++)
+		{
+			frames[n][i] = (unsigned char)rand();
+		}
+	}
+	bench(RefProcess, RefInit, frames, &ref_init_ns, &ref_bit_ns);
+	bench(TxProcess, TxInit, frames, &init_ns, &bit_ns);
+	printf("host, %u byte frames: TxInit() %.0f ns, TxProcess() %.2f ns per bit period; "
+		   "Read_Bit() walk %.0f ns and %.2f ns\n", TX_MAX_FRAME_SIZE,
+		   init_ns, bit_ns, ref_init_ns, ref_bit_ns);
+	return sim_result("test_tx_schedule_bench");
+#else
+	return sim_result("test_tx_schedule");
+#endif
+}
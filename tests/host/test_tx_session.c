@@ -0,0 +1,184 @@
+//*****************************************************************************
+//! @file       test_tx_session.c
+//! @brief      Radio-on and CPU busy time of a frame sent three times,
+//!				with and without RADIO_TX_SESSION.
+//!
+//!				Built twice. The library calls are replayed: for each
+//!				repeat sfx_init(TX) on a new frequency of the band and
+//!				sfx_send(), then sfx_close() and the wait for the next
+//!				frame. The repeats are sent back-to-back, then with the
+//!				sfx_delay(E_TX_DELAY) of the library between them.
+//!				The build without the session writes its counts per frame
+//!				to a file, the session build compares its own with them.
+//!
+//!				Usage:	test_tx_session_off <results to write>
+//!						test_tx_session_on <results of the build without>
+//!
+//!				SysState is read through sim_sys_state() (-DSysState in the
+//!				Makefile) so the polling loops move the time of the model.
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+#include "device_config.h"
+#include "sigfox_demo.h"
+#include "radio.h"
+#include "timer.h"
+#include "transmission.h"
+#include "../../sigfox_library_api/sigfox.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define FRAME_SIZE				SIM_FRAME_SIZE	// longest uplink frame
+#define NB_FRAMES				10
+#define NB_REPEATS				3
+#define BAND_WIDTH				192000		// Hz, around ftx
+#define NEXT_FRAME_MS			10000
+#define NB_SCENARIOS			2
+#define RADIO_ON_SLACK			0.1			// ms per frame, a synthesizer calibration less may shift the bits
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	unsigned long cals;			// synthesizer calibrations
+	unsigned long spi;			// SPI bytes
+	uint64_t on;				// cycles with the XOSC on
+	uint64_t cpu;				// cycles with the CPU on
+}Counts_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const char *const Scenarios[NB_SCENARIOS] = { "back-to-back", "sfx_delay" };
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+static void run(int b_Delay, Counts_t *pCounts)
+{
+	unsigned long cals = sim_radio.cals, spi = sim_spi.bytes;
+	uint64_t on = sim_radio_on_cycles(), cpu = sim_cpu.active;
+	unsigned int frame, repeat;
+
+	srand(1);
+	for (frame = 0; frame < NB_FRAMES; frame++)
+	{
+		for (repeat = 0; repeat < NB_REPEATS; repeat++)
+		{
+			*TxCF = ftx - BAND_WIDTH / 2 + (u32)rand() % BAND_WIDTH;
+			sfx_init(E_TX_MODE);
+			SIM_CHECK(sfx_send(sim_frame, FRAME_SIZE) == SFX_ERR_NONE, "frame %u, repeat %u: sfx_send",
+					  frame, repeat);
+			if (b_Delay && (repeat < NB_REPEATS - 1))
+			{
+				sfx_delay(E_TX_DELAY);
+			}
+		}
+		sfx_close();
+		sim_radio_log_clear();
+		SIM_CHECK((sim_radio_state() == SIM_MARC_IDLE) || (sim_radio_state() == SIM_MARC_SLEEP)
+				  || (sim_radio_state() == SIM_MARC_XOFF), "frame %u: radio state %02X after sfx_close()",
+				  frame, sim_radio_state());
+		TIMER_sleep_ms(NEXT_FRAME_MS);
+	}
+	pCounts->cals = sim_radio.cals - cals;
+	pCounts->spi = sim_spi.bytes - spi;
+	pCounts->on = sim_radio_on_cycles() - on;
+	pCounts->cpu = sim_cpu.active - cpu;
+}
+
+static void print(const char *build, const char *scenario, const Counts_t *c)
+{
+	printf("%-10s %-13s %4.2f calibrations, %4lu SPI bytes, radio on %8.3f ms, CPU busy %7.3f ms\n",
+		   build, scenario, (double)c->cals / NB_FRAMES, c->spi / NB_FRAMES,
+		   c->on * 1e3 / sim_mclk_hz / NB_FRAMES, c->cpu * 1e3 / sim_mclk_hz / NB_FRAMES);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *f;
+	Counts_t counts[NB_SCENARIOS];
+	unsigned int i;
+#ifdef RADIO_TX_SESSION
+	Counts_t ref;
+	unsigned long long on, cpu;
+#endif
+
+	if (argc != 2)
+	{
+		printf("usage: %s <results>\n", argv[0]);
+		return 2;
+	}
+	for (i = 0; i < FRAME_SIZE; i++)
+	{
+		sim_frame[i] = (u8)(0xA5 ^ (i * 37));
+	}
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	SIM_CHECK(RADIO_select_profile(E_PROFILE_FCC), "profile FCC");
+	TIMER_bitrate_init();
+	__enable_interrupt();
+
+	printf("per frame of %u repeats of %u bytes:\n", NB_REPEATS, FRAME_SIZE);
+	for (i = 0; i < NB_SCENARIOS; i++)
+	{
+		run(i, &counts[i]);
+	}
+
+#ifndef RADIO_TX_SESSION
+	f = fopen(argv[1], "w");
+	if (f == NULL)
+	{
+		printf("cannot write %s\n", argv[1]);
+		return 2;
+	}
+	for (i = 0; i < NB_SCENARIOS; i++)
+	{
+		fprintf(f, "%lu %lu %llu %llu\n", counts[i].cals, counts[i].spi, (unsigned long long)counts[i].on,
+				(unsigned long long)counts[i].cpu);
+		print("init", Scenarios[i], &counts[i]);
+	}
+	fclose(f);
+	return sim_result("test_tx_session_off");
+#else
+	f = fopen(argv[1], "r");
+	if (f == NULL)
+	{
+		printf("cannot read %s, run test_tx_session_off first\n", argv[1]);
+		return 2;
+	}
+	for (i = 0; i < NB_SCENARIOS; i++)
+	{
+		if (fscanf(f, "%lu %lu %llu %llu", &ref.cals, &ref.spi, &on, &cpu) != 4)
+		{
+			printf("cannot parse %s\n", argv[1]);
+			fclose(f);
+			return 2;
+		}
+		ref.on = on;
+		ref.cpu = cpu;
+		print("init", Scenarios[i], &ref);
+		print("session", Scenarios[i], &counts[i]);
+
+		SIM_CHECK(counts[i].spi < ref.spi, "%s: %lu SPI bytes, %lu without the session", Scenarios[i],
+				  counts[i].spi, ref.spi);
+		SIM_CHECK(counts[i].cals <= ref.cals, "%s: %lu calibrations, %lu without the session", Scenarios[i],
+				  counts[i].cals, ref.cals);
+		SIM_CHECK(counts[i].on <= ref.on + (uint64_t)(RADIO_ON_SLACK * 1e-3 * sim_mclk_hz) * NB_FRAMES,
+				  "%s: radio on longer with the session", Scenarios[i]);
+		SIM_CHECK(counts[i].cpu <= ref.cpu, "%s: CPU busy longer with the session", Scenarios[i]);
+	}
+	fclose(f);
+	// Back-to-back, the synthesizer is calibrated by the first repeat only
+	SIM_CHECK(counts[0].cals <= NB_FRAMES, "back-to-back: %lu calibrations for %u frames", counts[0].cals,
+			  NB_FRAMES);
+	return sim_result("test_tx_session_on");
+#endif
+}
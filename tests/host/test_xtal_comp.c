@@ -0,0 +1,249 @@
+//*****************************************************************************
+//! @file       test_xtal_comp.c
+//! @brief      Downlink windows caught with and without RADIO_XTAL_COMP, for
+//!				a CC112x XTAL off by a few ppm and drifting with the
+//!				temperature over a year.
+//!
+//!				Built twice. Four downlinks a day are requested, each gets
+//!				up to MAX_WINDOWS RX windows. A window is opened by
+//!				RADIO_init_chip(frx, E_RX_MODE): the LO is the frequency of
+//!				the FREQ and FREQOFF registers written, pulled by the XTAL
+//!				error. The base station is on frx:
+//!				\li within FOC_RANGE of the LO the frame is caught with
+//!					LINK_SUCCESS, falling to 0 at FOC_EDGE
+//!				\li a caught frame gives FREQOFF_EST, the offset from the
+//!					LO with 1 LSB rms of noise, or any value of the FOC
+//!					range for WRONG_LOCK of them
+//!				The frames caught go to RADIO_xtal_learn(), the misses to
+//!				RADIO_xtal_miss(), as sfx_waitframe() does. The temperature
+//!				of sfx_init() goes to RADIO_xtal_temperature().
+//!				The XTAL is an AT cut: cubic curve around 25 degC, plus the
+//!				initial error and AGEING_PPM a year. The temperature has a
+//!				seasonal, a daily and a weather swing.
+//!				These are models, the rates show how the correction
+//!				behaves, not what a device gets on the field.
+//!				radio.c is built into the test to start each case as a new
+//!				device: blank information memory, table read again.
+//!				The build without the compensation writes its rates to a
+//!				file, the compensation build compares its own with them.
+//!
+//!				Usage:	test_xtal_comp_off <results to write>
+//!						test_xtal_comp_on <results of the build without>
+//****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "radio.c"
+#include "sim.h"
+
+/******************************************************************************
+ * DEFINES
+ */
+#define DAYS					365
+#define DOWNLINKS_PER_DAY		4
+#define MAX_WINDOWS				4			// windows of a downlink request
+#define FOC_RANGE				2000.0		// Hz, frames caught
+#define FOC_EDGE				3000.0		// Hz, no frame caught past it
+#define LINK_SUCCESS			0.95		// radio link, frames caught within the FOC range
+#define WRONG_LOCK				0.03		// estimates of a wrong lock
+#define AGEING_PPM				1.0			// a year
+#define RANDOM_SLACK			0.01		// rates of both builds within the draws, once they diverge
+#define NB_CASES				(sizeof(Cases) / sizeof(Cases[0]))
+
+/* AT cut XTAL, ppm: A1 (T - 25) + A3 (T - 25)^3 */
+#define XTAL_A1					-0.09
+#define XTAL_A3					1.0e-4
+
+#if defined(RF_XTAL_FREQ_40MHZ)
+#define XOSC_HZ					40000000.0
+#else
+#define XOSC_HZ					32000000.0
+#endif
+#define LO_DIVIDER				4.0			// 820 - 960 MHz band
+#define FREQOFF_EST_HZ			(XOSC_HZ / (LO_DIVIDER * 262144.0))
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+	double ppm;					// initial XTAL error
+	double temp;				// mean temperature, degC
+}Case_t;
+
+typedef struct
+{
+	double first;				// downlinks caught by the first window
+	double caught;				// downlinks caught within MAX_WINDOWS
+	double windows;				// windows per downlink
+}Rates_t;
+
+/******************************************************************************
+ * VARIABLES
+ */
+static const Case_t Cases[] = {
+	{ -8.0, 15.0 }, { 0.0, -10.0 }, { 0.0, 15.0 }, { 0.0, 40.0 }, { 8.0, 15.0 },
+};
+
+/******************************************************************************
+ * FUNCTIONS
+ */
+extern void trxRfSpiInterfaceInit(uint8 prescalerValue);
+
+/* LO of the FREQ and FREQOFF registers, without the XTAL error */
+static double lo_hz(void)
+{
+	unsigned long freq = ((unsigned long)sim_radio_reg(CC112X_FREQ2) << 16)
+			| ((unsigned long)sim_radio_reg(CC112X_FREQ1) << 8) | sim_radio_reg(CC112X_FREQ0);
+	int16_t foff = (int16_t)(((uint16_t)sim_radio_reg(CC112X_FREQOFF1) << 8) | sim_radio_reg(CC112X_FREQOFF0));
+
+	return (freq + foff / 4.0) * XOSC_HZ / (LO_DIVIDER * 65536.0);
+}
+
+/* XTAL error at the temperature and the age, ppm */
+static double xtal_ppm(const Case_t *c, double temp, double years)
+{
+	double dt = temp - 25.0;
+
+	return c->ppm + XTAL_A1 * dt + XTAL_A3 * dt * dt * dt + AGEING_PPM * years;
+}
+
+/* FREQOFF_EST of a caught downlink: df, or anywhere in the FOC range on a
+ * wrong lock, with the noise of the estimate. Drawn without the compensation
+ * too, both builds see the same weather */
+static int16 estimate(double df)
+{
+	return (int16)lround(((sim_uniform() < WRONG_LOCK) ? FOC_RANGE * (2 * sim_uniform() - 1) : df)
+						 / FREQOFF_EST_HZ + sim_gaussian());
+}
+
+static void run(const Case_t *c, Rates_t *pRates)
+{
+	unsigned long downlinks = 0, first = 0, caught = 0, windows = 0;
+	double day, temp, weather = 0, df, p, ppm;
+	unsigned int d, k, w;
+
+	sim_seed(0x2545F491u);
+	for (d = 0; d < DAYS; d++)
+	{
+		weather = 0.9 * weather + 1.5 * sim_gaussian();
+		for (k = 0; k < DOWNLINKS_PER_DAY; k++)
+		{
+			day = d + (k + sim_uniform()) / DOWNLINKS_PER_DAY;
+			temp = c->temp - 10.0 * cos(2 * M_PI * day / DAYS) - 5.0 * cos(2 * M_PI * day) + weather;
+			ppm = xtal_ppm(c, temp, day / DAYS);
+#ifdef RADIO_XTAL_COMP
+			RADIO_xtal_temperature((int16)lround(temp * 10));
+#endif
+			downlinks++;
+			for (w = 0; w < MAX_WINDOWS; w++)
+			{
+				windows++;
+				RADIO_init_chip(frx, E_RX_MODE);
+				df = frx - lo_hz() * (1.0 + ppm * 1e-6);
+				p = (fabs(df) <= FOC_RANGE) ? LINK_SUCCESS
+						: (fabs(df) < FOC_EDGE) ? LINK_SUCCESS * (FOC_EDGE - fabs(df)) / (FOC_EDGE - FOC_RANGE) : 0;
+				if (sim_uniform() < p)
+				{
+#ifdef RADIO_XTAL_COMP
+					RADIO_xtal_learn(frx, estimate(df));
+#else
+					estimate(df);
+#endif
+					first += (w == 0);
+					caught++;
+					break;
+				}
+#ifdef RADIO_XTAL_COMP
+				RADIO_xtal_miss();
+#endif
+			}
+			RADIO_close_chip();
+		}
+	}
+	pRates->first = (double)first / downlinks;
+	pRates->caught = (double)caught / downlinks;
+	pRates->windows = (double)windows / downlinks;
+}
+
+static void print(const char *build, const Case_t *c, const Rates_t *r)
+{
+	printf("%-5s %+5.1f ppm %4.1f degC: first window %5.1f %%, within %u %5.1f %%, %4.2f windows per downlink\n",
+		   build, c->ppm, c->temp, r->first * 100, MAX_WINDOWS, r->caught * 100, r->windows);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *f;
+	Rates_t rates[NB_CASES];
+	unsigned int i;
+#ifdef RADIO_XTAL_COMP
+	Rates_t ref;
+	extern unsigned int info_array[INFO_SEGMENT_SIZE];
+#endif
+
+	if (argc != 2)
+	{
+		printf("usage: %s <results>\n", argv[0]);
+		return 2;
+	}
+
+	sim_reset();
+	trxRfSpiInterfaceInit(3);
+	printf("%u days, %u downlinks a day at %lu Hz:\n", DAYS, DOWNLINKS_PER_DAY, (unsigned long)frx);
+	for (i = 0; i < NB_CASES; i++)
+	{
+#ifdef RADIO_XTAL_COMP
+		// A new device: blank information memory, the table is read again
+		memset(info_array, 0xFF, sizeof(info_array));
+		b_XtalLoaded = false;
+		s16_XtalTemp = XTAL_TEMP_DEFAULT;
+		u8_XtalMisses = 0;
+		u8_XtalOutliers = 0;
+#endif
+		run(&Cases[i], &rates[i]);
+	}
+
+#ifndef RADIO_XTAL_COMP
+	f = fopen(argv[1], "w");
+	if (f == NULL)
+	{
+		printf("cannot write %s\n", argv[1]);
+		return 2;
+	}
+	for (i = 0; i < NB_CASES; i++)
+	{
+		fprintf(f, "%.6f %.6f %.6f\n", rates[i].first, rates[i].caught, rates[i].windows);
+		print("off", &Cases[i], &rates[i]);
+	}
+	fclose(f);
+	return sim_result("test_xtal_comp_off");
+#else
+	f = fopen(argv[1], "r");
+	if (f == NULL)
+	{
+		printf("cannot read %s, run test_xtal_comp_off first\n", argv[1]);
+		return 2;
+	}
+	for (i = 0; i < NB_CASES; i++)
+	{
+		if (fscanf(f, "%lf %lf %lf", &ref.first, &ref.caught, &ref.windows) != 3)
+		{
+			printf("cannot parse %s\n", argv[1]);
+			fclose(f);
+			return 2;
+		}
+		print("off", &Cases[i], &ref);
+		print("on", &Cases[i], &rates[i]);
+
+		SIM_CHECK(rates[i].first >= 0.9 * LINK_SUCCESS, "%+.1f ppm %.1f degC: %.1f %% by the first window",
+				  Cases[i].ppm, Cases[i].temp, rates[i].first * 100);
+		SIM_CHECK(rates[i].caught >= ref.caught - RANDOM_SLACK, "%+.1f ppm %.1f degC: %.1f %% caught, %.1f %% without",
+				  Cases[i].ppm, Cases[i].temp, rates[i].caught * 100, ref.caught * 100);
+		SIM_CHECK(rates[i].windows <= ref.windows + RANDOM_SLACK, "%+.1f ppm %.1f degC: %.2f windows per downlink, %.2f without",
+				  Cases[i].ppm, Cases[i].temp, rates[i].windows, ref.windows);
+	}
+	fclose(f);
+	return sim_result("test_xtal_comp_on");
+#endif
+}